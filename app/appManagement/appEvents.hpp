@@ -0,0 +1,40 @@
+/**
+ * @file appEvents.hpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+extern "C" {
+    #include "freertos/FreeRTOS.h"
+    #include "freertos/task.h"
+} // extern C close
+
+extern TaskHandle_t AppManagementHandle;
+
+namespace APP {
+
+// Events which wake up application management task. Delivered as task notification bits,
+// data (if any) still goes through queues.
+enum Event : uint32_t {
+    IMU_READY = 1 << 0,         // New position registered
+    SLEEP_PAUSE = 1 << 1,       // Someone wants to defer sleep
+    SLEEP_START = 1 << 2,       // Someone wants to sleep now
+    BLE_CONNECTED = 1 << 3,
+    BLE_DISCONNECTED = 1 << 4,
+};
+
+/**
+ * @brief Wake up application management task. Safe to call before the task exists.
+ */
+inline void Notify(Event event) {
+    if(AppManagementHandle != nullptr) {
+        xTaskNotify(AppManagementHandle, event, eSetBits);
+    }
+}
+
+} // namespace APP end --------------------
@@ -7,10 +7,23 @@
  * See the LICENCE file for more details.
  */
 
+#include <algorithm>
 #include "imu.hpp"
+#include "gpio.hpp"
 #include "ble.hpp"
 #include "battery.hpp"
 #include "dateTime.hpp"
+#include "timeSync.hpp"
+#include "appEvents.hpp"
+#include "sleepScheduler.hpp"
+#include "bleWindow.hpp"
+#include "wakeSchedule.hpp"
+#include "wakeStub.hpp"
+#include "powerGovernor.hpp"
+#include "telemetry.hpp"
+#include "bootProfile.hpp"
+#include "trace.hpp"
+#include "messages.hpp"
 
 extern "C" {
     #include "freertos/FreeRTOS.h"
@@ -18,26 +31,26 @@ extern "C" {
     #include "esp_sleep.h"
     #include "soc/rtc.h"
     #include "driver/rtc_io.h"
+    #include "esp_timer.h"
 } // extern C close
 
 #define TASK_STACK_DEPTH_NORMAL (4U * 1024U)
 #define TASK_STACK_DEPTH_MORE (6U * 1024U)
 #define TASK_PRIORITY_NORMAL (3U)
 
-//TODO add some info about queues
-//TODO simplify queues???
-QueueHandle_t BatteryQueue = xQueueCreate(1, sizeof(int));
-QueueHandle_t ImuReadyQueue = xQueueCreate(1, sizeof(uint8_t));
-QueueHandle_t ImuPositionQueue = xQueueCreate(1, sizeof(IMU::PositionQueueType));
-QueueHandle_t ImuPositionGetQueue = xQueueCreate(1, sizeof(uint8_t));
-QueueHandle_t ImuCalibrationInitQueue = xQueueCreate(1, sizeof(uint8_t));
-QueueHandle_t ImuCalibrationStateQueue = xQueueCreate(1, sizeof("x,xx"));
-QueueHandle_t SleepPauseQueue = xQueueCreate(1,16);
-QueueHandle_t SleepStartQueue = xQueueCreate(1, sizeof(uint8_t));
+// Data between tasks goes through BUS topics (see messages.hpp).
+// Producers wake application management task with APP::Notify
+TaskHandle_t AppManagementHandle = nullptr;
 
 namespace APP {
 
-RTC_DATA_ATTR Timestamp lastBle;
+// RTC time (WakeStub::GetRtcTime) of the last BLE link or window
+RTC_DATA_ATTR int64_t lastBle;
+// Learned usage pattern. Sets wake and BLE window intervals
+RTC_DATA_ATTR UsageHistory usageHistory;
+
+// Prove that task idles between events. Logged before sleep
+static uint32_t wakeups;
 
 static void sleep(std::chrono::duration<long long, std::micro> duration) {
     // Wake up after...
@@ -45,6 +58,9 @@ static void sleep(std::chrono::duration<long long, std::micro> duration) {
     
     // Tasks to do before going to deep sleep!
 
+    // Accelerometer keeps running for the wake stub, at low power
+    IMU::Imu::PrepareSleep();
+
     rtc_gpio_isolate(GPIO_NUM_2);
     rtc_gpio_isolate(GPIO_NUM_12);
 
@@ -52,6 +68,18 @@ static void sleep(std::chrono::duration<long long, std::micro> duration) {
         BLEDevice::deinit();
     }
 
+    BUS::LogDrops(BUS::Topics());
+    Gpio::LogStats();
+
+    TELEMETRY::BootProfile::Mark(TELEMETRY::BootProfile::Marker::Sleep);
+    auto awake = WakeStub::GetAwakeTime();
+    TELEMETRY::Telemetry::OnSleep(awake);
+
+    ESP_LOGI(__FILE__, "%s:%d. Awake %u ms (%u us since wake), %u wakeups", __func__ ,__LINE__, 
+                (unsigned int) (xTaskGetTickCount() * portTICK_PERIOD_MS),
+                (unsigned int) awake.count(), (unsigned int) wakeups);
+    TELEMETRY::Trace::Record(TELEMETRY::Trace::Event::Sleep, (uint32_t) (duration.count() / 1000),
+                                (uint32_t) (awake.count() / 1000));
     ESP_LOGI(__FILE__, "%s:%d. zzz...", __func__ ,__LINE__);
     esp_deep_sleep_start();
     // Remember - after deep sleep whole application CPU will run application from the start
@@ -60,6 +88,16 @@ static void sleep(std::chrono::duration<long long, std::micro> duration) {
 
 void AppManagementTask(void *pvParameters) {
     ESP_LOGI(__FILE__, "%s:%d. Task init", __func__ ,__LINE__);
+    AppManagementHandle = xTaskGetCurrentTaskHandle();
+    auto stubStats = WakeStub::GetStats();
+    TELEMETRY::Telemetry::OnWake(esp_sleep_get_wakeup_cause(), stubStats.wakes, stubStats.total);
+    WakeStub::LogStats();
+
+    // Clock has drifted while sleeping, remove what is predictable
+    TIMESYNC::TimeSync::Compensate();
+
+    // Before any task might use it
+    BUS::Init(BUS::Topics());
 
     TaskHandle_t imuTask;
     TaskHandle_t bleTask;
@@ -80,62 +118,87 @@ void AppManagementTask(void *pvParameters) {
     configASSERT(res);
     vTaskSuspend(bleTask);
 
-    //TODO check battery level. if below 20% sleep indefinetely/very loong
+    // Tier was chosen at previous sleep. It limits intervals and radio use of this wake
+    const auto& policy = PowerGovernor::GetPolicy();
 
     // If you want to debug device, see whats going on without it
-    // going to sleep so quick all the time: increase this cooldown!
-    // Sleep cooldown is a point in time
-    Timestamp sleepCooldown = Clock::now() + 100ms;
+    // going to sleep so quick all the time: defer with longer time!
+    // Deadlines are monotonic (esp_timer), system time updates do not affect them
+    SleepScheduler scheduler(esp_timer_get_time);
+    scheduler.Defer(SleepReason::BOOT);
+
+    WakeSchedule schedule(usageHistory);
+    // Advertise at least that often, even if nothing happened
+    const auto bleWindowPeriod = PowerGovernor::LimitBleInterval(schedule.GetBleInterval(time(NULL)));
+    // RTC clock runs through deep sleep and time syncs do not move it
+    BleWindow bleWindow([] { return (int64_t) WakeStub::GetRtcTime().count(); }, lastBle, bleWindowPeriod);
 
     for(;;) {
-        if(BLE::Ble::state == BLE::Ble::ConnectionState::CONNECTED) {
-            lastBle = Clock::now();
+        // Block until something happens or the nearest deadline (sleep, BLE window)
+        auto timeout = std::min(scheduler.GetTimeToSleep(), bleWindow.GetTimeToWindow());
+        // Round up, waking before the deadline would only cost another wakeup
+        TickType_t ticks = timeout.count() > 0 ? ConvertToTicks(timeout) + 1 : 0;
+        uint32_t events = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &events, ticks);
+        wakeups++;
+
+        if(BLE::Ble::state == BLE::Ble::ConnectionState::CONNECTED || (events & BLE_DISCONNECTED)) {
+            bleWindow.OnLink();
         }
-        // Last connection with BLE more than 5 min ago?
-        if(Clock::now() - lastBle > 5min) {
-            lastBle = Clock::now();
-            vTaskResume(bleTask);
-            // Let the BLE do the stuff
-            sleepCooldown += 5s;
+        if(events & BLE_CONNECTED) {
+            schedule.RecordConnection(time(NULL));
+        }
+        // Last connection with BLE too long ago?
+        // Without radio it is only a check-in boot, battery gets measured
+        if(bleWindow.Start()) {
+            if(policy.radio) {
+                schedule.RecordBleWindow(time(NULL));
+                vTaskResume(bleTask);
+                // Let the BLE do the stuff
+                scheduler.Defer(SleepReason::BLE_WINDOW);
+            }
         }
 
-        auto imuReady = 0;
         // IMU got new position?
-        if(xQueueReceive(ImuReadyQueue, &imuReady, 0)) {
-            vTaskResume(bleTask);
-            // vTaskResume(batteryTask);
-            sleepCooldown += 5s;
+        BUS::ImuReady imuReady;
+        // Without radio position stays saved until battery recovers
+        if((events & IMU_READY) && BUS::Receive(imuReady)) {
+            schedule.RecordFlip(time(NULL));
+            if(policy.radio) {
+                vTaskResume(bleTask);
+                scheduler.Defer(SleepReason::IMU_NEW_POSITION);
+            }
         }
 
         // Anyone delaying the sleep?
-        char msg[16] = {0};
-        if(xQueueReceive(SleepPauseQueue, msg, 0)) {
-            std::string message(msg);
-            ESP_LOGI(__FILE__, "%s:%d. Sleep deferred", __func__ ,__LINE__);
-            if(message == "imuCalibration") {
-                sleepCooldown = Clock::now() + 1min;
-            }
-            else if(message == "imuSendPosition") {
-                sleepCooldown = Clock::now() + 1s;
-            }
-            else if(message == "otaUpdate") {
-                sleepCooldown = Clock::now() + 5min;
-            }
+        BUS::SleepPause pause;
+        while((events & SLEEP_PAUSE) && BUS::Receive(pause)) {
+            ESP_LOGI(__FILE__, "%s:%d. Sleep deferred. Reason %d", __func__ ,__LINE__, (int) pause.reason);
+            scheduler.Defer(pause.reason);
         }
 
         // Someone requested immediate sleep
-        auto sleepStart = 0;
-        if(xQueueReceive(SleepStartQueue, &sleepStart, 0)) {
-            sleepCooldown = Clock::now();
+        BUS::SleepStart sleepStart;
+        if((events & SLEEP_START) && BUS::Receive(sleepStart)) {
+            scheduler.ReleaseAll();
         }
 
         // Is it the time to sleep?
-        // WILL SLEEP IMMEDIATELY IF SYSTEM TIME WAS UPDATED!
-        //TODO fix it? ^
-        if(Clock::now() >= sleepCooldown) {
-            sleep(20s);
+        if(scheduler.IsSleepAllowed()) {
+            // Battery estimated in this wake picks the tier of the next one
+            PowerGovernor::Update(BATTERY::Battery::GetLastPercent(), WakeStub::GetRtcTime());
+            auto interval = PowerGovernor::LimitWakeInterval(schedule.GetWakeInterval(time(NULL)));
+            // Idle wakes are handled by the stub, application boots when cube moves or BLE window is due
+            std::array<int16_t, 3> resting;
+            int16_t threshold;
+            if(IMU::GetRestingOrientation(resting, threshold)) {
+                WakeStub::Arm(resting, threshold, interval, bleWindow.GetTimeToWindow());
+            }
+            else {
+                WakeStub::Disarm();
+            }
+            sleep(interval);
         }
-        TaskDelay(10ms);
     }
 }
 
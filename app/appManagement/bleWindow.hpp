@@ -0,0 +1,69 @@
+/**
+ * @file bleWindow.hpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+// No ESP-IDF dependencies here. Clock is passed in, so it can be run on host with a fake one.
+
+#include <chrono>
+#include <cstdint>
+
+namespace APP {
+
+/**
+ * @brief Periodic BLE window. Device advertises if the last link is older than the period.
+ *      Time of the last link is kept by the caller across deep sleep (RTC memory), so the
+ *      clock must be monotonic through sleep too: RTC slow clock, not system time which
+ *      jumps with every time sync.
+ */
+class BleWindow {
+public:
+    // Monotonic time in microseconds since power on (WakeStub::GetRtcTime on target)
+    typedef int64_t (*NowFunc)();
+
+    BleWindow() = delete;
+    BleWindow(NowFunc _now, int64_t& _last, std::chrono::microseconds _period) :
+            now(_now), last(_last), period(_period.count()) {};
+
+    /**
+     * @brief Link is up or has just gone down. Next window is a period from now.
+     */
+    void OnLink() {
+        last = now();
+    }
+
+    /**
+     * @return true if the window is due. Next one is a period from now
+     */
+    bool Start() {
+        const int64_t time = now();
+        // Later than now only if RTC memory outlived the clock, take it as due
+        if(time - last > period || time < last) {
+            last = time;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @return Time left to the window, zero if due. Never more than the period
+     */
+    std::chrono::microseconds GetTimeToWindow() const {
+        const int64_t elapsed = now() - last;
+        const int64_t left = elapsed < 0 ? 0 : period - elapsed;
+        return std::chrono::microseconds(left > 0 ? left : 0);
+    }
+
+private:
+    NowFunc now;
+    int64_t& last;
+    int64_t period;
+};
+
+} // namespace APP end --------------------
@@ -0,0 +1,68 @@
+/**
+ * @file powerGovernor.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#include "powerGovernor.hpp"
+#include "telemetry.hpp"
+
+extern "C" {
+    #include "esp_attr.h"
+    #include "esp_log.h"
+} // extern C close
+
+using namespace APP;
+using PROTOCOL::PowerTier;
+
+// Zeroed at power on: Normal until battery is measured
+RTC_DATA_ATTR PowerTier tier;
+
+const std::array<PowerPolicy, (size_t) PowerTier::Count> PowerGovernor::policies = {{
+    // Normal. Whatever WakeSchedule learned
+    {100, 0s, 0s, 0, true, true},
+    // Saving
+    {40, 30s, 15min, 500, true, true},
+    // Low. Firmware update takes minutes of connection, not now
+    {20, 60s, 60min, 1000, false, true},
+    // Protect. Boot once a day to measure battery, cube flips boot it too
+    {5, 120s, 24h, 0, false, false},
+}};
+
+PowerTier PowerGovernor::Select(PowerTier current, int percent) {
+    size_t selected = 0;
+    for(size_t i = 1; i < policies.size(); i++) {
+        uint8_t threshold = policies[i].enterBelow;
+        // Leaving a tier upwards needs more than entering it
+        if(i <= (size_t) current) threshold += hysteresis;
+        if(percent < threshold) selected = i;
+    }
+    return (PowerTier) selected;
+}
+
+PowerTier PowerGovernor::Update(int percent, std::chrono::microseconds rtcTime) {
+    if(percent >= 0) {
+        auto selected = Select(tier, percent);
+        if(selected != tier) {
+            ESP_LOGI(__FILE__, "%s:%d. Battery %d%%, tier %d", __func__ ,__LINE__, percent, (int) selected);
+            tier = selected;
+        }
+    }
+    TELEMETRY::Telemetry::SetPowerTier(tier, rtcTime);
+    return tier;
+}
+
+PowerTier PowerGovernor::GetTier() {
+    return tier;
+}
+
+const PowerPolicy& PowerGovernor::GetPolicy() {
+    return GetPolicy(tier);
+}
+
+const PowerPolicy& PowerGovernor::GetPolicy(PowerTier _tier) {
+    return policies[(size_t) _tier < policies.size() ? (size_t) _tier : 0];
+}
@@ -0,0 +1,85 @@
+/**
+ * @file powerGovernor.hpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include "protocol.hpp"
+
+namespace APP {
+
+using namespace std::literals::chrono_literals;
+
+/**
+ * @brief What device may do in a power tier.
+ */
+struct PowerPolicy {
+    uint8_t enterBelow;                     // Battery [%] below which tier is entered
+    std::chrono::seconds minWakeInterval;   // Position checks not more often than that
+    std::chrono::seconds minBleInterval;    // BLE windows (or check-in boots without radio) not more often
+    uint16_t advertisingInterval;           // [ms], 0 - stack default
+    bool ota;                               // Firmware update allowed
+    bool radio;                             // BLE allowed. Without it positions are only recorded
+};
+
+/**
+ * @brief Maps battery level to operating tier. Firebeetle has no protection circuit,
+ *      so the lower the battery, the less the device does. Tier is kept in RTC memory,
+ *      it is changed before sleep (with estimate of that wake) and applies from next wake.
+ */
+class PowerGovernor {
+public:
+    // Tier goes up only when battery is that much above its threshold. Voltage recovers when load is gone
+    const static constexpr uint8_t hysteresis = 5;
+
+    // Indexed by PROTOCOL::PowerTier
+    static const std::array<PowerPolicy, (size_t) PROTOCOL::PowerTier::Count> policies;
+
+    /**
+     * @brief Pick the tier for the battery level and account time spent in the current one.
+     * @param percent battery level, negative if unknown (tier is kept)
+     * @param rtcTime RTC time (WakeStub::GetRtcTime)
+     * @return Tier from now on
+     */
+    static PROTOCOL::PowerTier Update(int percent, std::chrono::microseconds rtcTime);
+
+    /**
+     * @return Tier for battery level, given the current one (hysteresis)
+     */
+    static PROTOCOL::PowerTier Select(PROTOCOL::PowerTier current, int percent);
+
+    static PROTOCOL::PowerTier GetTier();
+
+    static const PowerPolicy& GetPolicy();
+
+    /**
+     * @return Policy of the tier, of Normal if tier is out of range (RTC memory not valid)
+     */
+    static const PowerPolicy& GetPolicy(PROTOCOL::PowerTier tier);
+
+    /**
+     * @return Interval stretched to the minimum of the current tier
+     */
+    static std::chrono::seconds LimitWakeInterval(std::chrono::seconds interval) {
+        auto min = GetPolicy().minWakeInterval;
+        return interval > min ? interval : min;
+    }
+
+    /**
+     * @return Interval stretched to the minimum of the current tier
+     */
+    static std::chrono::seconds LimitBleInterval(std::chrono::seconds interval) {
+        auto min = GetPolicy().minBleInterval;
+        return interval > min ? interval : min;
+    }
+};
+
+} // namespace APP end --------------------
@@ -0,0 +1,149 @@
+/**
+ * @file sleepScheduler.hpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+// No ESP-IDF dependencies here. Clock is passed in, so scheduler can be run on host with a fake one.
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace APP {
+
+using namespace std::literals::chrono_literals;
+
+// Why device stays awake. Sent with BUS::SleepPause
+enum class SleepReason : uint8_t {
+    BOOT,               // Let the tasks start
+    BLE_WINDOW,         // Periodic advertising
+    IMU_NEW_POSITION,   // New position registered, give BLE a chance to send it
+    IMU_SEND_POSITION,  // Position was read by client, more might follow
+    IMU_CALIBRATION,    // Calibration in progress
+    OTA_UPDATE,         // Firmware update in progress
+    COUNT
+};
+
+class SleepScheduler {
+public:
+    // Monotonic time in microseconds (esp_timer_get_time on target)
+    typedef int64_t (*NowFunc)();
+
+    SleepScheduler() = delete;
+    SleepScheduler(NowFunc _now) : now(_now) {
+        deadlines.fill(0);
+    };
+
+    /**
+     * @return How long given reason keeps device awake
+     */
+    static constexpr std::chrono::microseconds GetDeferTime(SleepReason reason) {
+        return reason == SleepReason::BOOT ? std::chrono::microseconds(100ms) :
+                reason == SleepReason::BLE_WINDOW ? std::chrono::microseconds(5s) :
+                reason == SleepReason::IMU_NEW_POSITION ? std::chrono::microseconds(5s) :
+                reason == SleepReason::IMU_SEND_POSITION ? std::chrono::microseconds(1s) :
+                reason == SleepReason::IMU_CALIBRATION ? std::chrono::microseconds(1min) :
+                reason == SleepReason::OTA_UPDATE ? std::chrono::microseconds(5min) :
+                std::chrono::microseconds(0);
+    }
+
+    /**
+     * @brief Keep device awake for default time of given reason. See Defer(reason, duration).
+     */
+    void Defer(SleepReason reason) {
+        Defer(reason, GetDeferTime(reason));
+    }
+
+    /**
+     * @brief Keep device awake for at least duration from now. Deadline of the reason
+     *      is only moved forward (later one wins), other reasons are not affected.
+     */
+    void Defer(SleepReason reason, std::chrono::microseconds duration) {
+        if(reason >= SleepReason::COUNT) return;
+        int64_t deadline = now() + duration.count();
+        auto& current = deadlines[(size_t) reason];
+        if(deadline > current) {
+            current = deadline;
+        }
+    }
+
+    /**
+     * @brief Reason no longer needs device awake.
+     */
+    void Release(SleepReason reason) {
+        if(reason >= SleepReason::COUNT) return;
+        deadlines[(size_t) reason] = 0;
+    }
+
+    /**
+     * @brief Drop all reasons. Device goes to sleep at next check.
+     */
+    void ReleaseAll() {
+        deadlines.fill(0);
+    }
+
+    /**
+     * @return true if no reason keeps device awake
+     */
+    bool IsSleepAllowed() const {
+        return GetAwakeReasons() == 0;
+    }
+
+    /**
+     * @return Time left until sleep is allowed, zero if it already is
+     */
+    std::chrono::microseconds GetTimeToSleep() const {
+        int64_t left = GetDeadline() - now();
+        return std::chrono::microseconds(left > 0 ? left : 0);
+    }
+
+    /**
+     * @return Point in time (NowFunc) at which the last reason expires
+     */
+    int64_t GetDeadline() const {
+        int64_t latest = 0;
+        for(auto deadline : deadlines) {
+            if(deadline > latest) latest = deadline;
+        }
+        return latest;
+    }
+
+    /**
+     * @return Bit mask of reasons keeping device awake, bit number = SleepReason
+     */
+    uint32_t GetAwakeReasons() const {
+        int64_t time = now();
+        uint32_t mask = 0;
+        for(size_t i = 0; i < deadlines.size(); i++) {
+            if(deadlines[i] > time) mask |= 1 << i;
+        }
+        return mask;
+    }
+
+    /**
+     * @return Reason with the latest deadline, COUNT if none is active
+     */
+    SleepReason GetDominantReason() const {
+        int64_t latest = now();
+        SleepReason dominant = SleepReason::COUNT;
+        for(size_t i = 0; i < deadlines.size(); i++) {
+            if(deadlines[i] > latest) {
+                latest = deadlines[i];
+                dominant = (SleepReason) i;
+            }
+        }
+        return dominant;
+    }
+
+private:
+    NowFunc now;
+    std::array<int64_t, (size_t) SleepReason::COUNT> deadlines;
+};
+
+} // namespace APP end --------------------
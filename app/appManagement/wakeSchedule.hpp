@@ -0,0 +1,173 @@
+/**
+ * @file wakeSchedule.hpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+// No ESP-IDF dependencies here. Time is passed in, so schedule can be run on host.
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+
+namespace APP {
+
+using namespace std::literals::chrono_literals;
+
+/**
+ * @brief Per hour of day usage counters. Kept in RTC memory (zeroed at power on).
+ *      Counters decay daily, so old habits fade out in about a week.
+ */
+struct UsageHistory {
+    std::array<uint8_t, 24> flips;      // Positions registered
+    std::array<uint8_t, 24> windows;    // BLE windows opened
+    std::array<uint8_t, 24> syncs;      // BLE windows with client connected
+    uint32_t lastDecayDay;
+};
+
+// Hard bounds. Whatever history says, intervals stay within
+const static constexpr std::chrono::seconds minWakeInterval = 10s;
+const static constexpr std::chrono::seconds maxWakeInterval = 120s;
+const static constexpr std::chrono::seconds defaultWakeInterval = 20s;
+const static constexpr std::chrono::seconds minBleInterval = 2min;
+const static constexpr std::chrono::seconds maxBleInterval = 60min;
+const static constexpr std::chrono::seconds defaultBleInterval = 5min;
+
+// Before that time clock was not synced. Hour of day is unknown, history is useless
+const static constexpr time_t validTime = 1672531200; // 2023-01-01
+// Each event adds that much to its counter. Leaves room for fractions when decaying
+const static constexpr uint8_t eventWeight = 4;
+// Less events than that in whole history - not enough to learn from
+const static constexpr unsigned int minHistory = 16 * eventWeight;
+
+class WakeSchedule {
+public:
+    WakeSchedule() = delete;
+    WakeSchedule(UsageHistory& _history) : history(_history) {};
+
+    void RecordFlip(time_t now) {
+        record(history.flips, now);
+    }
+
+    void RecordBleWindow(time_t now) {
+        record(history.windows, now);
+    }
+
+    void RecordConnection(time_t now) {
+        record(history.syncs, now);
+    }
+
+    /**
+     * @return Time to sleep before next wake (position check)
+     */
+    std::chrono::seconds GetWakeInterval(time_t now) const {
+        float likelihood = 0;
+        if(!getLikelihood(history.flips, now, likelihood)) {
+            return defaultWakeInterval;
+        }
+        return interpolate(minWakeInterval, maxWakeInterval, likelihood);
+    }
+
+    /**
+     * @return Time between BLE windows when nothing happens
+     */
+    std::chrono::seconds GetBleInterval(time_t now) const {
+        float likelihood = 0;
+        if(!getSyncLikelihood(now, likelihood)) {
+            return defaultBleInterval;
+        }
+        // Client is mostly around when cube is used. Flips make connection likely too
+        float flips = 0;
+        if(getLikelihood(history.flips, now, flips) && flips > likelihood) {
+            likelihood = flips;
+        }
+        return interpolate(minBleInterval, maxBleInterval, likelihood);
+    }
+
+private:
+    UsageHistory& history;
+
+    static unsigned int hourOf(time_t time) {
+        return (unsigned int) ((time / 3600) % 24);
+    }
+
+    static std::chrono::seconds interpolate(std::chrono::seconds min, std::chrono::seconds max, float likelihood) {
+        // Likely activity - short interval, unlikely - long
+        return std::chrono::seconds((long long) (max.count() - (max.count() - min.count()) * likelihood));
+    }
+
+    /**
+     * @brief Activity in current and next hour compared to the busiest hour.
+     * @return false if clock is not synced or history is too short
+     */
+    bool getLikelihood(const std::array<uint8_t, 24>& counters, time_t now, float& likelihood) const {
+        if(now < validTime) return false;
+
+        unsigned int total = 0;
+        uint8_t busiest = 0;
+        for(auto count : counters) {
+            total += count;
+            if(count > busiest) busiest = count;
+        }
+        if(total < minHistory || busiest == 0) return false;
+
+        auto hour = hourOf(now);
+        // Sleep might span into next hour, look ahead
+        uint8_t current = counters[hour] > counters[(hour + 1) % 24] ? counters[hour] : counters[(hour + 1) % 24];
+        likelihood = (float) current / busiest;
+        return true;
+    }
+
+    /**
+     * @brief Share of BLE windows in current and next hour which ended with a connection.
+     * @return false if clock is not synced or history is too short
+     */
+    bool getSyncLikelihood(time_t now, float& likelihood) const {
+        if(now < validTime) return false;
+
+        unsigned int total = 0;
+        for(auto count : history.windows) total += count;
+        if(total < minHistory) return false;
+
+        auto hour = hourOf(now);
+        likelihood = 0;
+        for(auto h : {hour, (hour + 1) % 24}) {
+            if(history.windows[h] == 0) continue;
+            float rate = (float) history.syncs[h] / history.windows[h];
+            if(rate > likelihood) likelihood = rate;
+        }
+        if(likelihood > 1) likelihood = 1;
+        return true;
+    }
+
+    void decay(time_t now) {
+        uint32_t day = (uint32_t) (now / 86400);
+        if(day == history.lastDecayDay) return;
+
+        // Each day counters drop to 3/4 (drop rounded up, so single events fade out within a week)
+        auto days = day > history.lastDecayDay ? day - history.lastDecayDay : 1;
+        for(uint32_t i = 0; i < days && i < 16; i++) {
+            for(size_t h = 0; h < 24; h++) {
+                history.flips[h] -= (history.flips[h] + 3) / 4;
+                history.windows[h] -= (history.windows[h] + 3) / 4;
+                history.syncs[h] -= (history.syncs[h] + 3) / 4;
+            }
+        }
+        history.lastDecayDay = day;
+    }
+
+    void record(std::array<uint8_t, 24>& counters, time_t now) {
+        if(now < validTime) return;
+        decay(now);
+        auto& counter = counters[hourOf(now)];
+        counter = counter > UINT8_MAX - eventWeight ? UINT8_MAX : counter + eventWeight;
+    }
+};
+
+} // namespace APP end --------------------
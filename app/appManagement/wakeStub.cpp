@@ -0,0 +1,312 @@
+/**
+ * @file wakeStub.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#include "wakeStub.hpp"
+
+extern "C" {
+    #include "esp_attr.h"
+    #include "esp_log.h"
+    #include "esp_sleep.h"
+    #include "esp_rom_sys.h"
+    #include "esp32/rom/rtc.h"
+    #include "soc/rtc.h"
+    #include "soc/rtc_cntl_reg.h"
+    #include "soc/gpio_reg.h"
+    #include "soc/gpio_sig_map.h"
+    #include "soc/io_mux_reg.h"
+} // extern C close
+
+// Everything called from the stub lives in RTC memory (RTC_IRAM_ATTR, RTC_DATA_ATTR) or ROM.
+// Flash is not available yet: no IDF drivers, no logs, no libgcc helpers (64 bit division!),
+// no out of line std:: calls. Keep it plain.
+
+using namespace APP;
+
+namespace {
+
+// Same pins as IMU::Imu
+constexpr uint32_t pinSda = 21;
+constexpr uint32_t pinScl = 22;
+constexpr uint32_t sda = BIT(pinSda);
+constexpr uint32_t scl = BIT(pinScl);
+// Half of SCL period. ~100 kHz
+constexpr uint32_t halfPeriodUs = 5;
+// MPU6050 register map. See mpu6050.hpp
+constexpr uint8_t mpuAddress = 0x68;
+constexpr uint8_t mpuAccelXoutH = 0x3B;
+
+constexpr uint32_t armedMagic = 0x57414B45;
+
+struct StubState {
+    uint32_t armed;             // armedMagic if application left valid data
+    int16_t resting[3];         // Raw accelerometer readings
+    int16_t threshold;
+    uint64_t interval;          // RTC slow clock ticks
+    uint64_t bleDeadline;       // RTC time at which application must boot
+    uint64_t wakeTime;          // RTC time of the latest wake
+    uint32_t wakes;             // Handled by the stub since application boot
+    uint32_t lastDuration;      // Ticks from wake to sleep
+    uint32_t maxDuration;
+    uint32_t totalDuration;
+};
+
+} // namespace end --------------------
+
+RTC_DATA_ATTR StubState stubState;
+
+// RTC time --------------------------------------------------------------------
+
+static uint64_t RTC_IRAM_ATTR rtcTime() {
+    SET_PERI_REG_MASK(RTC_CNTL_TIME_UPDATE_REG, RTC_CNTL_TIME_UPDATE);
+    while(GET_PERI_REG_MASK(RTC_CNTL_TIME_UPDATE_REG, RTC_CNTL_TIME_VALID) == 0) {
+        // Might take one slow clock period
+        esp_rom_delay_us(1);
+    }
+    SET_PERI_REG_MASK(RTC_CNTL_INT_CLR_REG, RTC_CNTL_TIME_VALID_INT_CLR);
+    return READ_PERI_REG(RTC_CNTL_TIME0_REG) | ((uint64_t) READ_PERI_REG(RTC_CNTL_TIME1_REG) << 32);
+}
+
+static bool RTC_IRAM_ATTR isTimerWake() {
+    return REG_GET_FIELD(RTC_CNTL_WAKEUP_STATE_REG, RTC_CNTL_WAKEUP_CAUSE) & RTC_TIMER_TRIG_EN;
+}
+
+// Bit-banged I2C --------------------------------------------------------------
+// Open drain emulated: output latch is 0, line is driven low by enabling the output,
+// released (pulled high) by disabling it
+
+static void RTC_IRAM_ATTR release(uint32_t line) {
+    REG_WRITE(GPIO_ENABLE_W1TC_REG, line);
+}
+
+static void RTC_IRAM_ATTR pull(uint32_t line) {
+    REG_WRITE(GPIO_ENABLE_W1TS_REG, line);
+}
+
+static bool RTC_IRAM_ATTR isHigh(uint32_t line) {
+    return REG_READ(GPIO_IN_REG) & line;
+}
+
+static void RTC_IRAM_ATTR delay() {
+    esp_rom_delay_us(halfPeriodUs);
+}
+
+static void RTC_IRAM_ATTR releaseScl() {
+    release(scl);
+    // Slave might stretch the clock. Do not wait forever
+    for(int i = 0; i < 100 && !isHigh(scl); i++) {
+        esp_rom_delay_us(1);
+    }
+}
+
+static void RTC_IRAM_ATTR busInit() {
+    PIN_FUNC_SELECT(PERIPHS_IO_MUX_GPIO21_U, PIN_FUNC_GPIO);
+    PIN_FUNC_SELECT(PERIPHS_IO_MUX_GPIO22_U, PIN_FUNC_GPIO);
+    PIN_INPUT_ENABLE(PERIPHS_IO_MUX_GPIO21_U);
+    PIN_INPUT_ENABLE(PERIPHS_IO_MUX_GPIO22_U);
+    PIN_PULLUP_EN(PERIPHS_IO_MUX_GPIO21_U);
+    PIN_PULLUP_EN(PERIPHS_IO_MUX_GPIO22_U);
+    REG_WRITE(GPIO_FUNC0_OUT_SEL_CFG_REG + pinSda * 4, SIG_GPIO_OUT_IDX);
+    REG_WRITE(GPIO_FUNC0_OUT_SEL_CFG_REG + pinScl * 4, SIG_GPIO_OUT_IDX);
+    REG_WRITE(GPIO_OUT_W1TC_REG, sda | scl);
+    release(sda | scl);
+    delay();
+
+    // Slave reset in the middle of a read might hold SDA. Clock it out
+    for(int i = 0; i < 9 && !isHigh(sda); i++) {
+        pull(scl);
+        delay();
+        releaseScl();
+        delay();
+    }
+}
+
+static void RTC_IRAM_ATTR busStart() {
+    // Also repeated start: both lines released first
+    release(sda);
+    delay();
+    releaseScl();
+    delay();
+    pull(sda);
+    delay();
+    pull(scl);
+}
+
+static void RTC_IRAM_ATTR busStop() {
+    pull(sda);
+    delay();
+    releaseScl();
+    delay();
+    release(sda);
+    delay();
+}
+
+static void RTC_IRAM_ATTR writeBit(bool bit) {
+    bit ? release(sda) : pull(sda);
+    delay();
+    releaseScl();
+    delay();
+    pull(scl);
+}
+
+static bool RTC_IRAM_ATTR readBit() {
+    release(sda);
+    delay();
+    releaseScl();
+    delay();
+    bool bit = isHigh(sda);
+    pull(scl);
+    return bit;
+}
+
+/**
+ * @return true if slave acknowledged
+ */
+static bool RTC_IRAM_ATTR writeByte(uint8_t byte) {
+    for(int i = 7; i >= 0; i--) {
+        writeBit((byte >> i) & 1);
+    }
+    return !readBit();
+}
+
+static uint8_t RTC_IRAM_ATTR readByte(bool ack) {
+    uint8_t byte = 0;
+    for(int i = 0; i < 8; i++) {
+        byte = (byte << 1) | readBit();
+    }
+    writeBit(!ack);
+    return byte;
+}
+
+static bool RTC_IRAM_ATTR readAcceleration(int16_t acc[3]) {
+    busInit();
+
+    busStart();
+    bool ok = writeByte(mpuAddress << 1) && writeByte(mpuAccelXoutH);
+    if(ok) {
+        busStart();
+        ok = writeByte(mpuAddress << 1 | 1);
+    }
+    if(ok) {
+        // XOUT_H, XOUT_L, YOUT_H ... big endian
+        for(int i = 0; i < 3; i++) {
+            uint8_t high = readByte(true);
+            uint8_t low = readByte(i < 2);
+            acc[i] = (int16_t) (high << 8 | low);
+        }
+    }
+    busStop();
+    // Leave the pins to I2C driver
+    release(sda | scl);
+    return ok;
+}
+
+// Stub ------------------------------------------------------------------------
+
+static bool RTC_IRAM_ATTR isResting() {
+    int16_t acc[3];
+    if(!readAcceleration(acc)) {
+        return false;
+    }
+    for(int i = 0; i < 3; i++) {
+        int diff = acc[i] - stubState.resting[i];
+        if(diff > stubState.threshold || diff < -stubState.threshold) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void RTC_IRAM_ATTR sleepUntil(uint64_t time) {
+    WRITE_PERI_REG(RTC_CNTL_SLP_TIMER0_REG, time & UINT32_MAX);
+    WRITE_PERI_REG(RTC_CNTL_SLP_TIMER1_REG, time >> 32);
+
+    // Same stub handles next wake. Power domains and wake sources are kept
+    // from the sleep application has configured
+    REG_WRITE(RTC_ENTRY_ADDR_REG, (uint32_t) &esp_wake_deep_sleep);
+    set_rtc_memory_crc();
+
+    CLEAR_PERI_REG_MASK(RTC_CNTL_STATE0_REG, RTC_CNTL_SLEEP_EN);
+    SET_PERI_REG_MASK(RTC_CNTL_STATE0_REG, RTC_CNTL_SLEEP_EN);
+    // Takes a few cycles to power down
+    while(true) {}
+}
+
+extern "C" void RTC_IRAM_ATTR esp_wake_deep_sleep(void) {
+    uint64_t now = rtcTime();
+    stubState.wakeTime = now;
+
+    if(stubState.armed == armedMagic && isTimerWake() && now < stubState.bleDeadline && isResting()) {
+        // Nothing moved, nothing to send. Back to sleep
+        uint64_t wake = now + stubState.interval;
+        if(wake > stubState.bleDeadline) {
+            wake = stubState.bleDeadline;
+        }
+        stubState.wakes++;
+        uint32_t duration = (uint32_t) (rtcTime() - now);
+        stubState.lastDuration = duration;
+        stubState.totalDuration += duration;
+        if(duration > stubState.maxDuration) {
+            stubState.maxDuration = duration;
+        }
+        sleepUntil(wake);
+    }
+
+    // Something to do. Regular boot (default stub waits for the flash to power up)
+    esp_default_wake_deep_sleep();
+}
+
+// Application side ------------------------------------------------------------
+
+void WakeStub::Arm(const std::array<int16_t, 3>& resting, int16_t threshold,
+                    std::chrono::microseconds interval, std::chrono::microseconds toBle) {
+    // Stub can't divide 64 bit numbers, hand over ticks
+    uint32_t calibration = REG_READ(RTC_SLOW_CLK_CAL_REG);
+    uint64_t now = rtc_time_get();
+
+    for(size_t i = 0; i < resting.size(); i++) {
+        stubState.resting[i] = resting[i];
+    }
+    stubState.threshold = threshold;
+    stubState.interval = rtc_time_us_to_slowclk(interval.count(), calibration);
+    stubState.bleDeadline = now + rtc_time_us_to_slowclk(toBle.count() > 0 ? toBle.count() : 0, calibration);
+    stubState.armed = armedMagic;
+}
+
+void WakeStub::Disarm() {
+    stubState.armed = 0;
+}
+
+std::chrono::microseconds WakeStub::GetAwakeTime() {
+    uint32_t calibration = REG_READ(RTC_SLOW_CLK_CAL_REG);
+    return std::chrono::microseconds(rtc_time_slowclk_to_us(rtc_time_get() - stubState.wakeTime, calibration));
+}
+
+std::chrono::microseconds WakeStub::GetRtcTime() {
+    uint32_t calibration = REG_READ(RTC_SLOW_CLK_CAL_REG);
+    return std::chrono::microseconds(rtc_time_slowclk_to_us(rtc_time_get(), calibration));
+}
+
+WakeStub::Stats WakeStub::GetStats() {
+    uint32_t calibration = REG_READ(RTC_SLOW_CLK_CAL_REG);
+    return Stats {
+        .wakes = stubState.wakes,
+        .total = std::chrono::microseconds(rtc_time_slowclk_to_us(stubState.totalDuration, calibration)),
+        .last = std::chrono::microseconds(rtc_time_slowclk_to_us(stubState.lastDuration, calibration)),
+        .max = std::chrono::microseconds(rtc_time_slowclk_to_us(stubState.maxDuration, calibration)),
+    };
+}
+
+void WakeStub::LogStats() {
+    auto stats = GetStats();
+    ESP_LOGI(__FILE__, "%s:%d. Stub wakes %u, wake to sleep last %u us, max %u us", __func__ ,__LINE__,
+                (unsigned int) stats.wakes, (unsigned int) stats.last.count(), (unsigned int) stats.max.count());
+    stubState.wakes = 0;
+    stubState.maxDuration = 0;
+    stubState.totalDuration = 0;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file wakeStub.hpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace APP {
+
+/**
+ * @brief Deep sleep wake stub. Runs from RTC fast memory before the bootloader.
+ *      Reads accelerometer with bit-banged I2C, if cube rests as it was and no BLE window
+ *      is due - goes back to sleep without booting the application.
+ *      Application arms it before each sleep.
+ */
+class WakeStub {
+public:
+    struct Stats {
+        uint32_t wakes;                     // Handled by the stub since application boot
+        std::chrono::microseconds total;    // Wake to sleep, all of them
+        std::chrono::microseconds last;
+        std::chrono::microseconds max;
+    };
+
+    /**
+     * @brief Let the stub handle following wakes.
+     * @param resting raw accelerometer readings (MPU6050 ACCEL_XOUT..ZOUT) of resting orientation
+     * @param threshold max difference of raw reading on any axis to treat cube as not moved
+     * @param interval time between wakes
+     * @param toBle time left to next BLE window, application boots then
+     */
+    static void Arm(const std::array<int16_t, 3>& resting, int16_t threshold,
+                    std::chrono::microseconds interval, std::chrono::microseconds toBle);
+
+    /**
+     * @brief Boot application on next wake.
+     */
+    static void Disarm();
+
+    /**
+     * @return Time since this wake (ROM, bootloader and application start included)
+     */
+    static std::chrono::microseconds GetAwakeTime();
+
+    /**
+     * @return RTC time since power on. Monotonic, runs through deep sleep, time syncs do not move it
+     */
+    static std::chrono::microseconds GetRtcTime();
+
+    /**
+     * @return Wakes handled by the stub since application boot
+     */
+    static Stats GetStats();
+
+    /**
+     * @brief Log how many wakes stub handled since last application boot and how long it took.
+     */
+    static void LogStats();
+};
+
+} // namespace APP end --------------------
@@ -9,6 +9,8 @@
 
 #include "battery.hpp"
 #include "dateTime.hpp"
+#include "messages.hpp"
+#include <algorithm>
 
 extern "C" {
   #include "freertos/FreeRTOS.h"
@@ -18,47 +20,91 @@ extern "C" {
 
 using namespace BATTERY;
 
-extern QueueHandle_t BatteryQueue;
+// Filtered open circuit voltage [mV]. Zeroed at power on
+RTC_DATA_ATTR float filteredVoltage;
+RTC_DATA_ATTR int lastPercent;
 
 void BATTERY::BatteryTask(void *pvParameters) {
     ESP_LOGI(__FILE__, "%s:%d. Task init", __func__ ,__LINE__);
 
-    // see ADCx_CHANNEL macro description for details
-    // Battery battery(ADC1_CHANNEL_6); // Lolinlite
+    // Scope: ADC is released before the task ends
+    {
+        // see ADCx_CHANNEL macro description for details
+        // Battery battery(ADC1_CHANNEL_6); // Lolinlite
 
-    //TODO lolin has no battery read pin
-    Battery battery(ADC_UNIT_1, ADC_CHANNEL_6); // Firebeetle
+        //TODO lolin has no battery read pin
+        Battery battery(ADC_UNIT_1, ADC_CHANNEL_6); // Firebeetle
 
-    for(;;) {
-        auto batPercent = battery.GetPercent();
-        if(xQueueSend(BatteryQueue, &batPercent, 0) == pdFALSE) {
-            // overwrite existing value
-            xQueueOverwrite(BatteryQueue, &batPercent);
+        // Once per wake. Voltage barely moves between wakes, filter keeps the history.
+        // Load of the moment: task runs at boot, mostly the CPU with radio still off
+        auto percent = battery.Update(Battery::GetLoadCurrent(TELEMETRY::Telemetry::GetRadio()));
+        if(percent >= 0) {
+            BUS::Publish(BUS::BatteryLevel {.percent = percent});
         }
-        
-        TaskDelay(1s);
+        ESP_LOGI(__FILE__, "%s:%d. Battery %d%% (%u mV)", __func__ ,__LINE__, percent, 
+                    (unsigned int) Battery::GetVoltage());
     }
+    vTaskDelete(NULL);
 }
 
-int Battery::GetPercent() {
-    // theres two stage voltage divider on battery voltage
-    // 1st *0.5, 2nd *0.3125
-    // Vout(@adc_pin) = Vbat * 0.1563
-    // Vbat = Vout(@adc_pin) / 0.1563; 1/0.1563 = 6.4
-#ifdef ARDUINO_LOLIN32_LITE
-    auto voltage = GetAdcVoltage() * 6.4;
-#endif
-    //firebeetle voltage divier: /2
-// #ifdef ARDUINO_FIREBEETLE32
-    auto voltage = GetAdcVoltage() * 2;
-// #endif
+float Battery::Measure() {
+    auto burst = AnalogStream::Measure(burstSamples, clipSigma);
+    if(burst.samples == 0) {
+        return 0;
+    }
+    ESP_LOGD(__FILE__, "%s:%d. %u samples, %.1f mV, variance %.1f mV^2", __func__ ,__LINE__,
+                (unsigned int) burst.samples, burst.mean, burst.variance);
+    return burst.mean * dividerRatio;
+}
+
+int Battery::Update(float loadMa) {
+    float measured = Measure();
+    if(measured == 0) {
+        // ADC failed, estimate of previous wakes still holds
+        return GetLastPercent();
+    }
+    // Compensate the sag to get open circuit voltage
+    float voltage = measured + loadMa * internalResistance / 1000;
+
+    float step = voltage - filteredVoltage;
+    if(filteredVoltage == 0 || step > filterResetMv || step < -filterResetMv) {
+        filteredVoltage = voltage;
+    }
+    else {
+        filteredVoltage += step / filterWeight;
+    }
+    lastPercent = Interpolate(curve, filteredVoltage);
+    return lastPercent;
+}
 
-    for (uint8_t i = 0; i < voltageCx.size(); i++) {
-        if(voltage > voltageCx[i]) {
-            if(voltage < voltageCx[i + 1]) {
-                return i * 10;
-            }
+float Battery::GetVoltage() {
+    return filteredVoltage;
+}
+
+int Battery::GetLastPercent() {
+    return filteredVoltage != 0 ? lastPercent : -1;
+}
+
+int Battery::Interpolate(const Curve& curve, float millivolts) {
+    if(millivolts <= curve.front().millivolts) {
+        return curve.front().percent;
+    }
+    for(size_t i = 1; i < curve.size(); i++) {
+        if(millivolts < curve[i].millivolts) {
+            auto& low = curve[i - 1];
+            auto& high = curve[i];
+            return low.percent + (int) ((high.percent - low.percent) * (millivolts - low.millivolts) / 
+                                        (high.millivolts - low.millivolts));
         }
     }
-    return 0;
+    return curve.back().percent;
+}
+
+float Battery::GetLoadCurrent(TELEMETRY::Telemetry::Radio radio) {
+    // Same figures as tools/powerModel.py
+    switch(radio) {
+        case TELEMETRY::Telemetry::Radio::ADVERTISING: return 55;
+        case TELEMETRY::Telemetry::Radio::CONNECTED: return 65;
+        default: return 40;
+    }
 }
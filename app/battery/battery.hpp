@@ -11,32 +11,94 @@
 
 #include "array"
 #include "gpio.hpp"
-#include "analogRead.hpp"
+#include "analogStream.hpp"
+#include "telemetry.hpp"
 
 namespace BATTERY {
 
 /**
  * @brief Battery task/thread. Execution managed by OS.
+ *      Estimates battery level once per wake, publishes it and ends.
  */
 void BatteryTask(void *pvParameters);
 
-class Battery : private AnalogRead {
-private:
-    // Each value represents step of 10% in capacity
-    std::array<float, 12> voltageCx = {2.5, 3.65, 3.69, 3.74, 3.8, 3.84,
-                          3.87, 3.95, 4.02, 4.10, 4.2, 4.3};
+// Point of discharge curve: open circuit voltage of the cell at given charge left
+struct CurvePoint {
+    uint16_t millivolts;
+    uint8_t percent;
+};
+
+// Points in ascending order. Charge between points is interpolated
+typedef std::array<CurvePoint, 11> Curve;
 
+const static constexpr Curve defaultCurve = {{
+    {2500, 0}, {3650, 10}, {3690, 20}, {3740, 30}, {3800, 40}, {3840, 50},
+    {3870, 60}, {3950, 70}, {4020, 80}, {4100, 90}, {4200, 100},
+}};
+
+class Battery : private AnalogStream {
 public:
+    // Conversions of the burst taken at each measurement, 13 ms at AnalogStream::sampleRateHz
+    const static constexpr size_t burstSamples = AnalogStream::maxSamples;
+    // Samples further from the mean of the burst are dropped as outliers [standard deviations]
+    const static constexpr float clipSigma = 3;
+#ifdef ARDUINO_LOLIN32_LITE
+    // Two stage voltage divider: *0.5, *0.3125. Vbat = Vadc / 0.1563
+    const static constexpr float dividerRatio = 6.4;
+#else
+    // Firebeetle voltage divider: /2
+    const static constexpr float dividerRatio = 2;
+#endif
+    // Cell, protection and wiring [mOhm]. Voltage sags by current * resistance under load
+    const static constexpr float internalResistance = 200;
+    // Filter across wakes: new estimate moves the filtered one by 1/filterWeight of the difference
+    const static constexpr float filterWeight = 4;
+    // Larger step is not noise (charger plugged in or out), filter starts over
+    const static constexpr float filterResetMv = 150;
+
     Battery() = delete;
     
-    Battery(adc_unit_t unit, adc_channel_t channel) : AnalogRead(unit, channel) {};
+    Battery(adc_unit_t unit, adc_channel_t channel, const Curve& _curve = defaultCurve) : 
+        AnalogStream(unit, channel), curve(_curve) {};
     
     /**
-     * @return Percentage value of battery. '0' or multiple of 10
+     * @brief Burst of conversions, outliers dropped.
+     *      0 if ADC failed.
+     * @return Battery voltage [mV] under current load
+     */
+    float Measure();
+
+    /**
+     * @brief Measure, compensate for the load and smooth with estimates of previous wakes.
+     *      Filter state is kept in RTC memory. Call once per wake.
+     * @param loadMa board current while measuring [mA], see GetLoadCurrent. The caller knows
+     *      what runs during the burst, the radio state alone does not tell it
+     * @return Charge left [%], 0..100. Previous one if ADC failed, -1 if there is none
+     */
+    int Update(float loadMa);
+
+    /**
+     * @return Filtered open circuit voltage [mV], 0 before first Update
      */
-    int GetPercent();
+    static float GetVoltage();
 
-    // ChargeState GetChargeState(void);
+    /**
+     * @return Charge left [%] of the latest Update (this or previous wake), -1 before first one
+     */
+    static int GetLastPercent();
+
+    /**
+     * @return Charge left [%] at open circuit voltage, linear between points of the curve
+     */
+    static int Interpolate(const Curve& curve, float millivolts);
+
+    /**
+     * @return Board current [mA] at given radio state, rough figures
+     */
+    static float GetLoadCurrent(TELEMETRY::Telemetry::Radio radio);
+
+private:
+    const Curve& curve;
 };
 
-}
\ No newline at end of file
+}
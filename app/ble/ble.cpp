@@ -8,34 +8,38 @@
  */
 
 #include "ble.hpp"
-#include "battery.hpp"
-#include "imu.hpp"
 #include "NimBLEDevice.h"
 #include "NimBLEUtils.h"
 #include "NimBLEServer.h"
+#include "telemetry.hpp"
+#include "bootProfile.hpp"
+#include "powerGovernor.hpp"
+#include "binaryLog.hpp"
 
 extern "C" {
     #include <freertos/FreeRTOS.h>
-    #include "freertos/queue.h"
     #include "esp_bt.h"
     #include "string.h"
     #include "esp_log.h"
     #include "driver/rtc_io.h"
     #include "esp_sleep.h"
+    #include "esp_timer.h"
 } // extern C close
 
 using namespace BLE;
 
-extern QueueHandle_t BatteryQueue;
-extern QueueHandle_t ImuPositionQueue;
-extern QueueHandle_t ImuPositionGetQueue;
-extern QueueHandle_t ImuCalibrationInitQueue;
-extern QueueHandle_t ImuCalibrationStateQueue;
-extern QueueHandle_t SleepPauseQueue;
-extern QueueHandle_t SleepStartQueue;
-
 BLEServer * Ble::server = NULL;
-esp_ota_handle_t Ble::otaHandle = NULL;
+Services * Ble::services = nullptr;
+uint16_t Ble::connHandle = BLE_HS_CONN_HANDLE_NONE;
+TaskHandle_t Ble::task = nullptr;
+ReconnectTimer Ble::reconnectTimer(esp_timer_get_time);
+int64_t Ble::lastReconnectTime = 0;
+constexpr std::chrono::milliseconds Ble::directedAdvertisingTime;
+
+// Identity address of the central we were bonded with at last connection
+const static constexpr uint8_t noAddressType = 0xFF;
+RTC_DATA_ATTR ble_addr_t bondedCentral = {.type = noAddressType, .val = {}};
+std::array<NimBLECharacteristic *, (size_t) CharacteristicId::Count> Ble::characteristics = {};
 Ble::ConnectionState Ble::state = Ble::ConnectionState::IDLE;
 
 const std::string advServiceUuid = "8227dcb2-30e3-11ed-a261-0242ac120002";
@@ -44,7 +48,13 @@ const static constexpr char * uuidImuPositionService = "7bef916a-3141-11ed-a261-
 const static constexpr char * uuidImuPositionCharateristic = "7bef916a-3141-11ed-a261-0242ac120001";
 const static constexpr char * uuidImuCalibrationCharateristic = "7bef916a-3141-11ed-a261-0242ac120002";
 
+const static constexpr char * uuidTimeSync = "8227dcb2-30e3-11ed-a261-0242ac120003";
+
 const static constexpr char * uuidSleep = "646b8837-cea9-4006-be25-00c990029e90";
+const static constexpr char * uuidTelemetry = "646b8837-cea9-4006-be25-00c990029e92";
+const static constexpr char * uuidBootProfile = "646b8837-cea9-4006-be25-00c990029e93";
+const static constexpr char * uuidTrace = "646b8837-cea9-4006-be25-00c990029e94";
+const static constexpr char * uuidBinaryLog = "646b8837-cea9-4006-be25-00c990029e95";
 
 const static constexpr char * uuidDeviceFirmwareUpdateService = "00009921-1212-efde-1523-785feabcd123"; 
 const static constexpr char * uuidDeviceFirmwareDataCharacteristic = "00009921-1212-efde-1523-785feabcd124"; 
@@ -59,7 +69,7 @@ const static constexpr char * uuidBattery = "2A19";
 const static constexpr char * uuidCurrentTime = "2A2B";
 
 void BLE::BleTask(void *pvParameters) {
-    ESP_LOGI(__FILE__, "%s:%d. Task init", __func__ ,__LINE__);
+    BLOGI("Task init");
 
     Ble ble;
     ble.Init();
@@ -67,28 +77,39 @@ void BLE::BleTask(void *pvParameters) {
     for(;;) {
         // Most of functionalities is done in BLE characteristic callbacks
 
-        //TODO pairing process???
-
         //TODO register ESP_ERRORS and send them thru ble?
 
-        TaskDelay(1s);
+        ble.Update();
+        ble.Wait();
     }
 }
 
 void Ble::Init() {
+    task = xTaskGetCurrentTaskHandle();
     BLEDevice::init("Time tracker");
+    TELEMETRY::BootProfile::Mark(TELEMETRY::BootProfile::Marker::BleInit);
+    services = new Services(*this);
+
+    // LE Secure Connections with bonding, no IO capabilities (just works).
+    // Keys are persisted in NVS by NimBLE, so pairing happens only once per central.
+    // Later connections only resume encryption with stored key.
+    BLEDevice::setSecurityAuth(true, false, true);
+    BLEDevice::setSecurityIOCap(BLE_HS_IO_NO_INPUT_OUTPUT);
 
     // Scheme: Callback to characteristic. Characteristics to service. 
 
     // IMU Position service 
     BLE::Service positionService(uuidImuPositionService);
-    BLE::Characteristic positionCharacteristic(uuidImuPositionCharateristic, NIMBLE_PROPERTY::READ);
-    positionCharacteristic.SetCallback(new Ble::ImuPositionCallback);
+    BLE::Characteristic positionCharacteristic(uuidImuPositionCharateristic, NIMBLE_PROPERTY::READ |
+                                                                            NIMBLE_PROPERTY::READ_ENC);
+    positionCharacteristic.SetCallback(CharacteristicId::Position);
     positionService.AddCharacteristic(&positionCharacteristic);
 
     BLE::Characteristic calibrationCharacteristic(uuidImuCalibrationCharateristic, NIMBLE_PROPERTY::WRITE |
-                                                                                    NIMBLE_PROPERTY::READ);  
-    calibrationCharacteristic.SetCallback(new Ble::ImuCalibrationCallback);
+                                                                                    NIMBLE_PROPERTY::WRITE_ENC |
+                                                                                    NIMBLE_PROPERTY::READ |
+                                                                                    NIMBLE_PROPERTY::READ_ENC);  
+    calibrationCharacteristic.SetCallback(CharacteristicId::Calibration);
     positionService.AddCharacteristic(&calibrationCharacteristic);
 
     AddService(positionService);
@@ -96,9 +117,27 @@ void Ble::Init() {
 
     // Sleep service
     BLE::Service sleepService(uuidSleep);
-    BLE::Characteristic sleepCharacteristic(uuidSleep, NIMBLE_PROPERTY::WRITE);
-    sleepCharacteristic.SetCallback(new Ble::SleepCallback);
+    BLE::Characteristic sleepCharacteristic(uuidSleep, NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::WRITE_ENC);
+    sleepCharacteristic.SetCallback(CharacteristicId::Sleep);
     sleepService.AddCharacteristic(&sleepCharacteristic);
+
+    // Frame is longer than default MTU, NimBLE serves it with long (blob) reads
+    BLE::Characteristic telemetryCharacteristic(uuidTelemetry, NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::READ_ENC);
+    telemetryCharacteristic.SetCallback(CharacteristicId::Telemetry);
+    sleepService.AddCharacteristic(&telemetryCharacteristic);
+
+    BLE::Characteristic bootProfileCharacteristic(uuidBootProfile, NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::READ_ENC);
+    bootProfileCharacteristic.SetCallback(CharacteristicId::BootProfile);
+    sleepService.AddCharacteristic(&bootProfileCharacteristic);
+
+    // Chunk of the trace per read, long reads too
+    BLE::Characteristic traceCharacteristic(uuidTrace, NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::READ_ENC);
+    traceCharacteristic.SetCallback(CharacteristicId::Trace);
+    sleepService.AddCharacteristic(&traceCharacteristic);
+
+    BLE::Characteristic binaryLogCharacteristic(uuidBinaryLog, NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::READ_ENC);
+    binaryLogCharacteristic.SetCallback(CharacteristicId::BinaryLog);
+    sleepService.AddCharacteristic(&binaryLogCharacteristic);
     AddService(sleepService);
     // ----------------------------------------------------------
 
@@ -121,7 +160,7 @@ void Ble::Init() {
     BLE::Service batteryService(uuidBattery);
     BLE::Characteristic batteryCharateristic(uuidBattery, NIMBLE_PROPERTY::READ |
                                                                         NIMBLE_PROPERTY::NOTIFY);
-    batteryCharateristic.SetCallback(new Ble::BatteryCallback);
+    batteryCharateristic.SetCallback(CharacteristicId::Battery);
     batteryService.AddCharacteristic(&batteryCharateristic);
     AddService(batteryService);
     // ----------------------------------------------------------
@@ -129,21 +168,30 @@ void Ble::Init() {
     // Current time service 
     BLE::Service currentTimeService(uuidCurrentTime);
     BLE::Characteristic currentTimeCharacteristic(uuidCurrentTime, NIMBLE_PROPERTY::WRITE |
+                                                                                NIMBLE_PROPERTY::WRITE_ENC |
                                                                                 NIMBLE_PROPERTY::READ);
-    currentTimeCharacteristic.SetCallback(new Ble::TimeCallback);
+    currentTimeCharacteristic.SetCallback(CharacteristicId::Time);
     currentTimeService.AddCharacteristic(&currentTimeCharacteristic);
+
+    BLE::Characteristic timeSyncCharacteristic(uuidTimeSync, NIMBLE_PROPERTY::WRITE |
+                                                                NIMBLE_PROPERTY::WRITE_ENC |
+                                                                NIMBLE_PROPERTY::READ);
+    timeSyncCharacteristic.SetCallback(CharacteristicId::TimeSync);
+    currentTimeService.AddCharacteristic(&timeSyncCharacteristic);
     AddService(currentTimeService);
     // ----------------------------------------------------------
 
     // Device firmware update service
     BLE::Service deviceFirmwareUpdateService(uuidDeviceFirmwareUpdateService);
     BLE::Characteristic deviceFirmwareControlCharacteristic(uuidDeviceFirmwareControlCharacteristic, NIMBLE_PROPERTY::WRITE |
+                                                                                                    NIMBLE_PROPERTY::WRITE_ENC |
                                                                                                     NIMBLE_PROPERTY::READ);
-    deviceFirmwareControlCharacteristic.SetCallback(new Ble::OtaControlCallback);
+    deviceFirmwareControlCharacteristic.SetCallback(CharacteristicId::OtaControl);
     deviceFirmwareUpdateService.AddCharacteristic(&deviceFirmwareControlCharacteristic);
 
-    BLE::Characteristic deviceFirmwareDataCharacteristic(uuidDeviceFirmwareDataCharacteristic, NIMBLE_PROPERTY::WRITE);
-    deviceFirmwareDataCharacteristic.SetCallback(new Ble::OtaDataCallback);
+    BLE::Characteristic deviceFirmwareDataCharacteristic(uuidDeviceFirmwareDataCharacteristic, NIMBLE_PROPERTY::WRITE |
+                                                                                                NIMBLE_PROPERTY::WRITE_ENC);
+    deviceFirmwareDataCharacteristic.SetCallback(CharacteristicId::OtaData);
     deviceFirmwareUpdateService.AddCharacteristic(&deviceFirmwareDataCharacteristic);
     AddService(deviceFirmwareUpdateService);
     // ----------------------------------------------------------
@@ -157,8 +205,39 @@ void Ble::Advertise() {
     adv->setScanResponse(false);
     adv->setMinPreferred(0x06);
     // adv->setMinPreferred(0x12); 
+    // Power saving tiers advertise slower. Units of 0.625 ms
+    uint16_t interval = APP::PowerGovernor::GetPolicy().advertisingInterval * 8 / 5;
+    if(interval) {
+        adv->setMinInterval(interval);
+        adv->setMaxInterval(interval);
+    }
+    TELEMETRY::BootProfile::Mark(TELEMETRY::BootProfile::Marker::Advertising);
+
+    if(bondedCentral.type != noAddressType && BLEDevice::isBonded(NimBLEAddress(bondedCentral))) {
+        // Bonded central is most likely the one listening. Directed advertising is answered
+        // by it only, no scan requests from others. If it does not show up, advertise to everyone.
+        NimBLEAddress central(bondedCentral);
+        adv->setAdvertisingCompleteCallback([](NimBLEAdvertising *adv) {
+            if(Ble::state != Ble::ConnectionState::CONNECTED) {
+                startAdvertising();
+            }
+        });
+        reconnectTimer.OnAdvertise();
+        if(adv->start(ConvertToMs(directedAdvertisingTime), &central)) {
+            BLE::Ble::state = Ble::ConnectionState::ADVERTISING;
+            TELEMETRY::Telemetry::SetRadio(TELEMETRY::Telemetry::Radio::ADVERTISING);
+            return;
+        }
+    }
+
+    startAdvertising();
+}
+
+void Ble::startAdvertising() {
+    reconnectTimer.OnAdvertise();
     BLEDevice::startAdvertising();
     BLE::Ble::state = Ble::ConnectionState::ADVERTISING;
+    TELEMETRY::Telemetry::SetRadio(TELEMETRY::Telemetry::Radio::ADVERTISING);
 }
 
 void Ble::AddService(Service service) {
@@ -175,174 +254,108 @@ void Ble::AddService(Service service) {
         characteristic->self = service.self->createCharacteristic(BLEUUID(characteristic->uuid), characteristic->property);
         characteristic->SetValue(characteristic->initValue);
         if(characteristic->callback != nullptr) characteristic->self->setCallbacks(characteristic->callback);
+        if(characteristic->id != CharacteristicId::Count) characteristics[(size_t) characteristic->id] = characteristic->self;
     }
     service.self->start();
 }
 
-void Ble::ServerCallbacks::onConnect(BLEServer * server, NimBLEConnInfo& connInfo) {
-    ESP_LOGI(__FILE__, "%s:%d. BLE connection established!", __func__ ,__LINE__);
-    Ble::state = Ble::ConnectionState::CONNECTED;
-    BLEDevice::stopAdvertising();
+void Ble::SetValue(CharacteristicId id, const uint8_t *data, size_t len) {
+    auto characteristic = characteristics[(size_t) id];
+    if(characteristic != nullptr) characteristic->setValue(data, len);
 }
 
-void Ble::ServerCallbacks::onDisconnect(BLEServer * server, NimBLEConnInfo& connInfo, int reason) {
-    ESP_LOGI(__FILE__, "%s:%d. BLE connection lost. Reason: %d", __func__ ,__LINE__, reason);
-    Ble::state = Ble::ConnectionState::DISCONNECTED;
-    BLEDevice::startAdvertising();
+void Ble::Notify(CharacteristicId id) {
+    auto characteristic = characteristics[(size_t) id];
+    if(characteristic != nullptr) characteristic->notify();
 }
 
-void Ble::ImuPositionCallback::onRead(NimBLECharacteristic* pCharacteristic, NimBLEConnInfo& connInfo) {
-    IMU::PositionQueueType item;
-    xQueueSend(ImuPositionGetQueue, &item, 0);
-    // Mind that these are two separate queues
-    if(xQueueReceive(ImuPositionQueue, &item, 0)) {
-        std::string text = std::to_string(item.startTime) + "," + std::to_string(item.face);
-        pCharacteristic->setValue(text);
-    }
-    else {
-        pCharacteristic->setValue(0);
+void Ble::RequestLink(const LinkRequest& request) {
+    if(server == NULL || connHandle == BLE_HS_CONN_HANDLE_NONE) {
+        return;
     }
+    server->updateConnParams(connHandle, request.minInterval, request.maxInterval, 
+                                request.latency, request.timeout);
 }
 
-void Ble::ImuCalibrationCallback::onRead(NimBLECharacteristic* pCharacteristic, NimBLEConnInfo& connInfo) {
-    ESP_LOGI(__FILE__, "%s:%d. Calibration callback onRead", __func__ ,__LINE__);
-    char item[5] = {};
-    if(xQueueReceive(ImuCalibrationStateQueue, &item, 0)) {
-        const std::string data(item);
-        // Set calibration result. Details in IMU namespace
-        pCharacteristic->setValue(item);
-        // Client must clear value
+void Ble::Update() {
+    if(services != nullptr && state == ConnectionState::CONNECTED) {
+        services->Update();
     }
 }
 
-void Ble::ImuCalibrationCallback::onWrite(NimBLECharacteristic* pCharacteristic, NimBLEConnInfo& connInfo) {
-    ESP_LOGI(__FILE__, "%s:%d. Calibration callback onWrite", __func__ ,__LINE__);
-    auto val = *pCharacteristic->getValue().data();
-    //TODO do calibration cancel!
-    if(val != 0) {
-        // Initiate calibration
-        xQueueSend(ImuCalibrationInitQueue, &val, 0);
-        // Pause sleep (with timeout). Resume it using BLE sleep characteristic
-        xQueueSend(SleepPauseQueue, "imuCalibration", 0);
-    }
-    // Clear request
-    pCharacteristic->setValue(0);
+void Ble::Wait() {
+    // Without a client there is nothing to do. Connection wakes the task up
+    TickType_t timeout = state == ConnectionState::CONNECTED ? ConvertToTicks(1s) : portMAX_DELAY;
+    ulTaskNotifyTake(pdTRUE, timeout);
 }
 
-void Ble::SleepCallback::onWrite(NimBLECharacteristic * pCharacteristic, NimBLEConnInfo& connInfo) {
-    // Sleep enter request from client
-    //TODO change to notify!
-    auto item = 1;
-    xQueueSend(SleepStartQueue, &item, 0);
+LinkInfo Ble::getLinkInfo(NimBLEConnInfo& connInfo) {
+    return LinkInfo {
+        .mtu = connInfo.getMTU(),
+        .interval = connInfo.getConnInterval(),
+        .latency = connInfo.getConnLatency(),
+        .timeout = connInfo.getConnTimeout(),
+    };
 }
 
-void Ble::BatteryCallback::onRead(NimBLECharacteristic * pCharacteristic, NimBLEConnInfo& connInfo) {
-    // Latest battery value is set after reading from char. Read twice to get latest data.
-    ESP_LOGI(__FILE__, "%s:%d. Battery read", __func__ ,__LINE__);
-    int batteryValue = 0.0;
-    // Receive battery percent from battery task
-    if(xQueueReceive(BatteryQueue, &batteryValue, 0)) {
-        pCharacteristic->setValue(batteryValue);
-    }
+void Characteristic::SetCallback(CharacteristicId _id) {
+    id = _id;
+    callback = new Ble::CharacteristicCallback(_id);
 }
 
-void Ble::TimeCallback::onRead(NimBLECharacteristic * pCharacteristic, NimBLEConnInfo& connInfo) {
-    timeval tv = {0,0};
-    gettimeofday(&tv, NULL);
-    pCharacteristic->setValue(tv.tv_sec);
+void Ble::ServerCallbacks::onConnect(BLEServer * server, NimBLEConnInfo& connInfo) {
+    BLOGI("BLE connection established!");
+    Ble::state = Ble::ConnectionState::CONNECTED;
+    BLEDevice::stopAdvertising();
+    TELEMETRY::Telemetry::SetRadio(TELEMETRY::Telemetry::Radio::CONNECTED);
+    Ble::connHandle = connInfo.getConnHandle();
+    // Ask the central to encrypt right away. With a bond it is just a key lookup
+    BLEDevice::startSecurity(connInfo.getConnHandle());
+    Ble::services->OnConnect(Ble::getLinkInfo(connInfo));
+    xTaskNotifyGive(Ble::task);
+    APP::Notify(APP::BLE_CONNECTED);
 }
 
-void Ble::TimeCallback::onWrite(NimBLECharacteristic * pCharacteristic, NimBLEConnInfo& connInfo) {
-    // sizeof(time_t) bytes of epoch seconds time should be received
-    NimBLEAttValue value = pCharacteristic->getValue();
-    if(value.length() != sizeof(time_t)) {
-        ESP_LOGE(__FILE__, "%s:%d. Time characteristic wrong format", __func__ ,__LINE__);
+void Ble::ServerCallbacks::onAuthenticationComplete(NimBLEConnInfo& connInfo) {
+    if(!connInfo.isEncrypted()) {
+        BLOGW("Encryption failed, disconnecting");
+        BLEDevice::getServer()->disconnect(connInfo.getConnHandle());
         return;
     }
 
-    time_t receivedTime;
-    memcpy(&receivedTime, value.data(), sizeof(time_t));
+    // Time from advertising start until link is encrypted (usable)
+    std::chrono::microseconds reconnect;
+    if(Ble::reconnectTimer.OnLink(reconnect)) {
+        Ble::lastReconnectTime = reconnect.count();
+        TELEMETRY::Telemetry::OnReconnect(reconnect);
+    }
+    BLOGI("Link encrypted. Bonded: %d. Reconnect took %u ms", 
+                connInfo.isBonded(), (unsigned int) (Ble::lastReconnectTime / 1000));
 
-    timeval tv = {.tv_sec = receivedTime, .tv_usec = 0};
-    settimeofday(&tv, NULL);
-    ESP_LOGI(__FILE__, "%s:%d. Time updated (epoch): %d", __func__ ,__LINE__, (unsigned int) receivedTime);
+    if(connInfo.isBonded()) {
+        // Next wake advertise directly to this central
+        bondedCentral = *connInfo.getIdAddress().getBase();
+    }
 }
 
-void Ble::OtaControlCallback::onWrite(NimBLECharacteristic * pCharacteristic, NimBLEConnInfo& connInfo) {
-    NimBLEAttValue chrRcv = pCharacteristic->getValue();
-    unsigned int rcv = (unsigned int) *chrRcv.data();
-    ESP_LOGI(__FILE__, "%s:%d. OTA Request: %d", __func__ ,__LINE__, rcv);
-    if(rcv == OTA_CONTROL_REQUEST) {
-        ESP_LOGI(__FILE__, "%s:%d. OTA Requested via BLE", __func__ ,__LINE__);
-        partitionHandle = esp_ota_get_next_update_partition(NULL);
-        if(partitionHandle == NULL) {
-            ESP_LOGE(__FILE__, "%s:%d. OTA Could not get partition", __func__ ,__LINE__);
-            pCharacteristic->setValue(OTA_CONTROL_REQUEST_NAK);
-            return;
-        }
-
-        auto status = esp_ota_begin(partitionHandle, OTA_WITH_SEQUENTIAL_WRITES, &Ble::otaHandle);
-        if(status != ESP_OK) {
-            ESP_LOGE(__FILE__, "%s:%d. OTA Error. %s", __func__ ,__LINE__, esp_err_to_name(status));
-            esp_ota_abort(Ble::otaHandle);
-            pCharacteristic->setValue(OTA_CONTROL_REQUEST_NAK);
-            return;
-        }
-
-        auto mtu = connInfo.getMTU();
-        if(mtu < 250) {
-            ESP_LOGW(__FILE__, "%s:%d. OTA: BLE MTU low %d", __func__ ,__LINE__, mtu);
-            //TODO negotiate higher mtu
-        }
-
-        ESP_LOGI(__FILE__, "%s:%d. OTA Begin", __func__ ,__LINE__);
-        xQueueSend(SleepPauseQueue, "otaUpdate", 0);
-
-        pCharacteristic->setValue(OTA_CONTROL_REQUEST_ACK);
-    } 
-    else if (rcv == OTA_CONTROL_DONE) {
-        ESP_LOGI(__FILE__, "%s:%d. OTA Request to end update", __func__ ,__LINE__);
-        auto status = esp_ota_end(Ble::otaHandle);
-        if(status != ESP_OK) {
-            ESP_LOGE(__FILE__, "%s:%d. OTA Error. %s", __func__ ,__LINE__, esp_err_to_name(status));
-            pCharacteristic->setValue(OTA_CONTROL_DONE_NAK);
-            return;
-        }
-
-        //TODO check image version
+void Ble::ServerCallbacks::onConnParamsUpdate(NimBLEConnInfo& connInfo) {
+    Ble::services->OnLinkUpdate(Ble::getLinkInfo(connInfo));
+}
 
-        status = esp_ota_set_boot_partition(partitionHandle);
-        if(status != ESP_OK) {
-            ESP_LOGE(__FILE__, "%s:%d. OTA Error. %s", __func__ ,__LINE__, esp_err_to_name(status));
-            pCharacteristic->setValue(OTA_CONTROL_DONE_NAK);
-            return;
-        }
+void Ble::ServerCallbacks::onDisconnect(BLEServer * server, NimBLEConnInfo& connInfo, int reason) {
+    BLOGI("BLE connection lost. Reason: %d", reason);
+    Ble::state = Ble::ConnectionState::DISCONNECTED;
+    Ble::connHandle = BLE_HS_CONN_HANDLE_NONE;
+    Ble::services->OnDisconnect(reason);
+    Ble::startAdvertising();
+    APP::Notify(APP::BLE_DISCONNECTED);
+}
 
-        ESP_LOGI(__FILE__, "%s:%d. OTA Success. Rebooting...", __func__ ,__LINE__);
-        //TODO enabled: skip image validation when exiting deep sleep
-        pCharacteristic->setValue(OTA_CONTROL_DONE_ACK);
-        TaskDelay(1s);
-        // when calling esp_restart OS is stuck
-        // workaround is to sleep after OTA, first reboot fails, then next one is fine
-        auto item = 0;
-        xQueueSend(SleepStartQueue, &item, 0);
-    }
-    else {
-        ESP_LOGW(__FILE__, "%s:%d. OTA Unkown request", __func__ ,__LINE__);
-    }
+void Ble::CharacteristicCallback::onRead(NimBLECharacteristic* pCharacteristic, NimBLEConnInfo& connInfo) {
+    Ble::services->OnRead(id, Ble::getLinkInfo(connInfo));
 }
 
-void Ble::OtaDataCallback::onWrite(NimBLECharacteristic * pCharacteristic, NimBLEConnInfo& connInfo) {
-    NimBLEAttValue pkg = pCharacteristic->getValue();
-    auto len = pkg.length();
-
-    //TODO sometimes (dont know why sometimes) OTA tranmission is very slow
-    ESP_LOGI(__FILE__, "%s:%d. Received packet %d", __func__ ,__LINE__, rcvPkg);
-    auto status = esp_ota_write(Ble::otaHandle, pkg.c_str(), len);
-    if(status == ESP_ERR_INVALID_ARG) {
-        ESP_LOGE(__FILE__, "%s:%d. OTA Data write. %s", __func__ ,__LINE__, esp_err_to_name(status));
-        // Notify in case of an error
-        pCharacteristic->notify();
-    }
-    rcvPkg++;
-}
\ No newline at end of file
+void Ble::CharacteristicCallback::onWrite(NimBLECharacteristic* pCharacteristic, NimBLEConnInfo& connInfo) {
+    NimBLEAttValue value = pCharacteristic->getValue();
+    Ble::services->OnWrite(id, value.data(), value.length(), Ble::getLinkInfo(connInfo));
+}
@@ -10,15 +10,16 @@
 #pragma once
 
 #include <memory>
+#include <array>
 #include "dateTime.hpp"
+#include "transport.hpp"
+#include "services.hpp"
+#include "reconnectTimer.hpp"
+#include "appEvents.hpp"
 #include "NimBLEServer.h"
 #include "NimBLEDevice.h"
 #include "NimBLECharacteristic.h"
 
-extern "C" {
-    #include "esp_ota_ops.h"
-} // extern C close
-
 namespace BLE {
 
 void BleTask(void *pvParameters);
@@ -30,6 +31,7 @@ class Characteristic {
 public:
     BLECharacteristic *self = nullptr;
     BLECharacteristicCallbacks *callback = nullptr;
+    CharacteristicId id = CharacteristicId::Count; // Count = not handled by service layer
     std::string uuid;
     uint32_t property;
     std::string initValue;
@@ -54,6 +56,11 @@ public:
         callback = cb;
     }
 
+    /**
+     * @brief Route client requests of this characteristic to service layer.
+     */
+    void SetCallback(CharacteristicId _id);
+
     void Notify() {
         self->notify();
     }
@@ -73,77 +80,66 @@ public:
     }
 };
 
-class Ble {
+class Ble : public Transport {
     static BLEServer * server;
-    static esp_ota_handle_t otaHandle;
+    static Services * services;
+    static uint16_t connHandle;
+    static TaskHandle_t task;
+    static ReconnectTimer reconnectTimer;
+    static std::array<NimBLECharacteristic *, (size_t) CharacteristicId::Count> characteristics;
+
+    static LinkInfo getLinkInfo(NimBLEConnInfo& connInfo);
+    // Every (re)start of advertising goes through it, reconnect time is measured from it
+    static void startAdvertising();
 public:
     enum class ConnectionState { IDLE, ADVERTISING, CONNECTED, DISCONNECTED };
     static ConnectionState state;
+    // Advertising start until encrypted link, microseconds
+    static int64_t lastReconnectTime;
+
+    // Directed advertising to the bonded central, then to everyone. It runs at low duty cycle
+    // (advertising interval of the tier), which has no limit in the spec. The 1.28 s limit is
+    // of high duty cycle only, not used: it keeps the radio busy all the time
+    const static constexpr std::chrono::milliseconds directedAdvertisingTime = 2000ms;
 
-    static void Init();
+    void Init();
 
     static void Advertise();
 
     static void AddService(Service service);
 
+    // Transport of service layer
+    using Transport::SetValue;
+    void SetValue(CharacteristicId id, const uint8_t *data, size_t len) override;
+    void Notify(CharacteristicId id) override;
+    void RequestLink(const LinkRequest& request) override;
+
+    /**
+     * @brief Periodic housekeeping of service layer
+     */
+    void Update();
+
+    /**
+     * @brief Block BLE task until there is something to do.
+     */
+    void Wait();
+
     // Callbacks of BLE server (GAP)
     class ServerCallbacks : public NimBLEServerCallbacks {
         void onConnect(BLEServer * server, NimBLEConnInfo& connInfo);
         void onDisconnect(BLEServer * server, NimBLEConnInfo& connInfo, int reason);
+        void onConnParamsUpdate(NimBLEConnInfo& connInfo);
+        void onAuthenticationComplete(NimBLEConnInfo& connInfo);
     };
 
-    // Callbacks of IMU characteristics in BLE communication
-    class ImuPositionCallback : public NimBLECharacteristicCallbacks {
-        // Used to send data about time spend in <face> position
-        // At read it will put new data (if available) into characteristic
+    // Callbacks of characteristics handled by service layer. Forwards requests to Services
+    class CharacteristicCallback : public NimBLECharacteristicCallbacks {
+        CharacteristicId id;
+    public:
+        CharacteristicCallback(CharacteristicId _id) : id(_id) {};
         void onRead(NimBLECharacteristic* pCharacteristic, NimBLEConnInfo& connInfo);
-    };
-
-    // Callbacks of IMU characteristics in BLE communication
-    class ImuCalibrationCallback : public NimBLECharacteristicCallbacks {
-        // Used in calibration process
-        void onRead(NimBLECharacteristic* pCharacteristic, NimBLEConnInfo& connInfo);
-        // Used to initiate calibration
         void onWrite(NimBLECharacteristic* pCharacteristic, NimBLEConnInfo& connInfo);
     };
-
-    // Callbacks of sleep characteristics in BLE communication
-    class SleepCallback : public NimBLECharacteristicCallbacks {
-        void onWrite(NimBLECharacteristic * pCharacteristic, NimBLEConnInfo& connInfo);
-    };
-
-    // Callbacks of battery characteristics in BLE communication
-    class BatteryCallback : public NimBLECharacteristicCallbacks {
-        void onRead(NimBLECharacteristic * pCharacteristic, NimBLEConnInfo& connInfo);
-    };
-
-    // Callbacks of time characteristics in BLE communication
-    class TimeCallback : public NimBLECharacteristicCallbacks {
-        void onRead(NimBLECharacteristic * pCharacteristic, NimBLEConnInfo& connInfo);
-        void onWrite(NimBLECharacteristic * pCharacteristic, NimBLEConnInfo& connInfo);
-    };
-
-    class OtaControlCallback : public NimBLECharacteristicCallbacks {
-        const esp_partition_t* partitionHandle;
-
-        enum OtaStatus {
-            OTA_CONTROL_NOP,
-            OTA_CONTROL_REQUEST,
-            OTA_CONTROL_REQUEST_ACK,
-            OTA_CONTROL_REQUEST_NAK,
-            OTA_CONTROL_DONE,
-            OTA_CONTROL_DONE_ACK,
-            OTA_CONTROL_DONE_NAK,
-        };
-
-        // void onRead(NimBLECharacteristic * pCharacteristic, NimBLEConnInfo& connInfo);
-        void onWrite(NimBLECharacteristic * pCharacteristic, NimBLEConnInfo& connInfo);
-    };
-
-    class OtaDataCallback : public NimBLECharacteristicCallbacks {
-        uint16_t rcvPkg = 0;
-        void onWrite(NimBLECharacteristic * pCharacteristic, NimBLEConnInfo& connInfo);
-    };
 };
 
 } // namespace BLE end --------------------
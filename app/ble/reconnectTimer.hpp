@@ -0,0 +1,59 @@
+/**
+ * @file reconnectTimer.hpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+// No ESP-IDF dependencies here. Clock is passed in, so it can be run on host with a fake one.
+
+#include <chrono>
+#include <cstdint>
+
+namespace BLE {
+
+/**
+ * @brief Advertising start until the link is usable (encrypted). Every start of advertising
+ *      stamps it, a second connection of the same wake is not measured from the first one.
+ */
+class ReconnectTimer {
+public:
+    // Time in microseconds (esp_timer_get_time on target)
+    typedef int64_t (*NowFunc)();
+
+    ReconnectTimer() = delete;
+    ReconnectTimer(NowFunc _now) : now(_now) {};
+
+    /**
+     * @brief Advertising started or restarted
+     */
+    void OnAdvertise() {
+        start = now();
+        advertising = true;
+    }
+
+    /**
+     * @brief Link is usable
+     * @param elapsed time since the last advertising start
+     * @return false if already counted since it, e.g. link encrypted again
+     */
+    bool OnLink(std::chrono::microseconds& elapsed) {
+        if(!advertising) {
+            return false;
+        }
+        advertising = false;
+        elapsed = std::chrono::microseconds(now() - start);
+        return true;
+    }
+
+private:
+    NowFunc now;
+    int64_t start = 0;
+    bool advertising = false;
+};
+
+} // namespace BLE end --------------------
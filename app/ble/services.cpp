@@ -0,0 +1,340 @@
+/**
+ * @file services.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#include "services.hpp"
+#include "imu.hpp"
+#include "protocol.hpp"
+#include "timeSync.hpp"
+#include "dateTime.hpp"
+#include "appEvents.hpp"
+#include "sleepScheduler.hpp"
+#include "telemetry.hpp"
+#include "bootProfile.hpp"
+#include "trace.hpp"
+#include "binaryLog.hpp"
+#include "messages.hpp"
+#include "powerGovernor.hpp"
+
+extern "C" {
+    #include <freertos/FreeRTOS.h>
+    #include "freertos/queue.h"
+    #include "string.h"
+    #include "esp_log.h"
+} // extern C close
+
+using namespace BLE;
+
+constexpr LinkRequest Services::bulkLink;
+constexpr LinkRequest Services::idleLink;
+
+// OTA progress in the binary log every that many packets. The ring holds 32 records, a record
+// per packet would push out everything logged before the update, its errors too
+static constexpr uint16_t otaLogEveryPackets = 512;
+
+void Services::OnConnect(const LinkInfo& _link) {
+    link = _link;
+    BLOGI("Client connected. MTU %d", link.mtu);
+    // Client connects to fetch data. Get it done quickly
+    profile = LinkProfile::NONE;
+    onActivity();
+}
+
+void Services::OnLinkUpdate(const LinkInfo& _link) {
+    link = _link;
+    BLOGI("Link: interval %d x1.25ms, latency %d, timeout %d x10ms", 
+                link.interval, link.latency, link.timeout);
+}
+
+void Services::Update() {
+    if(profile == LinkProfile::BULK && xTaskGetTickCount() - lastActivity > idleTimeout) {
+        setProfile(LinkProfile::IDLE);
+    }
+}
+
+void Services::onActivity() {
+    lastActivity = xTaskGetTickCount();
+    setProfile(LinkProfile::BULK);
+}
+
+void Services::setProfile(LinkProfile newProfile) {
+    if(newProfile == profile) {
+        return;
+    }
+    profile = newProfile;
+    transport.RequestLink(profile == LinkProfile::BULK ? bulkLink : idleLink);
+}
+
+void Services::OnDisconnect(int reason) {
+    profile = LinkProfile::NONE;
+    // Dump may have been left in the middle, it pauses the trace and the log
+    TELEMETRY::Trace::Rewind();
+    TELEMETRY::BinaryLog::Rewind();
+
+    if(otaInProgress) {
+        // Update will not be finished. Free the partition for the next attempt
+        BLOGW("OTA aborted, client disconnected");
+        esp_ota_abort(otaHandle);
+        otaInProgress = false;
+    }
+}
+
+void Services::OnRead(CharacteristicId id, const LinkInfo& link) {
+    // Status reads, no need to hurry
+    if(id != CharacteristicId::Battery && id != CharacteristicId::Telemetry && id != CharacteristicId::BootProfile) {
+        onActivity();
+    }
+    switch(id) {
+        case CharacteristicId::Position: readPosition(); break;
+        case CharacteristicId::Calibration: readCalibration(); break;
+        case CharacteristicId::Battery: readBattery(); break;
+        case CharacteristicId::Time: readTime(); break;
+        case CharacteristicId::TimeSync: readTimeSync(); break;
+        case CharacteristicId::Telemetry: readTelemetry(); break;
+        case CharacteristicId::BootProfile: readBootProfile(); break;
+        case CharacteristicId::Trace: readTrace(); break;
+        case CharacteristicId::BinaryLog: readBinaryLog(); break;
+        default: break;
+    }
+}
+
+void Services::OnWrite(CharacteristicId id, const uint8_t *data, size_t len, const LinkInfo& link) {
+    if(id != CharacteristicId::Sleep) {
+        onActivity();
+    }
+    switch(id) {
+        case CharacteristicId::Calibration: writeCalibration(data, len); break;
+        case CharacteristicId::Sleep: writeSleep(data, len); break;
+        case CharacteristicId::Time: writeTime(data, len); break;
+        case CharacteristicId::TimeSync: writeTimeSync(data, len); break;
+        case CharacteristicId::OtaControl: writeOtaControl(data, len, link); break;
+        case CharacteristicId::OtaData: writeOtaData(data, len); break;
+        default: break;
+    }
+}
+
+void Services::readPosition() {
+    BUS::Publish(BUS::PositionRequest {.count = 1});
+    IMU::Notify(IMU::REQUEST);
+
+    std::array<uint8_t, PROTOCOL::maxFrameSize> frame;
+    size_t len = PROTOCOL::headerSize;
+    frame[0] = PROTOCOL::version;
+    // Answer comes with the next read, IMU task has not run yet
+    IMU::PositionQueueType item;
+    if(BUS::Receive(item)) {
+        PROTOCOL::Position msg = {.face = (int8_t) item.face, .startTime = (int64_t) item.startTime};
+        len = PROTOCOL::Encode(msg, frame.data(), frame.size());
+    }
+    // Frame with header only means no more positions to read
+    transport.SetValue(CharacteristicId::Position, frame.data(), len);
+}
+
+void Services::readCalibration() {
+    BLOGI("Calibration callback onRead");
+    IMU::CalibrationQueueType item;
+    if(BUS::Receive(item)) {
+        std::array<uint8_t, PROTOCOL::maxFrameSize> frame;
+        PROTOCOL::Calibration msg = {.status = (int8_t) item.status, .face = (int8_t) item.face};
+        auto len = PROTOCOL::Encode(msg, frame.data(), frame.size());
+        // Set calibration result. Details in IMU namespace
+        transport.SetValue(CharacteristicId::Calibration, frame.data(), len);
+        // Client must clear value
+    }
+}
+
+void Services::writeCalibration(const uint8_t *data, size_t len) {
+    BLOGI("Calibration callback onWrite");
+    uint8_t val = len ? data[0] : 0;
+    //TODO do calibration cancel!
+    if(val != 0) {
+        // Initiate calibration
+        BUS::Publish(BUS::CalibrationRequest {.value = val});
+        IMU::Notify(IMU::REQUEST);
+        // Pause sleep (with timeout). Resume it using BLE sleep characteristic
+        BUS::Publish(BUS::SleepPause {.reason = APP::SleepReason::IMU_CALIBRATION});
+        APP::Notify(APP::SLEEP_PAUSE);
+    }
+    // Clear request
+    transport.SetValue(CharacteristicId::Calibration, 0);
+}
+
+void Services::writeSleep(const uint8_t *data, size_t len) {
+    // Sleep enter request from client
+    //TODO change to notify!
+    BUS::Publish(BUS::SleepStart {.source = 1});
+    APP::Notify(APP::SLEEP_START);
+}
+
+void Services::readBattery() {
+    // Battery is estimated once per wake. Value stays set for following reads
+    BLOGI("Battery read");
+    BUS::BatteryLevel battery;
+    // Receive battery percent from battery task
+    if(BUS::Receive(battery)) {
+        transport.SetValue(CharacteristicId::Battery, battery.percent);
+    }
+}
+
+void Services::readTime() {
+    timeval tv = {0,0};
+    gettimeofday(&tv, NULL);
+    transport.SetValue(CharacteristicId::Time, tv.tv_sec);
+}
+
+void Services::writeTime(const uint8_t *data, size_t len) {
+    // sizeof(time_t) bytes of epoch seconds time should be received
+    if(len != sizeof(time_t)) {
+        BLOGE("Time characteristic wrong format");
+        return;
+    }
+
+    time_t receivedTime;
+    memcpy(&receivedTime, data, sizeof(time_t));
+
+    // Whole seconds only. Use time sync characteristic for precise sync
+    auto correction = TIMESYNC::TimeSync::Apply((int64_t) receivedTime * 1000 - TIMESYNC::TimeSync::NowMs());
+    IMU::CorrectTimestamps(correction);
+    BLOGI("Time updated (epoch): %u", (unsigned int) receivedTime);
+}
+
+void Services::readTimeSync() {
+    std::array<uint8_t, PROTOCOL::maxFrameSize> frame;
+    size_t len = PROTOCOL::headerSize;
+    frame[0] = PROTOCOL::version;
+
+    PROTOCOL::TimeSyncResponse response;
+    if(TIMESYNC::TimeSync::GetResponse(response)) {
+        len = PROTOCOL::Encode(response, frame.data(), frame.size());
+    }
+    transport.SetValue(CharacteristicId::TimeSync, frame.data(), len);
+}
+
+void Services::writeTimeSync(const uint8_t *data, size_t len) {
+    PROTOCOL::TimeSyncAdjust adjust;
+
+    if(PROTOCOL::Decode(data, len, adjust)) {
+        // Last step of the exchange
+        TIMESYNC::Correction correction;
+        if(TIMESYNC::TimeSync::OnAdjust(adjust, correction)) {
+            IMU::CorrectTimestamps(correction);
+        }
+        return;
+    }
+    // Any other write starts the exchange
+    TIMESYNC::TimeSync::OnRequest();
+}
+
+void Services::readTelemetry() {
+    std::array<uint8_t, PROTOCOL::maxTelemetryFrameSize> frame;
+    auto len = TELEMETRY::Telemetry::Encode(frame.data(), frame.size());
+    transport.SetValue(CharacteristicId::Telemetry, frame.data(), len);
+}
+
+void Services::readBootProfile() {
+    std::array<uint8_t, PROTOCOL::maxTelemetryFrameSize> frame;
+    auto len = TELEMETRY::BootProfile::Encode(frame.data(), frame.size());
+    transport.SetValue(CharacteristicId::BootProfile, frame.data(), len);
+}
+
+void Services::readTrace() {
+    std::array<uint8_t, PROTOCOL::maxTelemetryFrameSize> frame;
+    auto len = TELEMETRY::Trace::Encode(frame.data(), frame.size());
+    transport.SetValue(CharacteristicId::Trace, frame.data(), len);
+}
+
+void Services::readBinaryLog() {
+    std::array<uint8_t, PROTOCOL::maxTelemetryFrameSize> frame;
+    auto len = TELEMETRY::BinaryLog::Encode(frame.data(), frame.size());
+    transport.SetValue(CharacteristicId::BinaryLog, frame.data(), len);
+}
+
+void Services::writeOtaControl(const uint8_t *data, size_t len, const LinkInfo& link) {
+    unsigned int rcv = len ? (unsigned int) data[0] : (unsigned int) OTA_CONTROL_NOP;
+    BLOGI("OTA Request: %d", rcv);
+    if(rcv == OTA_CONTROL_REQUEST) {
+        BLOGI("OTA Requested via BLE");
+        if(!APP::PowerGovernor::GetPolicy().ota) {
+            BLOGW("OTA refused, battery low");
+            transport.SetValue(CharacteristicId::OtaControl, OTA_CONTROL_REQUEST_NAK);
+            return;
+        }
+        otaPartition = esp_ota_get_next_update_partition(NULL);
+        if(otaPartition == NULL) {
+            BLOGE("OTA Could not get partition");
+            transport.SetValue(CharacteristicId::OtaControl, OTA_CONTROL_REQUEST_NAK);
+            return;
+        }
+
+        auto status = esp_ota_begin(otaPartition, OTA_WITH_SEQUENTIAL_WRITES, &otaHandle);
+        if(status != ESP_OK) {
+            BLOGE("OTA Error 0x%x", status);
+            esp_ota_abort(otaHandle);
+            transport.SetValue(CharacteristicId::OtaControl, OTA_CONTROL_REQUEST_NAK);
+            return;
+        }
+        otaInProgress = true;
+        otaRcvPkg = 0;
+
+        if(link.mtu < 250) {
+            BLOGW("OTA: BLE MTU low %d", link.mtu);
+            //TODO negotiate higher mtu
+        }
+
+        BLOGI("OTA Begin");
+        BUS::Publish(BUS::SleepPause {.reason = APP::SleepReason::OTA_UPDATE});
+        APP::Notify(APP::SLEEP_PAUSE);
+
+        transport.SetValue(CharacteristicId::OtaControl, OTA_CONTROL_REQUEST_ACK);
+    } 
+    else if (rcv == OTA_CONTROL_DONE) {
+        BLOGI("OTA Request to end update");
+        otaInProgress = false;
+        auto status = esp_ota_end(otaHandle);
+        if(status != ESP_OK) {
+            BLOGE("OTA Error 0x%x", status);
+            transport.SetValue(CharacteristicId::OtaControl, OTA_CONTROL_DONE_NAK);
+            return;
+        }
+
+        //TODO check image version
+
+        status = esp_ota_set_boot_partition(otaPartition);
+        if(status != ESP_OK) {
+            BLOGE("OTA Error 0x%x", status);
+            transport.SetValue(CharacteristicId::OtaControl, OTA_CONTROL_DONE_NAK);
+            return;
+        }
+
+        BLOGI("OTA Success, %u packets. Rebooting...", (unsigned int) otaRcvPkg);
+        //TODO enabled: skip image validation when exiting deep sleep
+        transport.SetValue(CharacteristicId::OtaControl, OTA_CONTROL_DONE_ACK);
+        TaskDelay(1s);
+        // when calling esp_restart OS is stuck
+        // workaround is to sleep after OTA, first reboot fails, then next one is fine
+        BUS::Publish(BUS::SleepStart {.source = 0});
+        APP::Notify(APP::SLEEP_START);
+    }
+    else {
+        BLOGW("OTA Unkown request");
+    }
+}
+
+void Services::writeOtaData(const uint8_t *data, size_t len) {
+    //TODO sometimes (dont know why sometimes) OTA tranmission is very slow
+    if(otaRcvPkg % otaLogEveryPackets == 0) {
+        BLOGI("OTA packet %u", (unsigned int) otaRcvPkg);
+    }
+    auto status = esp_ota_write(otaHandle, data, len);
+    if(status == ESP_ERR_INVALID_ARG) {
+        BLOGE("OTA Data write error 0x%x", status);
+        // Notify in case of an error
+        transport.Notify(CharacteristicId::OtaData);
+    }
+    otaRcvPkg++;
+}
@@ -0,0 +1,128 @@
+/**
+ * @file services.hpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+#include "transport.hpp"
+
+extern "C" {
+    #include "freertos/FreeRTOS.h"
+    #include "esp_ota_ops.h"
+} // extern C close
+
+namespace BLE {
+
+/**
+ * @brief Logic of GATT services (position sync, calibration, time, battery, OTA).
+ *      Knows nothing about BLE stack, talks to the client through Transport.
+ */
+class Services {
+public:
+    // Connection parameter profiles
+    enum class LinkProfile { NONE, BULK, IDLE };
+
+    // Short interval, no latency. Data transfer (position drain, calibration, OTA)
+    const static constexpr LinkRequest bulkLink = {.minInterval = 6, .maxInterval = 12, .latency = 0, .timeout = 400};
+    // Long interval, peripheral skips events. Radio mostly off while nothing happens
+    const static constexpr LinkRequest idleLink = {.minInterval = 320, .maxInterval = 400, .latency = 4, .timeout = 600};
+    // No requests for that long - switch to idle profile
+    const static constexpr TickType_t idleTimeout = 2000 / portTICK_PERIOD_MS;
+
+private:
+    Transport& transport;
+
+    LinkInfo link = {};
+    LinkProfile profile = LinkProfile::NONE;
+    TickType_t lastActivity = 0;
+
+    /**
+     * @brief Request profile if not active already.
+     */
+    void setProfile(LinkProfile newProfile);
+
+    /**
+     * @brief Data is being transferred. Keep bulk profile.
+     */
+    void onActivity();
+
+    const esp_partition_t* otaPartition = nullptr;
+    esp_ota_handle_t otaHandle = 0;
+    bool otaInProgress = false;
+    uint16_t otaRcvPkg = 0;
+
+    enum OtaStatus {
+        OTA_CONTROL_NOP,
+        OTA_CONTROL_REQUEST,
+        OTA_CONTROL_REQUEST_ACK,
+        OTA_CONTROL_REQUEST_NAK,
+        OTA_CONTROL_DONE,
+        OTA_CONTROL_DONE_ACK,
+        OTA_CONTROL_DONE_NAK,
+    };
+
+    // Used to send data about time spend in <face> position
+    // At read it will put new data (if available) into characteristic
+    void readPosition();
+    // Used in calibration process
+    void readCalibration();
+    // Used to initiate calibration
+    void writeCalibration(const uint8_t *data, size_t len);
+    void writeSleep(const uint8_t *data, size_t len);
+    void readBattery();
+    void readTime();
+    void writeTime(const uint8_t *data, size_t len);
+    void readTimeSync();
+    void writeTimeSync(const uint8_t *data, size_t len);
+    void writeOtaControl(const uint8_t *data, size_t len, const LinkInfo& link);
+    void writeOtaData(const uint8_t *data, size_t len);
+    void readTelemetry();
+    void readBootProfile();
+    void readTrace();
+    void readBinaryLog();
+
+public:
+    Services() = delete;
+    Services(Transport& _transport) : transport(_transport) {};
+
+    void OnConnect(const LinkInfo& link);
+    void OnDisconnect(int reason);
+
+    /**
+     * @brief Connection parameters have changed (requested by us or by the client).
+     */
+    void OnLinkUpdate(const LinkInfo& link);
+
+    /**
+     * @brief Periodic housekeeping, switches to idle profile. Call from BLE task.
+     */
+    void Update();
+
+    /**
+     * @return Parameters of current link, as reported by the stack
+     */
+    const LinkInfo& GetLink() const {
+        return link;
+    }
+
+    LinkProfile GetProfile() const {
+        return profile;
+    }
+
+    /**
+     * @brief Client is reading characteristic. Value must be set before return.
+     */
+    void OnRead(CharacteristicId id, const LinkInfo& link);
+
+    /**
+     * @brief Client has written characteristic.
+     */
+    void OnWrite(CharacteristicId id, const uint8_t *data, size_t len, const LinkInfo& link);
+};
+
+} // namespace BLE end --------------------
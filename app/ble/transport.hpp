@@ -0,0 +1,83 @@
+/**
+ * @file transport.hpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace BLE {
+
+// Characteristics handled by service layer. Transport maps them to its own handles/UUIDs.
+enum class CharacteristicId : uint8_t {
+    Position,
+    Calibration,
+    Sleep,
+    Battery,
+    Time,
+    TimeSync,
+    OtaControl,
+    OtaData,
+    Telemetry,
+    BootProfile,
+    Trace,
+    BinaryLog,
+    Count
+};
+
+// Parameters of the link with the client
+struct LinkInfo {
+    uint16_t mtu;
+    uint16_t interval;  // in 1.25 ms units
+    uint16_t latency;   // connection events peripheral might skip
+    uint16_t timeout;   // supervision timeout in 10 ms units
+};
+
+// Connection parameters requested from the client. Client decides what is actually used.
+struct LinkRequest {
+    uint16_t minInterval;   // in 1.25 ms units
+    uint16_t maxInterval;   // in 1.25 ms units
+    uint16_t latency;
+    uint16_t timeout;       // in 10 ms units
+};
+
+/**
+ * @brief What service layer needs from BLE stack. Implemented by NimBLE (Ble class)
+ *      and by host loopback (sim/ directory).
+ */
+class Transport {
+public:
+    virtual ~Transport() {};
+
+    /**
+     * @brief Set value of characteristic. Value is copied.
+     */
+    virtual void SetValue(CharacteristicId id, const uint8_t *data, size_t len) = 0;
+
+    /**
+     * @brief Send current value of characteristic to the client.
+     */
+    virtual void Notify(CharacteristicId id) = 0;
+
+    /**
+     * @brief Ask the client to change connection parameters. Result is reported
+     *      asynchronously with Services::OnLinkUpdate.
+     */
+    virtual void RequestLink(const LinkRequest& request) = 0;
+
+    /**
+     * @brief Set value of characteristic to a raw copy of given variable.
+     */
+    template<typename T>
+    void SetValue(CharacteristicId id, const T& value) {
+        SetValue(id, (const uint8_t *) &value, sizeof(T));
+    }
+};
+
+} // namespace BLE end --------------------
@@ -0,0 +1,175 @@
+/**
+ * @file bus.hpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+// Typed message bus. Each message type is a topic backed by its own statically
+// allocated FreeRTOS queue. Type decides the topic, so a message can't be sent
+// to a queue of a different item size. Register types in messages.hpp.
+// Messages are copied: they are a few bytes, copying costs less than noise of the queue
+// operation itself (test/busBenchmark.cpp). Large data should not go through the bus.
+
+#include <cstdint>
+#include <type_traits>
+#include "trace.hpp"
+
+extern "C" {
+    #include "freertos/FreeRTOS.h"
+    #include "freertos/queue.h"
+    #include "esp_log.h"
+} // extern C close
+
+namespace BUS {
+
+/**
+ * @brief Topic configuration. Specialise Traits with it for each message type.
+ * @tparam Id unique id of the topic, used in logs
+ * @tparam Depth max number of pending messages
+ * @tparam Latest keep only the newest message (publish overwrites), depth must be 1
+ */
+template<uint8_t Id, UBaseType_t Depth = 1, bool Latest = false>
+struct Config {
+    static constexpr uint8_t id = Id;
+    static constexpr UBaseType_t depth = Depth;
+    static constexpr bool latest = Latest;
+};
+
+// Not defined for unregistered types - publishing them does not compile
+template<typename T>
+struct Traits;
+
+template<typename T>
+class Topic {
+    static_assert(std::is_trivially_copyable<T>::value, "Messages are copied as raw bytes");
+    static_assert(!Traits<T>::latest || Traits<T>::depth == 1, "Latest value topics hold a single message");
+
+    static StaticQueue_t control;
+    static uint8_t storage[Traits<T>::depth * sizeof(T)];
+    static QueueHandle_t handle;
+    static uint32_t drops;
+
+public:
+    /**
+     * @brief Create the queue. No allocation, storage is static.
+     */
+    static void Init() {
+        if(handle == nullptr) {
+            handle = xQueueCreateStatic(Traits<T>::depth, sizeof(T), storage, &control);
+        }
+    }
+
+    /**
+     * @brief Copy message into the topic. Full topic drops the message,
+     *      latest value topics replace the old one (not counted as a drop).
+     * @param wait how long to wait for space
+     * @return false if message was dropped
+     */
+    static bool Publish(const T& msg, TickType_t wait = 0) {
+        if(handle == nullptr) {
+            drops++;
+            return false;
+        }
+        if(Traits<T>::latest) {
+            xQueueOverwrite(handle, &msg);
+            TELEMETRY::Trace::Record(TELEMETRY::Trace::Event::Publish, Traits<T>::id, 1);
+            return true;
+        }
+        if(xQueueSend(handle, &msg, wait) != pdTRUE) {
+            drops++;
+            TELEMETRY::Trace::Record(TELEMETRY::Trace::Event::Publish, Traits<T>::id, 0);
+            return false;
+        }
+        TELEMETRY::Trace::Record(TELEMETRY::Trace::Event::Publish, Traits<T>::id, 1);
+        return true;
+    }
+
+    /**
+     * @brief Take the oldest message.
+     * @param wait how long to wait for a message
+     * @return false if there was nothing to receive
+     */
+    static bool Receive(T& msg, TickType_t wait = 0) {
+        if(handle == nullptr || xQueueReceive(handle, &msg, wait) != pdTRUE) {
+            // Topics are polled, empty ones are not traced
+            return false;
+        }
+        TELEMETRY::Trace::Record(TELEMETRY::Trace::Event::Receive, Traits<T>::id, uxQueueMessagesWaiting(handle));
+        return true;
+    }
+
+    /**
+     * @return Messages lost since boot (topic full or not initialised)
+     */
+    static uint32_t GetDrops() {
+        return drops;
+    }
+
+    static UBaseType_t GetPending() {
+        return handle != nullptr ? uxQueueMessagesWaiting(handle) : 0;
+    }
+};
+
+template<typename T> StaticQueue_t Topic<T>::control;
+template<typename T> uint8_t Topic<T>::storage[Traits<T>::depth * sizeof(T)];
+template<typename T> QueueHandle_t Topic<T>::handle = nullptr;
+template<typename T> uint32_t Topic<T>::drops = 0;
+
+template<typename T>
+bool Publish(const T& msg, TickType_t wait = 0) {
+    return Topic<T>::Publish(msg, wait);
+}
+
+template<typename T>
+bool Receive(T& msg, TickType_t wait = 0) {
+    return Topic<T>::Receive(msg, wait);
+}
+
+// All topics of the application
+template<typename... T>
+struct TopicList {};
+
+template<typename... T>
+constexpr bool uniqueIds() {
+    const uint8_t ids[] = {Traits<T>::id...};
+    for(size_t i = 0; i < sizeof...(T); i++) {
+        for(size_t j = i + 1; j < sizeof...(T); j++) {
+            if(ids[i] == ids[j]) return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Create queues of all topics. Call before tasks using the bus are created.
+ */
+template<typename... T>
+void Init(TopicList<T...>) {
+    static_assert(uniqueIds<T...>(), "Topic ids must be unique");
+    int unused[] = {0, (Topic<T>::Init(), 0)...};
+    (void) unused;
+}
+
+template<typename T>
+void logDrops() {
+    if(Topic<T>::GetDrops()) {
+        ESP_LOGW(__FILE__, "%s:%d. Topic %d dropped %u messages", __func__ ,__LINE__,
+                    Traits<T>::id, (unsigned int) Topic<T>::GetDrops());
+    }
+}
+
+/**
+ * @brief Log topics which lost messages.
+ */
+template<typename... T>
+void LogDrops(TopicList<T...>) {
+    int unused[] = {0, (logDrops<T>(), 0)...};
+    (void) unused;
+}
+
+} // namespace BUS end --------------------
@@ -0,0 +1,66 @@
+/**
+ * @file messages.hpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+#include "bus.hpp"
+#include "imu.hpp"
+#include "sleepScheduler.hpp"
+
+namespace BUS {
+
+// Battery task -> BLE. Latest reading only
+struct BatteryLevel {
+    int percent;
+};
+
+// IMU -> application management. New position registered
+struct ImuReady {
+    uint8_t saved; // Positions waiting to be sent
+};
+
+// BLE -> IMU. Client reads position, IMU answers with IMU::PositionQueueType
+struct PositionRequest {
+    uint8_t count;
+};
+
+// BLE -> IMU. Client starts calibration of next face, IMU answers with IMU::CalibrationQueueType
+struct CalibrationRequest {
+    uint8_t value;
+};
+
+// Anyone -> application management
+struct SleepPause {
+    APP::SleepReason reason;
+};
+
+// Anyone -> application management
+struct SleepStart {
+    uint8_t source; // 1 - client request, 0 - after OTA
+};
+
+// IMU -> application management. Answer to IMU::Imu::PrepareSleep
+struct ImuAsleep {
+    bool ok;    // Interrupt and FIFO stopped, sleep profile set
+};
+
+template<> struct Traits<BatteryLevel> : Config<1, 1, true> {};
+template<> struct Traits<ImuReady> : Config<2, 1, true> {};
+template<> struct Traits<IMU::PositionQueueType> : Config<3> {};
+template<> struct Traits<PositionRequest> : Config<4> {};
+template<> struct Traits<CalibrationRequest> : Config<5> {};
+template<> struct Traits<IMU::CalibrationQueueType> : Config<6> {};
+template<> struct Traits<SleepPause> : Config<7, 4> {};
+template<> struct Traits<SleepStart> : Config<8> {};
+template<> struct Traits<ImuAsleep> : Config<9> {};
+
+typedef TopicList<BatteryLevel, ImuReady, IMU::PositionQueueType, PositionRequest,
+                    CalibrationRequest, IMU::CalibrationQueueType, SleepPause, SleepStart, ImuAsleep> Topics;
+
+} // namespace BUS end --------------------
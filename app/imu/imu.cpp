@@ -9,15 +9,21 @@
 
 #include "imu.hpp"
 #include "kalmanfilter.hpp"
+#include <algorithm>
 #include <cmath>
 #include <array>
 #include "dateTime.hpp"
+#include "appEvents.hpp"
+#include "sleepScheduler.hpp"
+#include "bootProfile.hpp"
+#include "messages.hpp"
 
 extern "C" {
     #include "esp_log.h"
     #include "freertos/FreeRTOS.h"
     #include "freertos/queue.h"
     #include "esp_sleep.h"
+    #include "esp_attr.h"
 } // extern C close
 
 // IMU stands for Inertial Measurement unit. 
@@ -25,13 +31,13 @@ extern "C" {
 
 using namespace IMU;
 
-// RTOS queues
-extern QueueHandle_t ImuReadyQueue;
-extern QueueHandle_t ImuPositionQueue;
-extern QueueHandle_t ImuPositionGetQueue;
-extern QueueHandle_t ImuCalibrationInitQueue;
-extern QueueHandle_t ImuCalibrationStateQueue;
-extern QueueHandle_t SleepPauseQueue;
+TaskHandle_t ImuHandle = nullptr;
+
+// Odr-used by chrono operators, C++14 needs the definitions
+constexpr std::chrono::milliseconds Imu::taskPeriod;
+constexpr std::chrono::milliseconds Imu::fifoPeriod;
+constexpr std::chrono::seconds Imu::rollCooldown;
+constexpr std::chrono::milliseconds Imu::sleepAckTimeout;
 
 // This data will be stored in case of deep sleep. And buffer can hold large number of
 // data in case of bluetooth connection lost. At reconnection will be sent.
@@ -47,64 +53,181 @@ RTC_DATA_ATTR Orientation oldPos;
 RTC_DATA_ATTR Timestamp cooldown;
 RTC_DATA_ATTR bool isNewPos;
 
+// Samples of one FIFO burst, room for gyroscope axes too. Too big for the task stack
+static int16_t SampleBlock[Imu::maxBurst * MPU6050::maxFifoValues];
+
+// MPU6050 has no FIFO watermark interrupt. Data ready pulses are counted instead,
+// task is woken when a batch is stored
+static struct {
+    uint32_t watermark;
+    volatile uint32_t samples;
+} DataReady;
+
+static void IRAM_ATTR onDataReady(void *arg) {
+    if(++DataReady.samples < DataReady.watermark) {
+        return;
+    }
+    DataReady.samples = 0;
+    BaseType_t woken = pdFALSE;
+    xTaskNotifyFromISR((TaskHandle_t) arg, IMU::DATA_READY, eSetBits, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+/**
+ * @brief Stability detection. Each sample of a flip restarts the cooldown,
+ *      position is registered when the cube rested for the whole cooldown.
+ */
+static void processSample(Imu& imu, const Orientation& orient) {
+    if(!(oldPos == orient)) {
+        isNewPos = true;
+        oldPos = orient;
+        // Block OnPositionChange until cube is steady / user has flipped completely
+        cooldown = Clock::now();
+    }
+
+    if(Clock::now() - cooldown > Imu::rollCooldown && isNewPos) {
+        // New position detected
+        if(imu.OnPositionChange(orient)) {
+            // New position accepted
+            BUS::Publish(BUS::ImuReady {.saved = (uint8_t) SavedPositions.GetActiveItems()});
+            APP::Notify(APP::IMU_READY);
+        }
+        isNewPos = false;
+    }
+}
+
 void IMU::ImuTask(void *pvParameters) {
     ESP_LOGI(__FILE__, "%s:%d. Task init", __func__ ,__LINE__);
     
+    ImuHandle = xTaskGetCurrentTaskHandle();
     Imu imu;
     
     for(;;) {
-        Orientation orient = imu.GetPositionRaw();
-
-        if(!(oldPos == orient)) {
-            isNewPos = true;
-            oldPos = orient;
-            // Block OnPositionChange until cube is steady / user has flipped completely
-            cooldown = Clock::now();
-        }
+        // Samples are read by the bus task while requests are served
+        imu.StartSample();
 
-        if(Clock::now() - cooldown > Imu::rollCooldown && isNewPos) {
-            // New position detected
-            if(imu.OnPositionChange(orient)) {
-                // New position accepted
-                auto item = 1;
-                xQueueSend(ImuReadyQueue, &item, 0);
-            }
-            isNewPos = false;
-        }
-
-        PositionQueueType item;
         // Send batched data from vector to BLE
-        if(xQueueReceive(ImuPositionGetQueue, &item, 0)) {
-            // Initiate send only if there are items available
-            if(SavedPositions.GetActiveItems()) {
+        BUS::PositionRequest request;
+        if(BUS::Receive(request)) {
+            // Initiate send only if there are items available. One answer at a time,
+            // BLE takes it with the next read
+            if(SavedPositions.GetActiveItems() && !BUS::Topic<PositionQueueType>::GetPending()) {
                 // Pop item from vector
-                item = SavedPositions.Pop();
-                xQueueSend(ImuPositionQueue, &item, 0);
+                BUS::Publish(SavedPositions.Pop());
 
-                const char * msg = "imuSendPosition";
                 // Defer sleep. Let someone process the data
-                xQueueSend(SleepPauseQueue, &msg, 0);
+                BUS::Publish(BUS::SleepPause {.reason = APP::SleepReason::IMU_SEND_POSITION});
+                APP::Notify(APP::SLEEP_PAUSE);
             }
         }
 
+        auto samples = imu.FinishSample(SampleBlock, Imu::maxBurst);
+        if(samples) {
+            TELEMETRY::BootProfile::Mark(TELEMETRY::BootProfile::Marker::FirstSample);
+        }
+        // Gyroscope values, if any, are skipped. Face is told by gravity
+        const size_t stride = imu.GetSampleValues();
+        for(size_t i = 0; i < samples; i++) {
+            const int16_t *raw = SampleBlock + stride * i;
+            // Orientation is inverted acceleration
+            processSample(imu, Orientation(-MPU6050::RawToAcc(raw[0]), -MPU6050::RawToAcc(raw[1]),
+                                            -MPU6050::RawToAcc(raw[2])));
+        }
+
         // If BLE initiated calibration...
-        auto val = 0;
-        if(xQueueReceive(ImuCalibrationInitQueue, &val, 0)) {
-            if(val != 0) {
+        BUS::CalibrationRequest calibration;
+        if(BUS::Receive(calibration)) {
+            if(calibration.value != 0) {
                 auto pos = -1;
                 // Pos will have face number
                 auto ret = imu.CalibrateCubeFaces(pos);
-                // Create a string "x,xx" containing calibration status and calibrated face
-                std::string calibrationStatus = std::to_string(ret) + ',' + std::to_string(pos);
-                xQueueSend(ImuCalibrationStateQueue, calibrationStatus.data(), 0);
+                // Calibration status and calibrated face. Encoded by BLE
+                BUS::Publish(CalibrationQueueType(ret, pos));
             }
         }
 
-        TaskDelay(Imu::taskPeriod);
+        // Until the sensor stored the next batch. BLE reads a position per request, do not keep it waiting
+        // Bits of bus transactions wake it as well, these are not events
+        const uint32_t wanted = IMU::DATA_READY | IMU::REQUEST | IMU::SLEEP;
+        const TickType_t period = ConvertToTicks(imu.GetPeriod());
+        const TickType_t start = xTaskGetTickCount();
+        uint32_t events = 0;
+        for(TickType_t elapsed = 0; !(events & wanted) && elapsed < period; elapsed = xTaskGetTickCount() - start) {
+            events = 0;
+            xTaskNotifyWait(0, wanted, &events, period - elapsed);
+        }
+        if(events & IMU::DATA_READY) {
+            imu.OnDataReady();
+        }
+        if(events & IMU::SLEEP) {
+            BUS::Publish(BUS::ImuAsleep {.ok = imu.EnterSleep()});
+            // Sensor belongs to the wake stub until the next boot
+            vTaskSuspend(NULL);
+        }
+    }
+}
+
+void IMU::CorrectTimestamps(const TIMESYNC::Correction& correction) {
+    SavedPositions.ForEach([&correction](PositionQueueType& item) {
+        item.startTime = correction.Apply(item.startTime);
+    });
+}
+
+bool IMU::GetRestingOrientation(std::array<int16_t, 3>& raw, int16_t& threshold) {
+    if(isNewPos) {
+        return false;
+    }
+    for(size_t i = 0; i < raw.size(); i++) {
+        // Orientation is inverted acceleration, see GetPositionRaw
+        raw[i] = MPU6050::AccToRaw(-oldPos.pos[i]);
+    }
+    threshold = MPU6050::AccToRaw(Orientation::drift);
+    return true;
+}
+
+I2cBus& Imu::openBus() {
+    return I2cBus::Open({Imu::pinScl, Imu::pinSda, Imu::port, Imu::busTimeoutMs});
+}
+
+bool Imu::PrepareSleep() {
+    BUS::ImuAsleep asleep;
+    // Left by a request which timed out
+    BUS::Receive(asleep);
+    if(ImuHandle == nullptr) {
+        ESP_LOGE(__FILE__, "%s:%d. IMU task not running", __func__ ,__LINE__);
+        return false;
     }
+    // ImuTask owns the sensor, it is between bus transactions when it takes the request
+    IMU::Notify(IMU::SLEEP);
+    if(!BUS::Receive(asleep, ConvertToTicks(Imu::sleepAckTimeout))) {
+        ESP_LOGE(__FILE__, "%s:%d. IMU task did not answer", __func__ ,__LINE__);
+        return false;
+    }
+    return asleep.ok;
 }
 
-Imu::Imu() : MPU6050(Imu::pinScl, Imu::pinSda, Imu::port) {
+bool Imu::EnterSleep() {
+    if(dataReady) {
+        interrupt.DisableInterrupt();
+        dataReady = false;
+    }
+    bool ok = disableDataReadyInterrupt();
+    if(fifo) {
+        ok &= disableFifo();
+        fifo = false;
+    }
+    if(!ok) {
+        ESP_LOGE(__FILE__, "%s:%d. Could not stop interrupt or FIFO", __func__ ,__LINE__);
+    }
+    if(!setProfile(Imu::sleepProfile)) {
+        ESP_LOGE(__FILE__, "%s:%d. Could not set sleep profile", __func__ ,__LINE__);
+        return false;
+    }
+    return ok;
+}
+
+Imu::Imu() : MPU6050(openBus()), fifo(false),
+                dataReady(false), interrupt(Imu::pinInt) {
     ESP_LOGI(__FILE__, "%s:%d. Init", __func__ ,__LINE__);
 
     if(nvs.init() != ESP_OK) {
@@ -120,6 +243,25 @@ Imu::Imu() : MPU6050(Imu::pinScl, Imu::pinSda, Imu::port) {
     }
     ESP_LOGI(__FILE__, "%s:%d. MPU6050 init done", __func__ ,__LINE__);
 
+    // Cycling profile of init is the one for deep sleep
+    if(!setProfile(Imu::awakeProfile, Imu::fifoSampleRateHz)) {
+        ESP_LOGW(__FILE__, "%s:%d. Could not set awake profile", __func__ ,__LINE__);
+    }
+    // Polled every taskPeriod if FIFO is not available
+    fifo = enableFifo();
+    if(!fifo) {
+        ESP_LOGW(__FILE__, "%s:%d. FIFO not enabled, polling", __func__ ,__LINE__);
+    }
+    // Task sleeps until the sensor has a batch, a sample at a time without FIFO
+    DataReady.watermark = fifo ? Imu::fifoSampleRateHz * Imu::fifoPeriod.count() / 1000 : 1;
+    DataReady.samples = 0;
+    dataReady = enableDataReadyInterrupt() &&
+                interrupt.EnableInterrupt(Gpio::RISING, onDataReady, xTaskGetCurrentTaskHandle()) == ESP_OK;
+    if(!dataReady) {
+        ESP_LOGW(__FILE__, "%s:%d. Data ready interrupt not enabled, timed reads", __func__ ,__LINE__);
+    }
+    TELEMETRY::BootProfile::Mark(TELEMETRY::BootProfile::Marker::ImuInit);
+
     KALMAN pfilter(0.005);
     KALMAN rfilter(0.005);
 
@@ -180,7 +322,38 @@ int Imu::CalibrateCubeFaces(int& returnPosition) {
 }
 
 Orientation Imu::GetPositionRaw() {
-    return Orientation(-getAccX(), -getAccY(), -getAccZ());
+    std::array<float, 3> acc = {0, 0, 0};
+    if(!getAcc(acc)) {
+        ESP_LOGE(__FILE__, "%s:%d. Could not read accelerometer", __func__ ,__LINE__);
+    }
+    return Orientation(-acc[0], -acc[1], -acc[2]);
+}
+
+bool Imu::StartSample() {
+    return fifo ? startFifoRead() : startAccRead();
+}
+
+size_t Imu::FinishSample(int16_t *block, size_t maxSamples) {
+    std::array<int16_t, 3> raw;
+    if(fifo) {
+        auto samples = finishFifoRead(block, maxSamples);
+        if(samples > 0) {
+            return samples;
+        }
+        if(samples < 0) {
+            ESP_LOGW(__FILE__, "%s:%d. FIFO samples lost", __func__ ,__LINE__);
+        }
+        // Nothing stored yet (just after boot) or lost, current sample still counts
+        if(!startAccRead()) {
+            return 0;
+        }
+    }
+    if(!finishAccRead(raw)) {
+        ESP_LOGE(__FILE__, "%s:%d. Could not read accelerometer", __func__ ,__LINE__);
+        return 0;
+    }
+    std::copy(raw.begin(), raw.end(), block);
+    return 1;
 }
 
 bool Imu::OnPositionChange(const Orientation& newOrient) {
@@ -202,7 +375,7 @@ bool Imu::OnPositionChange(const Orientation& newOrient) {
         PositionQueueType prevPos = SavedPositions.Pop();
         // Put back item we popped
         SavedPositions.Push(prevPos);
-        if(prevPos.face == face) {
+        if((int) prevPos.face == face) {
             // Same position as before, dont save it
             return false;
         }
@@ -12,16 +12,49 @@
 #include "mpu6050.hpp"
 #include <array>
 #include "dateTime.hpp"
+#include "timeSync.hpp"
 #include "gpio.hpp"
 #include "nvs.hpp"
 
+extern TaskHandle_t ImuHandle;
+
 namespace IMU {
 
+// Events which wake up IMU task, as task notification bits. Data still goes through the bus
+enum Event : uint32_t {
+    DATA_READY = 1 << 0,        // Sensor stored new samples (INT pin)
+    REQUEST = 1 << 1,           // BLE published a request
+    SLEEP = 1 << 2,             // Deep sleep follows, see Imu::PrepareSleep
+};
+
+/**
+ * @brief Wake up IMU task. Safe to call before the task exists.
+ */
+inline void Notify(Event event) {
+    if(ImuHandle != nullptr) {
+        xTaskNotify(ImuHandle, event, eSetBits);
+    }
+}
+
 /**
  * @brief IMU device task/thread. Execution managed by OS.
  */
 void ImuTask(void *pvParameters);
 
+/**
+ * @brief Fix start time of positions waiting to be sent. Call after clock was stepped.
+ * @param correction step made by time sync
+ */
+void CorrectTimestamps(const TIMESYNC::Correction& correction);
+
+/**
+ * @brief Orientation the cube rests in, as raw accelerometer readings. Used by the wake stub.
+ * @param[out] raw MPU6050 ACCEL_XOUT, ACCEL_YOUT, ACCEL_ZOUT
+ * @param[out] threshold max raw difference on any axis for the same orientation
+ * @return false if cube is moving or new position is not registered yet
+ */
+bool GetRestingOrientation(std::array<int16_t, 3>& raw, int16_t& threshold);
+
 struct PositionQueueType {
     PositionQueueType() {};
     PositionQueueType(int _face, int _time) : face(_face), startTime(_time) {};
@@ -30,6 +63,14 @@ struct PositionQueueType {
     time_t startTime;
 };
 
+struct CalibrationQueueType {
+    CalibrationQueueType() {};
+    CalibrationQueueType(int _status, int _face) : status(_status), face(_face) {};
+
+    int status;
+    int face;
+};
+
 template<typename Type, int SizeT>
 class SimpleVector {
     unsigned int activeItems;
@@ -64,12 +105,22 @@ public:
         activeItems++;
     }
 
+    /**
+     * @brief Call func on each active item. Items might be modified in place.
+     */
+    template<typename Func>
+    void ForEach(Func func) {
+        for(unsigned int i = 1; i <= activeItems; i++) {
+            func(elements[i]);
+        }
+    }
+
     bool isDuplicate(Type item) {
         if(!activeItems) {
             return false;
         }
 
-        for(int i = 0; i < activeItems; i++) {
+        for(unsigned int i = 0; i < activeItems; i++) {
             if(elements[i] == item) {
                 return true;
             }
@@ -87,14 +138,14 @@ public:
 
     std::array<float, 3> pos; // x, y, z
 
+    // Max difference on any axis [g] to be treated as the same orientation
+    const static constexpr float drift = 0.15;
+
     /**
      * "==" operator checks if value is in bound +/- x of compared one
      * @return close enough?
      */
     bool operator == (Orientation newPos) {
-
-        constexpr float drift = 0.15;
-
         for(auto i = 0; i < pos.size(); i++ ) {
             if(newPos.pos[i] > ( pos[i] + drift) ||
                 (newPos.pos[i]) < (pos[i] - drift)) {
@@ -113,11 +164,35 @@ public:
 class Imu : private MPU6050 {
 public:
     const static constexpr std::chrono::milliseconds taskPeriod = 5ms;
+    // FIFO mode: samples are stored by the MPU, task drains them in bursts
+    const static constexpr std::chrono::milliseconds fifoPeriod = 100ms;
+    const static constexpr uint16_t fifoSampleRateHz = 100;
+    // Awake: continuous samples for the FIFO. Asleep: wake stub reads a fresh sample now and then
+    const static constexpr MPU6050::Profile awakeProfile = MPU6050::Profile::FullAccel;
+    const static constexpr MPU6050::Profile sleepProfile = MPU6050::Profile::Cycle5Hz;
+    // Most samples the FIFO holds, accelerometer only (X, Y, Z)
+    const static constexpr size_t maxBurst = MPU6050::fifoSize / 6;
     const static constexpr std::chrono::seconds rollCooldown = 5s; // registering new position cooldown
     const static constexpr int cubeFaces = 9;
+    // ImuTask may be calibrating a face, that waits 200 ms
+    const static constexpr std::chrono::milliseconds sleepAckTimeout = 500ms;
 
     Imu();
 
+    /**
+     * @brief Ask ImuTask to put the accelerometer to sleep (see EnterSleep) and wait for
+     *      its answer, at most sleepAckTimeout. Call before deep sleep, from another task.
+     * @return false if ImuTask did not answer or the sensor could not be set
+     */
+    static bool PrepareSleep(void);
+
+    /**
+     * @brief Stop data ready interrupt and FIFO, switch to sleepProfile. Wake stub reads
+     *      single samples until the next boot. Called by ImuTask.
+     * @return false if a bus transaction failed
+     */
+    bool EnterSleep(void);
+
     /**
      * @brief Perform calibration process of face position. 
      *      One face register on function call.
@@ -133,6 +208,42 @@ public:
      */
     Orientation GetPositionRaw(void);
 
+    /**
+     * @brief Start reading samples. Bus task reads them while ImuTask serves requests
+     * @return false if read could not be started
+     */
+    bool StartSample(void);
+
+    /**
+     * @brief Wait for the read started by StartSample. In FIFO mode all samples stored
+     *      since the previous call, otherwise one. Current one if FIFO is empty or was lost.
+     * @param[out] block register values of each sample, oldest first. GetSampleValues() each,
+     *      accelerometer X, Y, Z first
+     * @param maxSamples capacity of block, at least 1
+     * @return Number of samples, 0 if read failed
+     */
+    size_t FinishSample(int16_t *block, size_t maxSamples);
+
+    /**
+     * @return Stride of samples in the block of FinishSample. Gyroscope axes follow
+     *      the accelerometer ones in FIFO mode of a profile with gyroscope
+     */
+    size_t GetSampleValues(void) const { return fifo ? getFifoValues() : 3; }
+
+    /**
+     * @brief ImuTask was woken by the data ready interrupt. Counts its latency
+     */
+    void OnDataReady(void) { interrupt.Handled(); }
+
+    /**
+     * @return How long ImuTask waits for new samples. With data ready interrupt it is woken
+     *      earlier, the timeout only covers missing pulses
+     */
+    std::chrono::milliseconds GetPeriod() const {
+        const auto period = fifo ? fifoPeriod : taskPeriod;
+        return dataReady ? 2 * period : period;
+    }
+
     /**
      * @brief Saves position in RTCdata memory.
      * @param newOrient new orientation
@@ -152,9 +263,18 @@ private:
     const static constexpr gpio_num_t pinSda = (gpio_num_t) 21; //23lolin(?gnd) //21firebeetle
     const static constexpr gpio_num_t pinScl = (gpio_num_t) 22; //19lolin(?gnd) //22firebeetle
     const static constexpr i2c_port_t port = (i2c_port_t) I2C_NUM_0;
+    const static constexpr int pinInt = 4; // MPU6050 INT, RTC capable
+    // Full FIFO burst takes ~25 ms at 400 kHz. Longer means the bus is stuck
+    const static constexpr uint32_t busTimeoutMs = 50;
+
+    bool fifo;
+    bool dataReady;     // INT pin wakes ImuTask
 
+    Gpio interrupt;
     NVS::Nvs nvs;
 
+    static I2cBus& openBus(void);
+
     enum CalibrationStatus {
         ERROR = -1,
         IDLE,   // Waiting for input from app
@@ -9,12 +9,27 @@
 
 #include "mpu6050.hpp"
 #include "kalmanfilter.hpp"
+#include <algorithm>
 #include <cmath>
 
 #define ORIGINAL_OUTPUT			 (0)
 #define ACC_FULLSCALE        	 (2)
 #define GYRO_FULLSCALE			 (250)
 
+// Gyroscope output rate with low pass filter on, sample rate is divided from it
+#define FILTERED_OUTPUT_RATE_HZ  (1000)
+#define FIFO_EN_ACCEL            (0x08)
+#define FIFO_EN_GYRO             (0x70)
+#define USER_CTRL_FIFO_EN        (0x40)
+#define USER_CTRL_FIFO_RESET     (0x04)
+#define INT_ENABLE_DATA_RDY      (0x01)
+#define PWR_MGMT_1_SLEEP         (0x40)
+#define PWR_MGMT_1_CYCLE         (0x20)
+#define PWR_MGMT_1_TEMP_DIS      (0x08)
+#define PWR_MGMT_1_CLK_GYRO_X    (0x01)
+#define PWR_MGMT_2_STBY_ACCEL    (0x38)
+#define PWR_MGMT_2_STBY_GYRO     (0x07)
+
 #if ORIGINAL_OUTPUT == 0
 	#if  ACC_FULLSCALE  == 2
 		#define AccAxis_Sensitive (float)(16384)
@@ -41,88 +56,236 @@
 	#define GyroAxis_Sensitive (1)
 #endif
 
-MPU6050::MPU6050(gpio_num_t scl, gpio_num_t sda, i2c_port_t port) {
-    i2c = new I2C(scl, sda, port);
+namespace {
+
+// Registers and FIFO are big endian
+int16_t toRaw(const uint8_t *r) {
+    return (int16_t) (r[0] << 8 | r[1]);
+}
+
+void rawToAcc(const uint8_t *r, std::array<float, 3>& acc) {
+    for (size_t i = 0; i < acc.size(); i++) {
+        acc[i] = (float)toRaw(r + 2 * i) / AccAxis_Sensitive;
+    }
 }
 
-MPU6050::~MPU6050() {
-    delete(i2c);
+// DLPF_CFG of CONFIG, bandwidth below half of the sample rate
+uint8_t lowPassFor(uint16_t sampleRateHz) {
+    if (sampleRateHz >= 100) return 0x03;   // 44 Hz
+    if (sampleRateHz >= 50) return 0x04;    // 21 Hz
+    if (sampleRateHz >= 20) return 0x05;    // 10 Hz
+    return 0x06;                            // 5 Hz
+}
+
+struct ProfileRegisters {
+    uint8_t pwrMgmt1;
+    uint8_t pwrMgmt2;
+    bool continuous;    // Sample rate and filter apply
+};
+
+// Indexed by MPU6050::Profile. LP_WAKE_CTRL is PWR_MGMT_2 bits 7:6
+const ProfileRegisters profiles[] = {
+    {PWR_MGMT_1_SLEEP | PWR_MGMT_1_TEMP_DIS, PWR_MGMT_2_STBY_ACCEL | PWR_MGMT_2_STBY_GYRO, false},
+    {PWR_MGMT_1_CYCLE | PWR_MGMT_1_TEMP_DIS, 0 << 6 | PWR_MGMT_2_STBY_GYRO, false},
+    {PWR_MGMT_1_CYCLE | PWR_MGMT_1_TEMP_DIS, 1 << 6 | PWR_MGMT_2_STBY_GYRO, false},
+    {PWR_MGMT_1_CYCLE | PWR_MGMT_1_TEMP_DIS, 2 << 6 | PWR_MGMT_2_STBY_GYRO, false},
+    {PWR_MGMT_1_CYCLE | PWR_MGMT_1_TEMP_DIS, 3 << 6 | PWR_MGMT_2_STBY_GYRO, false},
+    {PWR_MGMT_1_TEMP_DIS, PWR_MGMT_2_STBY_GYRO, true},
+    // Gyroscope clock is more stable than the internal oscillator, when it runs anyway
+    {PWR_MGMT_1_TEMP_DIS | PWR_MGMT_1_CLK_GYRO_X, 0x00, true},
+};
+
+} // namespace end --------------------
+
+// Odr-used when compared, C++14 needs the definitions
+constexpr size_t MPU6050::fifoSize;
+constexpr uint8_t MPU6050::maxFifoValues;
+
+MPU6050::MPU6050(I2cBus& bus) : device(bus, MPU6050_ADDR), sample{}, fifoValues(3),
+                                profile(Profile::Off) {
+    // Nothing started yet, finishAccRead must not wait for it
+    sample.done = true;
+    sample.result = ESP_ERR_INVALID_STATE;
 }
 
 bool MPU6050::init() {
-    if (!i2c -> slave_write(MPU6050_ADDR, PWR_MGMT_1  , 0x00))
-        return false;
-    if (!i2c -> slave_write(MPU6050_ADDR, SMPLRT_DIV  , 0x07))
+    if (device.Write(PWR_MGMT_1, 0x00) != ESP_OK)
         return false;
-    if (!i2c -> slave_write(MPU6050_ADDR, CONFIG      , 0x07))
+    // SMPLRT_DIV, CONFIG, GYRO_CONFIG, ACCEL_CONFIG are consecutive, one burst
+    const uint8_t config[] = {0x07, 0x07, 0x18, 0x01};
+    if (device.Write(SMPLRT_DIV, config, sizeof(config)) != ESP_OK)
         return false;
-    if (!i2c -> slave_write(MPU6050_ADDR, GYRO_CONFIG , 0x18))
+    if (device.Write(PWR_MGMT_1, 0x00) != ESP_OK)
         return false;
-    if (!i2c -> slave_write(MPU6050_ADDR, ACCEL_CONFIG, 0x01))
-        return false;
-    if (!i2c -> slave_write(MPU6050_ADDR, PWR_MGMT_1, 0x00))
-        return false;
-    enableSleepCycling();
-    
-    return true;
+    // Lowest power the tracker works with, user picks another one when awake
+    return setProfile(Profile::Cycle5Hz);
 }
 
 float MPU6050::getAccX() {
     uint8_t r[2];
-    i2c -> slave_read(MPU6050_ADDR, ACCEL_XOUT_H, r, 2);
+    device.Read(ACCEL_XOUT_H, r, 2);
     short accx = r[0] << 8 | r[1];
     return (float)accx / AccAxis_Sensitive;
 }
 
 float MPU6050::getAccY() {
     uint8_t r[2];
-    i2c -> slave_read(MPU6050_ADDR, ACCEL_YOUT_H, r, 2);
+    device.Read(ACCEL_YOUT_H, r, 2);
     short accy = r[0] << 8 | r[1];
     return (float)accy / AccAxis_Sensitive;
 }
 
 float MPU6050::getAccZ() {
     uint8_t r[2];
-    i2c -> slave_read(MPU6050_ADDR, ACCEL_ZOUT_H, r, 2);
+    device.Read(ACCEL_ZOUT_H, r, 2);
     short accz = r[0] << 8 | r[1];
     return (float)accz / AccAxis_Sensitive;
 }
 
 float MPU6050::getGyroX() {
     uint8_t r[2];
-    i2c -> slave_read(MPU6050_ADDR, GYRO_XOUT_H, r, 2);
+    device.Read(GYRO_XOUT_H, r, 2);
     short gyrox = r[0] << 8 | r[1];
     return (float)gyrox / GyroAxis_Sensitive;
 }
 
 float MPU6050::getGyroY() {
     uint8_t r[2];
-    i2c -> slave_read(MPU6050_ADDR, GYRO_YOUT_H, r, 2);
+    device.Read(GYRO_YOUT_H, r, 2);
     short gyroy = r[0] << 8 | r[1];
     return (float)gyroy / GyroAxis_Sensitive;
 }
 
 float MPU6050::getGyroZ() {
     uint8_t r[2];
-    i2c -> slave_read(MPU6050_ADDR, GYRO_ZOUT_H, r, 2);
+    device.Read(GYRO_ZOUT_H, r, 2);
     short gyroz = r[0] << 8 | r[1];
     return (float)gyroz / GyroAxis_Sensitive;
 }
 
-void MPU6050::enableSleepCycling() {
-    uint8_t r1, r2;
-    i2c->slave_read(MPU6050_ADDR, PWR_MGMT_1, &r1, 1);
-    i2c->slave_read(MPU6050_ADDR, PWR_MGMT_2, &r2, 1);
+bool MPU6050::getAcc(std::array<float, 3>& acc) {
+    // ACCEL_XOUT_H .. ACCEL_ZOUT_L
+    uint8_t r[6];
+    if (device.Read(ACCEL_XOUT_H, r, sizeof(r)) != ESP_OK)
+        return false;
+    rawToAcc(r, acc);
+    return true;
+}
 
-    /*
-        SLEEP When set to 1, this bit puts the MPU-60X0 into sleep mode.
-        CYCLE When this bit is set to 1 and SLEEP is disabled, the MPU-60X0 will cycle between sleep mode and 
-        waking up to take a single sample of data from active sensors at a rate determined by LP_WAKE_CTRL (register 108).
-    */
+bool MPU6050::startAccRead() {
+    // Previous one is still on the bus, its buffer is in use
+    if (!sample.done)
+        return false;
+    return device.StartRead(sample, ACCEL_XOUT_H, sampleRaw, sizeof(sampleRaw)) == ESP_OK;
+}
 
-    r1 = r1 || 0b00101000; // Set cycle and temp_disable bit
-    i2c->slave_write(MPU6050_ADDR, PWR_MGMT_1, r1);
+bool MPU6050::finishAccRead(std::array<int16_t, 3>& raw) {
+    if (device.Wait(sample) != ESP_OK)
+        return false;
+    for (size_t i = 0; i < raw.size(); i++) {
+        raw[i] = toRaw(sampleRaw + 2 * i);
+    }
+    return true;
+}
+
+bool MPU6050::setProfile(Profile newProfile, uint16_t sampleRateHz) {
+    const auto& registers = profiles[(uint8_t) newProfile];
+    if (registers.continuous) {
+        if (sampleRateHz < FILTERED_OUTPUT_RATE_HZ / 256 || sampleRateHz > FILTERED_OUTPUT_RATE_HZ)
+            return false;
+        // SMPLRT_DIV, CONFIG
+        const uint8_t rate[] = {(uint8_t) (FILTERED_OUTPUT_RATE_HZ / sampleRateHz - 1), lowPassFor(sampleRateHz)};
+        uint8_t written[sizeof(rate)];
+        if (device.Write(SMPLRT_DIV, rate, sizeof(rate)) != ESP_OK)
+            return false;
+        if (device.Read(SMPLRT_DIV, written, sizeof(written)) != ESP_OK || !std::equal(rate, rate + sizeof(rate), written))
+            return false;
+    }
+    // PWR_MGMT_1, PWR_MGMT_2. One burst, chip never runs a mix of two profiles
+    const uint8_t power[] = {registers.pwrMgmt1, registers.pwrMgmt2};
+    uint8_t written[sizeof(power)];
+    if (device.Write(PWR_MGMT_1, power, sizeof(power)) != ESP_OK)
+        return false;
+    if (device.Read(PWR_MGMT_1, written, sizeof(written)) != ESP_OK || !std::equal(power, power + sizeof(power), written))
+        return false;
+    profile = newProfile;
+    return true;
+}
 
-    r2 = r2 || 0b01000111; // Set wakeup frequency to 5 Hz and disable gyroscope
-    i2c->slave_write(MPU6050_ADDR, PWR_MGMT_2, r2);
-}
\ No newline at end of file
+bool MPU6050::enableFifo() {
+    if (getProfile() == Profile::Off)
+        return false;
+    const bool gyro = getProfile() == Profile::FullAccelGyro;
+    if (device.Write(USER_CTRL, USER_CTRL_FIFO_RESET) != ESP_OK)
+        return false;
+    if (device.Write(FIFO_EN, gyro ? FIFO_EN_ACCEL | FIFO_EN_GYRO : FIFO_EN_ACCEL) != ESP_OK)
+        return false;
+    fifoValues = gyro ? maxFifoValues : 3;
+    return device.Write(USER_CTRL, USER_CTRL_FIFO_EN) == ESP_OK;
+}
+
+bool MPU6050::resetFifo() {
+    return device.Write(USER_CTRL, USER_CTRL_FIFO_EN | USER_CTRL_FIFO_RESET) == ESP_OK;
+}
+
+bool MPU6050::disableFifo() {
+    // FIFO_EN bit cleared, reset empties it
+    if (device.Write(USER_CTRL, USER_CTRL_FIFO_RESET) != ESP_OK)
+        return false;
+    if (device.Write(FIFO_EN, 0x00) != ESP_OK)
+        return false;
+    fifoValues = 3;
+    return true;
+}
+
+bool MPU6050::startFifoRead() {
+    if (!sample.done)
+        return false;
+    // FIFO_COUNTH, FIFO_COUNTL
+    return device.StartRead(sample, FIFO_COUNTH, sampleRaw, 2) == ESP_OK;
+}
+
+int MPU6050::finishFifoRead(int16_t *block, size_t maxSamples) {
+    if (device.Wait(sample) != ESP_OK)
+        return -1;
+    const size_t count = (size_t) (sampleRaw[0] << 8 | sampleRaw[1]);
+    if (count >= fifoSize) {
+        // Oldest bytes were overwritten, sample boundaries are lost
+        resetFifo();
+        return -1;
+    }
+    const size_t sampleBytes = 2 * fifoValues;
+    const size_t samples = std::min(count / sampleBytes, maxSamples);
+    if (samples == 0)
+        return 0;
+
+    // Bytes are read into the block and converted in place, value i is at bytes 2i, 2i+1
+    uint8_t *bytes = (uint8_t *) block;
+    if (device.Read(FIFO_R_W, bytes, samples * sampleBytes) != ESP_OK) {
+        resetFifo();
+        return -1;
+    }
+    for (size_t i = 0; i < samples * fifoValues; i++) {
+        block[i] = toRaw(bytes + 2 * i);
+    }
+    return (int) samples;
+}
+
+bool MPU6050::enableDataReadyInterrupt() {
+    // Push-pull, active high, pulse: nothing to clear by the host
+    if (device.Write(INT_PIN_CFG, 0x00) != ESP_OK)
+        return false;
+    return device.Write(INT_ENABLE, INT_ENABLE_DATA_RDY) == ESP_OK;
+}
+
+bool MPU6050::disableDataReadyInterrupt() {
+    return device.Write(INT_ENABLE, 0x00) == ESP_OK;
+}
+
+int16_t MPU6050::AccToRaw(float acc) {
+    return (int16_t) (acc * AccAxis_Sensitive);
+}
+
+float MPU6050::RawToAcc(int16_t raw) {
+    return (float)raw / AccAxis_Sensitive;
+}
@@ -9,12 +9,16 @@
 
 #pragma once
 
-#include "i2c.hpp"
+#include "i2cBus.hpp"
+#include <array>
 
 #define	SMPLRT_DIV		0x19	//陀螺仪采样率，典型值：0x07(125Hz)
 #define	CONFIG			0x1A	//低通滤波频率，典型值：0x06(5Hz)
 #define	GYRO_CONFIG		0x1B	//陀螺仪自检及测量范围，典型值：0x18(不自检，2000deg/s)
 #define	ACCEL_CONFIG	0x1C	//加速计自检、测量范围及高通滤波频率，典型值：0x01(不自检，2G，5Hz)
+#define	FIFO_EN			0x23	//FIFO sources: 0x08 accelerometer, 0x70 gyroscope
+#define	INT_PIN_CFG		0x37	//INT pin level and latch, 0x00 active high pulse
+#define	INT_ENABLE		0x38	//0x01 data ready
 #define	ACCEL_XOUT_H	0x3B	
 #define	ACCEL_XOUT_L	0x3C
 #define	ACCEL_YOUT_H	0x3D
@@ -29,29 +33,147 @@
 #define	GYRO_YOUT_L		0x46
 #define	GYRO_ZOUT_H		0x47
 #define	GYRO_ZOUT_L		0x48
+#define	USER_CTRL		0x6A	//0x40 FIFO enable, 0x04 FIFO reset
 #define	PWR_MGMT_1		0x6B	//电源管理，典型值：0x00(正常启用)
 #define	PWR_MGMT_2		0x6C
+#define	FIFO_COUNTH		0x72
+#define	FIFO_COUNTL		0x73
+#define	FIFO_R_W		0x74
 #define	WHO_AM_I		0x75	//IIC地址寄存器(默认数值0x68，只读)
 #define	MPU6050_ADDR	0x68	//IIC写入时的地址字节数据，+1为读取
 
 class MPU6050 {
 private:
-    I2C *i2c;
+    I2cDevice device;
+    // Sample read (or FIFO fill level) running on the bus while the task works, see startAccRead
+    I2cBus::Transaction sample;
+    uint8_t sampleRaw[6];
+    // Values per FIFO sample: accelerometer X, Y, Z, then gyroscope X, Y, Z if enabled
+    uint8_t fifoValues;
 
-    void enableSleepCycling();
 public:
+    // Hardware FIFO. Count register saturates at the size, data was overwritten then
+    static constexpr size_t fifoSize = 1024;
+    // Register values of a FIFO sample: accelerometer X, Y, Z, then gyroscope X, Y, Z if enabled
+    static constexpr uint8_t maxFifoValues = 6;
+
+    /**
+     * @brief Power modes. Cycle ones wake the accelerometer for a single sample at the given
+     *      rate (LP_WAKE_CTRL), sleeping in between. Full ones sample continuously at the rate
+     *      passed to setProfile. Temperature sensor is disabled, unused axes are in standby.
+     */
+    enum class Profile : uint8_t {
+        Off,            // Sleep, registers are kept
+        Cycle1_25Hz,
+        Cycle5Hz,
+        Cycle20Hz,
+        Cycle40Hz,
+        FullAccel,      // Gyroscope in standby
+        FullAccelGyro
+    };
+
     MPU6050() = delete;
     MPU6050(MPU6050& copy) = delete;
-    MPU6050(gpio_num_t scl, gpio_num_t sda, i2c_port_t port);
-    ~MPU6050();
+    explicit MPU6050(I2cBus& bus);
     bool init();
 
     float getAccX();
     float getAccY();
     float getAccZ();
 
+    /**
+     * @brief All axes in one bus transaction, same sample
+     * @param[out] acc X, Y, Z [g]
+     * @return false if bus transaction failed
+     */
+    bool getAcc(std::array<float, 3>& acc);
+
+    /**
+     * @brief Start reading all axes. Bus completes it while caller does something else
+     * @return false if read could not be queued
+     */
+    bool startAccRead();
+
+    /**
+     * @brief Wait for the read started by startAccRead
+     * @param[out] raw X, Y, Z register values
+     * @return false if bus transaction failed
+     */
+    bool finishAccRead(std::array<int16_t, 3>& raw);
+
+    /**
+     * @brief Switch power mode, at any time. Registers are read back after the write.
+     *      Full profiles set SMPLRT_DIV and a low pass filter below half of the rate,
+     *      cycle ones keep them.
+     * @param sampleRateHz rate of full profiles, 4 .. 1000
+     * @return false if rate is out of range, bus transaction failed or registers differ.
+     *      getProfile keeps the previous one then
+     */
+    bool setProfile(Profile newProfile, uint16_t sampleRateHz = 100);
+
+    Profile getProfile() const { return profile; }
+
+    /**
+     * @brief Samples are stored in the FIFO at the rate of the profile, host drains them
+     *      in bursts. Gyroscope axes follow the accelerometer ones with FullAccelGyro.
+     * @return false if profile is Off or bus transaction failed
+     */
+    bool enableFifo();
+
+    /**
+     * @brief Drop all samples in the FIFO.
+     */
+    bool resetFifo();
+
+    /**
+     * @brief Stop storing samples, FIFO is emptied.
+     * @return false if bus transaction failed
+     */
+    bool disableFifo();
+
+    /**
+     * @brief Start reading FIFO fill level, finish with finishFifoRead
+     * @return false if read could not be queued
+     */
+    bool startFifoRead();
+
+    /**
+     * @brief Wait for the fill level and drain whole samples in one burst.
+     * @param[out] block samples in FIFO order, getFifoValues() register values each
+     * @param maxSamples capacity of block, in samples of getFifoValues()
+     * @return Number of samples, -1 if bus failed or FIFO overflowed (it is reset, samples are lost)
+     */
+    int finishFifoRead(int16_t *block, size_t maxSamples);
+
+    uint8_t getFifoValues() const { return fifoValues; }
+
+    /**
+     * @brief INT pin pulses (active high, 50 us) each time a new sample is in the sensor
+     *      registers and the FIFO.
+     * @return false if bus transaction failed
+     */
+    bool enableDataReadyInterrupt();
+
+    /**
+     * @brief INT pin stays low.
+     * @return false if bus transaction failed
+     */
+    bool disableDataReadyInterrupt();
+
     float getGyroX();
     float getGyroY();
     float getGyroZ();
 
+    /**
+     * @return Register value for given acceleration [g]
+     */
+    static int16_t AccToRaw(float acc);
+
+    /**
+     * @return Acceleration [g] of register value
+     */
+    static float RawToAcc(int16_t raw);
+
+private:
+    Profile profile;
 };
@@ -0,0 +1,674 @@
+/**
+ * @file protocol.hpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+// Binary format of custom BLE characteristics. Header has no ESP-IDF dependencies,
+// same file is meant to be used by the client (desktop app) to decode the data.
+//
+// Frame: [version] [tag][len][value ...] [tag][len][value ...] ...
+// Values are little endian. Unknown tags must be skipped by the decoder, so new
+// fields can be added without bumping the version. No heap is used.
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+
+namespace PROTOCOL {
+
+constexpr uint8_t version = 1;
+constexpr size_t headerSize = 1;
+constexpr size_t itemHeaderSize = 2; // tag + len
+// Fits in a single ATT payload with the default MTU (23 - 3)
+constexpr size_t maxFrameSize = 20;
+// Telemetry does not fit, client must negotiate MTU (or use long reads)
+constexpr size_t maxTelemetryFrameSize = 256;
+
+enum class Tag : uint8_t {
+    Face = 0x01,                // int8_t. Cube face, -1 if position is not calibrated
+    StartTime = 0x02,           // int64_t. Epoch seconds at which face was registered
+    CalibrationStatus = 0x03,   // int8_t. See IMU::Imu::CalibrationStatus
+    CalibrationFace = 0x04,     // int8_t. Number of faces calibrated so far, -1 if none
+    ServerReceiveTime = 0x05,   // int64_t. Epoch milliseconds at which sync request was received
+    ServerHoldTime = 0x06,      // uint32_t. Milliseconds between sync request and response
+    Offset = 0x07,              // int64_t. Milliseconds to add to tracker's clock
+    RoundTrip = 0x08,           // uint32_t. Milliseconds spent on the air during sync exchange
+    // Telemetry. Totals since power on, times in milliseconds
+    Wakes = 0x09,               // uint32_t. Application boots from deep sleep
+    StubWakes = 0x0A,           // uint32_t. Wakes handled by the wake stub (no application boot)
+    AwakeTime = 0x0B,           // uint32_t
+    AdvertisingTime = 0x0C,     // uint32_t
+    ConnectedTime = 0x0D,       // uint32_t
+    I2cTransactions = 0x0E,     // uint32_t
+    FlashWrites = 0x0F,         // uint32_t. NVS writes and erases
+    WakeCauses = 0x10,          // uint16_t[WakeCause::Count]. Wakes per cause
+    AwakeHistogram = 0x11,      // uint16_t[telemetryBins]. Wakes per awake time bin
+    // Telemetry. Latest wakes, oldest first, one array per field
+    RecentCause = 0x12,         // uint8_t[]. See WakeCause
+    RecentAwakeTime = 0x13,     // uint32_t[]
+    RecentAdvertisingTime = 0x14, // uint32_t[]
+    RecentConnectedTime = 0x15, // uint32_t[]
+    RecentI2cTransactions = 0x16, // uint16_t[]
+    RecentFlashWrites = 0x17,   // uint16_t[]
+    BootTimes = 0x18,           // uint32_t[BootMarker::Count]. Microseconds since wake, 0 if not reached
+    // Telemetry. Power tiers (APP::PowerGovernor)
+    PowerTier = 0x19,           // uint8_t. See PowerTier
+    TierTime = 0x1A,            // uint32_t[PowerTier::Count]. Seconds spent in each tier since power on
+    TierChanges = 0x1B,         // uint16_t. Tier changes since power on
+    // Trace (TELEMETRY::Trace), a chunk of one core's ring per frame
+    TraceCore = 0x1C,           // uint8_t. CPU core the records come from
+    TraceFirst = 0x1D,          // uint16_t. Index of the first record of the chunk, oldest is 0
+    TraceRecords = 0x1E,        // uint32_t[4 * n]. Records, see TraceRecord
+    // Binary log (TELEMETRY::BinaryLog), a chunk of the ring per frame
+    LogFirst = 0x1F,            // uint16_t. Index of the first record of the chunk, oldest is 0
+    LogRecords = 0x20,          // uint32_t[7 * n]. Records, see LogRecord
+    // Telemetry. Advertising start until the link is encrypted (Ble::lastReconnectTime)
+    ReconnectTime = 0x21,       // uint32_t. Latest connection, ms. 0 if none since power on
+    MaxReconnectTime = 0x22,    // uint32_t. Longest since power on, ms
+};
+
+class Encoder {
+    uint8_t *buffer;
+    size_t capacity;
+    size_t length = 0;
+    bool overflow = false;
+
+public:
+    Encoder() = delete;
+
+    Encoder(uint8_t *_buffer, size_t _capacity) : buffer(_buffer), capacity(_capacity) {
+        if(capacity < headerSize) {
+            overflow = true;
+            return;
+        }
+        buffer[length++] = version;
+    };
+
+    /**
+     * @brief Append tag-length-value item to the frame.
+     * @param tag item identifier
+     * @param value integral value, written little endian
+     * @return false if item does not fit into buffer. Frame is left untouched then.
+     */
+    template<typename T>
+    bool Put(Tag tag, T value) {
+        static_assert(std::is_integral<T>::value, "Only integral values are supported");
+        typedef typename std::make_unsigned<T>::type U;
+
+        if(overflow || length + itemHeaderSize + sizeof(T) > capacity) {
+            overflow = true;
+            return false;
+        }
+
+        buffer[length++] = (uint8_t) tag;
+        buffer[length++] = sizeof(T);
+        put<U>((U) value);
+        return true;
+    }
+
+    /**
+     * @brief Append item with array of values. Length of item is count * sizeof(T).
+     * @return false if item does not fit into buffer or is longer than 255 bytes
+     */
+    template<typename T>
+    bool PutArray(Tag tag, const T *values, size_t count) {
+        static_assert(std::is_integral<T>::value, "Only integral values are supported");
+        typedef typename std::make_unsigned<T>::type U;
+
+        size_t len = count * sizeof(T);
+        if(overflow || len > UINT8_MAX || length + itemHeaderSize + len > capacity) {
+            overflow = true;
+            return false;
+        }
+
+        buffer[length++] = (uint8_t) tag;
+        buffer[length++] = (uint8_t) len;
+        for(size_t i = 0; i < count; i++) {
+            put<U>((U) values[i]);
+        }
+        return true;
+    }
+
+    size_t Length() const {
+        return length;
+    }
+
+    bool IsValid() const {
+        return !overflow;
+    }
+
+private:
+    template<typename U>
+    void put(U raw) {
+        for(size_t i = 0; i < sizeof(U); i++) {
+            buffer[length++] = (uint8_t) (raw >> (8 * i));
+        }
+    }
+};
+
+class Decoder {
+    const uint8_t *buffer;
+    size_t length;
+    size_t offset = headerSize;
+
+public:
+    Decoder() = delete;
+
+    Decoder(const uint8_t *_buffer, size_t _length) : buffer(_buffer), length(_length) {};
+
+    /**
+     * @return true if frame header is present and version is supported
+     */
+    bool IsValid() const {
+        return buffer != nullptr && length >= headerSize && buffer[0] == version;
+    }
+
+    /**
+     * @brief Iterate over items of the frame.
+     * @param[out] tag item identifier
+     * @param[out] value pointer to first byte of item value (inside of decoded buffer)
+     * @param[out] len length of item value
+     * @return false when there are no more items or the frame is truncated
+     */
+    bool Next(Tag& tag, const uint8_t *& value, uint8_t& len) {
+        if(!IsValid() || offset + itemHeaderSize > length) {
+            return false;
+        }
+        auto itemLen = buffer[offset + 1];
+        if(offset + itemHeaderSize + itemLen > length) {
+            // Truncated item. Stop here, do not read past the frame
+            offset = length;
+            return false;
+        }
+        tag = (Tag) buffer[offset];
+        len = itemLen;
+        value = &buffer[offset + itemHeaderSize];
+        offset += itemHeaderSize + itemLen;
+        return true;
+    }
+
+    /**
+     * @brief Look up item by tag. Whole frame is searched, iteration state is not affected.
+     * @param tag item identifier
+     * @param[out] out decoded value, untouched if not found
+     * @return true if item was found and its length matches type of out
+     */
+    template<typename T>
+    bool Find(Tag tag, T& out) const {
+        static_assert(std::is_integral<T>::value, "Only integral values are supported");
+        typedef typename std::make_unsigned<T>::type U;
+
+        Decoder it(buffer, length);
+        Tag itemTag;
+        const uint8_t *value = nullptr;
+        uint8_t len = 0;
+        while(it.Next(itemTag, value, len)) {
+            if(itemTag != tag) continue;
+            if(len != sizeof(T)) return false;
+
+            out = (T) get<U>(value);
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Look up array item by tag. Whole frame is searched, iteration state is not affected.
+     * @param tag item identifier
+     * @param[out] out decoded values
+     * @param capacity max number of values to decode
+     * @param[out] count number of values decoded
+     * @return true if item was found and its length is a multiple of sizeof(T)
+     */
+    template<typename T>
+    bool FindArray(Tag tag, T *out, size_t capacity, size_t& count) const {
+        static_assert(std::is_integral<T>::value, "Only integral values are supported");
+        typedef typename std::make_unsigned<T>::type U;
+
+        Decoder it(buffer, length);
+        Tag itemTag;
+        const uint8_t *value = nullptr;
+        uint8_t len = 0;
+        while(it.Next(itemTag, value, len)) {
+            if(itemTag != tag) continue;
+            if(len % sizeof(T)) return false;
+
+            count = len / sizeof(T) < capacity ? len / sizeof(T) : capacity;
+            for(size_t i = 0; i < count; i++) {
+                out[i] = (T) get<U>(&value[i * sizeof(T)]);
+            }
+            return true;
+        }
+        return false;
+    }
+
+private:
+    template<typename U>
+    static U get(const uint8_t *value) {
+        U raw = 0;
+        for(size_t i = 0; i < sizeof(U); i++) {
+            raw |= (U) value[i] << (8 * i);
+        }
+        return raw;
+    }
+};
+
+// Messages ----------------------------------------------------------------------
+
+struct Position {
+    int8_t face;
+    int64_t startTime;
+};
+
+struct Calibration {
+    int8_t status;
+    int8_t face;
+};
+
+// Time sync exchange, NTP-like:
+//   client: T1 = now, write empty frame (request)
+//   tracker: T2 = receive time; on read T3 = now, responds with TimeSyncResponse
+//   client: T4 = now, computes TimeSyncAdjust (ComputeTimeSync) and writes it back
+struct TimeSyncResponse {
+    int64_t receiveTime;
+    uint32_t holdTime;
+};
+
+struct TimeSyncAdjust {
+    int64_t offset;
+    uint32_t roundTrip;
+};
+
+// Wake cause buckets. ESP-IDF esp_sleep_wakeup_cause_t, squeezed
+enum class WakeCause : uint8_t {
+    Reset,      // Power on, reset or crash. Not a wake from deep sleep
+    Timer,
+    Ext0,
+    Ext1,
+    Touchpad,
+    Ulp,
+    Gpio,
+    Other,
+    Count
+};
+
+// Operating tiers by battery level, highest first. See APP::PowerGovernor
+enum class PowerTier : uint8_t {
+    Normal,     // Intervals as learned
+    Saving,     // Less frequent wakes and BLE windows
+    Low,        // Rare BLE windows, no firmware update
+    Protect,    // No radio, positions are only recorded
+    Count
+};
+
+// Upper bounds [ms] of awake time histogram bins. Last bin has no bound
+constexpr std::array<uint32_t, 7> telemetryBinBounds = {{50, 100, 200, 500, 1000, 2000, 5000}};
+constexpr size_t telemetryBins = telemetryBinBounds.size() + 1;
+// Latest wakes sent in a telemetry frame
+constexpr size_t telemetryRecent = 8;
+
+struct TelemetryWake {
+    uint8_t cause;              // WakeCause
+    uint32_t awakeTime;         // ms, all times below too
+    uint32_t advertisingTime;
+    uint32_t connectedTime;
+    uint16_t i2cTransactions;
+    uint16_t flashWrites;
+};
+
+// Fixed points of a wake, from reset to sleep
+enum class BootMarker : uint8_t {
+    AppMain,        // app_main entry
+    NvsInit,        // NVS initialised
+    ImuInit,        // I2C driver installed, MPU6050 configured
+    FirstSample,    // First accelerometer read
+    BleInit,        // BLEDevice::init done
+    Advertising,    // Advertising started
+    Sleep,          // Deep sleep entry
+    Count
+};
+
+struct BootProfile {
+    std::array<uint32_t, (size_t) BootMarker::Count> times;
+};
+
+// Events of the trace. Meaning of the arguments is given for each
+enum class TraceEvent : uint8_t {
+    Wake,           // Application start. cause (esp_sleep_wakeup_cause_t) | CPU MHz << 8, epoch ms (low 32 bits)
+    Sleep,          // Deep sleep entry. Sleep duration ms, awake ms
+    TaskSwitch,     // Task switched in. Task handle, first 4 characters of its name
+    Publish,        // BUS message published. Topic id, 0 if dropped
+    Receive,        // BUS message received. Topic id, messages left
+    Count
+};
+
+// Trace record. Sent as 4 words: event | core << 8 | boot << 16, cycles, arg0, arg1
+struct TraceRecord {
+    uint8_t event;              // TraceEvent
+    uint8_t core;
+    uint16_t boot;              // Application boots counted by the trace, groups records of a wake
+    uint32_t cycles;            // CPU cycle counter, restarts at each boot
+    uint32_t arg0;
+    uint32_t arg1;
+};
+constexpr size_t traceRecordWords = 4;
+// Records per frame, item must not exceed 255 bytes
+constexpr size_t traceChunkRecords = UINT8_MAX / (traceRecordWords * sizeof(uint32_t));
+
+struct TraceChunk {
+    uint8_t core;
+    uint16_t first;
+    uint8_t count;
+    std::array<TraceRecord, traceChunkRecords> records;
+};
+
+// Binary log record. Sent as 7 words: id, time, level | argc << 8 | boot << 16, args
+constexpr size_t logMaxArgs = 4;
+struct LogRecord {
+    uint32_t id;                // Hash of the format string, see TELEMETRY::BinaryLog::Hash
+    uint32_t time;              // Microseconds since boot
+    uint8_t level;              // esp_log_level_t
+    uint8_t argc;
+    uint16_t boot;              // Application boots counted by the log, groups records of a wake
+    std::array<uint32_t, logMaxArgs> args;  // Raw printf arguments, floats as their bits
+};
+constexpr size_t logRecordWords = 3 + logMaxArgs;
+// Records per frame, with the other item the frame must fit maxTelemetryFrameSize
+constexpr size_t logChunkRecords = (maxTelemetryFrameSize - headerSize - 2 - sizeof(uint16_t) - 2) /
+                                    (logRecordWords * sizeof(uint32_t));
+
+struct LogChunk {
+    uint16_t first;
+    uint8_t count;
+    std::array<LogRecord, logChunkRecords> records;
+};
+
+struct Telemetry {
+    uint32_t wakes;
+    uint32_t stubWakes;
+    uint32_t awakeTime;         // ms, all times below too
+    uint32_t advertisingTime;
+    uint32_t connectedTime;
+    uint32_t i2cTransactions;
+    uint32_t flashWrites;
+    std::array<uint16_t, (size_t) WakeCause::Count> wakeCauses;
+    std::array<uint16_t, telemetryBins> awakeHistogram;
+    uint8_t recentCount;
+    std::array<TelemetryWake, telemetryRecent> recent;  // Oldest first
+    uint8_t powerTier;          // PowerTier
+    uint16_t tierChanges;
+    std::array<uint32_t, (size_t) PowerTier::Count> tierTime;   // s
+    uint32_t reconnectTime;     // ms
+    uint32_t maxReconnectTime;
+};
+
+/**
+ * @brief Round-trip compensated clock offset. All times in milliseconds.
+ * @param t1 client time at which request was sent
+ * @param response tracker's response
+ * @param t4 client time at which response was received
+ * @return offset to add to tracker's clock and time spent on the air
+ */
+inline TimeSyncAdjust ComputeTimeSync(int64_t t1, const TimeSyncResponse& response, int64_t t4) {
+    int64_t t2 = response.receiveTime;
+    int64_t t3 = response.receiveTime + response.holdTime;
+    TimeSyncAdjust adjust;
+    adjust.offset = ((t1 - t2) + (t4 - t3)) / 2;
+    adjust.roundTrip = (uint32_t) ((t4 - t1) - (t3 - t2));
+    return adjust;
+}
+
+/**
+ * @return Length of encoded frame, 0 if buffer is too small
+ */
+inline size_t Encode(const Position& msg, uint8_t *buffer, size_t size) {
+    Encoder encoder(buffer, size);
+    encoder.Put(Tag::Face, msg.face);
+    encoder.Put(Tag::StartTime, msg.startTime);
+    return encoder.IsValid() ? encoder.Length() : 0;
+}
+
+inline size_t Encode(const Calibration& msg, uint8_t *buffer, size_t size) {
+    Encoder encoder(buffer, size);
+    encoder.Put(Tag::CalibrationStatus, msg.status);
+    encoder.Put(Tag::CalibrationFace, msg.face);
+    return encoder.IsValid() ? encoder.Length() : 0;
+}
+
+inline size_t Encode(const TimeSyncResponse& msg, uint8_t *buffer, size_t size) {
+    Encoder encoder(buffer, size);
+    encoder.Put(Tag::ServerReceiveTime, msg.receiveTime);
+    encoder.Put(Tag::ServerHoldTime, msg.holdTime);
+    return encoder.IsValid() ? encoder.Length() : 0;
+}
+
+inline size_t Encode(const TimeSyncAdjust& msg, uint8_t *buffer, size_t size) {
+    Encoder encoder(buffer, size);
+    encoder.Put(Tag::Offset, msg.offset);
+    encoder.Put(Tag::RoundTrip, msg.roundTrip);
+    return encoder.IsValid() ? encoder.Length() : 0;
+}
+
+inline size_t Encode(const BootProfile& msg, uint8_t *buffer, size_t size) {
+    Encoder encoder(buffer, size);
+    encoder.PutArray(Tag::BootTimes, msg.times.data(), msg.times.size());
+    return encoder.IsValid() ? encoder.Length() : 0;
+}
+
+inline size_t Encode(const TraceChunk& msg, uint8_t *buffer, size_t size) {
+    Encoder encoder(buffer, size);
+    uint32_t words[traceChunkRecords * traceRecordWords];
+    size_t count = msg.count < traceChunkRecords ? msg.count : traceChunkRecords;
+    for(size_t i = 0; i < count; i++) {
+        const auto& record = msg.records[i];
+        uint32_t *word = &words[i * traceRecordWords];
+        word[0] = record.event | (uint32_t) record.core << 8 | (uint32_t) record.boot << 16;
+        word[1] = record.cycles;
+        word[2] = record.arg0;
+        word[3] = record.arg1;
+    }
+    encoder.Put(Tag::TraceCore, msg.core);
+    encoder.Put(Tag::TraceFirst, msg.first);
+    encoder.PutArray(Tag::TraceRecords, words, count * traceRecordWords);
+    return encoder.IsValid() ? encoder.Length() : 0;
+}
+
+inline size_t Encode(const LogChunk& msg, uint8_t *buffer, size_t size) {
+    Encoder encoder(buffer, size);
+    uint32_t words[logChunkRecords * logRecordWords];
+    size_t count = msg.count < logChunkRecords ? msg.count : logChunkRecords;
+    for(size_t i = 0; i < count; i++) {
+        const auto& record = msg.records[i];
+        uint32_t *word = &words[i * logRecordWords];
+        word[0] = record.id;
+        word[1] = record.time;
+        word[2] = record.level | (uint32_t) record.argc << 8 | (uint32_t) record.boot << 16;
+        for(size_t arg = 0; arg < logMaxArgs; arg++) {
+            word[3 + arg] = record.args[arg];
+        }
+    }
+    encoder.Put(Tag::LogFirst, msg.first);
+    encoder.PutArray(Tag::LogRecords, words, count * logRecordWords);
+    return encoder.IsValid() ? encoder.Length() : 0;
+}
+
+// Latest wakes go column by column, same field of each wake in one item
+inline size_t Encode(const Telemetry& msg, uint8_t *buffer, size_t size) {
+    Encoder encoder(buffer, size);
+    encoder.Put(Tag::Wakes, msg.wakes);
+    encoder.Put(Tag::StubWakes, msg.stubWakes);
+    encoder.Put(Tag::AwakeTime, msg.awakeTime);
+    encoder.Put(Tag::AdvertisingTime, msg.advertisingTime);
+    encoder.Put(Tag::ConnectedTime, msg.connectedTime);
+    encoder.Put(Tag::I2cTransactions, msg.i2cTransactions);
+    encoder.Put(Tag::FlashWrites, msg.flashWrites);
+    encoder.PutArray(Tag::WakeCauses, msg.wakeCauses.data(), msg.wakeCauses.size());
+    encoder.PutArray(Tag::AwakeHistogram, msg.awakeHistogram.data(), msg.awakeHistogram.size());
+
+    size_t count = msg.recentCount < telemetryRecent ? msg.recentCount : telemetryRecent;
+    auto putColumn = [&](Tag tag, auto field) {
+        typedef decltype(field(msg.recent[0])) T;
+        T values[telemetryRecent];
+        for(size_t i = 0; i < count; i++) values[i] = field(msg.recent[i]);
+        encoder.PutArray(tag, values, count);
+    };
+    putColumn(Tag::RecentCause, [](const TelemetryWake& w) { return w.cause; });
+    putColumn(Tag::RecentAwakeTime, [](const TelemetryWake& w) { return w.awakeTime; });
+    putColumn(Tag::RecentAdvertisingTime, [](const TelemetryWake& w) { return w.advertisingTime; });
+    putColumn(Tag::RecentConnectedTime, [](const TelemetryWake& w) { return w.connectedTime; });
+    putColumn(Tag::RecentI2cTransactions, [](const TelemetryWake& w) { return w.i2cTransactions; });
+    putColumn(Tag::RecentFlashWrites, [](const TelemetryWake& w) { return w.flashWrites; });
+
+    encoder.Put(Tag::PowerTier, msg.powerTier);
+    encoder.PutArray(Tag::TierTime, msg.tierTime.data(), msg.tierTime.size());
+    encoder.Put(Tag::TierChanges, msg.tierChanges);
+    encoder.Put(Tag::ReconnectTime, msg.reconnectTime);
+    encoder.Put(Tag::MaxReconnectTime, msg.maxReconnectTime);
+    return encoder.IsValid() ? encoder.Length() : 0;
+}
+
+/**
+ * @return true if all fields of the message were present in frame
+ */
+inline bool Decode(const uint8_t *buffer, size_t length, Position& msg) {
+    Decoder decoder(buffer, length);
+    return decoder.IsValid() &&
+            decoder.Find(Tag::Face, msg.face) &&
+            decoder.Find(Tag::StartTime, msg.startTime);
+}
+
+inline bool Decode(const uint8_t *buffer, size_t length, Calibration& msg) {
+    Decoder decoder(buffer, length);
+    return decoder.IsValid() &&
+            decoder.Find(Tag::CalibrationStatus, msg.status) &&
+            decoder.Find(Tag::CalibrationFace, msg.face);
+}
+
+inline bool Decode(const uint8_t *buffer, size_t length, TimeSyncResponse& msg) {
+    Decoder decoder(buffer, length);
+    return decoder.IsValid() &&
+            decoder.Find(Tag::ServerReceiveTime, msg.receiveTime) &&
+            decoder.Find(Tag::ServerHoldTime, msg.holdTime);
+}
+
+inline bool Decode(const uint8_t *buffer, size_t length, TimeSyncAdjust& msg) {
+    Decoder decoder(buffer, length);
+    return decoder.IsValid() &&
+            decoder.Find(Tag::Offset, msg.offset) &&
+            decoder.Find(Tag::RoundTrip, msg.roundTrip);
+}
+
+inline bool Decode(const uint8_t *buffer, size_t length, BootProfile& msg) {
+    Decoder decoder(buffer, length);
+    size_t count = 0;
+    msg.times = {};
+    // Older firmware might know less markers, missing ones stay 0
+    return decoder.IsValid() &&
+            decoder.FindArray(Tag::BootTimes, msg.times.data(), msg.times.size(), count);
+}
+
+inline bool Decode(const uint8_t *buffer, size_t length, TraceChunk& msg) {
+    Decoder decoder(buffer, length);
+    uint32_t words[traceChunkRecords * traceRecordWords];
+    size_t count = 0;
+    if(!decoder.IsValid() ||
+            !decoder.Find(Tag::TraceCore, msg.core) ||
+            !decoder.Find(Tag::TraceFirst, msg.first) ||
+            !decoder.FindArray(Tag::TraceRecords, words, traceChunkRecords * traceRecordWords, count)) {
+        return false;
+    }
+    msg.count = (uint8_t) (count / traceRecordWords);
+    for(size_t i = 0; i < msg.count; i++) {
+        const uint32_t *word = &words[i * traceRecordWords];
+        auto& record = msg.records[i];
+        record.event = (uint8_t) word[0];
+        record.core = (uint8_t) (word[0] >> 8);
+        record.boot = (uint16_t) (word[0] >> 16);
+        record.cycles = word[1];
+        record.arg0 = word[2];
+        record.arg1 = word[3];
+    }
+    return true;
+}
+
+inline bool Decode(const uint8_t *buffer, size_t length, LogChunk& msg) {
+    Decoder decoder(buffer, length);
+    uint32_t words[logChunkRecords * logRecordWords];
+    size_t count = 0;
+    if(!decoder.IsValid() ||
+            !decoder.Find(Tag::LogFirst, msg.first) ||
+            !decoder.FindArray(Tag::LogRecords, words, logChunkRecords * logRecordWords, count)) {
+        return false;
+    }
+    msg.count = (uint8_t) (count / logRecordWords);
+    for(size_t i = 0; i < msg.count; i++) {
+        const uint32_t *word = &words[i * logRecordWords];
+        auto& record = msg.records[i];
+        record.id = word[0];
+        record.time = word[1];
+        record.level = (uint8_t) word[2];
+        record.argc = (uint8_t) (word[2] >> 8);
+        record.boot = (uint16_t) (word[2] >> 16);
+        for(size_t arg = 0; arg < logMaxArgs; arg++) {
+            record.args[arg] = word[3 + arg];
+        }
+    }
+    return true;
+}
+
+inline bool Decode(const uint8_t *buffer, size_t length, Telemetry& msg) {
+    Decoder decoder(buffer, length);
+    size_t causes = 0;
+    size_t bins = 0;
+    bool valid = decoder.IsValid() &&
+            decoder.Find(Tag::Wakes, msg.wakes) &&
+            decoder.Find(Tag::StubWakes, msg.stubWakes) &&
+            decoder.Find(Tag::AwakeTime, msg.awakeTime) &&
+            decoder.Find(Tag::AdvertisingTime, msg.advertisingTime) &&
+            decoder.Find(Tag::ConnectedTime, msg.connectedTime) &&
+            decoder.Find(Tag::I2cTransactions, msg.i2cTransactions) &&
+            decoder.Find(Tag::FlashWrites, msg.flashWrites) &&
+            decoder.FindArray(Tag::WakeCauses, msg.wakeCauses.data(), msg.wakeCauses.size(), causes) &&
+            decoder.FindArray(Tag::AwakeHistogram, msg.awakeHistogram.data(), msg.awakeHistogram.size(), bins);
+    if(!valid) {
+        return false;
+    }
+
+    // Columns of latest wakes. Shortest one decides how many wakes are complete
+    size_t count = telemetryRecent;
+    auto getColumn = [&](Tag tag, auto setter, auto type) {
+        decltype(type) values[telemetryRecent];
+        size_t found = 0;
+        if(!decoder.FindArray(tag, values, telemetryRecent, found)) {
+            found = 0;
+        }
+        if(found < count) count = found;
+        for(size_t i = 0; i < found; i++) setter(msg.recent[i], values[i]);
+    };
+    getColumn(Tag::RecentCause, [](TelemetryWake& w, uint8_t v) { w.cause = v; }, uint8_t());
+    getColumn(Tag::RecentAwakeTime, [](TelemetryWake& w, uint32_t v) { w.awakeTime = v; }, uint32_t());
+    getColumn(Tag::RecentAdvertisingTime, [](TelemetryWake& w, uint32_t v) { w.advertisingTime = v; }, uint32_t());
+    getColumn(Tag::RecentConnectedTime, [](TelemetryWake& w, uint32_t v) { w.connectedTime = v; }, uint32_t());
+    getColumn(Tag::RecentI2cTransactions, [](TelemetryWake& w, uint16_t v) { w.i2cTransactions = v; }, uint16_t());
+    getColumn(Tag::RecentFlashWrites, [](TelemetryWake& w, uint16_t v) { w.flashWrites = v; }, uint16_t());
+    msg.recentCount = (uint8_t) count;
+
+    // Older firmware has no tiers, it always ran as Normal
+    size_t tiers = 0;
+    msg.tierTime = {};
+    if(!decoder.Find(Tag::PowerTier, msg.powerTier)) msg.powerTier = (uint8_t) PowerTier::Normal;
+    if(!decoder.Find(Tag::TierChanges, msg.tierChanges)) msg.tierChanges = 0;
+    decoder.FindArray(Tag::TierTime, msg.tierTime.data(), msg.tierTime.size(), tiers);
+    if(!decoder.Find(Tag::ReconnectTime, msg.reconnectTime)) msg.reconnectTime = 0;
+    if(!decoder.Find(Tag::MaxReconnectTime, msg.maxReconnectTime)) msg.maxReconnectTime = 0;
+    return true;
+}
+
+} // namespace PROTOCOL end --------------------
@@ -0,0 +1,121 @@
+/**
+ * @file binaryLog.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#include "binaryLog.hpp"
+#include <algorithm>
+
+extern "C" {
+    #include "esp_attr.h"
+    #include "esp_timer.h"
+} // extern C close
+
+using namespace TELEMETRY;
+
+// RTC_NOINIT memory is random after power on, valid ring carries it
+static constexpr uint32_t ringMagic = 0x424C4731;
+
+RTC_NOINIT_ATTR BinaryLog::Ring BinaryLog::ring;
+
+std::atomic<uint32_t> BinaryLog::head;
+std::atomic<bool> BinaryLog::recording(false);
+std::atomic<bool> BinaryLog::paused(false);
+std::atomic<uint32_t> BinaryLog::pausedMs(0);
+
+// Odr-used when compared, C++14 needs the definitions
+constexpr uint32_t BinaryLog::pauseTimeoutMs;
+
+uint32_t BinaryLog::readIndex = 0;
+
+void BinaryLog::Start() {
+    if(ring.magic != ringMagic) {
+        ring.magic = ringMagic;
+        ring.head = 0;
+        ring.boot = 0;
+    }
+    ring.boot++;
+    head = ring.head;
+    recording = true;
+}
+
+void IRAM_ATTR BinaryLog::record(esp_log_level_t level, uint32_t id, const uint32_t *args, size_t argc) {
+    if(!recording.load(std::memory_order_relaxed)) {
+        if(!paused || (uint32_t) (esp_timer_get_time() / 1000) - pausedMs < pauseTimeoutMs) {
+            return;
+        }
+        // Reader stopped in the middle of a dump, its next Encode starts again
+        paused = false;
+        recording = true;
+    }
+    // Writer interrupted by another one keeps its slot, records are not torn
+    const uint32_t index = head.fetch_add(1, std::memory_order_relaxed);
+
+    auto& record = ring.records[index % BINARY_LOG_RECORDS];
+    record.id = id;
+    record.time = (uint32_t) esp_timer_get_time();
+    record.level = (uint8_t) level;
+    record.argc = (uint8_t) argc;
+    record.boot = ring.boot;
+    for(size_t i = 0; i < PROTOCOL::logMaxArgs; i++) {
+        record.args[i] = i < argc ? args[i] : 0;
+    }
+    // Kept in RTC memory with each record, ring stays readable after a crash. Plain stores:
+    // a writer of the other core or an ISR may store a larger count between the load and
+    // the store of this one, so the store is repeated until the count did not change behind it
+    uint32_t count = head.load();
+    for(;;) {
+        ring.head = count;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const uint32_t current = head.load();
+        if(current == count) {
+            break;
+        }
+        count = current;
+    }
+}
+
+size_t BinaryLog::Encode(uint8_t *buffer, size_t size) {
+    // Before the pause, record must not take it as timed out
+    pausedMs = (uint32_t) (esp_timer_get_time() / 1000);
+    if(!paused.exchange(true)) {
+        // New dump, or the last one timed out and the ring moved on
+        readIndex = 0;
+    }
+    // Ring would move under the reader
+    recording = false;
+
+    const uint32_t count = std::min<uint32_t>(ring.head, BINARY_LOG_RECORDS);
+    if(readIndex < count) {
+        PROTOCOL::LogChunk chunk;
+        chunk.first = (uint16_t) readIndex;
+        chunk.count = (uint8_t) std::min<uint32_t>(PROTOCOL::logChunkRecords, count - readIndex);
+        const uint32_t oldest = ring.head - count;
+        for(size_t i = 0; i < chunk.count; i++) {
+            chunk.records[i] = ring.records[(oldest + readIndex + i) % BINARY_LOG_RECORDS];
+        }
+        auto len = PROTOCOL::Encode(chunk, buffer, size);
+        if(len) {
+            readIndex += chunk.count;
+        }
+        return len;
+    }
+
+    Rewind();
+    if(size < PROTOCOL::headerSize) {
+        return 0;
+    }
+    // Frame with header only means all was read
+    buffer[0] = PROTOCOL::version;
+    return PROTOCOL::headerSize;
+}
+
+void BinaryLog::Rewind() {
+    readIndex = 0;
+    paused = false;
+    recording = true;
+}
@@ -0,0 +1,153 @@
+/**
+ * @file binaryLog.hpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+#include "protocol.hpp"
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+extern "C" {
+    #include "esp_log.h"
+} // extern C close
+
+// Records in the ring. 28 B each, ring lives in RTC slow memory
+#ifndef BINARY_LOG_RECORDS
+#define BINARY_LOG_RECORDS (32)
+#endif
+
+// Most verbose level recorded (esp_log_level_t), others are compiled out
+#ifndef BINARY_LOG_LEVEL
+#define BINARY_LOG_LEVEL (ESP_LOG_INFO)
+#endif
+
+// Debug builds: same message goes to ESP_LOG too, its format string is then in flash
+#ifndef BINARY_LOG_TEXT
+#define BINARY_LOG_TEXT (0)
+#endif
+
+/**
+ * @brief Log to the binary log, printf format and up to PROTOCOL::logMaxArgs integer or
+ *      float arguments. Format must be a string literal, only its hash is in the firmware.
+ *      With BINARY_LOG_TEXT the message goes to ESP_LOG as well.
+ *      Expand the records with tools/binaryLog.py.
+ */
+#define BLOGE(format, ...) BINARY_LOG(ESP_LOG_ERROR, E, format, ##__VA_ARGS__)
+#define BLOGW(format, ...) BINARY_LOG(ESP_LOG_WARN, W, format, ##__VA_ARGS__)
+#define BLOGI(format, ...) BINARY_LOG(ESP_LOG_INFO, I, format, ##__VA_ARGS__)
+#define BLOGD(format, ...) BINARY_LOG(ESP_LOG_DEBUG, D, format, ##__VA_ARGS__)
+
+#define BINARY_LOG(level, letter, format, ...) do { \
+        constexpr uint32_t binaryLogId = TELEMETRY::BinaryLog::Hash(format); \
+        if(level <= BINARY_LOG_LEVEL) { \
+            TELEMETRY::BinaryLog::Write(level, binaryLogId, ##__VA_ARGS__); \
+        } \
+        BINARY_LOG_PRINT(letter, format, ##__VA_ARGS__); \
+    } while(0)
+
+#if BINARY_LOG_TEXT
+#define BINARY_LOG_PRINT(letter, format, ...) \
+        ESP_LOG##letter(__FILE__, "%s:%d. " format, __func__ ,__LINE__, ##__VA_ARGS__)
+#else
+#define BINARY_LOG_PRINT(letter, format, ...) do {} while(0)
+#endif
+
+namespace TELEMETRY {
+
+/**
+ * @brief Log of fixed size records: id of the format string, time and raw arguments.
+ *      Nothing is formatted on the device and format strings are not in flash, a host tool
+ *      hashes the formats found in the sources and expands the records. Ring is in RTC memory
+ *      not cleared by any reset, oldest records are overwritten. Safe from tasks and ISRs
+ *      (macros too, unless built with BINARY_LOG_TEXT).
+ */
+class BinaryLog {
+public:
+    /**
+     * @brief Id of a format string, 32 bit FNV-1a of its bytes. tools/binaryLog.py does the same
+     */
+    static constexpr uint32_t Hash(const char *format) {
+        uint32_t hash = 2166136261u;
+        for(; *format != '\0'; format++) {
+            hash = (hash ^ (uint8_t) *format) * 16777619u;
+        }
+        return hash;
+    }
+
+    /**
+     * @brief Open the log of this boot. Records before it are dropped. Call first thing in app_main.
+     */
+    static void Start();
+
+    template<typename... Args>
+    static void Write(esp_log_level_t level, uint32_t id, Args... args) {
+        static_assert(sizeof...(Args) <= PROTOCOL::logMaxArgs, "Too many arguments for the binary log");
+        const uint32_t words[] = {word(args)..., 0};
+        record(level, id, words, sizeof...(Args));
+    }
+
+    /**
+     * @brief Encode next chunk of the ring, oldest records first. Recording is paused until
+     *      the last chunk is read. If the reader stops in between, it resumes pauseTimeoutMs
+     *      after the last read and the next Encode starts again.
+     * @return Length of encoded frame, header only if all was read (next call starts again),
+     *      0 if buffer is too small
+     */
+    static size_t Encode(uint8_t *buffer, size_t size);
+
+    /**
+     * @brief Reader is gone. Next Encode starts from the beginning, recording goes on.
+     */
+    static void Rewind();
+
+    // Longest gap between reads of a dump, as Trace::pauseTimeoutMs
+    static constexpr uint32_t pauseTimeoutMs = 5000;
+
+private:
+    struct Ring {
+        uint32_t magic;
+        uint32_t head;              // Records written, index of the next one is head % BINARY_LOG_RECORDS
+        uint16_t boot;
+        PROTOCOL::LogRecord records[BINARY_LOG_RECORDS];
+    };
+    static Ring ring;
+
+    // Slots are claimed here (atomic instructions do not work on RTC memory)
+    static std::atomic<uint32_t> head;
+    static std::atomic<bool> recording;
+    // Dump in progress and time of its last read, esp_timer ms
+    static std::atomic<bool> paused;
+    static std::atomic<uint32_t> pausedMs;
+
+    // Read position of Encode
+    static uint32_t readIndex;
+
+    static void record(esp_log_level_t level, uint32_t id, const uint32_t *args, size_t argc);
+
+    // Strings and pointers can not be expanded on the host, 64 bit values do not fit a word
+    template<typename T>
+    static uint32_t word(T value) {
+        static_assert(std::is_integral<T>::value || std::is_enum<T>::value,
+                        "Binary log takes integers and floats only");
+        static_assert(sizeof(T) <= sizeof(uint32_t), "Binary log arguments are 32 bits at most");
+        return (uint32_t) value;
+    }
+    static uint32_t word(float value) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+    // %f takes a double, bits of the float are enough
+    static uint32_t word(double value) {
+        return word((float) value);
+    }
+};
+
+} // namespace TELEMETRY end --------------------
@@ -0,0 +1,72 @@
+/**
+ * @file bootProfile.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#include "bootProfile.hpp"
+
+extern "C" {
+    #include <stdio.h>
+    #include "esp_attr.h"
+    #include "esp_timer.h"
+} // extern C close
+
+using namespace TELEMETRY;
+
+// Complete timeline of previous wake
+RTC_DATA_ATTR PROTOCOL::BootProfile lastProfile;
+RTC_DATA_ATTR uint32_t profileWakes;
+
+PROTOCOL::BootProfile BootProfile::current = {};
+int64_t BootProfile::offset = 0;
+
+void BootProfile::Start(std::chrono::microseconds sinceWake) {
+    offset = sinceWake.count() - esp_timer_get_time();
+    current.times = {};
+    Mark(Marker::AppMain);
+}
+
+void BootProfile::Mark(Marker marker) {
+    auto& time = current.times[(size_t) marker];
+    if(time != 0) {
+        return;
+    }
+    time = (uint32_t) (esp_timer_get_time() + offset);
+
+    if(marker == Marker::Sleep) {
+        profileWakes++;
+        lastProfile = current;
+        dump(current);
+    }
+}
+
+size_t BootProfile::Encode(uint8_t *buffer, size_t size) {
+    return PROTOCOL::Encode(lastProfile, buffer, size);
+}
+
+#if BOOT_PROFILE_UART
+// Names used in UART dump, same order as markers
+static const char * markerNames[] = {
+    "app_main", "nvs_init", "imu_init", "first_sample", "ble_init", "advertising", "sleep"
+};
+static_assert(sizeof(markerNames) / sizeof(markerNames[0]) == (size_t) BootProfile::Marker::Count,
+                "Name each marker");
+#endif
+
+void BootProfile::dump(const PROTOCOL::BootProfile& profile) {
+#if BOOT_PROFILE_UART
+    // Not ESP_LOG, logs are compiled out in release builds
+    printf("boot_profile wake=%u", (unsigned int) profileWakes);
+    for(size_t i = 0; i < profile.times.size(); i++) {
+        printf(" %s=%u", markerNames[i], (unsigned int) profile.times[i]);
+    }
+    printf("\n");
+    fflush(stdout);
+#else
+    (void) profile;
+#endif
+}
@@ -0,0 +1,58 @@
+/**
+ * @file bootProfile.hpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+#include "dateTime.hpp"
+#include "protocol.hpp"
+
+// Print timeline of each wake on UART before sleep. Costs a few ms of awake time,
+// keep it off unless profiling (-D BOOT_PROFILE_UART=1). Parse with tools/bootProfile.py
+#ifndef BOOT_PROFILE_UART
+#define BOOT_PROFILE_UART (0)
+#endif
+
+namespace TELEMETRY {
+
+/**
+ * @brief Timeline of a wake. Each marker keeps the time it was first reached,
+ *      counted from the wake (ROM and bootloader included). No allocations,
+ *      safe to call from any task.
+ */
+class BootProfile {
+public:
+    typedef PROTOCOL::BootMarker Marker;
+
+    /**
+     * @brief Start the timeline. Call first thing in app_main.
+     * @param sinceWake time from wake until now
+     */
+    static void Start(std::chrono::microseconds sinceWake);
+
+    /**
+     * @brief Record the time marker was reached. Later calls for the same marker are ignored.
+     *      Sleep marker closes the timeline, it is kept in RTC memory for the next wake.
+     */
+    static void Mark(Marker marker);
+
+    /**
+     * @brief Encode timeline of previous (complete) wake.
+     * @return Length of encoded frame, 0 if buffer is too small
+     */
+    static size_t Encode(uint8_t *buffer, size_t size);
+
+private:
+    static PROTOCOL::BootProfile current;
+    // esp_timer starts late in the boot. Time from wake until esp_timer start
+    static int64_t offset;
+
+    static void dump(const PROTOCOL::BootProfile& profile);
+};
+
+} // namespace TELEMETRY end --------------------
@@ -0,0 +1,164 @@
+/**
+ * @file telemetry.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#include "telemetry.hpp"
+#include "i2c.hpp"
+#include "nvs.hpp"
+
+extern "C" {
+    #include "freertos/FreeRTOS.h"
+    #include "esp_attr.h"
+    #include "esp_log.h"
+    #include "esp_timer.h"
+} // extern C close
+
+using namespace TELEMETRY;
+
+// Totals since power on and latest wakes. Same layout as sent to the client
+RTC_DATA_ATTR PROTOCOL::Telemetry totals;
+// Wake in progress
+static PROTOCOL::TelemetryWake current;
+// Last accounting of tier time, RTC time in ms. 0 - nothing to account yet
+RTC_DATA_ATTR int64_t tierSinceMs;
+// Radio state is changed from BLE host task
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+Telemetry::Radio Telemetry::radio = Telemetry::Radio::OFF;
+int64_t Telemetry::radioSince = 0;
+
+static void add(uint16_t& counter, uint32_t value) {
+    counter = counter + value > UINT16_MAX ? UINT16_MAX : counter + value;
+}
+
+static size_t histogramBin(uint32_t awakeMs) {
+    size_t bin = 0;
+    while(bin < PROTOCOL::telemetryBinBounds.size() && awakeMs > PROTOCOL::telemetryBinBounds[bin]) {
+        bin++;
+    }
+    return bin;
+}
+
+void Telemetry::OnWake(esp_sleep_wakeup_cause_t cause, uint32_t stubWakes, std::chrono::microseconds stubTime) {
+    current = {};
+    current.cause = (uint8_t) toCause(cause);
+
+    totals.wakes++;
+    add(totals.wakeCauses[current.cause], 1);
+
+    if(stubWakes) {
+        // Stub wakes are all alike, timer and a single bus read each
+        uint32_t stubMs = ConvertToMs(stubTime);
+        totals.stubWakes += stubWakes;
+        totals.awakeTime += stubMs;
+        totals.i2cTransactions += stubWakes;
+        add(totals.wakeCauses[(size_t) PROTOCOL::WakeCause::Timer], stubWakes);
+        add(totals.awakeHistogram[histogramBin(stubMs / stubWakes)], stubWakes);
+    }
+}
+
+void Telemetry::SetRadio(Radio newRadio) {
+    portENTER_CRITICAL(&lock);
+    accountRadio(esp_timer_get_time());
+    radio = newRadio;
+    portEXIT_CRITICAL(&lock);
+}
+
+void Telemetry::SetPowerTier(PROTOCOL::PowerTier tier, std::chrono::microseconds rtcTime) {
+    int64_t nowMs = rtcTime.count() / 1000;
+    int64_t elapsedMs = nowMs - tierSinceMs;
+    // Behind the last accounting only if RTC memory outlived the clock
+    if(tierSinceMs != 0 && elapsedMs > 0) {
+        totals.tierTime[totals.powerTier] += (uint32_t) (elapsedMs / 1000);
+        // Remainder goes to next accounting
+        nowMs -= elapsedMs % 1000;
+    }
+    tierSinceMs = nowMs;
+
+    if((uint8_t) tier != totals.powerTier) {
+        ESP_LOGW(__FILE__, "%s:%d. Power tier %d -> %d", __func__ ,__LINE__, totals.powerTier, (int) tier);
+        totals.powerTier = (uint8_t) tier;
+        add(totals.tierChanges, 1);
+    }
+}
+
+void Telemetry::OnReconnect(std::chrono::microseconds time) {
+    totals.reconnectTime = ConvertToMs(time);
+    if(totals.reconnectTime > totals.maxReconnectTime) {
+        totals.maxReconnectTime = totals.reconnectTime;
+    }
+}
+
+Telemetry::Radio Telemetry::GetRadio() {
+    return radio;
+}
+
+void Telemetry::OnSleep(std::chrono::microseconds awake) {
+    portENTER_CRITICAL(&lock);
+    accountRadio(esp_timer_get_time());
+    radio = Radio::OFF;
+    portEXIT_CRITICAL(&lock);
+
+    // Each wake is a fresh boot, counters of drivers start from 0
+    current.awakeTime = ConvertToMs(awake);
+    current.i2cTransactions = I2C::transaction_count() > UINT16_MAX ? UINT16_MAX : I2C::transaction_count();
+    current.flashWrites = NVS::Nvs::write_count() > UINT16_MAX ? UINT16_MAX : NVS::Nvs::write_count();
+
+    totals.awakeTime += current.awakeTime;
+    totals.advertisingTime += current.advertisingTime;
+    totals.connectedTime += current.connectedTime;
+    totals.i2cTransactions += current.i2cTransactions;
+    totals.flashWrites += current.flashWrites;
+    add(totals.awakeHistogram[histogramBin(current.awakeTime)], 1);
+
+    // Latest wakes, oldest first
+    if(totals.recentCount < totals.recent.size()) {
+        totals.recent[totals.recentCount++] = current;
+    }
+    else {
+        for(size_t i = 1; i < totals.recent.size(); i++) {
+            totals.recent[i - 1] = totals.recent[i];
+        }
+        totals.recent.back() = current;
+    }
+
+    ESP_LOGI(__FILE__, "%s:%d. Wake cause %d, awake %u ms, adv %u ms, conn %u ms, i2c %u, flash %u", __func__ ,__LINE__,
+                current.cause, (unsigned int) current.awakeTime, (unsigned int) current.advertisingTime,
+                (unsigned int) current.connectedTime, current.i2cTransactions, current.flashWrites);
+    ESP_LOGI(__FILE__, "%s:%d. Totals: %u wakes (+%u stub), awake %u ms, adv %u ms, conn %u ms", __func__ ,__LINE__,
+                (unsigned int) totals.wakes, (unsigned int) totals.stubWakes, (unsigned int) totals.awakeTime,
+                (unsigned int) totals.advertisingTime, (unsigned int) totals.connectedTime);
+}
+
+size_t Telemetry::Encode(uint8_t *buffer, size_t size) {
+    return PROTOCOL::Encode(totals, buffer, size);
+}
+
+PROTOCOL::WakeCause Telemetry::toCause(esp_sleep_wakeup_cause_t cause) {
+    switch(cause) {
+        case ESP_SLEEP_WAKEUP_UNDEFINED: return PROTOCOL::WakeCause::Reset;
+        case ESP_SLEEP_WAKEUP_TIMER: return PROTOCOL::WakeCause::Timer;
+        case ESP_SLEEP_WAKEUP_EXT0: return PROTOCOL::WakeCause::Ext0;
+        case ESP_SLEEP_WAKEUP_EXT1: return PROTOCOL::WakeCause::Ext1;
+        case ESP_SLEEP_WAKEUP_TOUCHPAD: return PROTOCOL::WakeCause::Touchpad;
+        case ESP_SLEEP_WAKEUP_ULP: return PROTOCOL::WakeCause::Ulp;
+        case ESP_SLEEP_WAKEUP_GPIO: return PROTOCOL::WakeCause::Gpio;
+        default: return PROTOCOL::WakeCause::Other;
+    }
+}
+
+void Telemetry::accountRadio(int64_t now) {
+    uint32_t elapsedMs = (uint32_t) ((now - radioSince) / 1000);
+    if(radio == Radio::ADVERTISING) {
+        current.advertisingTime += elapsedMs;
+    }
+    else if(radio == Radio::CONNECTED) {
+        current.connectedTime += elapsedMs;
+    }
+    radioSince = now;
+}
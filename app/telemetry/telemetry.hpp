@@ -0,0 +1,82 @@
+/**
+ * @file telemetry.hpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+#include "dateTime.hpp"
+#include "protocol.hpp"
+
+extern "C" {
+    #include "esp_sleep.h"
+} // extern C close
+
+namespace TELEMETRY {
+
+/**
+ * @brief Where the battery goes. Per wake accounting (cause, awake time, radio time,
+ *      bus and flash activity) kept in RTC memory, with totals since power on
+ *      and a few latest wakes. Sent to the client with telemetry characteristic.
+ */
+class Telemetry {
+public:
+    enum class Radio { OFF, ADVERTISING, CONNECTED };
+
+    /**
+     * @brief Start accounting of a wake. Call once, at application start.
+     * @param cause what has woken the chip
+     * @param stubWakes wakes handled by the wake stub since previous application run
+     * @param stubTime awake time of these wakes
+     */
+    static void OnWake(esp_sleep_wakeup_cause_t cause, uint32_t stubWakes, std::chrono::microseconds stubTime);
+
+    /**
+     * @brief Radio state has changed. Time spent in previous state is accounted.
+     */
+    static void SetRadio(Radio radio);
+
+    /**
+     * @return Current radio state
+     */
+    static Radio GetRadio();
+
+    /**
+     * @brief Account time since previous call to the tier device was in, then switch to given tier.
+     *      Call at least once per wake.
+     * @param rtcTime RTC time (WakeStub::GetRtcTime), monotonic through deep sleep. System time
+     *      is stepped by time syncs, the steps would be counted as time in the tier
+     */
+    static void SetPowerTier(PROTOCOL::PowerTier tier, std::chrono::microseconds rtcTime);
+
+    /**
+     * @brief Link with the client is up and encrypted.
+     * @param time since advertising start
+     */
+    static void OnReconnect(std::chrono::microseconds time);
+
+    /**
+     * @brief Close the wake record. Call right before deep sleep.
+     * @param awake time since wake (ROM and bootloader included)
+     */
+    static void OnSleep(std::chrono::microseconds awake);
+
+    /**
+     * @brief Encode totals and latest (completed) wakes.
+     * @return Length of encoded frame, 0 if buffer is too small
+     */
+    static size_t Encode(uint8_t *buffer, size_t size);
+
+private:
+    static Radio radio;
+    static int64_t radioSince;
+
+    static PROTOCOL::WakeCause toCause(esp_sleep_wakeup_cause_t cause);
+    static void accountRadio(int64_t now);
+};
+
+} // namespace TELEMETRY end --------------------
@@ -0,0 +1,167 @@
+/**
+ * @file trace.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#include "trace.hpp"
+#include "traceHooks.h"
+#include <algorithm>
+
+extern "C" {
+    #include <sys/time.h>
+    #include "freertos/task.h"
+    #include "esp_attr.h"
+    #include "esp_cpu.h"
+    #include "esp_timer.h"
+    #include "sdkconfig.h"
+} // extern C close
+
+using namespace TELEMETRY;
+
+// RTC_NOINIT memory is random after power on, valid rings carry it
+static constexpr uint32_t ringMagic = 0x54524331;
+
+RTC_NOINIT_ATTR Trace::Ring Trace::rings[portNUM_PROCESSORS];
+RTC_NOINIT_ATTR uint16_t Trace::boot;
+
+std::atomic<uint32_t> Trace::heads[portNUM_PROCESSORS];
+std::atomic<bool> Trace::recording(false);
+std::atomic<bool> Trace::paused(false);
+std::atomic<uint32_t> Trace::pausedMs(0);
+
+// Odr-used when compared, C++14 needs the definitions
+constexpr uint32_t Trace::pauseTimeoutMs;
+
+size_t Trace::readCore = 0;
+uint32_t Trace::readIndex = 0;
+
+void Trace::Start(esp_sleep_wakeup_cause_t cause) {
+    bool valid = true;
+    for(const auto& ring : rings) {
+        valid = valid && ring.magic == ringMagic;
+    }
+    if(!valid) {
+        for(auto& ring : rings) {
+            ring.magic = ringMagic;
+            ring.head = 0;
+        }
+        boot = 0;
+    }
+    boot++;
+    for(size_t core = 0; core < portNUM_PROCESSORS; core++) {
+        heads[core] = rings[core].head;
+    }
+    recording = true;
+
+    timeval tv = {0, 0};
+    gettimeofday(&tv, NULL);
+    const int64_t epochMs = (int64_t) tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    Record(Event::Wake, (uint32_t) cause | (uint32_t) CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ << 8, (uint32_t) epochMs);
+}
+
+void IRAM_ATTR Trace::Record(Event event, uint32_t arg0, uint32_t arg1) {
+    if(!recording.load(std::memory_order_relaxed)) {
+        if(!paused || (uint32_t) (esp_timer_get_time() / 1000) - pausedMs < pauseTimeoutMs) {
+            return;
+        }
+        // Reader stopped in the middle of a dump, its next Encode starts again
+        paused = false;
+        recording = true;
+    }
+    const uint32_t core = xPortGetCoreID();
+    auto& ring = rings[core];
+    // ISR of this core may take the next slot before the record is complete, never the same one
+    const uint32_t index = heads[core].fetch_add(1, std::memory_order_relaxed);
+
+    auto& record = ring.records[index % TRACE_RECORDS];
+    record.event = (uint8_t) event;
+    record.core = (uint8_t) core;
+    record.boot = boot;
+    record.cycles = esp_cpu_get_cycle_count();
+    record.arg0 = arg0;
+    record.arg1 = arg1;
+    // Kept in RTC memory with each record, rings stay readable after a crash. Plain stores:
+    // an ISR may store a larger count between the load and the store of this writer,
+    // so the store is repeated until the count did not change behind it
+    uint32_t count = heads[core].load();
+    for(;;) {
+        ring.head = count;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const uint32_t current = heads[core].load();
+        if(current == count) {
+            break;
+        }
+        count = current;
+    }
+}
+
+void IRAM_ATTR Trace::OnTaskSwitch() {
+#if TRACE_TASK_SWITCH
+    if(!recording.load(std::memory_order_relaxed)) {
+        return;
+    }
+    // Name is 4 bytes, enough to tell tasks apart
+    const char *name = pcTaskGetName(NULL);
+    uint32_t packed = 0;
+    for(size_t i = 0; i < sizeof(packed) && name[i] != '\0'; i++) {
+        packed |= (uint32_t) (uint8_t) name[i] << (8 * i);
+    }
+    Record(Event::TaskSwitch, (uint32_t) (uintptr_t) xTaskGetCurrentTaskHandle(), packed);
+#endif
+}
+
+size_t Trace::Encode(uint8_t *buffer, size_t size) {
+    // Before the pause, Record must not take it as timed out
+    pausedMs = (uint32_t) (esp_timer_get_time() / 1000);
+    if(!paused.exchange(true)) {
+        // New dump, or the last one timed out and the rings moved on
+        readCore = 0;
+        readIndex = 0;
+    }
+    // Rings would move under the reader
+    recording = false;
+
+    for(; readCore < portNUM_PROCESSORS; readCore++, readIndex = 0) {
+        const auto& ring = rings[readCore];
+        const uint32_t count = std::min<uint32_t>(ring.head, TRACE_RECORDS);
+        if(readIndex >= count) {
+            continue;
+        }
+        PROTOCOL::TraceChunk chunk;
+        chunk.core = (uint8_t) readCore;
+        chunk.first = (uint16_t) readIndex;
+        chunk.count = (uint8_t) std::min<uint32_t>(PROTOCOL::traceChunkRecords, count - readIndex);
+        const uint32_t oldest = ring.head - count;
+        for(size_t i = 0; i < chunk.count; i++) {
+            chunk.records[i] = ring.records[(oldest + readIndex + i) % TRACE_RECORDS];
+        }
+        auto len = PROTOCOL::Encode(chunk, buffer, size);
+        if(len) {
+            readIndex += chunk.count;
+        }
+        return len;
+    }
+
+    Rewind();
+    if(size < PROTOCOL::headerSize) {
+        return 0;
+    }
+    // Frame with header only means all was read
+    buffer[0] = PROTOCOL::version;
+    return PROTOCOL::headerSize;
+}
+
+void Trace::Rewind() {
+    readCore = 0;
+    readIndex = 0;
+    paused = false;
+    recording = true;
+}
+
+extern "C" void IRAM_ATTR TraceTaskSwitchedIn(void) {
+    Trace::OnTaskSwitch();
+}
@@ -0,0 +1,98 @@
+/**
+ * @file trace.hpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+#include "protocol.hpp"
+#include <atomic>
+
+extern "C" {
+    #include "freertos/FreeRTOS.h"
+    #include "esp_sleep.h"
+} // extern C close
+
+// Records kept per core. 16 B each, rings live in RTC slow memory
+#ifndef TRACE_RECORDS
+#define TRACE_RECORDS (64)
+#endif
+
+// Record task switches (traceTASK_SWITCHED_IN, see traceHooks.h). Opt-in, set by CMakeLists.txt:
+// at 1000 Hz tick switches overwrite the wake, sleep and bus records of a ring within milliseconds
+#ifndef TRACE_TASK_SWITCH
+#define TRACE_TASK_SWITCH (0)
+#endif
+
+namespace TELEMETRY {
+
+/**
+ * @brief Binary trace of events. Fixed size records (event, CPU cycles, two arguments)
+ *      go to a ring of the core they happen on, oldest ones are overwritten. Rings are
+ *      in RTC memory not cleared by any reset, so they survive deep sleep and crashes.
+ *      Recording is cheap enough to stay on in release builds: no formatting, no lock
+ *      shared by the cores, safe from tasks and ISRs. Read over BLE, decode with tools/trace.py
+ */
+class Trace {
+public:
+    typedef PROTOCOL::TraceEvent Event;
+
+    /**
+     * @brief Open the trace of this boot, records Wake. Events before it are dropped.
+     *      Call first thing in app_main.
+     */
+    static void Start(esp_sleep_wakeup_cause_t cause);
+
+    /**
+     * @brief Append a record to the ring of the calling core. From tasks and ISRs.
+     */
+    static void Record(Event event, uint32_t arg0 = 0, uint32_t arg1 = 0);
+
+    /**
+     * @brief Encode next chunk of the rings, core 0 first, oldest records first.
+     *      Recording is paused until the last chunk is read. If the reader stops in between,
+     *      it resumes pauseTimeoutMs after the last read and the next Encode starts again.
+     * @return Length of encoded frame, header only if all was read (next call starts again),
+     *      0 if buffer is too small
+     */
+    static size_t Encode(uint8_t *buffer, size_t size);
+
+    /**
+     * @brief Reader is gone. Next Encode starts from the beginning, recording goes on.
+     */
+    static void Rewind();
+
+    /**
+     * @brief Task switched in on the calling core. Called by the kernel, see traceHooks.h
+     */
+    static void OnTaskSwitch();
+
+    // Longest gap between reads of a dump. BLE reads follow each other within a connection interval
+    static constexpr uint32_t pauseTimeoutMs = 5000;
+
+private:
+    struct Ring {
+        uint32_t magic;
+        uint32_t head;              // Records written, index of the next one is head % TRACE_RECORDS
+        PROTOCOL::TraceRecord records[TRACE_RECORDS];
+    };
+    static Ring rings[portNUM_PROCESSORS];
+    static uint16_t boot;
+
+    // Slots are claimed here (atomic instructions do not work on RTC memory)
+    static std::atomic<uint32_t> heads[portNUM_PROCESSORS];
+    static std::atomic<bool> recording;
+    // Dump in progress and time of its last read, esp_timer ms
+    static std::atomic<bool> paused;
+    static std::atomic<uint32_t> pausedMs;
+
+    // Read position of Encode
+    static size_t readCore;
+    static uint32_t readIndex;
+};
+
+} // namespace TELEMETRY end --------------------
@@ -0,0 +1,30 @@
+/**
+ * @file traceHooks.h
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+// FreeRTOS trace macros, forced into the kernel build with -include (CMakeLists.txt).
+// Kernel defines the ones left out as empty. Runs in the scheduler: IRAM, no blocking.
+
+#ifndef __ASSEMBLER__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Defined in trace.cpp
+void TraceTaskSwitchedIn(void);
+
+#ifdef __cplusplus
+} // extern C close
+#endif
+
+#define traceTASK_SWITCHED_IN() TraceTaskSwitchedIn()
+
+#endif
@@ -0,0 +1,124 @@
+/**
+ * @file timeSync.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#include "timeSync.hpp"
+#include <cinttypes>
+
+extern "C" {
+    #include <sys/time.h>
+    #include "esp_log.h"
+    #include "esp_attr.h"
+} // extern C close
+
+using namespace TIMESYNC;
+
+// RTC keeps running during deep sleep, so does the drift. Estimate must survive sleep too.
+// System time (after step) of last sync. 0 = never synced
+RTC_DATA_ATTR int64_t lastSyncMs;
+// System time of last drift compensation
+RTC_DATA_ATTR int64_t lastCompensationMs;
+RTC_DATA_ATTR float driftPpm;
+RTC_DATA_ATTR bool driftValid;
+
+constexpr std::chrono::milliseconds TimeSync::maxRoundTrip;
+constexpr std::chrono::minutes TimeSync::minDriftInterval;
+constexpr float TimeSync::maxDriftPpm;
+
+int64_t TimeSync::requestTime = 0;
+bool TimeSync::requestPending = false;
+
+int64_t TimeSync::NowMs() {
+    timeval tv = {0, 0};
+    gettimeofday(&tv, NULL);
+    return (int64_t) tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+void TimeSync::setTime(int64_t timeMs) {
+    timeval tv = {.tv_sec = (time_t) (timeMs / 1000), .tv_usec = (suseconds_t) (timeMs % 1000) * 1000};
+    settimeofday(&tv, NULL);
+}
+
+void TimeSync::OnRequest() {
+    requestTime = NowMs();
+    requestPending = true;
+}
+
+bool TimeSync::GetResponse(PROTOCOL::TimeSyncResponse& response) {
+    if(!requestPending) {
+        return false;
+    }
+    response.receiveTime = requestTime;
+    response.holdTime = (uint32_t) (NowMs() - requestTime);
+    return true;
+}
+
+bool TimeSync::OnAdjust(const PROTOCOL::TimeSyncAdjust& adjust, Correction& correction) {
+    if(!requestPending) {
+        ESP_LOGW(__FILE__, "%s:%d. Time sync adjust without request", __func__ ,__LINE__);
+        return false;
+    }
+    requestPending = false;
+
+    if(adjust.roundTrip > ConvertToMs(maxRoundTrip)) {
+        ESP_LOGW(__FILE__, "%s:%d. Time sync rejected. Round trip %u ms", __func__ ,__LINE__, 
+                    (unsigned int) adjust.roundTrip);
+        return false;
+    }
+
+    correction = Apply(adjust.offset);
+    ESP_LOGI(__FILE__, "%s:%d. Time synced. Offset %" PRId64 " ms, round trip %u ms, drift %.0f ppm", __func__ ,__LINE__, 
+                adjust.offset, (unsigned int) adjust.roundTrip, driftPpm);
+    return true;
+}
+
+Correction TimeSync::Apply(int64_t offsetMs) {
+    auto now = NowMs();
+    Correction correction = {.fromMs = lastSyncMs, .toMs = now, .offsetMs = offsetMs, .interpolate = lastSyncMs != 0};
+
+    auto elapsed = now - lastSyncMs;
+    if(lastSyncMs != 0 && elapsed >= (int64_t) ConvertToMs(minDriftInterval)) {
+        // Compensate() already removed the drift we knew about. Offset is what estimate missed.
+        float residualPpm = - (float) offsetMs * 1e6f / (float) elapsed;
+        float estimate = driftValid ? driftPpm + residualPpm / 2 : driftPpm + residualPpm;
+
+        if(estimate > maxDriftPpm || estimate < -maxDriftPpm) {
+            ESP_LOGW(__FILE__, "%s:%d. Drift estimate out of range %.0f ppm", __func__ ,__LINE__, estimate);
+        }
+        else {
+            driftPpm = estimate;
+            driftValid = true;
+        }
+    }
+
+    setTime(now + offsetMs);
+    lastSyncMs = now + offsetMs;
+    lastCompensationMs = lastSyncMs;
+
+    return correction;
+}
+
+void TimeSync::Compensate() {
+    if(!driftValid || lastCompensationMs == 0) {
+        return;
+    }
+
+    auto now = NowMs();
+    auto step = (int64_t) (- driftPpm * (float) (now - lastCompensationMs) / 1e6f);
+    if(step == 0) {
+        // Less than a millisecond. Keep accumulating
+        return;
+    }
+
+    setTime(now + step);
+    lastCompensationMs = now + step;
+}
+
+float TimeSync::GetDriftPpm() {
+    return driftValid ? driftPpm : 0;
+}
@@ -0,0 +1,102 @@
+/**
+ * @file timeSync.hpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+#include "dateTime.hpp"
+#include "protocol.hpp"
+
+namespace TIMESYNC {
+
+/**
+ * @brief Describes clock step made at sync. Used to fix timestamps
+ *      registered before the sync (with a drifted clock).
+ */
+struct Correction {
+    int64_t fromMs;     // Time of previous sync, 0 if there was none
+    int64_t toMs;       // Time of this sync, before the step
+    int64_t offsetMs;   // Step applied to the clock
+    bool interpolate;   // Drift accumulated linearly since previous sync
+
+    /**
+     * @param t timestamp taken with the clock before the step
+     * @return timestamp as it would be with a correct clock
+     */
+    time_t Apply(time_t t) const {
+        int64_t tMs = (int64_t) t * 1000;
+        if(!interpolate) {
+            // Clock was never synced, whole offset applies
+            return (tMs + offsetMs) / 1000;
+        }
+        if(tMs <= fromMs || toMs <= fromMs) {
+            // Registered before previous sync - already correct
+            return t;
+        }
+        if(tMs > toMs) tMs = toMs;
+        return (tMs + offsetMs * (tMs - fromMs) / (toMs - fromMs)) / 1000;
+    }
+};
+
+class TimeSync {
+    static int64_t requestTime;
+    static bool requestPending;
+
+    static void setTime(int64_t timeMs);
+
+public:
+    // Exchanges slower than this are too asymmetric to trust
+    const static constexpr std::chrono::milliseconds maxRoundTrip = 500ms;
+    // Shorter intervals give too noisy drift estimate
+    const static constexpr std::chrono::minutes minDriftInterval = 10min;
+    // Internal RTC is +/- 5%, anything beyond is a bad measurement
+    const static constexpr float maxDriftPpm = 100000;
+
+    /**
+     * @return System time in epoch milliseconds
+     */
+    static int64_t NowMs();
+
+    /**
+     * @brief Sync request received (T2 of the exchange).
+     */
+    static void OnRequest();
+
+    /**
+     * @brief Response for pending request (T3 taken now).
+     * @return false if there is no pending request
+     */
+    static bool GetResponse(PROTOCOL::TimeSyncResponse& response);
+
+    /**
+     * @brief Finish the exchange. Steps the clock and updates drift estimate.
+     * @param adjust offset computed by client
+     * @param[out] correction step made, use it to fix already registered timestamps
+     * @return false if exchange was rejected (no request, round trip too long)
+     */
+    static bool OnAdjust(const PROTOCOL::TimeSyncAdjust& adjust, Correction& correction);
+
+    /**
+     * @brief Step the clock by given offset. Updates drift estimate.
+     * @param offsetMs milliseconds to add to system time
+     * @return step made, use it to fix already registered timestamps
+     */
+    static Correction Apply(int64_t offsetMs);
+
+    /**
+     * @brief Remove drift predicted since last call or sync. Call once per wake.
+     */
+    static void Compensate();
+
+    /**
+     * @return Estimated drift of RTC. Positive if clock runs fast.
+     */
+    static float GetDriftPpm();
+};
+
+} // namespace TIMESYNC end --------------------
@@ -23,7 +23,7 @@ private:
 
 public:
     AnalogRead() = delete;
-    AnalogRead(adc_unit_t _unit, adc_channel_t _channel) : unit(_unit), channel(_channel) {
+    AnalogRead(adc_unit_t _unit, adc_channel_t _channel) : unit(_unit), channel(_channel), cali(nullptr) {
         esp_err_t ret = ESP_FAIL;
         adc_oneshot_unit_init_cfg_t adcConfig;
         adcConfig.unit_id = unit;
@@ -42,11 +42,21 @@ public:
             ESP_LOGI("ADC", "Calibration Success");
         } else if (ret == ESP_ERR_NOT_SUPPORTED) {
             ESP_LOGW("ADC", "eFuse not burnt, skip software calibration");
+            cali = nullptr;
         } else {
             ESP_LOGE("ADC", "Invalid arg or no memory");
+            cali = nullptr;
         }
     };
 
+    // Unit is taken only for a measurement, ADC is free again when done
+    ~AnalogRead() {
+        if(cali != nullptr) {
+            adc_cali_delete_scheme_line_fitting(cali);
+        }
+        adc_oneshot_del_unit(handle);
+    }
+
     /**
     * Read value from ADC input
     * @return value of ADC measurement
@@ -58,8 +68,19 @@ public:
     }
 
     float GetAdcVoltage() {
+        return RawToVoltage(GetAdcValue());
+    }
+
+    /**
+    * Convert ADC reading with calibration of the unit
+    * @return voltage [V] at ADC pin
+    */
+    float RawToVoltage(int raw) {
         int out;
-        adc_cali_raw_to_voltage(cali, GetAdcValue(), &out);
+        if(cali == nullptr || adc_cali_raw_to_voltage(cali, raw, &out) != ESP_OK) {
+            // Uncalibrated: 11 dB attenuation, 12 bits
+            out = raw * 3100 / 4095;
+        }
         float volt = (float)out;
         return volt / 1000;
     }
@@ -0,0 +1,164 @@
+/**
+ * @file analogStream.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#include "analogStream.hpp"
+#include <algorithm>
+#include <cmath>
+
+extern "C" {
+    #include "esp_attr.h"
+} // extern C close
+
+namespace {
+
+// Wait for a DMA frame. One takes 3.2 ms at sampleRateHz
+constexpr uint32_t readTimeoutMs = 20;
+// Key of the table, plus unit
+constexpr uint32_t tableMagic = 0x41444300;
+
+} // namespace end --------------------
+
+// Odr-used by std::min, C++14 needs the definitions
+constexpr size_t AnalogStream::maxSamples;
+constexpr int AnalogStream::maxRaw;
+
+RTC_DATA_ATTR AnalogStream::Table AnalogStream::table;
+
+AnalogStream::AnalogStream(adc_unit_t _unit, adc_channel_t _channel) : unit(_unit), channel(_channel), handle(nullptr) {
+    calibrate(unit);
+
+    adc_continuous_handle_cfg_t handleConfig = {
+        .max_store_buf_size = frameCount * frameSamples * resultBytes,
+        .conv_frame_size = frameSamples * resultBytes,
+    };
+    ESP_ERROR_CHECK(adc_continuous_new_handle(&handleConfig, &handle));
+
+    adc_digi_pattern_config_t pattern = {
+        .atten = ADC_ATTEN_DB_11,
+        .channel = (uint8_t) channel,
+        .unit = (uint8_t) unit,
+        .bit_width = ADC_BITWIDTH_12,
+    };
+    adc_continuous_config_t config = {
+        .pattern_num = 1,
+        .adc_pattern = &pattern,
+        .sample_freq_hz = sampleRateHz,
+        .conv_mode = unit == ADC_UNIT_1 ? ADC_CONV_SINGLE_UNIT_1 : ADC_CONV_SINGLE_UNIT_2,
+        .format = ADC_DIGI_OUTPUT_FORMAT_TYPE1,
+    };
+    ESP_ERROR_CHECK(adc_continuous_config(handle, &config));
+}
+
+AnalogStream::~AnalogStream() {
+    adc_continuous_deinit(handle);
+}
+
+void AnalogStream::calibrate(adc_unit_t unit) {
+    if(table.key == tableMagic + unit) {
+        return;
+    }
+    adc_cali_handle_t cali = nullptr;
+    // Fields differ between chips (default_vref on ESP32), the ones not set stay 0
+    adc_cali_line_fitting_config_t caliConfig = {};
+    caliConfig.unit_id = unit;
+    caliConfig.atten = ADC_ATTEN_DB_11;
+    caliConfig.bitwidth = ADC_BITWIDTH_DEFAULT;
+    if(adc_cali_create_scheme_line_fitting(&caliConfig, &cali) != ESP_OK) {
+        ESP_LOGW(__FILE__, "%s:%d. eFuse not burnt, uncalibrated", __func__ ,__LINE__);
+        cali = nullptr;
+    }
+    for(size_t i = 0; i < table.points.size(); i++) {
+        // Last point is one past the range, maxRaw stands in for it
+        const int raw = std::min((int) i << tableShift, maxRaw);
+        int mv;
+        if(cali == nullptr || adc_cali_raw_to_voltage(cali, raw, &mv) != ESP_OK) {
+            // Uncalibrated: 11 dB attenuation, 12 bits
+            mv = raw * 3100 / 4095;
+        }
+        table.points[i] = (uint16_t) mv;
+    }
+    if(cali != nullptr) {
+        adc_cali_delete_scheme_line_fitting(cali);
+    }
+    table.key = tableMagic + unit;
+}
+
+int AnalogStream::RawToMillivolts(int raw) {
+    raw = std::max(0, std::min(raw, maxRaw));
+    const int i = raw >> tableShift;
+    const int fraction = raw & ((1 << tableShift) - 1);
+    return table.points[i] + (table.points[i + 1] - table.points[i]) * fraction / (1 << tableShift);
+}
+
+size_t AnalogStream::read(size_t samples) {
+    if(adc_continuous_start(handle) != ESP_OK) {
+        return 0;
+    }
+    const size_t bytes = samples * resultBytes;
+    size_t filled = 0;
+    while(filled < bytes) {
+        uint32_t length = 0;
+        if(adc_continuous_read(handle, buffer.data() + filled, bytes - filled, &length, readTimeoutMs) != ESP_OK) {
+            break;
+        }
+        filled += length;
+    }
+    adc_continuous_stop(handle);
+
+    // Converted in one pass, no calibration calls per sample
+    size_t count = 0;
+    for(size_t i = 0; i + resultBytes <= filled; i += resultBytes) {
+        auto result = (const adc_digi_output_data_t *) (buffer.data() + i);
+        if(result->type1.channel == channel) {
+            millivolts[count++] = RawToMillivolts(result->type1.data);
+        }
+    }
+    return count;
+}
+
+AnalogStream::Stats AnalogStream::Measure(size_t samples, float clipSigma) {
+    Stats stats = {0, 0, 0};
+    const size_t count = read(std::min(samples, maxSamples));
+    if(count == 0) {
+        ESP_LOGE(__FILE__, "%s:%d. No conversions", __func__ ,__LINE__);
+        return stats;
+    }
+
+    // Exact integer sums, mV fit in 16 bits
+    auto figures = [this, count](float mean, float limit) {
+        int64_t sum = 0;
+        int64_t squares = 0;
+        uint32_t kept = 0;
+        for(size_t i = 0; i < count; i++) {
+            const float distance = millivolts[i] - mean;
+            if(distance * distance > limit) {
+                continue;
+            }
+            sum += millivolts[i];
+            squares += (int64_t) millivolts[i] * millivolts[i];
+            kept++;
+        }
+        Stats result = {kept, 0, 0};
+        if(kept) {
+            result.mean = (float) sum / kept;
+            result.variance = (float) (kept * squares - sum * sum) / ((float) kept * kept);
+        }
+        return result;
+    };
+
+    stats = figures(0, INFINITY);
+    if(clipSigma > 0 && stats.variance > 0) {
+        // Spikes inflate the first variance, the limit is loose enough to keep all regular samples
+        auto clipped = figures(stats.mean, clipSigma * clipSigma * stats.variance);
+        if(clipped.samples) {
+            stats = clipped;
+        }
+    }
+    return stats;
+}
@@ -0,0 +1,89 @@
+/**
+ * @file analogStream.hpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+extern "C" {
+    #include "esp_adc/adc_continuous.h"
+    #include "esp_adc/adc_cali.h"
+    #include "esp_adc/adc_cali_scheme.h"
+    #include "esp_log.h"
+} // extern C close
+
+/**
+ * @brief Burst of conversions of one channel, done by the ADC with DMA (continuous mode).
+ *      Converted to mV with a lookup table, built from the calibration scheme once per
+ *      power on and kept in RTC memory.
+ */
+class AnalogStream {
+public:
+    struct Stats {
+        uint32_t samples;       // Conversions the figures are made of, outliers excluded
+        float mean;             // Voltage at ADC pin [mV]
+        float variance;         // [mV^2]
+    };
+
+    // Longest burst, the read buffer is a member
+    const static constexpr size_t maxSamples = 256;
+    // Conversions per DMA frame. Driver keeps frameCount frames in its ring
+    const static constexpr size_t frameSamples = 64;
+    const static constexpr size_t frameCount = 4;
+    // Lowest rate of ESP32 continuous mode. 256 conversions take 13 ms
+    const static constexpr uint32_t sampleRateHz = 20000;
+
+    AnalogStream() = delete;
+    AnalogStream(const AnalogStream& copy) = delete;
+
+    /**
+     * @brief Unit is taken only for a measurement, ADC is free again when the object is gone.
+     *      ESP32 runs continuous mode on ADC_UNIT_1 only.
+     */
+    AnalogStream(adc_unit_t unit, adc_channel_t channel);
+    ~AnalogStream();
+
+    /**
+     * @brief Start conversions, read samples of the channel and stop.
+     * @param samples up to maxSamples
+     * @param clipSigma samples further from the mean than clipSigma standard deviations
+     *      are dropped (spikes), 0 keeps all
+     * @return Figures of the burst, samples 0 if ADC failed
+     */
+    Stats Measure(size_t samples, float clipSigma = 3);
+
+    /**
+     * @return Voltage at ADC pin [mV] of a conversion, from the lookup table
+     */
+    static int RawToMillivolts(int raw);
+
+private:
+    const static constexpr size_t resultBytes = sizeof(adc_digi_output_data_t);
+    // Table has a point each 2^tableShift raw units, linear in between
+    const static constexpr int tableShift = 7;
+    const static constexpr int maxRaw = 4095;   // 12 bits
+
+    struct Table {
+        uint32_t key;       // Unit it was built for
+        std::array<uint16_t, ((maxRaw + 1) >> tableShift) + 1> points;
+    };
+    // eFuse calibration does not change, built at power on only (RTC memory)
+    static Table table;
+
+    adc_unit_t unit;
+    adc_channel_t channel;
+    adc_continuous_handle_t handle;
+    std::array<uint8_t, maxSamples * resultBytes> buffer;
+    std::array<uint16_t, maxSamples> millivolts;
+
+    static void calibrate(adc_unit_t unit);
+    size_t read(size_t samples);
+};
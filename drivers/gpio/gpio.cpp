@@ -8,10 +8,22 @@
  */
 
 #include "gpio.hpp"
+#include <algorithm>
 
-//TODO you should define copy-constructor
+extern "C" {
+    #include "esp_attr.h"
+    #include "esp_log.h"
+    #include "esp_sleep.h"
+    #include "esp_timer.h"
+    #include "driver/rtc_io.h"
+} // extern C close
 
-Gpio::Gpio(int _pin, Mode mode, bool initState, Pull pull) {
+Gpio *Gpio::withInterrupt[GPIO_NUM_MAX];
+uint64_t Gpio::wakeupPins;
+// Chip knows only that EXT0 woke it, not the pin
+RTC_DATA_ATTR int Gpio::ext0Pin = GPIO_NUM_NC;
+
+Gpio::Gpio(int _pin, Mode mode, bool initState, Pull pull) : pull(pull), interrupt() {
     pin = (gpio_num_t) _pin;
     gpio_pullup_t pu = GPIO_PULLUP_DISABLE;
     gpio_pulldown_t pd = GPIO_PULLDOWN_DISABLE;
@@ -68,4 +80,141 @@ void Gpio::Toggle() {
 
 bool Gpio::Read(void) { return false; }
 
-uint32_t Gpio::GetPinNumber(void) { return pin; }
\ No newline at end of file
+uint32_t Gpio::GetPinNumber(void) { return pin; }
+
+Gpio::~Gpio() {
+    if(withInterrupt[pin] == this) {
+        DisableInterrupt();
+        withInterrupt[pin] = nullptr;
+    }
+}
+
+void IRAM_ATTR Gpio::handler(void *arg) {
+    auto& gpio = *(Gpio *) arg;
+    auto& interrupt = gpio.interrupt;
+    interrupt.lastUs = esp_timer_get_time();
+    interrupt.stats.interrupts++;
+    if(interrupt.isr != nullptr) {
+        interrupt.isr(interrupt.arg);
+        return;
+    }
+    // Level would interrupt again at once, edge may bounce. Masked until Acknowledge
+    gpio_intr_disable(gpio.pin);
+    BaseType_t woken = pdFALSE;
+    xTaskNotifyFromISR(interrupt.task, interrupt.bits, eSetBits, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+esp_err_t Gpio::attach(Trigger trigger) {
+    // Another pin may have installed the service already
+    esp_err_t res = gpio_install_isr_service(0);
+    if(res != ESP_OK && res != ESP_ERR_INVALID_STATE) {
+        return res;
+    }
+    res = gpio_set_intr_type(pin, (gpio_int_type_t) trigger);
+    if(res != ESP_OK) {
+        return res;
+    }
+    // Shared handler, the object is its argument
+    res = gpio_isr_handler_add(pin, handler, this);
+    if(res != ESP_OK) {
+        return res;
+    }
+    withInterrupt[pin] = this;
+    return gpio_intr_enable(pin);
+}
+
+esp_err_t Gpio::EnableInterrupt(Trigger trigger, Isr isr, void *arg) {
+    interrupt.isr = isr;
+    interrupt.arg = arg;
+    interrupt.task = nullptr;
+    return attach(trigger);
+}
+
+esp_err_t Gpio::EnableDeferredInterrupt(Trigger trigger, TaskHandle_t task, uint32_t bits) {
+    interrupt.isr = nullptr;
+    interrupt.task = task;
+    interrupt.bits = bits;
+    return attach(trigger);
+}
+
+bool Gpio::Acknowledge(uint32_t debounceMs) {
+    Handled();
+    const TickType_t debounce = debounceMs / portTICK_PERIOD_MS;
+    bool level = gpio_get_level(pin);
+    TickType_t stable = xTaskGetTickCount();
+    while(xTaskGetTickCount() - stable < debounce) {
+        vTaskDelay(1);
+        const bool now = gpio_get_level(pin);
+        if(now != level) {
+            level = now;
+            stable = xTaskGetTickCount();
+        }
+    }
+    if(interrupt.task != nullptr) {
+        gpio_intr_enable(pin);
+    }
+    return level;
+}
+
+void Gpio::Handled(void) {
+    const uint32_t latency = (uint32_t) (esp_timer_get_time() - interrupt.lastUs);
+    auto& stats = interrupt.stats;
+    stats.handled++;
+    stats.totalLatencyUs += latency;
+    stats.maxLatencyUs = std::max(stats.maxLatencyUs, latency);
+}
+
+void Gpio::DisableInterrupt(void) {
+    gpio_intr_disable(pin);
+    gpio_isr_handler_remove(pin);
+}
+
+void Gpio::LogStats(void) {
+    for(auto gpio : withInterrupt) {
+        if(gpio == nullptr) {
+            continue;
+        }
+        const auto& stats = gpio->interrupt.stats;
+        ESP_LOGI(__FILE__, "%s:%d. GPIO %d: %u interrupts, %u handled, latency mean %u us, max %u us", __func__ ,__LINE__,
+                    (int) gpio->pin, (unsigned int) stats.interrupts, (unsigned int) stats.handled,
+                    (unsigned int) (stats.handled ? stats.totalLatencyUs / stats.handled : 0),
+                    (unsigned int) stats.maxLatencyUs);
+    }
+}
+
+esp_err_t Gpio::EnableWakeup(bool level) {
+    if(!rtc_gpio_is_valid_gpio(pin)) {
+        ESP_LOGE(__FILE__, "%s:%d. GPIO %d is not an RTC GPIO", __func__ ,__LINE__, (int) pin);
+        return ESP_ERR_INVALID_ARG;
+    }
+    // Digital pulls are off in deep sleep, RTC ones hold the pin
+    rtc_gpio_pullup_dis(pin);
+    rtc_gpio_pulldown_dis(pin);
+    if(pull == PULLUP) {
+        rtc_gpio_pullup_en(pin);
+    }
+    else if(pull == PULLDOWN) {
+        rtc_gpio_pulldown_en(pin);
+    }
+    if(pull != NO_PULL) {
+        // Pulls are powered with RTC peripherals, off in deep sleep by default
+        esp_sleep_pd_config(ESP_PD_DOMAIN_RTC_PERIPH, ESP_PD_OPTION_ON);
+    }
+
+    if(!level) {
+        // EXT1 of ESP32 wakes on low only if all its pins are low
+        ext0Pin = pin;
+        return esp_sleep_enable_ext0_wakeup(pin, 0);
+    }
+    wakeupPins |= BIT64(pin);
+    return esp_sleep_enable_ext1_wakeup(wakeupPins, ESP_EXT1_WAKEUP_ANY_HIGH);
+}
+
+bool Gpio::IsWakeupSource(void) {
+    switch(esp_sleep_get_wakeup_cause()) {
+        case ESP_SLEEP_WAKEUP_EXT0: return ext0Pin == pin;
+        case ESP_SLEEP_WAKEUP_EXT1: return esp_sleep_get_ext1_wakeup_status() & BIT64(pin);
+        default: return false;
+    }
+}
@@ -11,12 +11,50 @@
 
 #include "driver/gpio.h"
 
+extern "C" {
+    #include "freertos/FreeRTOS.h"
+    #include "freertos/task.h"
+} // extern C close
 
 class Gpio {
+public:
+    /**
+     * Interrupt handler. Runs in interrupt context: keep it short, place it in IRAM (IRAM_ATTR)
+     * and use only FromISR calls.
+     */
+    typedef void (*Isr)(void *arg);
+
+    // Interrupt counters of a pin. Latency is from the ISR to the task which handled it
+    struct Stats {
+        uint32_t interrupts;
+        uint32_t handled;
+        uint32_t maxLatencyUs;
+        uint64_t totalLatencyUs;
+    };
+
 private:
     gpio_num_t pin;
     bool state;
     //   GPIO_TypeDef *port;
+    int pull;               // Pull, kept for RTC domain
+
+    // Written by the ISR
+    struct Interrupt {
+        Isr isr;                // Handler of the user, nullptr if deferred to task
+        void *arg;
+        TaskHandle_t task;      // Deferred: notified with bits (eSetBits)
+        uint32_t bits;
+        volatile int64_t lastUs;
+        Stats stats;
+    } interrupt;
+
+    // Pins with an interrupt, for LogStats
+    static Gpio *withInterrupt[GPIO_NUM_MAX];
+    // EXT1 wake sources
+    static uint64_t wakeupPins;
+    static int ext0Pin;
+
+    static void handler(void *arg);
 
 public:
     enum Mode {
@@ -31,6 +69,18 @@ public:
         PULLDOWN,
     };
 
+    enum Trigger {
+        RISING = GPIO_INTR_POSEDGE,
+        FALLING = GPIO_INTR_NEGEDGE,
+        ANY = GPIO_INTR_ANYEDGE,
+        LOW_LEVEL = GPIO_INTR_LOW_LEVEL,
+        HIGH_LEVEL = GPIO_INTR_HIGH_LEVEL
+    };
+
+private:
+    esp_err_t attach(Trigger trigger);
+
+public:
     /**
      * Gpio class constructor. Instantize if want to initialize GPIO pin.
      *
@@ -42,6 +92,10 @@ public:
     Gpio(int _pin, Mode = INPUT, bool initState = 0, Pull = NO_PULL);
 
     Gpio() = delete;
+    Gpio(const Gpio& copy) = delete;
+
+    // Interrupt of the pin is removed
+    ~Gpio();
 
     // Sets pin value to '1'
     void Set(void);
@@ -63,4 +117,65 @@ public:
     bool Read(void);
 
     uint32_t GetPinNumber(void);
+
+    /**
+     * Call isr on each edge of the pin. GPIO ISR service is installed at the first use,
+     * it is shared by all pins. Level triggers would keep interrupting, use
+     * EnableDeferredInterrupt for them.
+     *
+     * @param trigger which edge triggers the interrupt
+     * @param isr handler, see Isr
+     * @param arg passed to isr
+     * @retval ESP_OK or error of gpio driver
+     */
+    esp_err_t EnableInterrupt(Trigger trigger, Isr isr, void *arg);
+
+    /**
+     * Interrupt handled by a task. ISR masks the pin and notifies task with bits (eSetBits),
+     * nothing else. Task calls Acknowledge, pin interrupts again after it. A level which still
+     * holds then interrupts at once.
+     *
+     * @param trigger edge or level
+     * @param task to notify, usually the calling one
+     * @param bits notification bits of this pin
+     * @retval ESP_OK or error of gpio driver
+     */
+    esp_err_t EnableDeferredInterrupt(Trigger trigger, TaskHandle_t task, uint32_t bits);
+
+    /**
+     * In the notified task. Waits until the level holds for debounceMs (each change starts
+     * the wait again) and unmasks the interrupt.
+     *
+     * @param debounceMs 0 takes the level as it is
+     * @retval Level after bouncing
+     */
+    bool Acknowledge(uint32_t debounceMs = 0);
+
+    /**
+     * Record latency of an interrupt handled by EnableInterrupt isr and the task it woke.
+     * Call in the task. Acknowledge does it for deferred ones.
+     */
+    void Handled(void);
+
+    void DisableInterrupt(void);
+
+    Stats GetStats(void) const { return interrupt.stats; }
+
+    /**
+     * Log counters of each pin with an interrupt. Before sleep
+     */
+    static void LogStats(void);
+
+    /**
+     * Wake the chip from deep sleep at given level. Pin must be an RTC GPIO, its pull is kept
+     * by the RTC domain. High: any of such pins wakes the chip (EXT1). Low: one pin only (EXT0).
+     *
+     * @retval ESP_OK, ESP_ERR_INVALID_ARG if not an RTC GPIO
+     */
+    esp_err_t EnableWakeup(bool level);
+
+    /**
+     * @retval Pin was (one of) the wake source(s) of this boot
+     */
+    bool IsWakeupSource(void);
 };
\ No newline at end of file
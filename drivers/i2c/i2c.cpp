@@ -9,10 +9,22 @@
 
 #include "i2c.hpp"
 
+extern "C" {
+    #include "esp_log.h"
+    #include "esp_rom_sys.h"
+} // extern C close
+
 #define I2C_MASTER_FREQ_HZ 400000
+// Recovery clock, standard mode is understood by every slave
+#define I2C_RECOVERY_HALF_PERIOD_US 5
+
+uint32_t I2C::transactions = 0;
+uint32_t I2C::recoveries = 0;
 
-I2C::I2C(gpio_num_t scl, gpio_num_t sda, i2c_port_t port) {
+I2C::I2C(gpio_num_t scl, gpio_num_t sda, i2c_port_t port, uint32_t timeout_ms) {
      this -> port = port;
+    // At least one tick, 0 would not wait for the transaction at all
+    timeout = timeout_ms / portTICK_PERIOD_MS > 0 ? timeout_ms / portTICK_PERIOD_MS : 1;
     conf.mode = I2C_MODE_MASTER;
     conf.sda_io_num = sda;
     conf.sda_pullup_en = GPIO_PULLUP_ENABLE;
@@ -28,67 +40,90 @@ I2C::~I2C() {
     i2c_driver_delete(port);
 }
 
-bool I2C::slave_write(uint8_t slave_addr,uint8_t reg_addr, uint8_t data) {
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, slave_addr << 1, 1);
-    i2c_master_write_byte(cmd, reg_addr, 1);
-    i2c_master_write_byte(cmd, data, 1);
-    i2c_master_stop(cmd);
-    int ret = i2c_master_cmd_begin(port, cmd, 1000 / portTICK_PERIOD_MS);
-    i2c_cmd_link_delete(cmd);
-    if (ret == ESP_FAIL) {
-        return false;
+esp_err_t I2C::execute(i2c_cmd_handle_t cmd) {
+    transactions++;
+    esp_err_t ret = i2c_master_cmd_begin(port, cmd, timeout);
+    i2c_cmd_link_delete_static(cmd);
+    if(ret != ESP_OK) {
+        ESP_LOGW(__FILE__, "%s:%d. Transaction failed: %s", __func__ ,__LINE__, esp_err_to_name(ret));
     }
-    return true;
+    return ret;
 }
 
-bool I2C::slave_read(uint8_t slave_addr, uint8_t data, uint8_t *buf, uint32_t len) {
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, slave_addr << 1, 1);
-    i2c_master_write_byte(cmd, data, 1);
-    i2c_master_stop(cmd);
-    int ret = i2c_master_cmd_begin(port, cmd, 1000 / portTICK_PERIOD_MS);
-    i2c_cmd_link_delete(cmd);
-    if (ret == ESP_FAIL) {
-        return false;
+esp_err_t I2C::write(uint8_t slave_addr, uint8_t reg_addr, const uint8_t *data, size_t len) {
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create_static(cmdBuffer, sizeof(cmdBuffer));
+    if(cmd == NULL) {
+        return ESP_ERR_NO_MEM;
     }
-
-    cmd = i2c_cmd_link_create();
+    const uint8_t header[] = {(uint8_t) (slave_addr << 1 | I2C_MASTER_WRITE), reg_addr};
+    // Links keep pointers to the data, it must live until the transaction ends
     i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, slave_addr << 1 | 1, 1);
-    while(len) {
-        i2c_master_read_byte(cmd, buf,(i2c_ack_type_t)(len == 1));
-        buf++;
-        len--;
+    i2c_master_write(cmd, header, sizeof(header), true);
+    if(len) {
+        i2c_master_write(cmd, data, len, true);
     }
     i2c_master_stop(cmd);
-    ret = i2c_master_cmd_begin(port, cmd, 1000 / portTICK_PERIOD_MS);
-    i2c_cmd_link_delete(cmd);
-    if (ret == ESP_FAIL) {
-        return false;
-    }
-
-    return true;
+    return execute(cmd);
 }
 
-uint8_t I2C::slave_read_byte(uint8_t slave_addr, uint8_t reg) {
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+esp_err_t I2C::read(uint8_t slave_addr, uint8_t reg_addr, uint8_t *buf, size_t len) {
+    if(len == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create_static(cmdBuffer, sizeof(cmdBuffer));
+    if(cmd == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    const uint8_t header[] = {(uint8_t) (slave_addr << 1 | I2C_MASTER_WRITE), reg_addr};
     i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, slave_addr << 1, 1);
-    i2c_master_write_byte(cmd, reg, 1);
-    i2c_master_stop(cmd);
-    i2c_master_cmd_begin(port, cmd, 1000 / portTICK_PERIOD_MS);
-    i2c_cmd_link_delete(cmd);
-
-    uint8_t buf;
-    cmd = i2c_cmd_link_create();
+    i2c_master_write(cmd, header, sizeof(header), true);
+    // Repeated start, bus is not released between setting the register and reading it
     i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, slave_addr << 1 | 1, 1);
-    i2c_master_read_byte(cmd, &buf, (i2c_ack_type_t)1);
+    i2c_master_write_byte(cmd, slave_addr << 1 | I2C_MASTER_READ, true);
+    i2c_master_read(cmd, buf, len, I2C_MASTER_LAST_NACK);
     i2c_master_stop(cmd);
-    i2c_master_cmd_begin(port, cmd, 1000 / portTICK_PERIOD_MS);
-    i2c_cmd_link_delete(cmd);
-    return buf;
+    return execute(cmd);
+}
+
+esp_err_t I2C::recover() {
+    recoveries++;
+    i2c_driver_delete(port);
+
+    const gpio_num_t scl = (gpio_num_t) conf.scl_io_num;
+    const gpio_num_t sda = (gpio_num_t) conf.sda_io_num;
+    gpio_config_t lines = {};
+    lines.pin_bit_mask = BIT64(scl) | BIT64(sda);
+    // Open drain, a line is only pulled low or released. Level of SDA is still readable
+    lines.mode = GPIO_MODE_INPUT_OUTPUT_OD;
+    lines.pull_up_en = GPIO_PULLUP_ENABLE;
+    gpio_config(&lines);
+    gpio_set_level(sda, 1);
+    gpio_set_level(scl, 1);
+    esp_rom_delay_us(I2C_RECOVERY_HALF_PERIOD_US);
+
+    // Slave finishes the byte it is sending and sees NACK when SDA is high at the 9th clock
+    for(int i = 0; i < recovery_clocks && gpio_get_level(sda) == 0; i++) {
+        gpio_set_level(scl, 0);
+        esp_rom_delay_us(I2C_RECOVERY_HALF_PERIOD_US);
+        gpio_set_level(scl, 1);
+        esp_rom_delay_us(I2C_RECOVERY_HALF_PERIOD_US);
+    }
+    // STOP: SDA rises while SCL is high
+    gpio_set_level(scl, 0);
+    gpio_set_level(sda, 0);
+    esp_rom_delay_us(I2C_RECOVERY_HALF_PERIOD_US);
+    gpio_set_level(scl, 1);
+    esp_rom_delay_us(I2C_RECOVERY_HALF_PERIOD_US);
+    gpio_set_level(sda, 1);
+    esp_rom_delay_us(I2C_RECOVERY_HALF_PERIOD_US);
+    const bool released = gpio_get_level(sda) != 0;
+
+    i2c_param_config(port, &conf);
+    i2c_driver_install(port, conf.mode, 0, 0, 0);
+    if(!released) {
+        ESP_LOGE(__FILE__, "%s:%d. SDA held low after %d clocks", __func__ ,__LINE__, recovery_clocks);
+        return ESP_FAIL;
+    }
+    ESP_LOGW(__FILE__, "%s:%d. Bus recovered", __func__ ,__LINE__);
+    return ESP_OK;
 }
@@ -15,12 +15,61 @@
 
 class I2C {
 private:
+    // Register write, repeated start, read: start, 2 writes, start, write, read, stop
+    static constexpr size_t cmdBufferSize = I2C_LINK_RECOMMENDED_SIZE(2);
+
     i2c_config_t conf;
     i2c_port_t port;
+    TickType_t timeout;
+    // Command link of every transaction of this instance. No heap use per transaction.
+    // One transaction at a time - instance is not shared between tasks
+    alignas(8) uint8_t cmdBuffer[cmdBufferSize];
+    // Bus transactions of all instances since boot
+    static uint32_t transactions;
+    // Bus recoveries of all instances since boot
+    static uint32_t recoveries;
+
+    esp_err_t execute(i2c_cmd_handle_t cmd);
+
 public:
-    I2C(gpio_num_t scl, gpio_num_t sda, i2c_port_t port);
+    // Clock pulses which free any slave stuck in the middle of a byte
+    static constexpr int recovery_clocks = 9;
+
+    /**
+     * @param timeout_ms bound of one transaction, ESP_ERR_TIMEOUT after it
+     */
+    I2C(gpio_num_t scl, gpio_num_t sda, i2c_port_t port, uint32_t timeout_ms = 1000);
     ~I2C();
-    bool slave_write(uint8_t slave_addr,uint8_t reg_addr, uint8_t data);
-    bool slave_read(uint8_t slave_addr, uint8_t data, uint8_t *buf, uint32_t len);
-    uint8_t slave_read_byte(uint8_t slave_addr, uint8_t reg);
+
+    /**
+     * @brief Free the bus after a slave holds SDA low (reset in the middle of a read, glitch).
+     *      Driver is removed, SCL is clocked by hand until SDA is released, STOP is generated
+     *      and the driver is installed again.
+     * @return ESP_OK if SDA is high afterwards, ESP_FAIL if it is still held
+     */
+    esp_err_t recover();
+
+    /**
+     * @brief Write consecutive registers in one transaction (slave auto increments register address).
+     * @return ESP_OK, ESP_FAIL (no acknowledge), ESP_ERR_TIMEOUT, ESP_ERR_INVALID_STATE
+     */
+    esp_err_t write(uint8_t slave_addr, uint8_t reg_addr, const uint8_t *data, size_t len);
+
+    /**
+     * @brief Read consecutive registers in one transaction: register address, repeated start, read.
+     * @return ESP_OK, ESP_FAIL (no acknowledge), ESP_ERR_TIMEOUT, ESP_ERR_INVALID_STATE
+     */
+    esp_err_t read(uint8_t slave_addr, uint8_t reg_addr, uint8_t *buf, size_t len);
+
+    esp_err_t slave_write(uint8_t slave_addr, uint8_t reg_addr, uint8_t data) {
+        return write(slave_addr, reg_addr, &data, 1);
+    }
+    esp_err_t slave_read(uint8_t slave_addr, uint8_t reg_addr, uint8_t *buf, uint32_t len) {
+        return read(slave_addr, reg_addr, buf, len);
+    }
+    esp_err_t slave_read_byte(uint8_t slave_addr, uint8_t reg, uint8_t& out) {
+        return read(slave_addr, reg, &out, 1);
+    }
+    static uint32_t transaction_count() { return transactions; }
+    static uint32_t recovery_count() { return recoveries; }
 };
@@ -0,0 +1,189 @@
+/**
+ * @file i2cBus.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#include "i2cBus.hpp"
+#include <algorithm>
+#include <new>
+
+extern "C" {
+    #include "esp_log.h"
+} // extern C close
+
+// Odr-used by std::min, C++14 needs the definition
+constexpr uint32_t I2cBus::maxTimeoutMs;
+
+namespace {
+
+uint32_t boundedTimeout(uint32_t timeoutMs) {
+    return std::min(std::max(timeoutMs, (uint32_t) 1), I2cBus::maxTimeoutMs);
+}
+
+} // namespace end --------------------
+
+I2cBus& I2cBus::Open(const Config& config) {
+    // No heap, bus lives until reset
+    alignas(I2cBus) static uint8_t memory[I2C_NUM_MAX][sizeof(I2cBus)];
+    static I2cBus *buses[I2C_NUM_MAX];
+
+    auto& bus = buses[config.port];
+    if(bus == nullptr) {
+        bus = new(memory[config.port]) I2cBus(config);
+    }
+    return *bus;
+}
+
+I2cBus::I2cBus(const Config& config) : i2c(config.scl, config.sda, config.port, boundedTimeout(config.timeoutMs)) {
+    const uint32_t timeoutMs = boundedTimeout(config.timeoutMs);
+    // Try, recovery, try again. For own transaction and each one queued before it
+    const uint32_t boundMs = (queueDepth + 1) * (2 * timeoutMs + recoveryMs);
+    waitBound = boundMs / portTICK_PERIOD_MS + 1;
+
+    queue = xQueueCreateStatic(queueDepth, sizeof(Transaction *), storage, &control);
+    configASSERT(queue);
+    auto res = xTaskCreate(busTask, "I2cBusTask", taskStackDepth, this, taskPriority, NULL);
+    configASSERT(res);
+}
+
+void I2cBus::busTask(void *pvParameters) {
+    auto& bus = *(I2cBus *) pvParameters;
+    Transaction *transaction;
+
+    for(;;) {
+        if(xQueueReceive(bus.queue, &transaction, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        esp_err_t ret = bus.execute(*transaction);
+        // Timeout: a slave holds SDA or the controller is stuck. NACK (ESP_FAIL) is not a bus problem
+        if(ret == ESP_ERR_TIMEOUT || ret == ESP_ERR_INVALID_STATE) {
+            if(bus.i2c.recover() == ESP_OK) {
+                ret = bus.execute(*transaction);
+            }
+        }
+        complete(*transaction, ret);
+    }
+}
+
+esp_err_t I2cBus::execute(const Transaction& transaction) {
+    if(transaction.type == Transaction::READ) {
+        return i2c.read(transaction.address, transaction.reg, transaction.data, transaction.len);
+    }
+    return i2c.write(transaction.address, transaction.reg, transaction.data, transaction.len);
+}
+
+void I2cBus::complete(Transaction& transaction, esp_err_t result) {
+    // Owner may reuse the transaction as soon as it is done, copy what is needed first
+    const auto callback = transaction.callback;
+    const auto context = transaction.context;
+    const auto task = transaction.task;
+    const auto bits = transaction.notifyBits;
+
+    transaction.result = result;
+    transaction.done = true;
+    if(callback != nullptr) {
+        callback(result, context);
+    }
+    if(task != nullptr) {
+        xTaskNotify(task, bits, eSetBits);
+    }
+}
+
+esp_err_t I2cBus::Submit(Transaction& transaction) {
+    transaction.done = false;
+    Transaction *pointer = &transaction;
+    if(xQueueSend(queue, &pointer, waitBound) != pdTRUE) {
+        ESP_LOGE(__FILE__, "%s:%d. Bus queue full", __func__ ,__LINE__);
+        transaction.result = ESP_ERR_TIMEOUT;
+        transaction.done = true;
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+}
+
+esp_err_t I2cBus::Wait(Transaction& transaction, TickType_t ticks) {
+    const TickType_t start = xTaskGetTickCount();
+    uint32_t others = 0;
+    // Notification may belong to another transaction of this task, done flag decides
+    while(!transaction.done) {
+        const TickType_t elapsed = xTaskGetTickCount() - start;
+        if(elapsed >= ticks) {
+            break;
+        }
+        uint32_t value = 0;
+        xTaskNotifyWait(0, transaction.notifyBits, &value, ticks - elapsed);
+        others |= value & ~transaction.notifyBits;
+    }
+    if(transaction.done) {
+        // Done before the wait or between its wakes, the bits are still pending. Take them,
+        // they would wake the next wait of this task
+        uint32_t value = 0;
+        if(xTaskNotifyWait(0, transaction.notifyBits, &value, 0) == pdTRUE) {
+            others |= value & ~transaction.notifyBits;
+        }
+    }
+    if(others) {
+        // Events of the task itself were taken with this wait. Bits are kept, mark them pending again
+        xTaskNotify(xTaskGetCurrentTaskHandle(), 0, eSetBits);
+    }
+    return transaction.done ? transaction.result : ESP_ERR_TIMEOUT;
+}
+
+esp_err_t I2cDevice::transfer(I2cBus::Transaction& transaction) {
+    transaction.callback = nullptr;
+    transaction.context = nullptr;
+    transaction.task = xTaskGetCurrentTaskHandle();
+    transaction.notifyBits = I2cBus::syncBit;
+
+    auto ret = bus.Submit(transaction);
+    if(ret != ESP_OK) {
+        return ret;
+    }
+    ret = Wait(transaction);
+    // Transaction is on the stack, bus task must be done with it before returning
+    while(ret == ESP_ERR_TIMEOUT && !transaction.done) {
+        ESP_LOGE(__FILE__, "%s:%d. Bus task did not finish in %u ticks", __func__ ,__LINE__,
+                    (unsigned int) bus.GetWaitBound());
+        ret = Wait(transaction);
+    }
+    return ret;
+}
+
+esp_err_t I2cDevice::Write(uint8_t reg, const uint8_t *data, size_t len) {
+    I2cBus::Transaction transaction = {};
+    transaction.type = I2cBus::Transaction::WRITE;
+    transaction.address = address;
+    transaction.reg = reg;
+    // Only read from by the bus
+    transaction.data = const_cast<uint8_t *>(data);
+    transaction.len = len;
+    return transfer(transaction);
+}
+
+esp_err_t I2cDevice::Read(uint8_t reg, uint8_t *buf, size_t len) {
+    I2cBus::Transaction transaction = {};
+    transaction.type = I2cBus::Transaction::READ;
+    transaction.address = address;
+    transaction.reg = reg;
+    transaction.data = buf;
+    transaction.len = len;
+    return transfer(transaction);
+}
+
+esp_err_t I2cDevice::StartRead(I2cBus::Transaction& transaction, uint8_t reg, uint8_t *buf, size_t len,
+                                uint32_t notifyBits) {
+    transaction.type = I2cBus::Transaction::READ;
+    transaction.address = address;
+    transaction.reg = reg;
+    transaction.data = buf;
+    transaction.len = len;
+    transaction.callback = nullptr;
+    transaction.context = nullptr;
+    transaction.task = xTaskGetCurrentTaskHandle();
+    transaction.notifyBits = notifyBits;
+    return bus.Submit(transaction);
+}
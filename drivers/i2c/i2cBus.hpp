@@ -0,0 +1,154 @@
+/**
+ * @file i2cBus.hpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+#include "i2c.hpp"
+
+extern "C" {
+    #include "freertos/FreeRTOS.h"
+    #include "freertos/queue.h"
+    #include "freertos/task.h"
+} // extern C close
+
+/**
+ * @brief Shared I2C bus. Devices queue transactions, one bus task runs them in order and
+ *      completes each with a callback and/or task notification. Caller is free to do other
+ *      work in the meantime. A transaction which times out resets the bus (stuck SDA) and is
+ *      tried once more.
+ */
+class I2cBus {
+public:
+    struct Config {
+        gpio_num_t scl;
+        gpio_num_t sda;
+        i2c_port_t port;
+        uint32_t timeoutMs;     // One transaction on the wire, 1 .. maxTimeoutMs
+    };
+
+    /**
+     * @brief Called from the bus task when transaction is done. Keep it short
+     */
+    typedef void (*Callback)(esp_err_t result, void *context);
+
+    /**
+     * @brief Register read or write. Owned by the caller, it and its data must live until done.
+     */
+    struct Transaction {
+        enum Type : uint8_t {
+            READ,
+            WRITE
+        };
+        Type type;
+        uint8_t address;
+        uint8_t reg;
+        uint8_t *data;          // Read into, or written from
+        size_t len;
+
+        Callback callback;      // Optional
+        void *context;
+        TaskHandle_t task;      // Optional, notified with notifyBits set (eSetBits)
+        uint32_t notifyBits;
+
+        volatile bool done;
+        esp_err_t result;       // Valid when done
+    };
+
+    static constexpr uint32_t maxTimeoutMs = 1000;
+    static constexpr UBaseType_t queueDepth = 4;
+    // Notification bit of blocking helpers. Others are free for the tasks
+    static constexpr uint32_t syncBit = 1UL << 31;
+
+    /**
+     * @brief Bus of the port, started at the first call. Later calls return the same bus.
+     *      Not thread safe, open buses before tasks share them.
+     */
+    static I2cBus& Open(const Config& config);
+
+    I2cBus(const I2cBus& copy) = delete;
+
+    /**
+     * @brief Queue transaction. Waits for a free slot at most GetWaitBound().
+     * @return ESP_OK if queued. Otherwise transaction is done with the same error
+     */
+    esp_err_t Submit(Transaction& transaction);
+
+    /**
+     * @brief Block calling task until transaction, which notifies it, is done.
+     *      Bits of the transaction are taken even if it was done before, other bits of the task stay pending.
+     * @return Result of transaction, ESP_ERR_TIMEOUT if it is still pending after ticks
+     */
+    esp_err_t Wait(Transaction& transaction, TickType_t ticks);
+
+    /**
+     * @return Longest time from Submit to done: full queue ahead, each transaction
+     *      timing out, resetting the bus and timing out again
+     */
+    TickType_t GetWaitBound() const { return waitBound; }
+
+private:
+    // Bus recovery: 9 clocks, STOP and driver reinstall
+    static constexpr uint32_t recoveryMs = 2;
+    static constexpr uint32_t taskStackDepth = 3 * 1024;
+    static constexpr UBaseType_t taskPriority = 4;
+
+    I2C i2c;
+    TickType_t waitBound;
+    StaticQueue_t control;
+    uint8_t storage[queueDepth * sizeof(Transaction *)];
+    QueueHandle_t queue;
+
+    explicit I2cBus(const Config& config);
+
+    static void busTask(void *pvParameters);
+    esp_err_t execute(const Transaction& transaction);
+    static void complete(Transaction& transaction, esp_err_t result);
+};
+
+/**
+ * @brief Slave on a shared bus.
+ */
+class I2cDevice {
+private:
+    I2cBus& bus;
+    uint8_t address;
+
+    esp_err_t transfer(I2cBus::Transaction& transaction);
+
+public:
+    I2cDevice(I2cBus& bus, uint8_t address) : bus(bus), address(address) {}
+
+    /**
+     * @brief Write consecutive registers, block until done.
+     */
+    esp_err_t Write(uint8_t reg, const uint8_t *data, size_t len);
+
+    esp_err_t Write(uint8_t reg, uint8_t value) {
+        return Write(reg, &value, 1);
+    }
+
+    /**
+     * @brief Read consecutive registers, block until done.
+     */
+    esp_err_t Read(uint8_t reg, uint8_t *buf, size_t len);
+
+    /**
+     * @brief Start reading consecutive registers. Calling task is notified with notifyBits,
+     *      finish with Wait.
+     */
+    esp_err_t StartRead(I2cBus::Transaction& transaction, uint8_t reg, uint8_t *buf, size_t len,
+                        uint32_t notifyBits = I2cBus::syncBit);
+
+    /**
+     * @brief Wait for transaction started by this task. Bounded by I2cBus::GetWaitBound
+     */
+    esp_err_t Wait(I2cBus::Transaction& transaction) {
+        return bus.Wait(transaction, bus.GetWaitBound());
+    }
+};
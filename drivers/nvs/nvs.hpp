@@ -80,6 +80,7 @@ public:
     [[nodiscard]] esp_err_t erase(const char* const key) const { 
         auto ret = ESP_OK;
         ret = nvs_erase_key(handle, key);
+        _write_counter()++;
         ret = nvs_commit(handle);
         return ret;
     }
@@ -133,7 +134,16 @@ public:
     [[nodiscard]] esp_err_t verify_buffer(const char* const key, const T* input, const size_t len) const
         { return _verify_buf(handle, key, input, len); }
 
+	/// @brief Number of writes and erases issued by all instances since boot
+	///
+	/// @return write count
+    [[nodiscard]] static uint32_t write_count(void)
+        { return _write_counter(); }
+
 private:
+    static uint32_t& _write_counter(void)
+        { static uint32_t count{0}; return count; }
+
 	/// @brief Open a partition in the NVS API
 	///
 	/// @param[in] partition_name : cstring name of the partition
@@ -266,6 +276,7 @@ private:
         else
         {
             status = nvs_set_blob(handle, key, input, sizeof(T) * len);
+            _write_counter()++;
 
             if (ESP_OK == status)
                 status = nvs_commit(handle);
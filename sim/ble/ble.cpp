@@ -0,0 +1,183 @@
+/**
+ * @file ble.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#include "ble.hpp"
+#include "loopbackTransport.hpp"
+#include "protocol.hpp"
+#include "reconnectTimer.hpp"
+#include "telemetry.hpp"
+#include "bootProfile.hpp"
+#include "powerGovernor.hpp"
+#include "sim.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+
+extern "C" {
+    #include "esp_log.h"
+    #include "esp_timer.h"
+} // extern C close
+
+using namespace BLE;
+
+Ble::ConnectionState Ble::state = Ble::ConnectionState::IDLE;
+
+namespace {
+
+// Phone stops reading after that many empty position frames in a row
+constexpr int emptyReads = 3;
+// Never more reads than positions the tracker can keep, and some
+constexpr int maxReads = 150;
+// Trace and log chunks, more than rings of both cores hold
+constexpr int maxDumpReads = 32;
+// NimBLE default when the tier sets none (BLE_GAP_ADV_FAST_INTERVAL1, 30-60 ms)
+constexpr int64_t defaultAdvertisingUs = 45000;
+
+// Advertising starts of the backend, as Ble takes them
+ReconnectTimer reconnectTimer(esp_timer_get_time);
+
+// Let the air time used by transport pass
+void spend(SIM::LoopbackTransport& transport, uint64_t& airTime) {
+    auto used = transport.GetAirTimeUs() - airTime;
+    airTime = transport.GetAirTimeUs();
+    TaskDelay(std::max(std::chrono::microseconds(used), std::chrono::microseconds(1ms)));
+}
+
+void advertise() {
+    reconnectTimer.OnAdvertise();
+    Ble::state = Ble::ConnectionState::ADVERTISING;
+    TELEMETRY::Telemetry::SetRadio(TELEMETRY::Telemetry::Radio::ADVERTISING);
+}
+
+/**
+ * @brief Phone scans all the time, it connects at the first advertising event it hears.
+ *      Reconnect time is measured as on the chip: advertising start until the link is encrypted.
+ */
+void connect(SIM::LoopbackTransport& transport, uint64_t& airTime) {
+    auto& state = SIM::GetState();
+    const int64_t interval = APP::PowerGovernor::GetPolicy().advertisingInterval * 1000;
+    TaskDelay(std::chrono::microseconds(interval ? interval : defaultAdvertisingUs));
+
+    Ble::state = Ble::ConnectionState::CONNECTED;
+    TELEMETRY::Telemetry::SetRadio(TELEMETRY::Telemetry::Radio::CONNECTED);
+    transport.Connect(state.bonded);
+    spend(transport, airTime);
+
+    std::chrono::microseconds reconnect(0);
+    reconnectTimer.OnLink(reconnect);
+    TELEMETRY::Telemetry::OnReconnect(reconnect);
+    const int64_t reconnectUs = reconnect.count();
+    if(!state.bonded) {
+        state.pairingUs = reconnectUs;
+        state.bonded = true;
+    }
+    else {
+        state.reconnects++;
+        state.reconnectUs += reconnectUs;
+        state.worstReconnectUs = std::max(state.worstReconnectUs, reconnectUs);
+    }
+    APP::Notify(APP::BLE_CONNECTED);
+}
+
+void disconnect(SIM::LoopbackTransport& transport) {
+    transport.Disconnect();
+    Ble::state = Ble::ConnectionState::DISCONNECTED;
+    APP::Notify(APP::BLE_DISCONNECTED);
+    // Advertising again, as NimBLE backend does
+    advertise();
+}
+
+/**
+ * @brief Read chunks of a dump characteristic until the empty frame, append them to a file as hex
+ */
+void dump(SIM::LoopbackTransport& transport, uint64_t& airTime, CharacteristicId id, const std::string& path) {
+    if(path.empty()) {
+        return;
+    }
+    std::ofstream file(path, std::ios::app);
+    for(int i = 0; i < maxDumpReads; i++) {
+        auto frame = transport.ReadLong(id);
+        spend(transport, airTime);
+        if(frame.size() <= PROTOCOL::headerSize) {
+            break;
+        }
+        for(auto byte : frame) {
+            file << "0123456789abcdef"[byte >> 4] << "0123456789abcdef"[byte & 0xf];
+        }
+        file << "\n";
+    }
+}
+
+/**
+ * @brief What the phone app does: sets the time and drains positions.
+ */
+void sync(SIM::LoopbackTransport& transport) {
+    auto& state = SIM::GetState();
+    uint64_t airTime = transport.GetAirTimeUs();
+    connect(transport, airTime);
+
+    // First sync sets the clock from power on, drift is only known after that
+    if(state.syncs) {
+        state.worstClockErrorUs = std::max<int64_t>(state.worstClockErrorUs, std::abs(state.clockErrorUs));
+    }
+    time_t now = SIM::GetWallTime() / 1000000;
+    transport.Write(CharacteristicId::Time, (const uint8_t *) &now, sizeof(now));
+    spend(transport, airTime);
+
+    int empty = 0;
+    for(int i = 0; i < maxReads && empty < emptyReads; i++) {
+        auto frame = transport.Read(CharacteristicId::Position);
+        if(frame.size() > PROTOCOL::headerSize) {
+            state.positionsReceived++;
+            empty = 0;
+        }
+        else {
+            empty++;
+        }
+        transport.Update();
+        spend(transport, airTime);
+    }
+
+    // Developer build of the phone app collects the trace and the log, see tools/trace.py
+    // and tools/binaryLog.py
+    dump(transport, airTime, CharacteristicId::Trace, SIM::GetOptions().traceFile);
+    dump(transport, airTime, CharacteristicId::BinaryLog, SIM::GetOptions().binaryLogFile);
+
+    disconnect(transport);
+    state.syncs++;
+    state.nextSync = SIM::GetScenario().GetSyncs(SIM::Now());
+    ESP_LOGI(__FILE__, "%s:%d. Phone synced, %u positions so far", __func__ ,__LINE__,
+                (unsigned int) state.positionsReceived);
+}
+
+} // namespace end --------------------
+
+void BLEDevice::deinit() {
+    Ble::state = Ble::ConnectionState::IDLE;
+    TELEMETRY::Telemetry::SetRadio(TELEMETRY::Telemetry::Radio::OFF);
+}
+
+void BLE::BleTask(void *pvParameters) {
+    ESP_LOGI(__FILE__, "%s:%d. Task init", __func__ ,__LINE__);
+
+    SIM::LoopbackTransport transport;
+    TELEMETRY::BootProfile::Mark(TELEMETRY::BootProfile::Marker::BleInit);
+
+    advertise();
+    TELEMETRY::BootProfile::Mark(TELEMETRY::BootProfile::Marker::Advertising);
+
+    for(;;) {
+        // Phone connects when it wants data and hears advertising
+        auto& state = SIM::GetState();
+        if(Ble::state == Ble::ConnectionState::ADVERTISING && SIM::GetScenario().GetSyncs(SIM::Now()) > state.nextSync) {
+            sync(transport);
+        }
+        TaskDelay(100ms);
+    }
+}
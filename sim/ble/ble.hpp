@@ -0,0 +1,39 @@
+/**
+ * @file ble.hpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+// Host version of app/ble/ble.hpp. No NimBLE, the phone of the scenario talks to
+// BLE::Services through SIM::LoopbackTransport.
+
+#include "dateTime.hpp"
+#include "transport.hpp"
+#include "services.hpp"
+#include "appEvents.hpp"
+
+// Part of NimBLEDevice used by application management
+class BLEDevice {
+public:
+    static void deinit();
+};
+
+namespace BLE {
+
+/**
+ * @brief BLE task/thread. Advertises and serves phone syncs of the scenario.
+ */
+void BleTask(void *pvParameters);
+
+class Ble {
+public:
+    enum class ConnectionState { IDLE, ADVERTISING, CONNECTED, DISCONNECTED };
+    static ConnectionState state;
+};
+
+} // namespace BLE end --------------------
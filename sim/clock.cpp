@@ -0,0 +1,146 @@
+/**
+ * @file clock.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+// Simulated time. While awake it runs Options::speed times faster than real time,
+// deep sleep skips it (see deepSleep.cpp).
+// Application reads time with esp_timer, time(), gettimeofday() and std::chrono::system_clock.
+// The C library calls are replaced here, so the application keeps its own code.
+
+#include "sim.hpp"
+#include <algorithm>
+#include <atomic>
+
+extern "C" {
+    #include <sys/syscall.h>
+    #include <sys/time.h>
+    #include <time.h>
+    #include <unistd.h>
+    #include "esp_cpu.h"
+    #include "esp_timer.h"
+    #include "sdkconfig.h"
+} // extern C close
+
+namespace {
+
+// Shortest tick of accelerated scheduler. Signals can't be delivered much faster
+constexpr int64_t minTickUs = 50;
+
+// Real time at process start (= application start of simulated boot)
+int64_t realStartUs;
+
+// Host tests move time by hand
+std::atomic<bool> frozen(false);
+std::atomic<int64_t> frozenUs(0);
+
+// Not clock_gettime(), it is replaced below
+int64_t realMonotonicUs() {
+    timespec ts;
+    syscall(SYS_clock_gettime, CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+__attribute__((constructor(101))) void startClock() {
+    realStartUs = realMonotonicUs();
+}
+
+// System time of the device, runs from power on until phone sets it
+int64_t deviceTimeUs() {
+    return SIM::GetWallTime() + SIM::GetState().clockErrorUs;
+}
+
+void scale(timeval& tv) {
+    int64_t us = (int64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+    if(us == 0) {
+        // Disarms the timer
+        return;
+    }
+    us = std::max<int64_t>(us / SIM::GetOptions().speed, minTickUs);
+    tv.tv_sec = us / 1000000;
+    tv.tv_usec = us % 1000000;
+}
+
+} // namespace end --------------------
+
+int64_t SIM::Now() {
+    if(frozen) {
+        return frozenUs;
+    }
+    return GetState().bootUs + (int64_t) ((realMonotonicUs() - realStartUs) * GetOptions().speed);
+}
+
+void SIM::FreezeTime() {
+    frozenUs = Now();
+    frozen = true;
+}
+
+void SIM::AdvanceTime(int64_t us) {
+    frozenUs += us;
+}
+
+int64_t SIM::GetWallTime() {
+    return epochStartUs + Now();
+}
+
+int64_t SIM::GetEnd() {
+    return (int64_t) (GetOptions().days * 24 * 3600 * 1000000);
+}
+
+int64_t esp_timer_get_time(void) {
+    return SIM::Now() - SIM::GetState().bootUs;
+}
+
+uint32_t esp_cpu_get_cycle_count(void) {
+    // Counter runs from the start of the boot, wraps as the 32 bit one
+    return (uint32_t) (esp_timer_get_time() * CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+}
+
+// C library ---------------------------------------------------------------------
+
+extern "C" int clock_gettime(clockid_t clock, struct timespec *tp) noexcept {
+    if(clock != CLOCK_REALTIME && clock != CLOCK_REALTIME_COARSE) {
+        return syscall(SYS_clock_gettime, clock, tp);
+    }
+    int64_t us = deviceTimeUs();
+    tp->tv_sec = us / 1000000;
+    tp->tv_nsec = (us % 1000000) * 1000;
+    return 0;
+}
+
+extern "C" int gettimeofday(struct timeval *tv, void *tz) noexcept {
+    int64_t us = deviceTimeUs();
+    tv->tv_sec = us / 1000000;
+    tv->tv_usec = us % 1000000;
+    return 0;
+}
+
+extern "C" int settimeofday(const struct timeval *tv, const struct timezone *tz) noexcept {
+    if(tv != nullptr) {
+        int64_t us = (int64_t) tv->tv_sec * 1000000 + tv->tv_usec;
+        SIM::GetState().clockErrorUs = us - SIM::GetWallTime();
+    }
+    return 0;
+}
+
+extern "C" time_t time(time_t *out) noexcept {
+    time_t now = deviceTimeUs() / 1000000;
+    if(out != nullptr) {
+        *out = now;
+    }
+    return now;
+}
+
+// POSIX port of FreeRTOS drives the tick with an interval timer. Shorter interval, faster tick
+extern "C" int setitimer(int which, const struct itimerval *value, struct itimerval *old) noexcept {
+    itimerval scaled = *value;
+    if(which == ITIMER_REAL) {
+        scale(scaled.it_interval);
+        scale(scaled.it_value);
+    }
+    return syscall(SYS_setitimer, which, &scaled, old);
+}
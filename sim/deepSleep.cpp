@@ -0,0 +1,214 @@
+/**
+ * @file deepSleep.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+// Deep sleep is a reset: the process saves RTC memory (RTC_DATA_ATTR, see esp_attr.h) and
+// simulation state to a file and starts itself again. The new process restores them before
+// any constructor runs, the rest of memory starts clean - as on the chip.
+// Wakes handled by the wake stub don't restart the process, they only advance the time.
+
+#include "sim.hpp"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+extern "C" {
+    #include <pthread.h>
+    #include <signal.h>
+    #include <stdio.h>
+    #include <stdlib.h>
+    #include <sys/syscall.h>
+    #include <sys/time.h>
+    #include <unistd.h>
+    #include "esp_sleep.h"
+    #include "esp_system.h"
+    #include "driver/rtc_io.h"
+    #include "freertos/FreeRTOS.h"
+    #include "freertos/task.h"
+} // extern C close
+
+// Start and end of RTC memory section, defined by the linker
+extern "C" char __start_rtc_data[];
+extern "C" char __stop_rtc_data[];
+
+namespace {
+
+// Set for the restarted process, names the image to restore
+const char * const imageVariable = "SIM_RTC_IMAGE";
+constexpr uint32_t imageMagic = 0x43545253;
+
+struct ImageHeader {
+    uint32_t magic;
+    uint32_t rtcSize;
+    SIM::State state;
+};
+
+SIM::State state;
+bool powerOn = true;
+
+double toMah(int64_t us, float ma) {
+    return us * (double) ma / 3.6e9;
+}
+
+// Before constructors of the application. Constructors of RTC_DATA_ATTR objects run
+// after restore, the same as they do after each wake on the chip
+__attribute__((constructor(101))) void restore() {
+    const char *path = getenv(imageVariable);
+    if(path == nullptr) {
+        return;
+    }
+    std::ifstream image(path, std::ios::binary);
+    ImageHeader header;
+    if(!image.read((char *) &header, sizeof(header)) || header.magic != imageMagic ||
+            header.rtcSize != SIM::GetRtcSize()) {
+        fprintf(stderr, "RTC image %s not valid, power on\n", path);
+        return;
+    }
+    if(!image.read(__start_rtc_data, header.rtcSize)) {
+        fprintf(stderr, "RTC image %s truncated, power on\n", path);
+        return;
+    }
+    state = header.state;
+    powerOn = false;
+}
+
+std::vector<std::string> arguments() {
+    std::ifstream cmdline("/proc/self/cmdline", std::ios::binary);
+    std::vector<std::string> args;
+    std::string arg;
+    while(std::getline(cmdline, arg, '\0')) {
+        args.push_back(arg);
+    }
+    return args;
+}
+
+// RTC slow clock runs while asleep, with its error
+void asleep(int64_t from, int64_t to) {
+    // Accelerometer stays in the power mode it was left in
+    state.chargeMah += toMah(to - from, SIM::sleepCurrentMa + state.mpu.GetCurrentMa());
+    state.clockErrorUs += (int64_t) ((to - from) * (double) SIM::GetOptions().driftPpm / 1e6);
+}
+
+[[noreturn]] void reset(int64_t wakeUs, esp_sleep_wakeup_cause_t cause) {
+    state.wakeUs = wakeUs;
+    state.bootUs = wakeUs + SIM::bootDelayUs;
+    state.cause = cause;
+    state.chargeMah += toMah(SIM::bootDelayUs, SIM::activeCurrentMa);
+
+    const auto& path = SIM::GetOptions().rtcImage;
+    std::ofstream image(path, std::ios::binary | std::ios::trunc);
+    ImageHeader header = {imageMagic, (uint32_t) SIM::GetRtcSize(), state};
+    image.write((const char *) &header, sizeof(header));
+    image.write(__start_rtc_data, header.rtcSize);
+    image.close();
+    if(!image) {
+        fprintf(stderr, "Could not write RTC image %s\n", path.c_str());
+        abort();
+    }
+    setenv(imageVariable, path.c_str(), 1);
+    fflush(stdout);
+    fflush(stderr);
+
+    // Interval timer, ignored and blocked signals survive exec. Scheduler of the new process
+    // sets them up again, nothing must arrive before
+    itimerval off = {};
+    syscall(SYS_setitimer, ITIMER_REAL, &off, nullptr);
+    signal(SIGALRM, SIG_IGN);
+    signal(SIGUSR1, SIG_IGN);
+    sigset_t none;
+    sigemptyset(&none);
+    pthread_sigmask(SIG_SETMASK, &none, nullptr);
+
+    auto args = arguments();
+    std::vector<char *> argv;
+    for(auto& arg : args) {
+        argv.push_back(&arg[0]);
+    }
+    argv.push_back(nullptr);
+    execv("/proc/self/exe", argv.data());
+    perror("Simulated reset failed");
+    abort();
+}
+
+} // namespace end --------------------
+
+SIM::State& SIM::GetState() {
+    return state;
+}
+
+bool SIM::IsPowerOn() {
+    return powerOn;
+}
+
+size_t SIM::GetRtcSize() {
+    return __stop_rtc_data - __start_rtc_data;
+}
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us) {
+    state.sleepRequestUs = time_in_us;
+    return ESP_OK;
+}
+
+esp_err_t esp_sleep_enable_ext0_wakeup(int gpio_num, int level) {
+    return rtc_gpio_is_valid_gpio((gpio_num_t) gpio_num) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_sleep_enable_ext1_wakeup(uint64_t mask, esp_sleep_ext1_wakeup_mode_t mode) {
+    for(int pin = 0; pin < GPIO_NUM_MAX; pin++) {
+        if((mask & BIT64(pin)) && !rtc_gpio_is_valid_gpio((gpio_num_t) pin)) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    return ESP_OK;
+}
+
+uint64_t esp_sleep_get_ext1_wakeup_status(void) {
+    return 0;
+}
+
+esp_err_t esp_sleep_pd_config(esp_sleep_pd_domain_t domain, esp_sleep_pd_option_t option) {
+    return domain < ESP_PD_DOMAIN_MAX ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause(void) {
+    return state.cause;
+}
+
+void esp_deep_sleep_start(void) {
+    // Other tasks stop as on the chip, none may touch RTC memory or read the time which jumps
+    vTaskSuspendAll();
+    const int64_t now = SIM::Now();
+    state.awakeUs += now - state.wakeUs;
+    state.chargeMah += toMah(now - state.bootUs, SIM::activeCurrentMa);
+
+    // No timer - sleeps until the end of simulation
+    int64_t wake = state.sleepRequestUs ? now + (int64_t) state.sleepRequestUs : SIM::GetEnd();
+    asleep(now, wake);
+
+    while(wake < SIM::GetEnd()) {
+        auto next = SIM::RunWakeStub(wake);
+        if(next == 0) {
+            break;
+        }
+        state.stubWakes++;
+        state.stubUs += SIM::stubDurationUs;
+        state.chargeMah += toMah(SIM::stubDurationUs, SIM::stubCurrentMa);
+        asleep(wake + SIM::stubDurationUs, wake + SIM::stubDurationUs + next);
+        wake += SIM::stubDurationUs + next;
+    }
+    reset(std::min(wake, SIM::GetEnd()), ESP_SLEEP_WAKEUP_TIMER);
+}
+
+void esp_restart(void) {
+    vTaskSuspendAll();
+    const int64_t now = SIM::Now();
+    state.awakeUs += now - state.wakeUs;
+    state.chargeMah += toMah(now - state.bootUs, SIM::activeCurrentMa);
+    reset(now, ESP_SLEEP_WAKEUP_UNDEFINED);
+}
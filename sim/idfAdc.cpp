@@ -0,0 +1,184 @@
+/**
+ * @file idfAdc.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+// Host version of ESP-IDF oneshot and continuous ADC. The only analog input is battery voltage
+// (after divider by 2, see BATTERY::Battery), which follows the charge used so far.
+
+#include "sim.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+extern "C" {
+    #include "esp_adc/adc_oneshot.h"
+    #include "esp_adc/adc_continuous.h"
+    #include "esp_adc/adc_cali.h"
+    #include "esp_adc/adc_cali_scheme.h"
+} // extern C close
+
+namespace {
+
+// 11 dB attenuation, 12 bits
+constexpr float fullScaleMv = 3100;
+constexpr int fullScaleRaw = 4095;
+// Noise of a single conversion, raw. Every 16th conversion is way off, as on the chip
+constexpr int noiseRaw = 12;
+constexpr int spikeRaw = 200;
+
+uint32_t conversions;
+
+struct Point {
+    float charge;   // Left, %
+    float voltage;
+};
+
+// Discharge curve of a small LiPo cell at low current
+const std::array<Point, 12> curve = {{
+    {0, 3.00}, {5, 3.45}, {10, 3.68}, {20, 3.74}, {30, 3.77}, {40, 3.79},
+    {50, 3.82}, {60, 3.87}, {70, 3.92}, {80, 3.98}, {90, 4.06}, {100, 4.20},
+}};
+
+float batteryVoltage() {
+    const auto& state = SIM::GetState();
+    // Charge used until now, including this boot
+    double used = state.chargeMah + (SIM::Now() - state.bootUs) * (double) SIM::activeCurrentMa / 3.6e9;
+    float left = std::max(0.0, 100 * (1 - used / SIM::GetOptions().batteryMah));
+    for(size_t i = 1; i < curve.size(); i++) {
+        if(left <= curve[i].charge) {
+            auto& a = curve[i - 1];
+            auto& b = curve[i];
+            return a.voltage + (b.voltage - a.voltage) * (left - a.charge) / (b.charge - a.charge);
+        }
+    }
+    return curve.back().voltage;
+}
+
+/**
+ * @return Raw result of a conversion, 11 dB attenuation, 12 bits
+ */
+int convert(adc_unit_t unit, adc_channel_t channel) {
+    if(unit != ADC_UNIT_1 || channel != ADC_CHANNEL_6) {
+        // Not connected
+        return 0;
+    }
+    float mv = batteryVoltage() / 2 * 1000;
+    int raw = (int) (mv * fullScaleRaw / fullScaleMv) + rand() % (2 * noiseRaw + 1) - noiseRaw;
+    if(++conversions % 16 == 0) {
+        raw -= spikeRaw;
+    }
+    return std::max(0, std::min(fullScaleRaw, raw));
+}
+
+} // namespace end --------------------
+
+struct adc_continuous_ctx_t {
+    uint32_t frameBytes;
+    std::vector<adc_digi_pattern_config_t> pattern;
+    size_t next;        // Pattern entry converted next
+    bool running;
+};
+
+struct adc_oneshot_unit_ctx_t {
+    adc_unit_t unit;
+};
+
+esp_err_t adc_oneshot_new_unit(const adc_oneshot_unit_init_cfg_t *init_config, adc_oneshot_unit_handle_t *ret_unit) {
+    *ret_unit = new adc_oneshot_unit_ctx_t {init_config->unit_id};
+    return ESP_OK;
+}
+
+esp_err_t adc_oneshot_config_channel(adc_oneshot_unit_handle_t handle, adc_channel_t channel,
+                                        const adc_oneshot_chan_cfg_t *config) {
+    return ESP_OK;
+}
+
+esp_err_t adc_oneshot_read(adc_oneshot_unit_handle_t handle, adc_channel_t chan, int *out_raw) {
+    *out_raw = convert(handle->unit, chan);
+    return ESP_OK;
+}
+
+esp_err_t adc_oneshot_del_unit(adc_oneshot_unit_handle_t handle) {
+    delete handle;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_new_handle(const adc_continuous_handle_cfg_t *hdl_config, adc_continuous_handle_t *ret_handle) {
+    if(hdl_config->conv_frame_size == 0 || hdl_config->conv_frame_size % sizeof(adc_digi_output_data_t)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *ret_handle = new adc_continuous_ctx_t {hdl_config->conv_frame_size, {}, 0, false};
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_config(adc_continuous_handle_t handle, const adc_continuous_config_t *config) {
+    // ESP32 has DMA on ADC1 only, results are TYPE1
+    if(handle->running || config->pattern_num == 0 || config->conv_mode != ADC_CONV_SINGLE_UNIT_1 ||
+            config->format != ADC_DIGI_OUTPUT_FORMAT_TYPE1) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    handle->pattern.assign(config->adc_pattern, config->adc_pattern + config->pattern_num);
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_start(adc_continuous_handle_t handle) {
+    if(handle->running || handle->pattern.empty()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    handle->running = true;
+    handle->next = 0;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_read(adc_continuous_handle_t handle, uint8_t *buf, uint32_t length_max,
+                                uint32_t *out_length, uint32_t timeout_ms) {
+    if(!handle->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // A frame at most, as the DMA hands them over
+    const uint32_t results = std::min(length_max, handle->frameBytes) / sizeof(adc_digi_output_data_t);
+    auto out = (adc_digi_output_data_t *) buf;
+    for(uint32_t i = 0; i < results; i++) {
+        const auto& entry = handle->pattern[handle->next];
+        handle->next = (handle->next + 1) % handle->pattern.size();
+        out[i].type1.channel = entry.channel;
+        out[i].type1.data = convert((adc_unit_t) entry.unit, (adc_channel_t) entry.channel);
+    }
+    *out_length = results * sizeof(adc_digi_output_data_t);
+    return results ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+esp_err_t adc_continuous_stop(adc_continuous_handle_t handle) {
+    if(!handle->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    handle->running = false;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_deinit(adc_continuous_handle_t handle) {
+    if(handle->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    delete handle;
+    return ESP_OK;
+}
+
+esp_err_t adc_cali_create_scheme_line_fitting(const adc_cali_line_fitting_config_t *config, adc_cali_handle_t *ret_handle) {
+    *ret_handle = nullptr;
+    return ESP_OK;
+}
+
+esp_err_t adc_cali_delete_scheme_line_fitting(adc_cali_handle_t handle) {
+    return ESP_OK;
+}
+
+esp_err_t adc_cali_raw_to_voltage(adc_cali_handle_t handle, int raw, int *voltage) {
+    *voltage = raw * fullScaleMv / fullScaleRaw;
+    return ESP_OK;
+}
@@ -0,0 +1,240 @@
+/**
+ * @file idfI2c.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+// Host version of ESP-IDF I2C master. Command links are recorded and executed against
+// device models when started, so drivers/i2c runs unchanged.
+// It is also the fake bus of the simulation: with --i2c-faults the slave holds SDA low
+// in the middle of a byte, the way a reset during a read leaves it, until SCL is clocked.
+
+#include "sim.hpp"
+#include <new>
+#include <vector>
+
+extern "C" {
+    #include "driver/i2c.h"
+    #include "freertos/task.h"
+} // extern C close
+
+namespace {
+
+struct Command {
+    enum Type { START, WRITE, READ, STOP } type;
+    uint8_t byte;       // WRITE
+    uint8_t *data;      // READ
+};
+
+struct Link {
+    std::vector<Command> commands;
+    bool dynamic;           // Heap link, ESP-IDF allocates each command too
+};
+
+struct Port {
+    int scl = -1;
+    int sda = -1;
+    bool installed = false;
+    uint32_t sclLevel = 1;
+};
+
+std::array<Port, I2C_NUM_MAX> ports;
+
+// Byte in progress when the fault hits, remaining clocks until slave lets SDA go
+uint8_t faultClocks(uint32_t transaction) {
+    return 1 + transaction % 8;
+}
+
+// Sends bytes written since the address to the device
+void flush(SIM::Mpu6050Model& device, std::vector<uint8_t>& written) {
+    if(!written.empty()) {
+        device.Write(written.data(), written.size());
+        written.clear();
+    }
+}
+
+void add(i2c_cmd_handle_t cmd_handle, const Command& command) {
+    auto& link = *(Link *) cmd_handle;
+    // Static links take commands from the buffer of the caller
+    if(link.dynamic) {
+        SIM::GetState().i2cAllocations++;
+    }
+    link.commands.push_back(command);
+}
+
+} // namespace end --------------------
+
+bool SIM::SetI2cLine(int pin, uint32_t level) {
+    auto& state = GetState();
+    for(auto& port : ports) {
+        if(port.sda == pin) {
+            return true;
+        }
+        if(port.scl == pin) {
+            // Slave shifts out a bit at each rising edge
+            if(level && !port.sclLevel && state.i2cStuckClocks && --state.i2cStuckClocks == 0) {
+                state.i2cRecoveries++;
+            }
+            port.sclLevel = level;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SIM::GetI2cLine(int pin, int& level) {
+    for(auto& port : ports) {
+        if(port.sda == pin) {
+            level = GetState().i2cStuckClocks ? 0 : 1;
+            return true;
+        }
+        if(port.scl == pin) {
+            level = port.sclLevel;
+            return true;
+        }
+    }
+    return false;
+}
+
+esp_err_t i2c_param_config(i2c_port_t i2c_num, const i2c_config_t *i2c_conf) {
+    if(i2c_num >= I2C_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    ports[i2c_num].scl = i2c_conf->scl_io_num;
+    ports[i2c_num].sda = i2c_conf->sda_io_num;
+    return ESP_OK;
+}
+
+esp_err_t i2c_driver_install(i2c_port_t i2c_num, i2c_mode_t mode, size_t slv_rx_buf_len, size_t slv_tx_buf_len,
+                                int intr_alloc_flags) {
+    if(i2c_num >= I2C_NUM_MAX || ports[i2c_num].installed) {
+        return i2c_num < I2C_NUM_MAX ? ESP_FAIL : ESP_ERR_INVALID_ARG;
+    }
+    ports[i2c_num].installed = true;
+    return ESP_OK;
+}
+
+esp_err_t i2c_driver_delete(i2c_port_t i2c_num) {
+    if(i2c_num >= I2C_NUM_MAX || !ports[i2c_num].installed) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    ports[i2c_num].installed = false;
+    return ESP_OK;
+}
+
+i2c_cmd_handle_t i2c_cmd_link_create(void) {
+    SIM::GetState().i2cAllocations++;
+    return new Link {{}, true};
+}
+
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd_handle) {
+    delete (Link *) cmd_handle;
+}
+
+// Link object lives in the buffer of the caller
+i2c_cmd_handle_t i2c_cmd_link_create_static(uint8_t *buffer, uint32_t size) {
+    if(buffer == nullptr || size < sizeof(Link) || (uintptr_t) buffer % alignof(Link)) {
+        return nullptr;
+    }
+    return new(buffer) Link {{}, false};
+}
+
+void i2c_cmd_link_delete_static(i2c_cmd_handle_t cmd_handle) {
+    ((Link *) cmd_handle)->~Link();
+}
+
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd_handle) {
+    add(cmd_handle, {Command::START, 0, nullptr});
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd_handle, uint8_t data, bool ack_en) {
+    add(cmd_handle, {Command::WRITE, data, nullptr});
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_read_byte(i2c_cmd_handle_t cmd_handle, uint8_t *data, i2c_ack_type_t ack) {
+    add(cmd_handle, {Command::READ, 0, data});
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd_handle, const uint8_t *data, size_t data_len, bool ack_en) {
+    for(size_t i = 0; i < data_len; i++) {
+        i2c_master_write_byte(cmd_handle, data[i], ack_en);
+    }
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_read(i2c_cmd_handle_t cmd_handle, uint8_t *data, size_t data_len, i2c_ack_type_t ack) {
+    for(size_t i = 0; i < data_len; i++) {
+        i2c_master_read_byte(cmd_handle, data + i, ack);
+    }
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd_handle) {
+    add(cmd_handle, {Command::STOP, 0, nullptr});
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_cmd_begin(i2c_port_t i2c_num, i2c_cmd_handle_t cmd_handle, TickType_t ticks_to_wait) {
+    if(i2c_num >= I2C_NUM_MAX || !ports[i2c_num].installed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    auto& state = SIM::GetState();
+    const auto every = SIM::GetOptions().i2cFaultEvery;
+    state.i2cTransactions++;
+    if(every && state.i2cTransactions % every == 0 && !state.i2cStuckClocks) {
+        state.i2cStuckClocks = faultClocks(state.i2cTransactions);
+        state.i2cFaults++;
+    }
+    if(state.i2cStuckClocks) {
+        // Controller cannot get the bus, driver gives up after the timeout
+        vTaskDelay(ticks_to_wait);
+        return ESP_ERR_TIMEOUT;
+    }
+
+    // Only the accelerometer is on the bus. It keeps registers across simulated resets
+    auto& device = state.mpu;
+    std::vector<uint8_t> written;
+    bool addressed = false;     // Next written byte is the address
+    bool selected = false;
+
+    for(auto& command : ((Link *) cmd_handle)->commands) {
+        state.i2cBitTimes += command.type == Command::START || command.type == Command::STOP ? 1 : 9;
+        switch(command.type) {
+            case Command::START:
+                flush(device, written);
+                addressed = true;
+                break;
+            case Command::WRITE:
+                if(addressed) {
+                    addressed = false;
+                    selected = (command.byte >> 1) == SIM::Mpu6050Model::address;
+                    if(!selected) {
+                        // Nobody acknowledges the address
+                        return ESP_FAIL;
+                    }
+                }
+                else if(selected) {
+                    written.push_back(command.byte);
+                }
+                break;
+            case Command::READ:
+                if(!selected) {
+                    return ESP_FAIL;
+                }
+                device.Read(command.data, 1);
+                break;
+            case Command::STOP:
+                flush(device, written);
+                selected = false;
+                break;
+        }
+    }
+    flush(device, written);
+    return ESP_OK;
+}
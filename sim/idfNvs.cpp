@@ -0,0 +1,131 @@
+/**
+ * @file idfNvs.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+// Host version of ESP-IDF NVS. Flash is a file (Options::nvsFile) which outlives the simulation,
+// written at each commit. Blobs only, that is all drivers/nvs uses.
+
+#include "sim.hpp"
+#include <fstream>
+#include <map>
+#include <vector>
+
+extern "C" {
+    #include <string.h>
+    #include "nvs.h"
+    #include "nvs_flash.h"
+} // extern C close
+
+namespace {
+
+// Keys are "<namespace>/<key>"
+std::map<std::string, std::vector<uint8_t>> entries;
+std::vector<std::string> namespaces;
+bool initialised = false;
+
+std::string fullKey(nvs_handle_t handle, const char *key) {
+    return namespaces[handle - 1] + "/" + key;
+}
+
+bool validHandle(nvs_handle_t handle) {
+    return handle >= 1 && handle <= namespaces.size();
+}
+
+void load() {
+    entries.clear();
+    std::ifstream file(SIM::GetOptions().nvsFile, std::ios::binary);
+    uint32_t keyLength;
+    while(file.read((char *) &keyLength, sizeof(keyLength))) {
+        std::string key(keyLength, '\0');
+        uint32_t length;
+        if(!file.read(&key[0], keyLength) || !file.read((char *) &length, sizeof(length))) {
+            break;
+        }
+        std::vector<uint8_t> value(length);
+        if(!file.read((char *) value.data(), length)) {
+            break;
+        }
+        entries[key] = value;
+    }
+}
+
+esp_err_t save() {
+    std::ofstream file(SIM::GetOptions().nvsFile, std::ios::binary | std::ios::trunc);
+    for(auto& entry : entries) {
+        uint32_t keyLength = entry.first.size();
+        uint32_t length = entry.second.size();
+        file.write((const char *) &keyLength, sizeof(keyLength));
+        file.write(entry.first.data(), keyLength);
+        file.write((const char *) &length, sizeof(length));
+        file.write((const char *) entry.second.data(), length);
+    }
+    return file ? ESP_OK : ESP_FAIL;
+}
+
+} // namespace end --------------------
+
+esp_err_t nvs_flash_init(void) {
+    if(!initialised) {
+        load();
+        initialised = true;
+    }
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle) {
+    if(!initialised) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    namespaces.push_back(name);
+    *out_handle = namespaces.size();
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length) {
+    if(!validHandle(handle)) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    auto entry = entries.find(fullKey(handle, key));
+    if(entry == entries.end()) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if(out_value == nullptr) {
+        *length = entry->second.size();
+        return ESP_OK;
+    }
+    if(*length < entry->second.size()) {
+        *length = entry->second.size();
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    *length = entry->second.size();
+    memcpy(out_value, entry->second.data(), *length);
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length) {
+    if(!validHandle(handle)) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    auto data = (const uint8_t *) value;
+    entries[fullKey(handle, key)].assign(data, data + length);
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key) {
+    if(!validHandle(handle)) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    return entries.erase(fullKey(handle, key)) ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    return validHandle(handle) ? save() : ESP_ERR_NVS_INVALID_HANDLE;
+}
+
+void nvs_close(nvs_handle_t handle) {
+}
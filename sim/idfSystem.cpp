@@ -0,0 +1,319 @@
+/**
+ * @file idfSystem.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+// Host versions of ESP-IDF logs, errors, GPIO (with interrupts), ROM delay and OTA
+
+#include "sim.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <vector>
+
+extern "C" {
+    #include <stdarg.h>
+    #include <stdio.h>
+    #include <stdlib.h>
+    #include "esp_err.h"
+    #include "esp_log.h"
+    #include "esp_ota_ops.h"
+    #include "esp_rom_sys.h"
+    #include "driver/gpio.h"
+    #include "driver/rtc_io.h"
+    #include "freertos/FreeRTOS.h"
+    #include "freertos/task.h"
+} // extern C close
+
+namespace {
+
+std::array<uint32_t, GPIO_NUM_MAX> levels;
+
+struct Interrupt {
+    gpio_isr_t isr;
+    void *arg;
+    gpio_int_type_t type;
+    bool enabled;
+};
+std::array<Interrupt, GPIO_NUM_MAX> interrupts;
+bool isrService;
+
+// Above application tasks, interrupts preempt them
+constexpr UBaseType_t interruptPriority = configMAX_PRIORITIES - 1;
+
+bool valid(gpio_num_t gpio_num) {
+    return gpio_num >= 0 && gpio_num < GPIO_NUM_MAX;
+}
+
+// Level of an input pin raises the interrupt
+bool active(const Interrupt& interrupt, uint32_t level) {
+    return (interrupt.type == GPIO_INTR_HIGH_LEVEL && level) || (interrupt.type == GPIO_INTR_LOW_LEVEL && !level);
+}
+
+// ISR runs from the task which drives the pin, or which unmasks a pin still at its level
+void raise(gpio_num_t gpio_num) {
+    const auto& interrupt = interrupts[gpio_num];
+    if(interrupt.enabled && interrupt.isr != nullptr) {
+        interrupt.isr(interrupt.arg);
+    }
+}
+
+/**
+ * @brief Drives INT pins of the models: MPU6050 data ready.
+ */
+void interruptTask(void *pvParameters) {
+    for(;;) {
+        const int64_t periodUs = SIM::GetState().mpu.GetDataReadyPeriodUs();
+        if(periodUs == 0) {
+            vTaskDelay(10 / portTICK_PERIOD_MS);
+            continue;
+        }
+        const TickType_t ticks = periodUs / 1000 / portTICK_PERIOD_MS;
+        vTaskDelay(ticks ? ticks : 1);
+        // Short pulse, as the sensor drives it
+        SIM::SetGpioInput(SIM::mpuInterruptPin, 1);
+        SIM::SetGpioInput(SIM::mpuInterruptPin, 0);
+    }
+}
+
+const esp_partition_t running = {0x10000, 0x180000, "sim"};
+// Update partition lives in memory, next boot still runs the simulation
+const esp_partition_t update = {0x190000, 0x180000, "sim_update"};
+
+// Handle of the update in progress, 0 if none
+esp_ota_handle_t otaHandle;
+std::vector<uint8_t> otaImage;
+bool otaComplete;
+
+} // namespace end --------------------
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...) {
+    if(level > SIM::GetOptions().log) {
+        return;
+    }
+    static const char letters[] = "NEWIDV";
+    // Tags are __FILE__, the name is enough
+    const char *name = strrchr(tag, '/');
+    name = name != nullptr ? name + 1 : tag;
+
+    fprintf(stderr, "%c (%.6f) %s: ", letters[level], SIM::Now() / 1e6, name);
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+const char *esp_err_to_name(esp_err_t code) {
+    switch(code) {
+        case ESP_OK: return "ESP_OK";
+        case ESP_FAIL: return "ESP_FAIL";
+        case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+        case ESP_ERR_NVS_INVALID_HANDLE: return "ESP_ERR_NVS_INVALID_HANDLE";
+        case ESP_ERR_NVS_INVALID_LENGTH: return "ESP_ERR_NVS_INVALID_LENGTH";
+        default: return "UNKNOWN ERROR";
+    }
+}
+
+void _esp_error_check_failed(esp_err_t rc, const char *file, int line, const char *function, const char *expression) {
+    fprintf(stderr, "ESP_ERROR_CHECK failed: %s (0x%x) at %s:%d %s(): %s\n",
+            esp_err_to_name(rc), rc, file, line, function, expression);
+    abort();
+}
+
+void SIM::SetGpioInput(int pin, uint32_t level) {
+    if(!valid((gpio_num_t) pin)) {
+        return;
+    }
+    const uint32_t previous = levels[pin];
+    levels[pin] = level;
+    const auto type = interrupts[pin].type;
+    const bool rising = !previous && level;
+    const bool falling = previous && !level;
+    if((rising && (type == GPIO_INTR_POSEDGE || type == GPIO_INTR_ANYEDGE)) ||
+            (falling && (type == GPIO_INTR_NEGEDGE || type == GPIO_INTR_ANYEDGE)) ||
+            active(interrupts[pin], level)) {
+        raise((gpio_num_t) pin);
+    }
+}
+
+esp_err_t gpio_config(const gpio_config_t *config) {
+    return config->pin_bit_mask >> GPIO_NUM_MAX ? ESP_ERR_INVALID_ARG : ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level) {
+    if(gpio_num < 0 || gpio_num >= GPIO_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    levels[gpio_num] = level;
+    SIM::SetI2cLine(gpio_num, level);
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num) {
+    int level;
+    if(SIM::GetI2cLine(gpio_num, level)) {
+        return level;
+    }
+    return gpio_num >= 0 && gpio_num < GPIO_NUM_MAX ? levels[gpio_num] : 0;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags) {
+    if(isrService) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    isrService = xTaskCreate(interruptTask, "SimInterrupts", 2 * 1024, NULL, interruptPriority, NULL) == pdPASS;
+    return isrService ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args) {
+    if(!isrService) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if(!valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    interrupts[gpio_num].isr = isr_handler;
+    interrupts[gpio_num].arg = args;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio_num) {
+    if(!valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    interrupts[gpio_num].isr = nullptr;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio_num, gpio_int_type_t intr_type) {
+    if(!valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    interrupts[gpio_num].type = intr_type;
+    return ESP_OK;
+}
+
+esp_err_t gpio_intr_enable(gpio_num_t gpio_num) {
+    if(!valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    interrupts[gpio_num].enabled = true;
+    if(active(interrupts[gpio_num], levels[gpio_num])) {
+        raise(gpio_num);
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_intr_disable(gpio_num_t gpio_num) {
+    if(!valid(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    interrupts[gpio_num].enabled = false;
+    return ESP_OK;
+}
+
+void esp_rom_delay_us(uint32_t us) {
+}
+
+bool rtc_gpio_is_valid_gpio(gpio_num_t gpio_num) {
+    static const gpio_num_t rtcPins[] = {
+        GPIO_NUM_0, GPIO_NUM_2, GPIO_NUM_4, GPIO_NUM_12, GPIO_NUM_13, GPIO_NUM_14, GPIO_NUM_15, GPIO_NUM_25,
+        GPIO_NUM_26, GPIO_NUM_27, GPIO_NUM_32, GPIO_NUM_33, GPIO_NUM_34, GPIO_NUM_35, GPIO_NUM_36, GPIO_NUM_37,
+        GPIO_NUM_38, GPIO_NUM_39,
+    };
+    return std::find(std::begin(rtcPins), std::end(rtcPins), gpio_num) != std::end(rtcPins);
+}
+
+esp_err_t rtc_gpio_isolate(gpio_num_t gpio_num) {
+    return ESP_OK;
+}
+
+esp_err_t rtc_gpio_pullup_en(gpio_num_t gpio_num) {
+    return rtc_gpio_is_valid_gpio(gpio_num) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t rtc_gpio_pullup_dis(gpio_num_t gpio_num) {
+    return rtc_gpio_is_valid_gpio(gpio_num) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t rtc_gpio_pulldown_en(gpio_num_t gpio_num) {
+    return rtc_gpio_is_valid_gpio(gpio_num) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t rtc_gpio_pulldown_dis(gpio_num_t gpio_num) {
+    return rtc_gpio_is_valid_gpio(gpio_num) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+const esp_partition_t *esp_ota_get_running_partition(void) {
+    return &running;
+}
+
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from) {
+    return &update;
+}
+
+esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp_ota_handle_t *out_handle) {
+    if(partition != &update || out_handle == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if(otaHandle != 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    otaImage.clear();
+    otaComplete = false;
+    otaHandle = 1;
+    *out_handle = otaHandle;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size) {
+    if(handle == 0 || handle != otaHandle || data == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if(otaImage.size() + size > update.size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    otaImage.insert(otaImage.end(), (const uint8_t *) data, (const uint8_t *) data + size);
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_end(esp_ota_handle_t handle) {
+    if(handle == 0 || handle != otaHandle) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    otaHandle = 0;
+    if(otaImage.empty()) {
+        // ESP_ERR_OTA_VALIDATE_FAILED on the chip
+        return ESP_ERR_INVALID_SIZE;
+    }
+    otaComplete = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle) {
+    if(handle == otaHandle) {
+        otaHandle = 0;
+        otaImage.clear();
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition) {
+    // Image is not run, the simulation boots itself again
+    return partition == &update && otaComplete ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+const std::vector<uint8_t>& SIM::GetOtaImage() {
+    return otaImage;
+}
@@ -0,0 +1,31 @@
+/**
+ * @file rtc_io.h
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+// Host simulation. Pins have no effect, RTC GPIO numbers are those of ESP32.
+
+#include <stdbool.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool rtc_gpio_is_valid_gpio(gpio_num_t gpio_num);
+esp_err_t rtc_gpio_isolate(gpio_num_t gpio_num);
+esp_err_t rtc_gpio_pullup_en(gpio_num_t gpio_num);
+esp_err_t rtc_gpio_pullup_dis(gpio_num_t gpio_num);
+esp_err_t rtc_gpio_pulldown_en(gpio_num_t gpio_num);
+esp_err_t rtc_gpio_pulldown_dis(gpio_num_t gpio_num);
+
+#ifdef __cplusplus
+} // extern C close
+#endif
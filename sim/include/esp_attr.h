@@ -0,0 +1,17 @@
+/**
+ * @file esp_attr.h
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+// Host simulation. RTC memory is a linker section, saved and restored by the simulated deep sleep (sim/deepSleep.cpp).
+
+#define RTC_DATA_ATTR   __attribute__((section("rtc_data")))
+#define RTC_NOINIT_ATTR RTC_DATA_ATTR
+#define RTC_IRAM_ATTR
+#define IRAM_ATTR
@@ -0,0 +1,24 @@
+/**
+ * @file esp_cpu.h
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+// Host simulation. Cycle counter of the CPU, derived from the simulation clock (sim/clock.cpp).
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t esp_cpu_get_cycle_count(void);
+
+#ifdef __cplusplus
+} // extern C close
+#endif
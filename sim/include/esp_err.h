@@ -0,0 +1,52 @@
+/**
+ * @file esp_err.h
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+// Host simulation. Subset of ESP-IDF esp_err.h used by the application.
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int esp_err_t;
+
+#define ESP_OK                      (0)
+#define ESP_FAIL                    (-1)
+#define ESP_ERR_NO_MEM              (0x101)
+#define ESP_ERR_INVALID_ARG         (0x102)
+#define ESP_ERR_INVALID_STATE       (0x103)
+#define ESP_ERR_INVALID_SIZE        (0x104)
+#define ESP_ERR_NOT_FOUND           (0x105)
+#define ESP_ERR_NOT_SUPPORTED       (0x106)
+#define ESP_ERR_TIMEOUT             (0x107)
+
+#define ESP_ERR_NVS_BASE            (0x1100)
+#define ESP_ERR_NVS_NOT_INITIALIZED (ESP_ERR_NVS_BASE + 0x01)
+#define ESP_ERR_NVS_NOT_FOUND       (ESP_ERR_NVS_BASE + 0x02)
+#define ESP_ERR_NVS_INVALID_HANDLE  (ESP_ERR_NVS_BASE + 0x07)
+#define ESP_ERR_NVS_INVALID_LENGTH  (ESP_ERR_NVS_BASE + 0x0c)
+
+const char *esp_err_to_name(esp_err_t code);
+
+void _esp_error_check_failed(esp_err_t rc, const char *file, int line, const char *function, const char *expression)
+        __attribute__((noreturn));
+
+#define ESP_ERROR_CHECK(x) do {                                             \
+        esp_err_t err_rc_ = (x);                                            \
+        if(err_rc_ != ESP_OK) {                                             \
+            _esp_error_check_failed(err_rc_, __FILE__, __LINE__, __func__, #x); \
+        }                                                                   \
+    } while(0)
+
+#ifdef __cplusplus
+} // extern C close
+#endif
@@ -0,0 +1,24 @@
+/**
+ * @file esp_system.h
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+// Host simulation. Restart is a power-on reset of the simulated device.
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void esp_restart(void) __attribute__((noreturn));
+
+#ifdef __cplusplus
+} // extern C close
+#endif
@@ -0,0 +1,32 @@
+/**
+ * @file FreeRTOS.h
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+// Host simulation. ESP-IDF include layout and SMP API on top of the host kernel (sim/kernel or POSIX port).
+
+#include <FreeRTOS.h>
+// Pulled in by ESP-IDF port headers, application relies on it
+#include <sys/time.h>
+#include "esp_attr.h"
+#include "esp_err.h"
+
+// Spinlocks of ESP-IDF. Critical section of the host kernels is global, the lock is not needed
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+
+// Single core
+#define portNUM_PROCESSORS 1
+#define xPortGetCoreID() 0
+
+#undef portENTER_CRITICAL
+#undef portEXIT_CRITICAL
+// Same form as on target, the lock argument is evaluated, so it counts as used
+#define portENTER_CRITICAL(mux) ((void) (mux), vPortEnterCritical())
+#define portEXIT_CRITICAL(mux)  ((void) (mux), vPortExitCritical())
@@ -0,0 +1,15 @@
+/**
+ * @file queue.h
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+// Host simulation. ESP-IDF include layout of the host kernel.
+
+#include "freertos/FreeRTOS.h"
+#include <queue.h>
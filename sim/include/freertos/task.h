@@ -0,0 +1,19 @@
+/**
+ * @file task.h
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+// Host simulation. ESP-IDF include layout of the host kernel.
+
+#include "freertos/FreeRTOS.h"
+#include <task.h>
+
+// Single core. Stack depth is in bytes on ESP-IDF and in words here, tasks get more than they ask for
+#define xTaskCreatePinnedToCore(code, name, depth, parameters, priority, handle, core) \
+        xTaskCreate(code, name, depth, parameters, priority, handle)
@@ -0,0 +1,16 @@
+/**
+ * @file sdkconfig.h
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+// Host simulation. Options of sdkconfig.env the application depends on.
+
+#define CONFIG_FREERTOS_HZ 1000
+#define CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ 80
+#define CONFIG_LOG_DEFAULT_LEVEL 0
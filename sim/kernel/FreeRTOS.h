@@ -0,0 +1,55 @@
+/**
+ * @file FreeRTOS.h
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+// Host kernel of the simulation (SIM_KERNEL=host), the part of the FreeRTOS API the firmware
+// uses. Tasks are threads, see hostKernel.cpp.
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FreeRTOSConfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint32_t TickType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uintptr_t StackType_t;
+
+#define portMAX_DELAY ((TickType_t) 0xffffffffUL)
+#define portTICK_PERIOD_MS ((TickType_t) 1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms) ((TickType_t) (((TickType_t) (ms) * (TickType_t) configTICK_RATE_HZ) / (TickType_t) 1000U))
+
+#define pdFALSE ((BaseType_t) 0)
+#define pdTRUE ((BaseType_t) 1)
+#define pdPASS (pdTRUE)
+#define pdFAIL (pdFALSE)
+
+// Static allocation buffers. Kernel keeps its own objects, only the queue storage is used
+typedef struct {
+    void *reserved;
+} StaticTask_t;
+typedef struct {
+    void *reserved;
+} StaticQueue_t;
+
+// Global, nesting critical section
+void vPortEnterCritical(void);
+void vPortExitCritical(void);
+#define portENTER_CRITICAL() vPortEnterCritical()
+#define portEXIT_CRITICAL() vPortExitCritical()
+
+#define portYIELD_FROM_ISR(woken) (void) (woken)
+
+#ifdef __cplusplus
+} // extern C close
+#endif
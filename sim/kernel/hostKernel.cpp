@@ -0,0 +1,364 @@
+/**
+ * @file hostKernel.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+// Host kernel of the simulation. Builds offline, without a FreeRTOS-Kernel checkout.
+// Tasks are threads and run in parallel, as on a dual core chip, priorities are not scheduled on.
+// Time of the kernel is simulated time (sim/clock.cpp): ticks follow esp_timer and blocking
+// calls wait Options::speed times shorter in real time.
+// The POSIX port (SIM_KERNEL=posix) runs one task at a time, with priorities.
+
+#include "sim.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+extern "C" {
+    #include <pthread.h>
+    #include <unistd.h>
+    #include "FreeRTOS.h"
+    #include "task.h"
+    #include "queue.h"
+    #include "esp_timer.h"
+} // extern C close
+
+namespace {
+
+// Shortest real wait, simulated time is checked again after it
+constexpr int64_t minWaitUs = 20;
+
+struct Task {
+    pthread_t thread;
+    TaskFunction_t code;
+    void *parameters;
+    char name[configMAX_TASK_NAME_LEN];
+    UBaseType_t priority;
+    std::condition_variable changed;    // Notification or resume
+    uint32_t value = 0;
+    bool pending = false;
+    bool suspended = false;
+};
+
+struct Queue {
+    UBaseType_t length;
+    UBaseType_t itemSize;
+    std::vector<uint8_t> own;
+    uint8_t *storage;
+    UBaseType_t head = 0;
+    UBaseType_t count = 0;
+    std::condition_variable changed;
+};
+
+// Guards all tasks and queues
+std::mutex kernel;
+std::condition_variable never;
+std::recursive_mutex critical;
+
+thread_local Task *self = nullptr;
+std::vector<Task *> created;
+bool running = false;
+// Task that stopped the scheduler, the others stop at their next kernel call
+Task *stoppedBy = nullptr;
+
+int64_t tickUs() {
+    return (int64_t) portTICK_PERIOD_MS * 1000;
+}
+
+/**
+ * @brief Entry of each kernel call of a task. Blocks a suspended task until it is resumed and
+ *      any task other than the one which stopped the scheduler for good.
+ */
+void checkpoint(std::unique_lock<std::mutex>& lock) {
+    if(self == nullptr) {
+        return;
+    }
+    self->changed.wait(lock, [] { return !self->suspended; });
+    if(stoppedBy != nullptr && stoppedBy != self) {
+        never.wait(lock, [] { return false; });
+    }
+}
+
+/**
+ * @brief Wait until ready or ticks of simulated time passed
+ * @return false on timeout
+ */
+template<typename Ready>
+bool wait(std::unique_lock<std::mutex>& lock, std::condition_variable& condition, TickType_t ticks, Ready ready) {
+    if(ticks == portMAX_DELAY) {
+        condition.wait(lock, ready);
+        return true;
+    }
+    const int64_t deadline = SIM::Now() + ticks * tickUs();
+    while(!ready()) {
+        const int64_t left = deadline - SIM::Now();
+        if(left <= 0) {
+            return false;
+        }
+        const int64_t realUs = std::max<int64_t>(left / SIM::GetOptions().speed, minWaitUs);
+        condition.wait_for(lock, std::chrono::microseconds(realUs));
+    }
+    return true;
+}
+
+void *run(void *argument) {
+    self = (Task *) argument;
+    {
+        std::unique_lock<std::mutex> lock(kernel);
+        checkpoint(lock);
+    }
+    self->code(self->parameters);
+    // Task functions must not return, as on FreeRTOS
+    configASSERT(false);
+    return nullptr;
+}
+
+void start(Task *task) {
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+    const int result = pthread_create(&task->thread, &attributes, run, task);
+    pthread_attr_destroy(&attributes);
+    configASSERT(result == 0);
+}
+
+Task *toTask(TaskHandle_t handle) {
+    return handle != nullptr ? (Task *) handle : self;
+}
+
+bool notify(Task *task, uint32_t value, eNotifyAction action) {
+    std::lock_guard<std::mutex> lock(kernel);
+    switch(action) {
+        case eSetBits: task->value |= value; break;
+        case eIncrement: task->value++; break;
+        case eSetValueWithOverwrite: task->value = value; break;
+        case eSetValueWithoutOverwrite:
+            if(task->pending) {
+                return false;
+            }
+            task->value = value;
+            break;
+        default: break;
+    }
+    task->pending = true;
+    task->changed.notify_all();
+    return true;
+}
+
+} // namespace end --------------------
+
+// Port -----------------------------------------------------------------------------
+
+void vPortEnterCritical(void) {
+    critical.lock();
+}
+
+void vPortExitCritical(void) {
+    critical.unlock();
+}
+
+// Tasks ----------------------------------------------------------------------------
+
+BaseType_t xTaskCreate(TaskFunction_t code, const char *name, uint32_t stackDepth, void *parameters,
+                        UBaseType_t priority, TaskHandle_t *handle) {
+    auto task = new Task;
+    task->code = code;
+    task->parameters = parameters;
+    strncpy(task->name, name != nullptr ? name : "", sizeof(task->name) - 1);
+    task->name[sizeof(task->name) - 1] = '\0';
+    task->priority = priority;
+    if(handle != nullptr) {
+        *handle = task;
+    }
+
+    std::lock_guard<std::mutex> lock(kernel);
+    if(running) {
+        start(task);
+    }
+    else {
+        created.push_back(task);
+    }
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t handle) {
+    // Threads can only end themselves
+    configASSERT(handle == nullptr || handle == self);
+    pthread_exit(nullptr);
+}
+
+void vTaskStartScheduler(void) {
+    {
+        std::lock_guard<std::mutex> lock(kernel);
+        running = true;
+        for(auto task : created) {
+            start(task);
+        }
+        created.clear();
+    }
+    // Process ends with a simulated reset, from one of the tasks
+    for(;;) {
+        pause();
+    }
+}
+
+void vTaskDelay(TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(kernel);
+    checkpoint(lock);
+    if(self != nullptr) {
+        wait(lock, self->changed, ticks, [] { return false; });
+    }
+    checkpoint(lock);
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t) (esp_timer_get_time() / tickUs());
+}
+
+void vTaskSuspend(TaskHandle_t handle) {
+    std::unique_lock<std::mutex> lock(kernel);
+    auto task = toTask(handle);
+    task->suspended = true;
+    if(task == self) {
+        checkpoint(lock);
+    }
+}
+
+void vTaskResume(TaskHandle_t handle) {
+    std::lock_guard<std::mutex> lock(kernel);
+    auto task = (Task *) handle;
+    task->suspended = false;
+    task->changed.notify_all();
+}
+
+void vTaskSuspendAll(void) {
+    std::lock_guard<std::mutex> lock(kernel);
+    stoppedBy = self;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    return self;
+}
+
+char *pcTaskGetName(TaskHandle_t handle) {
+    auto task = toTask(handle);
+    static char none[] = "";
+    return task != nullptr ? task->name : none;
+}
+
+// Notifications --------------------------------------------------------------------
+
+BaseType_t xTaskNotify(TaskHandle_t handle, uint32_t value, eNotifyAction action) {
+    return notify((Task *) handle, value, action) ? pdPASS : pdFAIL;
+}
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t handle, uint32_t value, eNotifyAction action, BaseType_t *woken) {
+    if(woken != nullptr) {
+        *woken = pdFALSE;
+    }
+    return xTaskNotify(handle, value, action);
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clearOnEntry, uint32_t clearOnExit, uint32_t *value, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(kernel);
+    checkpoint(lock);
+    if(!self->pending) {
+        self->value &= ~clearOnEntry;
+    }
+    const bool received = wait(lock, self->changed, ticks, [] { return self->pending; });
+    checkpoint(lock);
+    if(value != nullptr) {
+        *value = self->value;
+    }
+    if(!received) {
+        return pdFALSE;
+    }
+    self->value &= ~clearOnExit;
+    self->pending = false;
+    return pdTRUE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(kernel);
+    checkpoint(lock);
+    wait(lock, self->changed, ticks, [] { return self->value != 0; });
+    checkpoint(lock);
+    const uint32_t value = self->value;
+    if(value != 0) {
+        self->value = clearOnExit ? 0 : value - 1;
+    }
+    self->pending = false;
+    return value;
+}
+
+// Queues ---------------------------------------------------------------------------
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t itemSize, uint8_t *storage, StaticQueue_t *buffer) {
+    auto queue = new Queue;
+    queue->length = length;
+    queue->itemSize = itemSize;
+    if(storage == nullptr) {
+        queue->own.resize(length * itemSize);
+        storage = queue->own.data();
+    }
+    queue->storage = storage;
+    return queue;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    return xQueueCreateStatic(length, itemSize, nullptr, nullptr);
+}
+
+BaseType_t xQueueSend(QueueHandle_t handle, const void *item, TickType_t ticks) {
+    auto queue = (Queue *) handle;
+    std::unique_lock<std::mutex> lock(kernel);
+    checkpoint(lock);
+    if(!wait(lock, queue->changed, ticks, [queue] { return queue->count < queue->length; })) {
+        return pdFALSE;
+    }
+    const UBaseType_t tail = (queue->head + queue->count) % queue->length;
+    memcpy(queue->storage + tail * queue->itemSize, item, queue->itemSize);
+    queue->count++;
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t handle, const void *item) {
+    auto queue = (Queue *) handle;
+    std::lock_guard<std::mutex> lock(kernel);
+    // Meant for queues of one item
+    queue->head = 0;
+    queue->count = 1;
+    memcpy(queue->storage, item, queue->itemSize);
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t handle, void *item, TickType_t ticks) {
+    auto queue = (Queue *) handle;
+    std::unique_lock<std::mutex> lock(kernel);
+    checkpoint(lock);
+    const bool received = wait(lock, queue->changed, ticks, [queue] { return queue->count > 0; });
+    checkpoint(lock);
+    if(!received) {
+        return pdFALSE;
+    }
+    memcpy(item, queue->storage + queue->head * queue->itemSize, queue->itemSize);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t handle) {
+    auto queue = (Queue *) handle;
+    std::lock_guard<std::mutex> lock(kernel);
+    return queue->count;
+}
@@ -0,0 +1,65 @@
+/**
+ * @file task.h
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+// Host kernel of the simulation, tasks and direct to task notifications.
+
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+typedef enum {
+    eNoAction,
+    eSetBits,
+    eIncrement,
+    eSetValueWithOverwrite,
+    eSetValueWithoutOverwrite
+} eNotifyAction;
+
+/**
+ * @brief Task starts with the scheduler, or right away if it runs. Priority is kept but
+ *      not scheduled on: tasks run in parallel, as threads.
+ */
+BaseType_t xTaskCreate(TaskFunction_t code, const char *name, uint32_t stackDepth, void *parameters,
+                        UBaseType_t priority, TaskHandle_t *handle);
+void vTaskDelete(TaskHandle_t task);
+void vTaskStartScheduler(void);
+
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+
+/**
+ * @brief Suspend a task. Another task stops at its next kernel call, not in the middle of its code.
+ */
+void vTaskSuspend(TaskHandle_t task);
+void vTaskResume(TaskHandle_t task);
+/**
+ * @brief Scheduler stops for good: tasks other than the caller stop at their next kernel call.
+ *      Used before a simulated reset.
+ */
+void vTaskSuspendAll(void);
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+char *pcTaskGetName(TaskHandle_t task);
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action);
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action, BaseType_t *woken);
+BaseType_t xTaskNotifyWait(uint32_t clearOnEntry, uint32_t clearOnExit, uint32_t *value, TickType_t ticks);
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks);
+#define xTaskNotifyGive(task) xTaskNotify((task), 0, eIncrement)
+
+#ifdef __cplusplus
+} // extern C close
+#endif
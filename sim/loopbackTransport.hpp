@@ -0,0 +1,179 @@
+/**
+ * @file loopbackTransport.hpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+// Host (Linux) backend of BLE::Transport. Client and tracker live in the same process,
+// attribute operations are passed straight to BLE::Services. Air time is not spent,
+// it is accounted on a simulated clock according to MTU and connection interval.
+
+#include "transport.hpp"
+#include "services.hpp"
+#include <array>
+#include <vector>
+#include <cstdint>
+
+namespace SIM {
+
+// Connection events of link setup (rough, no retransmissions). Connect request to first event
+constexpr uint32_t connectEvents = 1;
+// LL encryption with the bonded keys: LL_ENC_REQ/RSP, LL_START_ENC_REQ/RSP
+constexpr uint32_t encryptionEvents = 2;
+// LE Secure Connections pairing: request/response, public keys, confirm, randoms, DHKey checks
+// and key distribution, a request and a response each
+constexpr uint32_t pairingEvents = 12;
+// Two P-256 operations (public key, DHKey) in software on the chip
+constexpr uint64_t pairingComputeUs = 150000;
+
+class LoopbackTransport : public BLE::Transport {
+    std::array<std::vector<uint8_t>, (size_t) BLE::CharacteristicId::Count> values;
+    BLE::Services services;
+    BLE::LinkInfo link;
+    uint16_t connectInterval;
+    uint8_t packetsPerEvent;
+    uint64_t airTimeUs = 0;
+    uint32_t notifications = 0;
+    uint32_t linkRequests = 0;
+
+    uint64_t intervalUs() const {
+        return (uint64_t) link.interval * 1250;
+    }
+
+public:
+    /**
+     * @param mtu ATT MTU negotiated with the client
+     * @param interval connection interval in 1.25 ms units
+     * @param _packetsPerEvent writes without response controller fits in one connection event
+     */
+    LoopbackTransport(uint16_t mtu = 23, uint16_t interval = 24, uint8_t _packetsPerEvent = 4) :
+            services(*this), link{mtu, interval, 0, 400}, connectInterval(interval), packetsPerEvent(_packetsPerEvent) {};
+
+    // Tracker side ----------------------------------------------------------------
+
+    using BLE::Transport::SetValue;
+    void SetValue(BLE::CharacteristicId id, const uint8_t *data, size_t len) override {
+        values[(size_t) id].assign(data, data + len);
+    }
+
+    void Notify(BLE::CharacteristicId id) override {
+        notifications++;
+        airTimeUs += intervalUs();
+    }
+
+    void RequestLink(const BLE::LinkRequest& request) override {
+        // Client accepts whatever is requested. Update costs one connection event
+        airTimeUs += intervalUs();
+        link.interval = request.maxInterval;
+        link.latency = request.latency;
+        link.timeout = request.timeout;
+        linkRequests++;
+        services.OnLinkUpdate(link);
+    }
+
+    // Client side -----------------------------------------------------------------
+
+    /**
+     * @brief Central connects and the link gets encrypted: pairing the first time,
+     *      encryption with the stored keys afterwards. Costs the connection events of it.
+     * @param bonded keys of an earlier pairing are kept on both sides
+     */
+    void Connect(bool bonded = true) {
+        // Central connects with its own parameters, the profile is requested again
+        link.interval = connectInterval;
+        link.latency = 0;
+        airTimeUs += (connectEvents + encryptionEvents) * intervalUs();
+        if(!bonded) {
+            airTimeUs += pairingEvents * intervalUs() + pairingComputeUs;
+        }
+        services.OnConnect(link);
+    }
+
+    void Disconnect(int reason = 0) {
+        services.OnDisconnect(reason);
+    }
+
+    /**
+     * @brief Read request. Costs a connection event for request and one for response.
+     * @return value, truncated to what fits in one ATT_READ_RSP (MTU - 1)
+     */
+    std::vector<uint8_t> Read(BLE::CharacteristicId id) {
+        services.OnRead(id, link);
+        airTimeUs += 2 * intervalUs();
+        auto value = values[(size_t) id];
+        if(value.size() > (size_t) link.mtu - 1) value.resize(link.mtu - 1);
+        return value;
+    }
+
+    /**
+     * @brief Read request followed by read blob requests for the rest of the value.
+     *      Each part costs a connection event for request and one for response.
+     * @return whole value
+     */
+    std::vector<uint8_t> ReadLong(BLE::CharacteristicId id) {
+        services.OnRead(id, link);
+        auto value = values[(size_t) id];
+        const size_t parts = value.size() / (link.mtu - 1) + 1;
+        airTimeUs += 2 * parts * intervalUs();
+        return value;
+    }
+
+    /**
+     * @brief Write request (with response). Costs a connection event for request and one for response.
+     */
+    void Write(BLE::CharacteristicId id, const uint8_t *data, size_t len) {
+        services.OnWrite(id, data, len, link);
+        airTimeUs += 2 * intervalUs();
+    }
+
+    /**
+     * @brief Write command (without response), as used for OTA data.
+     *      Several of them share one connection event.
+     * @return false if data does not fit in one packet (MTU - 3)
+     */
+    bool WriteNoResponse(BLE::CharacteristicId id, const uint8_t *data, size_t len, uint32_t packetNo) {
+        if(len > (size_t) link.mtu - 3) return false;
+        services.OnWrite(id, data, len, link);
+        if(packetNo % packetsPerEvent == 0) airTimeUs += intervalUs();
+        return true;
+    }
+
+    void SetMtu(uint16_t mtu) {
+        link.mtu = mtu;
+    }
+
+    void SetInterval(uint16_t interval) {
+        link.interval = interval;
+        connectInterval = interval;
+    }
+
+    const BLE::LinkInfo& GetLink() const {
+        return link;
+    }
+
+    uint64_t GetAirTimeUs() const {
+        return airTimeUs;
+    }
+
+    uint32_t GetNotifications() const {
+        return notifications;
+    }
+
+    uint32_t GetLinkRequests() const {
+        return linkRequests;
+    }
+
+    /**
+     * @brief Periodic housekeeping of service layer, as BLE task does
+     */
+    void Update() {
+        services.Update();
+    }
+};
+
+} // namespace SIM end --------------------
@@ -0,0 +1,206 @@
+/**
+ * @file main.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+// Entry of host simulation. Each simulated boot is a process, see deepSleep.cpp
+
+#include "sim.hpp"
+#include "imu.hpp"
+#include <cstring>
+#include <string>
+
+extern "C" {
+    #include <getopt.h>
+    #include <stdio.h>
+    #include <stdlib.h>
+    #include "freertos/FreeRTOS.h"
+    #include "freertos/task.h"
+    #include "nvs.h"
+    #include "nvs_flash.h"
+} // extern C close
+
+extern "C" void app_main();
+
+namespace {
+
+// Some RTC slow memory is used by IDF itself
+constexpr size_t rtcMemorySize = 8 * 1024;
+
+SIM::Options options;
+SIM::Scenario scenario;
+
+void usage(const char *name) {
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  --days N          simulated days (7)\n"
+        "  --speed N         simulated seconds per real second while awake (20)\n"
+        "  --scenario FILE   user events, see sim/scenario.hpp (generated week)\n"
+        "  --seed N          seed of generated week (1)\n"
+        "  --drift PPM       RTC clock error while asleep (100)\n"
+        "  --battery MAH     battery capacity (500)\n"
+        "  --nvs FILE        flash image, kept between runs (sim_nvs.bin)\n"
+        "  --rtc FILE        RTC memory image (sim_rtc.bin)\n"
+        "  --i2c-faults N    every Nth I2C transaction leaves SDA stuck low (0, never)\n"
+        "  --trace FILE      phone reads the trace at each sync, frames appended as hex (none)\n"
+        "  --binary-log FILE same for the binary log (none)\n"
+        "  --log LEVEL       0 none .. 5 verbose (2)\n", name);
+}
+
+bool parse(int argc, char **argv) {
+    static const option longOptions[] = {
+        {"days", required_argument, nullptr, 'd'},
+        {"speed", required_argument, nullptr, 's'},
+        {"scenario", required_argument, nullptr, 'f'},
+        {"seed", required_argument, nullptr, 'r'},
+        {"drift", required_argument, nullptr, 'p'},
+        {"battery", required_argument, nullptr, 'b'},
+        {"nvs", required_argument, nullptr, 'n'},
+        {"rtc", required_argument, nullptr, 'm'},
+        {"log", required_argument, nullptr, 'l'},
+        {"i2c-faults", required_argument, nullptr, 'i'},
+        {"trace", required_argument, nullptr, 't'},
+        {"binary-log", required_argument, nullptr, 'g'},
+        {nullptr, 0, nullptr, 0},
+    };
+    int option;
+    while((option = getopt_long(argc, argv, "", longOptions, nullptr)) != -1) {
+        switch(option) {
+            case 'd': options.days = atof(optarg); break;
+            case 's': options.speed = atof(optarg); break;
+            case 'f': options.scenario = optarg; break;
+            case 'r': options.seed = strtoul(optarg, nullptr, 0); break;
+            case 'p': options.driftPpm = atof(optarg); break;
+            case 'b': options.batteryMah = atof(optarg); break;
+            case 'n': options.nvsFile = optarg; break;
+            case 'm': options.rtcImage = optarg; break;
+            case 'l': options.log = (esp_log_level_t) atoi(optarg); break;
+            case 'i': options.i2cFaultEvery = strtoul(optarg, nullptr, 0); break;
+            case 't': options.traceFile = optarg; break;
+            case 'g': options.binaryLogFile = optarg; break;
+            default: return false;
+        }
+    }
+    return options.days > 0 && options.speed > 0 && options.batteryMah > 0;
+}
+
+/**
+ * @brief Tracker was calibrated before it was given to the user. Faces of the model
+ *      are saved as IMU::Imu::CalibrateCubeFaces does, unless flash has them already.
+ */
+void calibrate() {
+    nvs_handle_t handle;
+    if(nvs_flash_init() != ESP_OK || nvs_open("nvs", NVS_READWRITE, &handle) != ESP_OK) {
+        return;
+    }
+    size_t length;
+    if(nvs_get_blob(handle, "pos1", nullptr, &length) == ESP_OK) {
+        return;
+    }
+    for(int face = 1; face <= SIM::Mpu6050Model::faces; face++) {
+        auto gravity = SIM::Mpu6050Model::GetGravity(face);
+        // Orientation is inverted acceleration, see Imu::GetPositionRaw
+        IMU::Orientation orientation(-gravity[0], -gravity[1], -gravity[2]);
+        auto key = "pos" + std::to_string(face);
+        nvs_set_blob(handle, key.c_str(), &orientation, sizeof(orientation));
+    }
+    nvs_commit(handle);
+}
+
+void mainTask(void *pvParameters) {
+    app_main();
+    vTaskDelete(NULL);
+}
+
+} // namespace end --------------------
+
+const SIM::Options& SIM::GetOptions() {
+    return options;
+}
+
+const SIM::Scenario& SIM::GetScenario() {
+    return scenario;
+}
+
+void SIM::Report() {
+    const auto& state = GetState();
+    const double days = GetEnd() / (24 * 3600 * 1e6);
+    const double hours = days * 24;
+    const double averageMa = state.chargeMah / hours;
+
+    printf("Simulated %.1f days\n", days);
+    printf("  application boots     %u (%.1f per day)\n", (unsigned int) state.boots, state.boots / days);
+    printf("  stub wakes            %u (%.1f per day)\n", (unsigned int) state.stubWakes, state.stubWakes / days);
+    printf("  awake                 %.1f s per day, stub %.1f s per day\n",
+            state.awakeUs / 1e6 / days, state.stubUs / 1e6 / days);
+    printf("  flips                 %u\n", (unsigned int) scenario.GetFlips(GetEnd()));
+    printf("  positions received    %u\n", (unsigned int) state.positionsReceived);
+    printf("  syncs                 %u of %u requested\n", (unsigned int) state.syncs,
+            (unsigned int) scenario.GetSyncs(GetEnd()));
+    printf("  worst clock error     %.3f s at sync\n", state.worstClockErrorUs / 1e6);
+    if(state.bonded) {
+        printf("  reconnect             pairing %.0f ms, bonded %.0f ms average, %.0f ms worst\n",
+                state.pairingUs / 1e3, state.reconnects ? state.reconnectUs / 1e3 / state.reconnects : 0.0,
+                state.worstReconnectUs / 1e3);
+    }
+    if(options.i2cFaultEvery) {
+        printf("  i2c                   %u transactions, %u stuck, %u recovered\n",
+                (unsigned int) state.i2cTransactions, (unsigned int) state.i2cFaults,
+                (unsigned int) state.i2cRecoveries);
+    }
+    printf("  charge                %.2f mAh, average %.3f mA, %.0f days on %.0f mAh\n",
+            state.chargeMah, averageMa, averageMa > 0 ? options.batteryMah / averageMa / 24 : 0.0,
+            options.batteryMah);
+}
+
+// Idle task of static allocation (configSUPPORT_STATIC_ALLOCATION)
+extern "C" void vApplicationGetIdleTaskMemory(StaticTask_t **ppxIdleTaskTCBBuffer, StackType_t **ppxIdleTaskStackBuffer,
+                                                uint32_t *pulIdleTaskStackSize) {
+    static StaticTask_t tcb;
+    static StackType_t stack[configMINIMAL_STACK_SIZE];
+    *ppxIdleTaskTCBBuffer = &tcb;
+    *ppxIdleTaskStackBuffer = stack;
+    *pulIdleTaskStackSize = configMINIMAL_STACK_SIZE;
+}
+
+int main(int argc, char **argv) {
+    if(!parse(argc, argv)) {
+        usage(argv[0]);
+        return 2;
+    }
+    if(options.scenario.empty()) {
+        scenario.Generate(options.days, options.seed);
+    }
+    else if(!scenario.Load(options.scenario)) {
+        fprintf(stderr, "Could not read scenario %s\n", options.scenario.c_str());
+        return 2;
+    }
+
+    auto& state = SIM::GetState();
+    if(SIM::IsPowerOn()) {
+        state = {};
+        state.mpu.Reset();
+        state.cause = ESP_SLEEP_WAKEUP_UNDEFINED;
+        state.bootUs = SIM::bootDelayUs;
+        calibrate();
+        if(SIM::GetRtcSize() > rtcMemorySize) {
+            fprintf(stderr, "RTC memory used %u B, chip has %u B\n", (unsigned int) SIM::GetRtcSize(),
+                    (unsigned int) rtcMemorySize);
+        }
+    }
+    if(SIM::Now() >= SIM::GetEnd()) {
+        SIM::Report();
+        remove(options.rtcImage.c_str());
+        return 0;
+    }
+    state.boots++;
+
+    // app_main runs in a task on ESP-IDF too
+    xTaskCreate(mainTask, "main", 4 * 1024, NULL, 1, NULL);
+    vTaskStartScheduler();
+    return 1;
+}
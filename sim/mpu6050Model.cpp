@@ -0,0 +1,213 @@
+/**
+ * @file mpu6050Model.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#include "mpu6050Model.hpp"
+#include "mpu6050.hpp"
+#include "sim.hpp"
+#include <cmath>
+
+using namespace SIM;
+
+namespace {
+
+// Noise of resting accelerometer, raw units (16384 = 1 g)
+constexpr int noise = 160;
+// New noise sample each 5 ms, as often as IMU task used to poll
+constexpr int64_t samplePeriodUs = 5000;
+
+constexpr size_t fifoSize = 1024;
+
+int16_t toRaw(float acc) {
+    return (int16_t) std::lround(acc * 16384);
+}
+
+// Same result for the same sample, whichever process asks
+int pseudoNoise(int64_t sample, int axis) {
+    uint32_t x = (uint32_t) (sample * 2654435761u) ^ (uint32_t) (axis * 40503u + GetOptions().seed);
+    x ^= x >> 15;
+    x *= 2246822519u;
+    x ^= x >> 13;
+    return (int) (x % (2 * noise + 1)) - noise;
+}
+
+} // namespace end --------------------
+
+void Mpu6050Model::Reset() {
+    registers.fill(0);
+    registers[PWR_MGMT_1] = 0x40;   // Sleep
+    registers[WHO_AM_I] = address;
+    pointer = 0;
+    fifoStartUs = 0;
+    fifoByte = 0;
+}
+
+int64_t Mpu6050Model::getWakePeriodUs() const {
+    // LP_WAKE_CTRL: 1.25, 5, 20 or 40 Hz
+    static const int64_t wakePeriodUs[] = {800000, 200000, 50000, 25000};
+    return wakePeriodUs[registers[PWR_MGMT_2] >> 6];
+}
+
+int64_t Mpu6050Model::getSamplePeriodUs() const {
+    if(registers[PWR_MGMT_1] & 0x20) {
+        // Cycle mode, a sample per wake
+        return getWakePeriodUs();
+    }
+    // Gyroscope output rate is 8 kHz with low pass filter off (DLPF_CFG 0 or 7), 1 kHz on
+    const uint8_t lowPass = registers[CONFIG] & 0x07;
+    const int64_t outputRateHz = lowPass == 0 || lowPass == 7 ? 8000 : 1000;
+    return (1 + registers[SMPLRT_DIV]) * 1000000 / outputRateHz;
+}
+
+int64_t Mpu6050Model::GetDataReadyPeriodUs() const {
+    if(!(registers[INT_ENABLE] & 0x01) || (registers[PWR_MGMT_1] & 0x40)) {
+        return 0;
+    }
+    return getSamplePeriodUs();
+}
+
+float Mpu6050Model::GetCurrentMa() const {
+    // Typical values of the datasheet
+    if(registers[PWR_MGMT_1] & 0x40) {
+        return 0.005;
+    }
+    if(registers[PWR_MGMT_1] & 0x20) {
+        static const float cycleMa[] = {0.010, 0.020, 0.070, 0.140};
+        return cycleMa[registers[PWR_MGMT_2] >> 6];
+    }
+    const bool accel = (registers[PWR_MGMT_2] & 0x38) != 0x38;
+    const bool gyro = (registers[PWR_MGMT_2] & 0x07) != 0x07;
+    if(gyro) {
+        return accel ? 3.9 : 3.6;
+    }
+    return accel ? 0.5 : 0.005;
+}
+
+size_t Mpu6050Model::getFifoSampleBytes() const {
+    if(!(registers[USER_CTRL] & 0x40)) {
+        return 0;
+    }
+    const uint8_t sources = registers[FIFO_EN];
+    // Register order: accelerometer, temperature, gyroscope X, Y, Z
+    return (sources & 0x08 ? 6 : 0) + (sources & 0x80 ? 2 : 0) + (sources & 0x40 ? 2 : 0)
+            + (sources & 0x20 ? 2 : 0) + (sources & 0x10 ? 2 : 0);
+}
+
+size_t Mpu6050Model::getFifoCount(int64_t nowUs) {
+    const size_t sampleBytes = getFifoSampleBytes();
+    if(sampleBytes == 0) {
+        return 0;
+    }
+    const int64_t period = getSamplePeriodUs();
+    const size_t samples = (nowUs - fifoStartUs) / period;
+    const size_t count = samples * sampleBytes - fifoByte;
+    if(count >= fifoSize) {
+        // Overflow, chip overwrites the oldest bytes. Keep whole samples, count saturates
+        const size_t kept = fifoSize / sampleBytes;
+        fifoStartUs += (samples - kept) * period;
+        fifoByte = 0;
+        return fifoSize;
+    }
+    return count;
+}
+
+uint8_t Mpu6050Model::readFifo(int64_t nowUs) {
+    const size_t sampleBytes = getFifoSampleBytes();
+    if(sampleBytes == 0 || getFifoCount(nowUs) == 0) {
+        return 0;
+    }
+    const int64_t sampleUs = fifoStartUs + getSamplePeriodUs();
+    uint8_t value = 0;
+    if((registers[FIFO_EN] & 0x08) && fifoByte < 6) {
+        auto acc = GetAcceleration(sampleUs);
+        const uint16_t axis = (uint16_t) acc[fifoByte / 2];
+        value = fifoByte % 2 ? axis & 0xFF : axis >> 8;
+    }
+    // Temperature and gyroscope read as zero
+    if(++fifoByte == sampleBytes) {
+        fifoByte = 0;
+        fifoStartUs = sampleUs;
+    }
+    return value;
+}
+
+void Mpu6050Model::onWrite(uint8_t reg) {
+    if(reg == USER_CTRL && (registers[USER_CTRL] & 0x04)) {
+        // Reset bit clears itself
+        registers[USER_CTRL] &= ~0x04;
+        fifoStartUs = Now();
+        fifoByte = 0;
+    }
+    else if(reg == FIFO_EN || reg == USER_CTRL || reg == SMPLRT_DIV || reg == CONFIG) {
+        // Samples are counted from the change on
+        fifoStartUs = Now();
+        fifoByte = 0;
+    }
+}
+
+void Mpu6050Model::Write(const uint8_t *data, size_t len) {
+    if(len == 0) {
+        return;
+    }
+    pointer = data[0] & 0x7F;
+    for(size_t i = 1; i < len; i++) {
+        if(pointer != WHO_AM_I) {
+            registers[pointer] = data[i];
+            onWrite(pointer);
+        }
+        pointer = (pointer + 1) & 0x7F;
+    }
+}
+
+void Mpu6050Model::Read(uint8_t *data, size_t len) {
+    // Sensor registers are sampled by the chip, refresh them at read unless sleeping
+    if(!(registers[PWR_MGMT_1] & 0x40)) {
+        auto acc = GetAcceleration(Now());
+        for(size_t i = 0; i < acc.size(); i++) {
+            registers[ACCEL_XOUT_H + 2 * i] = (uint16_t) acc[i] >> 8;
+            registers[ACCEL_XOUT_L + 2 * i] = (uint16_t) acc[i] & 0xFF;
+        }
+    }
+    for(size_t i = 0; i < len; i++) {
+        if(pointer == FIFO_R_W) {
+            // Burst reads of FIFO_R_W drain the FIFO
+            data[i] = readFifo(Now());
+            continue;
+        }
+        if(pointer == FIFO_COUNTH) {
+            // Count is latched when high byte is read
+            const size_t count = getFifoCount(Now());
+            registers[FIFO_COUNTH] = count >> 8;
+            registers[FIFO_COUNTL] = count & 0xFF;
+        }
+        data[i] = registers[pointer];
+        pointer = (pointer + 1) & 0x7F;
+    }
+}
+
+std::array<float, 3> Mpu6050Model::GetGravity(int face) {
+    // Six sides and three slanted faces, far enough apart for IMU::Orientation::drift
+    const float d = std::sqrt(0.5f);
+    static const std::array<std::array<float, 3>, faces> gravity = {{
+        {0, 0, 1}, {0, 0, -1}, {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0},
+        {d, d, 0}, {d, 0, d}, {0, d, d},
+    }};
+    if(face < 1 || face > faces) {
+        face = 1;
+    }
+    return gravity[face - 1];
+}
+
+std::array<int16_t, 3> Mpu6050Model::GetAcceleration(int64_t timeUs) {
+    auto gravity = GetGravity(GetScenario().GetFace(timeUs));
+    std::array<int16_t, 3> raw;
+    for(size_t i = 0; i < raw.size(); i++) {
+        raw[i] = toRaw(gravity[i]) + pseudoNoise(timeUs / samplePeriodUs, i);
+    }
+    return raw;
+}
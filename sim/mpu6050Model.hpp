@@ -0,0 +1,81 @@
+/**
+ * @file mpu6050Model.hpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace SIM {
+
+/**
+ * @brief Register model of MPU6050 on the I2C bus. Accelerometer shows gravity of the face
+ *      which is up at the time of the read (see Scenario). FIFO stores accelerometer and
+ *      gyroscope (zero) samples at SMPLRT_DIV rate (LP_WAKE_CTRL in cycle mode), INT pulses
+ *      with each one if enabled. Plain data, kept in simulation state, the chip does not
+ *      reset with ESP32.
+ */
+class Mpu6050Model {
+    std::array<uint8_t, 128> registers;
+    uint8_t pointer;
+    // FIFO is not stored, samples are generated when read: count since the oldest one
+    int64_t fifoStartUs;    // Oldest sample not read is taken one period after it
+    uint8_t fifoByte;       // Bytes of the oldest sample already read
+
+    int64_t getWakePeriodUs() const;
+    int64_t getSamplePeriodUs() const;
+    size_t getFifoSampleBytes() const;
+    size_t getFifoCount(int64_t nowUs);
+    uint8_t readFifo(int64_t nowUs);
+    void onWrite(uint8_t reg);
+
+public:
+    const static constexpr uint8_t address = 0x68;
+    // Faces of the tracker, same count as IMU::Imu::cubeFaces
+    const static constexpr int faces = 9;
+
+    /**
+     * @brief Power on values of registers.
+     */
+    void Reset();
+
+    /**
+     * @brief Write transaction. First byte sets register pointer, following ones are written
+     *      to consecutive registers.
+     */
+    void Write(const uint8_t *data, size_t len);
+
+    /**
+     * @brief Read transaction from register pointer, pointer is incremented (except FIFO_R_W).
+     */
+    void Read(uint8_t *data, size_t len);
+
+    /**
+     * @return Period of INT pin pulses (data ready), 0 if interrupt is disabled or chip sleeps
+     */
+    int64_t GetDataReadyPeriodUs() const;
+
+    /**
+     * @return Supply current in the power mode set by PWR_MGMT_1, PWR_MGMT_2 [mA]
+     */
+    float GetCurrentMa() const;
+
+    /**
+     * @return Direction of gravity (acceleration, g) when given face is up. Faces start from 1
+     */
+    static std::array<float, 3> GetGravity(int face);
+
+    /**
+     * @return ACCEL_XOUT, ACCEL_YOUT, ACCEL_ZOUT at given time, with a bit of noise
+     */
+    static std::array<int16_t, 3> GetAcceleration(int64_t timeUs);
+};
+
+} // namespace SIM end --------------------
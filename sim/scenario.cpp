@@ -0,0 +1,136 @@
+/**
+ * @file scenario.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#include "scenario.hpp"
+#include "mpu6050Model.hpp"
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+using namespace SIM;
+
+namespace {
+
+constexpr int64_t hourUs = 3600LL * 1000000;
+constexpr int64_t minuteUs = 60LL * 1000000;
+
+// Tracker rests on it when nobody works
+constexpr int idleFace = 1;
+
+} // namespace end --------------------
+
+void Scenario::sort() {
+    auto byTime = [](const Event& a, const Event& b) { return a.time < b.time; };
+    std::stable_sort(flips.begin(), flips.end(), byTime);
+    std::stable_sort(syncs.begin(), syncs.end(), byTime);
+}
+
+bool Scenario::Load(const std::string& path) {
+    std::ifstream file(path);
+    if(!file) {
+        return false;
+    }
+    flips.clear();
+    syncs.clear();
+
+    std::string line;
+    while(std::getline(file, line)) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        double hours;
+        std::string type;
+        if(!(fields >> hours)) {
+            // Empty line
+            continue;
+        }
+        if(!(fields >> type)) {
+            return false;
+        }
+        Event event = {(int64_t) (hours * hourUs), 0};
+        if(type == "face") {
+            if(!(fields >> event.face) || event.face < 1 || event.face > Mpu6050Model::faces) {
+                return false;
+            }
+            flips.push_back(event);
+        }
+        else if(type == "sync") {
+            syncs.push_back(event);
+        }
+        else {
+            return false;
+        }
+    }
+    sort();
+    return true;
+}
+
+void Scenario::Generate(double days, uint32_t seed) {
+    std::mt19937 random(seed);
+    auto uniform = [&random](int64_t from, int64_t to) {
+        return std::uniform_int_distribution<int64_t>(from, to)(random);
+    };
+
+    flips.clear();
+    syncs.clear();
+    int face = idleFace;
+
+    for(int day = 0; day < days; day++) {
+        const int64_t midnight = day * 24 * hourUs;
+        // Simulation starts on Monday
+        const bool weekend = day % 7 >= 5;
+        int64_t time = midnight + (weekend ? 10 * hourUs : 8 * hourUs + uniform(0, 60 * minuteUs));
+        const int64_t end = midnight + (weekend ? 14 * hourUs : 17 * hourUs + uniform(0, 60 * minuteUs));
+
+        while(time < end) {
+            int next;
+            do {
+                next = (int) uniform(1, Mpu6050Model::faces);
+            } while(next == face);
+            face = next;
+            flips.push_back({time, face});
+            time += weekend ? uniform(60 * minuteUs, 180 * minuteUs) : uniform(15 * minuteUs, 90 * minuteUs);
+        }
+        if(face != idleFace) {
+            face = idleFace;
+            flips.push_back({end, face});
+        }
+
+        syncs.push_back({midnight + 12 * hourUs + uniform(0, 60 * minuteUs), 0});
+        syncs.push_back({midnight + 20 * hourUs + uniform(0, 60 * minuteUs), 0});
+    }
+    sort();
+}
+
+int Scenario::GetFace(int64_t time) const {
+    // Read every few ms by IMU task
+    auto next = std::upper_bound(flips.begin(), flips.end(), time, [](int64_t t, const Event& e) {
+        return t < e.time;
+    });
+    return next == flips.begin() ? idleFace : (next - 1)->face;
+}
+
+uint32_t Scenario::GetFlips(int64_t time) const {
+    uint32_t count = 0;
+    int face = idleFace;
+    for(auto& flip : flips) {
+        if(flip.time > time) {
+            break;
+        }
+        count += flip.face != face;
+        face = flip.face;
+    }
+    return count;
+}
+
+uint32_t Scenario::GetSyncs(int64_t time) const {
+    return std::upper_bound(syncs.begin(), syncs.end(), time, [](int64_t t, const Event& e) {
+        return t < e.time;
+    }) - syncs.begin();
+}
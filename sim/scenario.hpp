@@ -0,0 +1,66 @@
+/**
+ * @file scenario.hpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace SIM {
+
+/**
+ * @brief What the user does with the tracker: flips it and syncs with the phone.
+ *      Rebuilt the same way after each simulated reset.
+ *
+ *      File format, one event per line ('#' starts a comment):
+ *          <hours since power on> face <n>     put the tracker on face n (1..9)
+ *          <hours since power on> sync         phone wants data, connects at next advertising
+ */
+class Scenario {
+public:
+    struct Event {
+        int64_t time;   // us since power on
+        int face;       // 0 for sync
+    };
+
+private:
+    std::vector<Event> flips;
+    std::vector<Event> syncs;
+
+    void sort();
+
+public:
+    /**
+     * @return false if file could not be read or has an invalid line
+     */
+    bool Load(const std::string& path);
+
+    /**
+     * @brief Working days of flips during office hours, quiet weekends, two syncs a day.
+     */
+    void Generate(double days, uint32_t seed);
+
+    /**
+     * @return Face up at given time
+     */
+    int GetFace(int64_t time) const;
+
+    /**
+     * @return Flips (face changes) until given time
+     */
+    uint32_t GetFlips(int64_t time) const;
+
+    /**
+     * @return Syncs requested until given time
+     */
+    uint32_t GetSyncs(int64_t time) const;
+};
+
+} // namespace SIM end --------------------
@@ -0,0 +1,164 @@
+/**
+ * @file sim.hpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+// Host simulation of the whole firmware. Application tasks run on a FreeRTOS kernel for the host,
+// ESP-IDF drivers are replaced with models (sim/include, sim/idf*.cpp).
+// Deep sleep saves RTC memory and restarts the process, the same way the chip reboots.
+// Simulated time runs faster than real time while awake and is skipped while asleep.
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "mpu6050Model.hpp"
+#include "scenario.hpp"
+
+extern "C" {
+    #include "esp_log.h"
+    #include "esp_sleep.h"
+} // extern C close
+
+namespace SIM {
+
+// Wall time at power on: Monday 2026-01-05 00:00:00 UTC. Device clock is not set until the first sync
+const static constexpr int64_t epochStartUs = 1767571200LL * 1000000;
+
+// Rough costs of the hardware. Replace with measurements (telemetry, boot profile) when available
+// ROM, bootloader and application start until app_main
+const static constexpr int64_t bootDelayUs = 250000;
+// Wake stub: wake delay, accelerometer read, back to sleep
+const static constexpr int64_t stubDurationUs = 2500;
+const static constexpr float activeCurrentMa = 45.0;
+const static constexpr float stubCurrentMa = 12.0;
+const static constexpr float sleepCurrentMa = 0.015;
+
+// Board wiring of the models. MPU6050 INT, same pin as IMU::Imu
+const static constexpr int mpuInterruptPin = 4;
+
+struct Options {
+    double days = 7;                        // Simulated time
+    double speed = 20;                      // Simulated seconds per real second while awake
+    uint32_t seed = 1;                      // Generated scenario
+    std::string scenario;                   // Scenario file, generated week if empty
+    std::string nvsFile = "sim_nvs.bin";    // Flash, kept between runs
+    std::string rtcImage = "sim_rtc.bin";   // RTC memory, kept between simulated resets only
+    float driftPpm = 100;                   // RTC slow clock error while asleep
+    float batteryMah = 500;
+    uint32_t i2cFaultEvery = 0;             // Every Nth I2C transaction a slave holds SDA low, 0 never
+    std::string traceFile;                  // Trace frames read at each sync are appended, none if empty
+    std::string binaryLogFile;              // Same for binary log frames
+    esp_log_level_t log = ESP_LOG_WARN;
+};
+
+// Kept across simulated resets, next to the RTC memory image. Plain data only
+struct State {
+    int64_t wakeUs;             // Simulated time of this wake (since power on)
+    int64_t bootUs;             // Application start of this boot, esp_timer counts from here
+    int64_t clockErrorUs;       // Device system time minus true wall time
+    uint64_t sleepRequestUs;    // esp_sleep_enable_timer_wakeup
+    esp_sleep_wakeup_cause_t cause;
+    Mpu6050Model mpu;           // Accelerometer is powered all the time, keeps its registers
+    uint8_t i2cStuckClocks;     // and holds SDA through resets until it is clocked this many times
+    uint32_t nextSync;          // First phone sync of scenario not served yet
+    bool bonded;                // Phone and tracker keep keys of a pairing
+
+    // Statistics of the run
+    uint32_t boots;
+    uint32_t stubWakes;
+    int64_t awakeUs;            // Application, wake to sleep
+    int64_t stubUs;
+    double chargeMah;           // Used from battery
+    uint32_t syncs;
+    uint32_t positionsReceived;
+    int64_t worstClockErrorUs;  // At sync, before it was corrected
+    int64_t pairingUs;          // First connection, advertising start until encrypted
+    uint32_t reconnects;        // Later ones, with the bonded keys
+    int64_t reconnectUs;
+    int64_t worstReconnectUs;
+    uint32_t i2cTransactions;
+    uint32_t i2cFaults;         // SDA held low by the slave
+    uint32_t i2cRecoveries;     // SDA released by clocking SCL
+    uint32_t i2cAllocations;    // Heap blocks ESP-IDF takes: a dynamic link and each of its commands
+    uint64_t i2cBitTimes;       // On the wire: 9 per byte, 1 per START and STOP
+};
+
+const Options& GetOptions();
+State& GetState();
+const Scenario& GetScenario();
+
+/**
+ * @return false if this process continues after a simulated deep sleep or restart
+ */
+bool IsPowerOn();
+
+/**
+ * @return Size of RTC memory used by the application (RTC_DATA_ATTR)
+ */
+size_t GetRtcSize();
+
+/**
+ * @return Simulated time since power on [us]
+ */
+int64_t Now();
+
+/**
+ * @brief Stop simulated time, only AdvanceTime moves it. For host tests: kernel waits with
+ *      a timeout do not end until the time is advanced.
+ */
+void FreezeTime();
+void AdvanceTime(int64_t us);
+
+/**
+ * @return True wall time (what the phone shows) [us since epoch]
+ */
+int64_t GetWallTime();
+
+/**
+ * @return Time at which simulation ends [us since power on]
+ */
+int64_t GetEnd();
+
+/**
+ * @brief Wake stub of the application decides about the wake. See sim/wakeStub.cpp
+ * @param wakeUs time of wake
+ * @return time until next wake if stub went back to sleep, 0 if application boots
+ */
+int64_t RunWakeStub(int64_t wakeUs);
+
+/**
+ * @brief I2C lines driven as GPIO, during bus recovery. See sim/idfI2c.cpp
+ * @return false if pin is not an I2C line
+ */
+bool SetI2cLine(int pin, uint32_t level);
+
+/**
+ * @param[out] level of the line, low while slave holds it
+ * @return false if pin is not an I2C line
+ */
+bool GetI2cLine(int pin, int& level);
+
+/**
+ * @brief Input pin driven by a model or a scenario. Raises the GPIO interrupt of the
+ *      firmware on its edge, or while at its level.
+ */
+void SetGpioInput(int pin, uint32_t level);
+
+/**
+ * @return Image written to the update partition by esp_ota_write, valid after esp_ota_end
+ */
+const std::vector<uint8_t>& GetOtaImage();
+
+/**
+ * @brief Print what happened during simulation.
+ */
+void Report();
+
+} // namespace SIM end --------------------
@@ -0,0 +1,101 @@
+/**
+ * @file wakeStub.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+// Host version of app/appManagement/wakeStub.cpp. Same decision, taken by the simulated
+// deep sleep at each timer wake: go back to sleep if cube rests as it was and no BLE window is due.
+
+#include "wakeStub.hpp"
+#include "sim.hpp"
+#include <algorithm>
+#include <cstdlib>
+
+extern "C" {
+    #include "esp_attr.h"
+    #include "esp_log.h"
+} // extern C close
+
+using namespace APP;
+
+namespace {
+
+constexpr uint32_t armedMagic = 0x57414B45;
+
+struct StubState {
+    uint32_t armed;
+    int16_t resting[3];
+    int16_t threshold;
+    int64_t interval;
+    int64_t bleDeadline;    // Simulated time at which application must boot
+    uint32_t wakes;
+    int64_t lastDuration;
+    int64_t maxDuration;
+    int64_t totalDuration;
+};
+
+} // namespace end --------------------
+
+RTC_DATA_ATTR StubState stubState;
+
+int64_t SIM::RunWakeStub(int64_t wakeUs) {
+    if(stubState.armed != armedMagic || wakeUs >= stubState.bleDeadline) {
+        return 0;
+    }
+    auto raw = Mpu6050Model::GetAcceleration(wakeUs);
+    for(size_t i = 0; i < raw.size(); i++) {
+        if(std::abs(raw[i] - stubState.resting[i]) > stubState.threshold) {
+            return 0;
+        }
+    }
+    stubState.wakes++;
+    stubState.lastDuration = stubDurationUs;
+    stubState.maxDuration = std::max(stubState.maxDuration, stubState.lastDuration);
+    stubState.totalDuration += stubDurationUs;
+    return stubState.interval;
+}
+
+void WakeStub::Arm(const std::array<int16_t, 3>& resting, int16_t threshold,
+                    std::chrono::microseconds interval, std::chrono::microseconds toBle) {
+    for(size_t i = 0; i < resting.size(); i++) {
+        stubState.resting[i] = resting[i];
+    }
+    stubState.threshold = threshold;
+    stubState.interval = interval.count();
+    stubState.bleDeadline = SIM::Now() + (toBle.count() > 0 ? toBle.count() : 0);
+    stubState.armed = armedMagic;
+}
+
+void WakeStub::Disarm() {
+    stubState.armed = 0;
+}
+
+std::chrono::microseconds WakeStub::GetAwakeTime() {
+    return std::chrono::microseconds(SIM::Now() - SIM::GetState().wakeUs);
+}
+
+std::chrono::microseconds WakeStub::GetRtcTime() {
+    return std::chrono::microseconds(SIM::Now());
+}
+
+WakeStub::Stats WakeStub::GetStats() {
+    return Stats {
+        .wakes = stubState.wakes,
+        .total = std::chrono::microseconds(stubState.totalDuration),
+        .last = std::chrono::microseconds(stubState.lastDuration),
+        .max = std::chrono::microseconds(stubState.maxDuration),
+    };
+}
+
+void WakeStub::LogStats() {
+    auto stats = GetStats();
+    ESP_LOGI(__FILE__, "%s:%d. Stub wakes %u, wake to sleep last %u us, max %u us", __func__ ,__LINE__,
+                (unsigned int) stats.wakes, (unsigned int) stats.last.count(), (unsigned int) stats.max.count());
+    stubState.wakes = 0;
+    stubState.maxDuration = 0;
+    stubState.totalDuration = 0;
+}
@@ -9,6 +9,9 @@
 
 #include "appManagement.hpp"
 #include "nvs.hpp"
+#include "bootProfile.hpp"
+#include "trace.hpp"
+#include "binaryLog.hpp"
 
 extern "C" {
     #include <freertos/FreeRTOS.h>
@@ -16,9 +19,13 @@ extern "C" {
     #include <esp_system.h>
     #include <sdkconfig.h>
     #include "esp_ota_ops.h"
+    #include "esp_sleep.h"
 } // extern C close
 
 extern "C" void app_main() {
+    TELEMETRY::BootProfile::Start(APP::WakeStub::GetAwakeTime());
+    TELEMETRY::Trace::Start(esp_sleep_get_wakeup_cause());
+    TELEMETRY::BinaryLog::Start();
     const esp_partition_t *running_partition = esp_ota_get_running_partition();
     ESP_LOGI(__FILE__, "%s:%d. Boot on partition: %s", __func__ ,__LINE__, running_partition->label);
 
@@ -31,6 +38,7 @@ extern "C" void app_main() {
 
     NVS::Nvs nvs;
     ESP_ERROR_CHECK(nvs.init());
+    TELEMETRY::BootProfile::Mark(TELEMETRY::BootProfile::Marker::NvsInit);
 
     while (1) {
         vTaskDelay(10 / portTICK_PERIOD_MS);  // keep it, otherwise watchdog is not fed
@@ -0,0 +1,100 @@
+/**
+ * @file analogStreamTest.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+// AnalogStream on the ADC of sim/idfAdc.cpp: full cell (4.20 V) behind the divider by 2,
+// noise of 12 raw units and a spike 200 raw units low every 16th conversion
+
+#include "simTest.hpp"
+#include "analogStream.hpp"
+#include <gtest/gtest.h>
+#include <cstdlib>
+
+namespace {
+
+constexpr float pinMv = 2100;
+// Raw units of the model in mV, 11 dB attenuation
+constexpr float noiseMv = 12 * 3100.0 / 4095;
+constexpr float spikeMv = 200 * 3100.0 / 4095;
+constexpr size_t spikeEvery = 16;
+
+// Calibration scheme of the model, no eFuse values
+int schemeMillivolts(int raw) {
+    return raw * 3100 / 4095;
+}
+
+class AnalogStreamTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        TEST::Reset();
+        TEST::Options().log = ESP_LOG_NONE;
+        // Same noise each run
+        srand(1);
+    }
+};
+
+} // namespace end --------------------
+
+TEST_F(AnalogStreamTest, TableFollowsCalibration) {
+    // Table is built by the first stream
+    AnalogStream stream(ADC_UNIT_1, ADC_CHANNEL_6);
+    int previous = -1;
+    for(int raw = 0; raw <= 4095; raw++) {
+        const int mv = AnalogStream::RawToMillivolts(raw);
+        // Linear between points of the table, integer rounding only
+        EXPECT_NEAR(mv, schemeMillivolts(raw), 1) << "raw " << raw;
+        EXPECT_GE(mv, previous) << "raw " << raw;
+        previous = mv;
+    }
+    EXPECT_EQ(AnalogStream::RawToMillivolts(0), 0);
+    // Last point of the table is the value of 4095 at 4096
+    EXPECT_NEAR(AnalogStream::RawToMillivolts(4095), 3100, 1);
+    // Out of range raw values are clamped
+    EXPECT_EQ(AnalogStream::RawToMillivolts(-10), 0);
+    EXPECT_EQ(AnalogStream::RawToMillivolts(5000), AnalogStream::RawToMillivolts(4095));
+}
+
+TEST_F(AnalogStreamTest, BurstDropsSpikes) {
+    AnalogStream stream(ADC_UNIT_1, ADC_CHANNEL_6);
+    auto stats = stream.Measure(AnalogStream::maxSamples, 3);
+
+    EXPECT_EQ(stats.samples, AnalogStream::maxSamples - AnalogStream::maxSamples / spikeEvery);
+    // Mean of uniform noise, a few mV off at most
+    EXPECT_NEAR(stats.mean, pinMv, 3);
+    // Uniform noise: (2 * noise)^2 / 12, plus rounding of the table
+    EXPECT_LT(stats.variance, noiseMv * noiseMv / 3 + 5);
+    EXPECT_GT(stats.variance, 0);
+}
+
+TEST_F(AnalogStreamTest, BurstKeepsAllWithoutClipping) {
+    AnalogStream stream(ADC_UNIT_1, ADC_CHANNEL_6);
+    auto stats = stream.Measure(AnalogStream::maxSamples, 0);
+
+    EXPECT_EQ(stats.samples, AnalogStream::maxSamples);
+    // Spikes pull the mean down by their share
+    EXPECT_NEAR(stats.mean, pinMv - spikeMv / spikeEvery, 3);
+    // And dominate the variance
+    EXPECT_GT(stats.variance, spikeMv * spikeMv / spikeEvery / 2);
+}
+
+TEST_F(AnalogStreamTest, BurstLength) {
+    AnalogStream stream(ADC_UNIT_1, ADC_CHANNEL_6);
+    // Several DMA frames, not a whole one at the end
+    EXPECT_EQ(stream.Measure(100, 0).samples, 100u);
+    // Read buffer is the limit
+    EXPECT_EQ(stream.Measure(10 * AnalogStream::maxSamples, 0).samples, AnalogStream::maxSamples);
+}
+
+TEST_F(AnalogStreamTest, UnconnectedChannel) {
+    // Model converts only the battery input, other pins read ground
+    AnalogStream stream(ADC_UNIT_1, ADC_CHANNEL_0);
+    auto stats = stream.Measure(64);
+    EXPECT_EQ(stats.samples, 64u);
+    EXPECT_EQ(stats.mean, 0);
+    EXPECT_EQ(stats.variance, 0);
+}
@@ -0,0 +1,119 @@
+/**
+ * @file batteryTest.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+// Battery estimate on the ADC of sim/idfAdc.cpp. Cell voltage follows the charge used
+// (SIM::GetState().chargeMah), conversions have noise and a spike every 16th.
+
+#include "simTest.hpp"
+#include "battery.hpp"
+#include <gtest/gtest.h>
+#include <cstdlib>
+
+using namespace BATTERY;
+
+namespace {
+
+// Cell of the model at 100%, 90% and 50% charge left
+constexpr float fullMv = 4200;
+constexpr float ninetyMv = 4060;
+constexpr float halfMv = 3820;
+// Mean of a burst is within 3 mV at the pin, divider by 2
+constexpr float burstErrorMv = 6;
+
+// Charge left of the model cell, %
+void setCharge(float percent) {
+    SIM::GetState().chargeMah = (100 - percent) / 100 * SIM::GetOptions().batteryMah;
+}
+
+class BatteryTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        TEST::Reset();
+        TEST::Options().log = ESP_LOG_NONE;
+        // Same noise each run
+        srand(1);
+        setCharge(100);
+    }
+};
+
+} // namespace end --------------------
+
+TEST(BatteryInterpolate, CurvePoints) {
+    for(auto& point : defaultCurve) {
+        EXPECT_EQ(Battery::Interpolate(defaultCurve, point.millivolts), point.percent) << point.millivolts;
+    }
+    // Between points
+    EXPECT_EQ(Battery::Interpolate(defaultCurve, 3670), 15);
+    EXPECT_EQ(Battery::Interpolate(defaultCurve, 3075), 5);
+    EXPECT_EQ(Battery::Interpolate(defaultCurve, 4150), 95);
+}
+
+TEST(BatteryInterpolate, OutOfRange) {
+    EXPECT_EQ(Battery::Interpolate(defaultCurve, 2499), 0);
+    EXPECT_EQ(Battery::Interpolate(defaultCurve, 0), 0);
+    EXPECT_EQ(Battery::Interpolate(defaultCurve, -100), 0);
+    // Charging voltage is above the curve
+    EXPECT_EQ(Battery::Interpolate(defaultCurve, 4201), 100);
+    EXPECT_EQ(Battery::Interpolate(defaultCurve, 5000), 100);
+}
+
+TEST_F(BatteryTest, MeasureDropsSpikes) {
+    Battery battery(ADC_UNIT_1, ADC_CHANNEL_6);
+    // Spikes left in would pull the mean down by about 19 mV
+    EXPECT_NEAR(battery.Measure(), fullMv, burstErrorMv);
+}
+
+TEST_F(BatteryTest, NoEstimateBeforeUpdate) {
+    EXPECT_EQ(Battery::GetLastPercent(), -1);
+    EXPECT_EQ(Battery::GetVoltage(), 0);
+}
+
+TEST_F(BatteryTest, LoadCompensation) {
+    Battery battery(ADC_UNIT_1, ADC_CHANNEL_6);
+    const float loadMa = 500;
+    battery.Update(loadMa);
+    // Sag of the load on the internal resistance is added back
+    EXPECT_NEAR(Battery::GetVoltage(), fullMv + loadMa * Battery::internalResistance / 1000, burstErrorMv);
+    EXPECT_EQ(Battery::GetLastPercent(), 100);
+}
+
+TEST_F(BatteryTest, FilterSmoothsSmallSteps) {
+    Battery battery(ADC_UNIT_1, ADC_CHANNEL_6);
+    battery.Update(0);
+    EXPECT_NEAR(Battery::GetVoltage(), fullMv, burstErrorMv);
+
+    // Next wake, 140 mV lower: noise for the filter
+    setCharge(90);
+    battery.Update(0);
+    EXPECT_NEAR(Battery::GetVoltage(), fullMv + (ninetyMv - fullMv) / Battery::filterWeight, burstErrorMv);
+}
+
+TEST_F(BatteryTest, FilterResetsOnLargeStep) {
+    Battery battery(ADC_UNIT_1, ADC_CHANNEL_6);
+    battery.Update(0);
+
+    // Charger unplugged under load, or a long sleep: over filterResetMv, taken as is
+    setCharge(50);
+    const int percent = battery.Update(0);
+    EXPECT_NEAR(Battery::GetVoltage(), halfMv, burstErrorMv);
+    EXPECT_EQ(percent, Battery::Interpolate(defaultCurve, Battery::GetVoltage()));
+    EXPECT_EQ(Battery::GetLastPercent(), percent);
+}
+
+TEST_F(BatteryTest, FailedAdcKeepsEstimate) {
+    int percent;
+    {
+        Battery battery(ADC_UNIT_1, ADC_CHANNEL_6);
+        percent = battery.Update(0);
+    }
+    // Model converts only the battery input, other pins read ground, as a failed read
+    Battery unconnected(ADC_UNIT_1, ADC_CHANNEL_0);
+    EXPECT_EQ(unconnected.Update(0), percent);
+    EXPECT_NEAR(Battery::GetVoltage(), fullMv, burstErrorMv);
+}
@@ -0,0 +1,46 @@
+/**
+ * @file binaryLogDump.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+// Binary log of two boots, dumped as the desktop reads it: characteristic frames as hex,
+// one per line (input of tools/binaryLog.py). binaryLogRoundTrip.py expands it with the
+// formats of this file and checks the text.
+
+#include "simTest.hpp"
+#include "binaryLog.hpp"
+#include <cstdio>
+
+using TELEMETRY::BinaryLog;
+
+int main() {
+    TEST::Reset();
+    TEST::Options().log = ESP_LOG_NONE;
+
+    BinaryLog::Start();
+    SIM::AdvanceTime(412345);
+    BLOGW("Round trip battery %d mV, %.2f V, flags 0x%04x", -5, 3.75f, 0xABCDu);
+    SIM::AdvanceTime(1000);
+    BLOGE("Round trip " "adjacent literals, tab\there");
+
+    // Next boot
+    SIM::AdvanceTime(60000000);
+    BinaryLog::Start();
+    SIM::AdvanceTime(2000);
+    BLOGI("Round trip boot %u, %c", 2u, 'x');
+
+    for(;;) {
+        uint8_t frame[PROTOCOL::maxTelemetryFrameSize];
+        const size_t len = BinaryLog::Encode(frame, sizeof(frame));
+        for(size_t i = 0; i < len; i++) {
+            printf("%02x%c", frame[i], i + 1 < len ? ' ' : '\n');
+        }
+        if(len <= PROTOCOL::headerSize) {
+            return 0;
+        }
+    }
+}
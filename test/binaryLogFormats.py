@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+"""
+@file binaryLogFormats.py
+@author Maciej Sliwinski
+@brief This file is a part of time_tracker_esp32 project.
+
+The code is distributed under the MIT License.
+See the LICENCE file for more details.
+
+Formats tools/binaryLog.py extracts from the sources, as C++ table entries for
+binaryLogFormatsTest.cpp: the string literals as written in the source, so the compiler
+reads them, and the id the tool computed from its own unescaping.
+        { "Client connected. MTU %d", 0x1b2f3c4du, "services.cpp:38" },
+
+Usage:
+    binaryLogFormats.py OUTPUT [--sources DIR...]
+"""
+
+import argparse
+import os
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "tools"))
+import binaryLog  # noqa: E402
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Binary log formats of the sources as a C++ table")
+    parser.add_argument("output")
+    parser.add_argument("--sources", nargs="+", default=binaryLog.DEFAULT_SOURCES)
+    args = parser.parse_args()
+
+    # Same walk as binaryLog.extract, keeping the literals
+    entries = []
+    for source in args.sources:
+        for directory, _, files in os.walk(source):
+            for name in sorted(files):
+                if not binaryLog.SOURCE_FILES.match(name):
+                    continue
+                with open(os.path.join(directory, name), encoding="utf-8", errors="replace") as file:
+                    text = file.read()
+                for call in binaryLog.CALL.finditer(text):
+                    literals = [m.group(0) for m in binaryLog.LITERAL.finditer(call.group(1))]
+                    data = b"".join(binaryLog.unescape(m.group(1)) for m in binaryLog.LITERAL.finditer(call.group(1)))
+                    line = text.count("\n", 0, call.start()) + 1
+                    entries.append((" ".join(literals), binaryLog.fnv1a(data), "%s:%d" % (name, line)))
+
+    # Ids of the table the tool expands with must be the same ones
+    table = binaryLog.extract(args.sources)
+    if set(table) != {"%08x" % id for _, id, _ in entries}:
+        print("Table of binaryLog.extract differs from the calls found", file=sys.stderr)
+        return 1
+
+    with open(args.output, "w") as file:
+        file.write("// Generated by test/binaryLogFormats.py\n")
+        for literals, id, place in entries:
+            file.write("{ %s, 0x%08xu, \"%s\" },\n" % (literals, id, place))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,51 @@
+#!/usr/bin/env python3
+"""
+@file binaryLogRoundTrip.py
+@author Maciej Sliwinski
+@brief This file is a part of time_tracker_esp32 project.
+
+The code is distributed under the MIT License.
+See the LICENCE file for more details.
+
+Binary log dump of the firmware (binaryLogDump.cpp) expanded by tools/binaryLog.py with
+the formats of test/: each record must come back as the text the format and arguments give.
+
+Usage:
+    binaryLogRoundTrip.py BINARY_LOG_DUMP BINARY_LOG_PY
+"""
+
+import os
+import subprocess
+import sys
+
+# Boot, time, level and message of each record
+EXPECTED = [
+    (1, "0.412345", "W", "Round trip battery -5 mV, 3.75 V, flags 0xabcd"),
+    (1, "0.413345", "E", "Round trip adjacent literals, tab\there"),
+    (2, "60.415345", "I", "Round trip boot 2, x"),
+]
+
+
+def main():
+    dump_exe, binary_log_py = sys.argv[1:3]
+    dump = subprocess.run([dump_exe], check=True, stdout=subprocess.PIPE, universal_newlines=True).stdout
+    sources = os.path.dirname(os.path.abspath(__file__))
+    text = subprocess.run([sys.executable, binary_log_py, "--sources", sources], input=dump, check=True,
+                          stdout=subprocess.PIPE, universal_newlines=True).stdout
+
+    lines = text.splitlines()
+    if len(lines) != len(EXPECTED):
+        print("FAILED: %d records, expected %d\n%s" % (len(lines), len(EXPECTED), text))
+        return 1
+    for line, (boot, time, level, message) in zip(lines, EXPECTED):
+        fields = line.split(None, 5)
+        if fields[:4] != ["boot", str(boot), time, level] or not fields[4].startswith("binaryLogDump.cpp:") \
+                or fields[5] != message:
+            print("FAILED: '%s', expected boot %d at %s: %s %s" % (line, boot, time, level, message))
+            return 1
+    print("Round trip of %d records passed" % len(lines))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,186 @@
+/**
+ * @file binaryLogTest.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+// TELEMETRY::BinaryLog: format ids, records written by the macros and their dump, decoded
+// with PROTOCOL as the desktop does
+
+#include "simTest.hpp"
+#include "binaryLog.hpp"
+#include <gtest/gtest.h>
+#include <vector>
+
+using TELEMETRY::BinaryLog;
+
+// Compile time ids, as the macros use them
+static_assert(BinaryLog::Hash("") == 2166136261u, "FNV-1a offset basis");
+static_assert(BinaryLog::Hash("a") == 0xe40c292cu, "FNV-1a of \"a\"");
+
+namespace {
+
+std::vector<PROTOCOL::LogRecord> records;
+std::vector<uint16_t> firsts;
+
+/**
+ * @brief Read chunks as BLE does
+ * @param chunks most chunks to read, the dump is left in the middle after them
+ * @return false if a frame did not decode
+ */
+bool dump(size_t chunks = SIZE_MAX) {
+    records.clear();
+    firsts.clear();
+    for(size_t i = 0; i < chunks; i++) {
+        uint8_t frame[PROTOCOL::maxTelemetryFrameSize];
+        const size_t len = BinaryLog::Encode(frame, sizeof(frame));
+        if(len == PROTOCOL::headerSize) {
+            return true;
+        }
+        PROTOCOL::LogChunk chunk;
+        if(!PROTOCOL::Decode(frame, len, chunk)) {
+            return false;
+        }
+        firsts.push_back(chunk.first);
+        records.insert(records.end(), chunk.records.begin(), chunk.records.begin() + chunk.count);
+    }
+    return true;
+}
+
+// Each record a millisecond after the previous one
+void record(uint32_t value) {
+    SIM::AdvanceTime(1000);
+    BLOGI("Value %u", value);
+}
+
+uint32_t floatBits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+class BinaryLogTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        TEST::Reset();
+        TEST::Options().log = ESP_LOG_NONE;
+        BinaryLog::Start();
+    }
+};
+
+} // namespace end --------------------
+
+TEST(BinaryLogHash, Fnv1a) {
+    // Test vectors of the FNV reference, 32 bit FNV-1a
+    EXPECT_EQ(BinaryLog::Hash("foobar"), 0xbf9cf968u);
+    EXPECT_EQ(BinaryLog::Hash("foo"), 0xa9f37ed7u);
+    // Bytes above 0x7F are not sign extended
+    EXPECT_EQ(BinaryLog::Hash("\xff"), (2166136261u ^ 0xffu) * 16777619u);
+    EXPECT_NE(BinaryLog::Hash("Value %u"), BinaryLog::Hash("Value %d"));
+}
+
+TEST_F(BinaryLogTest, RecordRoundTrip) {
+    SIM::AdvanceTime(1234567);
+    BLOGW("Battery %d mV, %f V, flags %x", -5, 3.75f, 0xABCDu);
+    SIM::AdvanceTime(1000);
+    BLOGE("Plain message");
+    ASSERT_TRUE(dump());
+
+    ASSERT_EQ(records.size(), 2u);
+    EXPECT_EQ(records[0].id, BinaryLog::Hash("Battery %d mV, %f V, flags %x"));
+    EXPECT_EQ(records[0].time, 1234567u);
+    EXPECT_EQ(records[0].level, ESP_LOG_WARN);
+    EXPECT_EQ(records[0].argc, 3);
+    EXPECT_EQ(records[0].boot, 1);
+    EXPECT_EQ(records[0].args[0], (uint32_t) -5);
+    EXPECT_EQ(records[0].args[1], floatBits(3.75f));
+    EXPECT_EQ(records[0].args[2], 0xABCDu);
+    EXPECT_EQ(records[0].args[3], 0u);
+
+    EXPECT_EQ(records[1].id, BinaryLog::Hash("Plain message"));
+    EXPECT_EQ(records[1].level, ESP_LOG_ERROR);
+    EXPECT_EQ(records[1].argc, 0);
+    EXPECT_EQ(records[1].time, 1235567u);
+}
+
+TEST_F(BinaryLogTest, DebugCompiledOut) {
+    // BINARY_LOG_LEVEL is INFO
+    BLOGD("Not recorded %d", 1);
+    BLOGI("Recorded %d", 2);
+    ASSERT_TRUE(dump());
+
+    ASSERT_EQ(records.size(), 1u);
+    EXPECT_EQ(records[0].id, BinaryLog::Hash("Recorded %d"));
+}
+
+TEST_F(BinaryLogTest, RingKeepsNewestAfterWrapping) {
+    const uint32_t count = 3 * BINARY_LOG_RECORDS + 5;
+    for(uint32_t i = 0; i < count; i++) {
+        record(i);
+    }
+    ASSERT_TRUE(dump());
+
+    ASSERT_EQ(records.size(), (size_t) BINARY_LOG_RECORDS);
+    for(size_t i = 0; i < firsts.size(); i++) {
+        EXPECT_EQ(firsts[i], i * PROTOCOL::logChunkRecords);
+    }
+    for(size_t i = 0; i < records.size(); i++) {
+        // Oldest first
+        EXPECT_EQ(records[i].args[0], count - BINARY_LOG_RECORDS + i) << "record " << i;
+    }
+}
+
+TEST_F(BinaryLogTest, RingSurvivesNextBoot) {
+    for(uint32_t i = 0; i < 5; i++) {
+        record(i);
+    }
+    // Deep sleep: ring is in RTC memory, the next boot appends to it
+    BinaryLog::Start();
+    record(100);
+    ASSERT_TRUE(dump());
+
+    ASSERT_EQ(records.size(), 6u);
+    EXPECT_EQ(records[4].boot, 1);
+    EXPECT_EQ(records[5].boot, 2);
+    EXPECT_EQ(records[5].args[0], 100u);
+}
+
+TEST_F(BinaryLogTest, HalfReadDumpResumesAfterTimeout) {
+    for(uint32_t i = 0; i < BINARY_LOG_RECORDS; i++) {
+        record(i);
+    }
+    // Reader goes away without disconnecting, logging is paused
+    ASSERT_TRUE(dump(1));
+    SIM::AdvanceTime((BinaryLog::pauseTimeoutMs - 2) * 1000);
+    record(1000);
+    SIM::AdvanceTime(1000);
+    record(1001);
+
+    // Next reader starts from the beginning and sees the records after the timeout
+    ASSERT_TRUE(dump());
+    ASSERT_FALSE(firsts.empty());
+    EXPECT_EQ(firsts[0], 0);
+    ASSERT_EQ(records.size(), (size_t) BINARY_LOG_RECORDS);
+    EXPECT_EQ(records.back().args[0], 1001u);
+    EXPECT_EQ(records[records.size() - 2].args[0], BINARY_LOG_RECORDS - 1u);
+}
+
+#ifdef BINARY_LOG_FORMATS
+TEST(BinaryLogHash, SameAsTool) {
+    // Formats of the sources: literals compiled here, ids from tools/binaryLog.py
+    struct Format {
+        const char *format;
+        uint32_t id;
+        const char *place;
+    };
+    const Format formats[] = {
+        #include "binaryLogFormats.inc"
+    };
+    for(const auto& format : formats) {
+        EXPECT_EQ(BinaryLog::Hash(format.format), format.id) << format.place << " \"" << format.format << "\"";
+    }
+}
+#endif
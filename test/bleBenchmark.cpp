@@ -0,0 +1,187 @@
+/**
+ * @file bleBenchmark.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+// Desktop client stand-in against BLE::Services over SIM::LoopbackTransport. Full sync
+// (time sync exchange, position drain, telemetry) and OTA of an image, as the phone app does them.
+// Air time follows MTU and connection interval (see loopbackTransport.hpp), host time is
+// the service layer only (OTA: data packets only). IMU task is replaced by a queue of positions answering requests.
+// Fails if a position or a byte of the image is lost, or OTA does not speed up with MTU.
+
+#include "simTest.hpp"
+#include "loopbackTransport.hpp"
+#include "messages.hpp"
+#include "protocol.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <thread>
+#include <vector>
+
+using namespace BLE;
+
+namespace {
+
+constexpr int positions = 100;
+constexpr size_t imageSize = 256 * 1024;
+// Phone stops reading after that many empty position frames in a row
+constexpr int emptyReads = 3;
+
+enum OtaStatus : uint8_t { REQUEST = 1, REQUEST_ACK = 2, DONE = 4, DONE_ACK = 5 };
+
+struct Result {
+    uint64_t airUs;
+    double hostUs;
+    uint32_t count;
+    bool passed;
+};
+
+// Stand-in of IMU task: a request takes the next saved position
+std::deque<IMU::PositionQueueType> saved;
+
+void serveRequests() {
+    BUS::PositionRequest request;
+    while(BUS::Receive(request)) {
+        if(!saved.empty() && BUS::Publish(saved.front())) {
+            saved.pop_front();
+        }
+    }
+}
+
+double hostUsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+Result fullSync(uint16_t mtu) {
+    SIM::LoopbackTransport transport(mtu);
+    saved.clear();
+    for(int i = 0; i < positions; i++) {
+        saved.emplace_back(i % 6, (int) (SIM::epochStartUs / 1000000) + 60 * i);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    transport.Connect();
+
+    // Time sync exchange, see docs/bleApi.md
+    const uint8_t begin[] = {PROTOCOL::version};
+    const int64_t t1 = SIM::GetWallTime() / 1000;
+    transport.Write(CharacteristicId::TimeSync, begin, sizeof(begin));
+    auto frame = transport.Read(CharacteristicId::TimeSync);
+    PROTOCOL::TimeSyncResponse response;
+    bool passed = PROTOCOL::Decode(frame.data(), frame.size(), response);
+    auto adjust = PROTOCOL::ComputeTimeSync(t1, response, SIM::GetWallTime() / 1000);
+    std::array<uint8_t, PROTOCOL::maxFrameSize> adjustFrame;
+    transport.Write(CharacteristicId::TimeSync, adjustFrame.data(),
+                    PROTOCOL::Encode(adjust, adjustFrame.data(), adjustFrame.size()));
+
+    uint32_t received = 0;
+    for(int empty = 0; empty < emptyReads;) {
+        frame = transport.Read(CharacteristicId::Position);
+        PROTOCOL::Position position;
+        if(PROTOCOL::Decode(frame.data(), frame.size(), position)) {
+            received++;
+            empty = 0;
+        }
+        else {
+            empty++;
+        }
+        serveRequests();
+    }
+    frame = transport.ReadLong(CharacteristicId::Telemetry);
+    PROTOCOL::Telemetry telemetry;
+    passed &= PROTOCOL::Decode(frame.data(), frame.size(), telemetry);
+    transport.Disconnect();
+
+    return {transport.GetAirTimeUs(), hostUsSince(start), received, passed && received == positions};
+}
+
+Result ota(uint16_t mtu, uint8_t packetsPerEvent) {
+    SIM::LoopbackTransport transport(mtu, 24, packetsPerEvent);
+    std::vector<uint8_t> image(imageSize);
+    for(size_t i = 0; i < image.size(); i++) {
+        image[i] = (uint8_t) (i * 2654435761u >> 24);
+    }
+
+    transport.Connect();
+    const uint8_t request = REQUEST;
+    transport.Write(CharacteristicId::OtaControl, &request, 1);
+    auto status = transport.Read(CharacteristicId::OtaControl);
+    // Status is the raw enum of Services, first byte carries it
+    bool passed = !status.empty() && status[0] == REQUEST_ACK;
+
+    const size_t packet = mtu - 3;
+    uint32_t packetNo = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for(size_t offset = 0; passed && offset < image.size(); offset += packet, packetNo++) {
+        const size_t len = std::min(packet, image.size() - offset);
+        passed &= transport.WriteNoResponse(CharacteristicId::OtaData, &image[offset], len, packetNo);
+    }
+    const double hostUs = hostUsSince(start);
+    const uint8_t done = DONE;
+    transport.Write(CharacteristicId::OtaControl, &done, 1);
+    status = transport.Read(CharacteristicId::OtaControl);
+    passed &= !status.empty() && status[0] == DONE_ACK && SIM::GetOtaImage() == image;
+    transport.Disconnect();
+
+    return {transport.GetAirTimeUs(), hostUs, packetNo, passed};
+}
+
+} // namespace end --------------------
+
+int main() {
+    TEST::Reset();
+    TEST::Options().log = ESP_LOG_NONE;
+    BUS::Init(BUS::Topics());
+
+    // OTA end waits a second before sleep. Keep simulated time moving
+    std::atomic<bool> running(true);
+    std::thread clock([&running] {
+        while(running) {
+            SIM::AdvanceTime(1000);
+            std::this_thread::sleep_for(std::chrono::microseconds(20));
+        }
+    });
+
+    static bool passed = true;
+    TEST::RunInTask([](void *) {
+        printf("Full sync: time sync, %d positions, telemetry. Bulk link profile (%.1f ms interval)\n",
+                positions, Services::bulkLink.maxInterval * 1.25);
+        for(uint16_t mtu : {23, 247}) {
+            auto result = fullSync(mtu);
+            printf("  MTU %3u  air %7.3f s  %5.1f positions/s  host %6.1f us/position  %s\n", mtu,
+                    result.airUs / 1e6, result.count / (result.airUs / 1e6), result.hostUs / positions,
+                    result.passed ? "ok" : "FAILED");
+            passed &= result.passed;
+        }
+
+        printf("OTA: %u KiB image, write without response\n", (unsigned int) (imageSize / 1024));
+        double lowMtuRate = 0;
+        for(uint16_t mtu : {23, 185, 247}) {
+            for(uint8_t perEvent : {4, 6}) {
+                auto result = ota(mtu, perEvent);
+                const double rate = imageSize / 1024.0 / (result.airUs / 1e6);
+                printf("  MTU %3u  %u packets/event  air %7.2f s  %6.1f KiB/s  host %5.2f us/packet  %s\n",
+                        mtu, perEvent, result.airUs / 1e6, rate, result.hostUs / result.count,
+                        result.passed ? "ok" : "FAILED");
+                passed &= result.passed;
+                if(mtu == 23 && perEvent == 4) {
+                    lowMtuRate = rate;
+                }
+                else if(mtu == 247) {
+                    passed &= rate > 5 * lowMtuRate;
+                }
+            }
+        }
+    });
+
+    running = false;
+    clock.join();
+    printf("%s\n", passed ? "Benchmark passed" : "Benchmark failed");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,100 @@
+/**
+ * @file bleWindowTest.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#include "bleWindow.hpp"
+#include <gtest/gtest.h>
+
+using namespace APP;
+using namespace std::literals::chrono_literals;
+
+namespace {
+
+// Fake RTC clock, us since power on
+int64_t rtcUs;
+
+int64_t fakeNow() {
+    return rtcUs;
+}
+
+constexpr std::chrono::microseconds period = 2h;
+
+class BleWindowTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        // RTC memory is cleared at power on, boot takes a while
+        rtcUs = 300000;
+        last = 0;
+    }
+
+    int64_t last;
+};
+
+} // namespace end --------------------
+
+TEST_F(BleWindowTest, DueAfterPeriod) {
+    BleWindow window(fakeNow, last, period);
+    EXPECT_FALSE(window.Start());
+    EXPECT_EQ(window.GetTimeToWindow(), period - 300000us);
+
+    rtcUs = period.count();
+    EXPECT_FALSE(window.Start());
+    rtcUs += 1;
+    EXPECT_EQ(window.GetTimeToWindow(), 0us);
+    EXPECT_TRUE(window.Start());
+    // Next one a period later
+    EXPECT_EQ(last, rtcUs);
+    EXPECT_EQ(window.GetTimeToWindow(), period);
+    EXPECT_FALSE(window.Start());
+}
+
+TEST_F(BleWindowTest, LinkMovesWindow) {
+    BleWindow window(fakeNow, last, period);
+    rtcUs = 90 * 60 * 1000000LL;
+    window.OnLink();
+    rtcUs += 60 * 60 * 1000000LL;
+    EXPECT_FALSE(window.Start());
+    EXPECT_EQ(window.GetTimeToWindow(), 1h);
+}
+
+TEST_F(BleWindowTest, KeptAcrossSleep) {
+    {
+        BleWindow window(fakeNow, last, period);
+        window.OnLink();
+    }
+    // Deep sleep: RTC clock runs on, the window is built again after boot
+    rtcUs += std::chrono::microseconds(30min).count();
+    BleWindow window(fakeNow, last, period);
+    EXPECT_EQ(window.GetTimeToWindow(), 90min);
+    rtcUs += std::chrono::microseconds(90min).count() + 1;
+    EXPECT_TRUE(window.Start());
+}
+
+TEST_F(BleWindowTest, CountsDownWithRtcClock) {
+    // System time is stepped at each sync (1970 to 2026 at the first one), it is not an input.
+    // Time left only follows the RTC clock and stays within the period: WakeStub::Arm never
+    // gets a deadline years away
+    BleWindow window(fakeNow, last, period);
+    window.OnLink();
+    for(int i = 1; i <= 12; i++) {
+        rtcUs += std::chrono::microseconds(10min).count();
+        EXPECT_EQ(window.GetTimeToWindow(), period - i * 10min) << "step " << i;
+    }
+    EXPECT_EQ(window.GetTimeToWindow(), 0us);
+    rtcUs += 1;
+    EXPECT_TRUE(window.Start());
+}
+
+TEST_F(BleWindowTest, LastAheadOfClockIsDue) {
+    // RTC memory kept through a reset that restarted the clock
+    last = 50LL * 3600 * 1000000;
+    BleWindow window(fakeNow, last, period);
+    EXPECT_EQ(window.GetTimeToWindow(), 0us);
+    EXPECT_TRUE(window.Start());
+    EXPECT_EQ(window.GetTimeToWindow(), period);
+}
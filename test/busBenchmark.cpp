@@ -0,0 +1,134 @@
+/**
+ * @file busBenchmark.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+// BUS topics copy messages into their queues. Would a pool of static slots, with only a pointer
+// on the queue, pay off? Throughput of Publish + Receive in one task by message size, the
+// messages of messages.hpp against a pointer sized one, and latency from Publish in one task
+// to Receive in a waiting task of higher priority. Host kernel, only ratios carry over.
+// Fails if copying the largest message of the application costs more than maxCopyShare of
+// a pointer sized round trip: a pool would save no more than that, and adds its own locking.
+
+#include "simTest.hpp"
+#include "messages.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+constexpr int iterations = 200000;
+// Best of the runs, scheduling noise of the host is larger than the copy
+constexpr int runs = 7;
+constexpr int latencySamples = 10000;
+constexpr double maxCopyShare = 0.25;
+
+template<size_t Size>
+struct Payload {
+    uint8_t data[Size];
+};
+
+// What a pool would put on the queue
+struct Slot {
+    void *item;
+};
+
+} // namespace end --------------------
+
+namespace BUS {
+template<> struct Traits<Slot> : Config<100> {};
+template<> struct Traits<Payload<64>> : Config<101> {};
+template<> struct Traits<Payload<256>> : Config<102> {};
+} // namespace BUS end --------------------
+
+namespace {
+
+template<typename T>
+double nsPerRoundTrip() {
+    BUS::Topic<T>::Init();
+    T msg = {};
+    double best = 0;
+    for(int run = 0; run < runs; run++) {
+        const auto start = std::chrono::steady_clock::now();
+        for(int i = 0; i < iterations; i++) {
+            BUS::Publish(msg);
+            BUS::Receive(msg);
+        }
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        const double ns = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+        best = run == 0 || ns < best ? ns : best;
+    }
+    return best;
+}
+
+struct Latency {
+    std::vector<std::chrono::steady_clock::time_point> sent;
+    std::vector<double> us;
+};
+
+Latency latency;
+
+void consumerTask(void *) {
+    IMU::PositionQueueType position;
+    for(int i = 0; i < latencySamples; i++) {
+        BUS::Receive(position, portMAX_DELAY);
+        const auto elapsed = std::chrono::steady_clock::now() - latency.sent[position.face];
+        latency.us.push_back(std::chrono::duration<double, std::micro>(elapsed).count());
+    }
+    // Publisher waits for it
+    BUS::Publish(BUS::SleepStart {0}, portMAX_DELAY);
+    vTaskDelete(NULL);
+}
+
+double percentile(std::vector<double> values, double p) {
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, (size_t) (p / 100 * values.size()))];
+}
+
+} // namespace end --------------------
+
+int main() {
+    TEST::Reset();
+    TEST::Options().log = ESP_LOG_NONE;
+    BUS::Init(BUS::Topics());
+
+    static bool passed = true;
+    TEST::RunInTask([](void *) {
+        printf("Publish + Receive in one task, best of %d runs of %d round trips\n", runs, iterations);
+        const double slotNs = nsPerRoundTrip<Slot>();
+        auto report = [slotNs](const char *name, size_t size, double ns) {
+            printf("  %-24s %4zu B  %7.1f ns  copy %+6.1f ns against a pointer\n", name, size, ns, ns - slotNs);
+        };
+        report("pointer (pool slot)", sizeof(Slot), slotNs);
+        report("SleepPause", sizeof(BUS::SleepPause), nsPerRoundTrip<BUS::SleepPause>());
+        report("CalibrationQueueType", sizeof(IMU::CalibrationQueueType), nsPerRoundTrip<IMU::CalibrationQueueType>());
+        const double positionNs = nsPerRoundTrip<IMU::PositionQueueType>();
+        report("PositionQueueType", sizeof(IMU::PositionQueueType), positionNs);
+        report("64 B", 64, nsPerRoundTrip<Payload<64>>());
+        report("256 B", 256, nsPerRoundTrip<Payload<256>>());
+        passed &= positionNs - slotNs < maxCopyShare * slotNs;
+
+        // Receiving task waits above the publisher, publish switches to it
+        latency.sent.resize(latencySamples);
+        xTaskCreate(consumerTask, "Consumer", configMINIMAL_STACK_SIZE, NULL, 2, NULL);
+        for(int i = 0; i < latencySamples; i++) {
+            IMU::PositionQueueType position(i, 0);
+            latency.sent[i] = std::chrono::steady_clock::now();
+            passed &= BUS::Publish(position, portMAX_DELAY);
+        }
+        BUS::SleepStart done;
+        passed &= BUS::Receive(done, portMAX_DELAY);
+        printf("Publish to Receive in a waiting task, PositionQueueType, %d messages\n", latencySamples);
+        printf("  p50 %.2f us  p99 %.2f us  max %.2f us\n", percentile(latency.us, 50),
+                percentile(latency.us, 99), percentile(latency.us, 100));
+    });
+
+    printf("%s\n", passed ? "Benchmark passed" : "Benchmark failed");
+    return passed ? 0 : 1;
+}
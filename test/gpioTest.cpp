@@ -0,0 +1,170 @@
+/**
+ * @file gpioTest.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+// Deferred GPIO interrupts: ISR masks the pin and notifies a task, Acknowledge debounces
+// and unmasks. Inputs are driven with SIM::SetGpioInput, which runs the ISR in the caller.
+
+#include "simTest.hpp"
+#include "gpio.hpp"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace {
+
+// Button of the board, no model drives it
+constexpr int pin = 13;
+constexpr uint32_t bit = 1 << 3;
+
+// Notification taken without waiting, 0 if none
+uint32_t takeBits() {
+    uint32_t value = 0;
+    return xTaskNotifyWait(0, UINT32_MAX, &value, 0) == pdTRUE ? value : 0;
+}
+
+/**
+ * @brief Contact bouncing after an edge. Drives the pin from another thread and keeps
+ *      simulated time moving, so the debounce wait of Acknowledge ends.
+ */
+class Bouncer {
+    std::atomic<bool> running;
+    std::thread thread;
+
+public:
+    /**
+     * @param bounceUs the level toggles each millisecond until then, from the time of the call
+     * @param level held after bouncing
+     */
+    Bouncer(int64_t bounceUs, uint32_t level) : running(true) {
+        const int64_t start = SIM::Now();
+        thread = std::thread([this, start, bounceUs, level] {
+            while(running) {
+                const int64_t t = SIM::Now() - start;
+                SIM::SetGpioInput(pin, t < bounceUs ? (uint32_t) (t / 1000 % 2 == 0 ? !level : level) : level);
+                SIM::AdvanceTime(100);
+                std::this_thread::sleep_for(std::chrono::microseconds(20));
+            }
+        });
+    }
+
+    ~Bouncer() {
+        running = false;
+        thread.join();
+    }
+};
+
+class GpioTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        TEST::Reset();
+        TEST::Options().log = ESP_LOG_NONE;
+        SIM::SetGpioInput(pin, 0);
+    }
+};
+
+} // namespace end --------------------
+
+TEST_F(GpioTest, DeferredEdgeMaskedUntilAcknowledge) {
+    static uint32_t first, whileMasked, afterAcknowledge;
+    static Gpio::Stats masked, stats;
+
+    TEST::RunInTask([](void *) {
+        Gpio gpio(pin);
+        ASSERT_EQ(gpio.EnableDeferredInterrupt(Gpio::RISING, xTaskGetCurrentTaskHandle(), bit), ESP_OK);
+
+        SIM::AdvanceTime(1000);
+        SIM::SetGpioInput(pin, 1);
+        first = takeBits();
+        // More edges, the pin is masked
+        for(int i = 0; i < 3; i++) {
+            SIM::SetGpioInput(pin, 0);
+            SIM::SetGpioInput(pin, 1);
+        }
+        whileMasked = takeBits();
+        masked = gpio.GetStats();
+
+        // Task got to it 2 ms after the edge
+        SIM::AdvanceTime(2000);
+        gpio.Acknowledge();
+        SIM::SetGpioInput(pin, 0);
+        SIM::SetGpioInput(pin, 1);
+        afterAcknowledge = takeBits();
+        stats = gpio.GetStats();
+    });
+
+    EXPECT_EQ(first, bit);
+    EXPECT_EQ(whileMasked, 0u);
+    EXPECT_EQ(masked.interrupts, 1u);
+    EXPECT_EQ(masked.handled, 0u);
+    EXPECT_EQ(afterAcknowledge, bit);
+    EXPECT_EQ(stats.interrupts, 2u);
+    EXPECT_EQ(stats.handled, 1u);
+    EXPECT_EQ(stats.maxLatencyUs, 2000u);
+    EXPECT_EQ(stats.totalLatencyUs, 2000u);
+}
+
+TEST_F(GpioTest, LevelInterruptsAgainWhileHeld) {
+    static uint32_t first, afterAcknowledge, released;
+    static Gpio::Stats stats;
+
+    TEST::RunInTask([](void *) {
+        Gpio gpio(pin);
+        ASSERT_EQ(gpio.EnableDeferredInterrupt(Gpio::HIGH_LEVEL, xTaskGetCurrentTaskHandle(), bit), ESP_OK);
+        SIM::SetGpioInput(pin, 1);
+        first = takeBits();
+        // Level still holds, unmasking interrupts at once
+        gpio.Acknowledge();
+        afterAcknowledge = takeBits();
+        SIM::SetGpioInput(pin, 0);
+        gpio.Acknowledge();
+        released = takeBits();
+        stats = gpio.GetStats();
+    });
+
+    EXPECT_EQ(first, bit);
+    EXPECT_EQ(afterAcknowledge, bit);
+    EXPECT_EQ(released, 0u);
+    EXPECT_EQ(stats.interrupts, 2u);
+    EXPECT_EQ(stats.handled, 2u);
+}
+
+TEST_F(GpioTest, AcknowledgeWaitsOutBouncing) {
+    constexpr uint32_t debounceMs = 20;
+    constexpr int64_t bounceUs = 5000;
+    static uint32_t first, whileBouncing;
+    static bool level;
+    static int64_t elapsedUs;
+    static Gpio::Stats stats;
+
+    TEST::RunInTask([](void *) {
+        Gpio gpio(pin);
+        ASSERT_EQ(gpio.EnableDeferredInterrupt(Gpio::ANY, xTaskGetCurrentTaskHandle(), bit), ESP_OK);
+        SIM::SetGpioInput(pin, 1);
+        first = takeBits();
+        const int64_t start = SIM::Now();
+        {
+            // Released: bounces from high, low after it
+            Bouncer bouncer(bounceUs, 0);
+            level = gpio.Acknowledge(debounceMs);
+            elapsedUs = SIM::Now() - start;
+        }
+        // Edges of the bouncing were not interrupts
+        whileBouncing = takeBits();
+        stats = gpio.GetStats();
+    });
+
+    EXPECT_EQ(first, bit);
+    EXPECT_FALSE(level);
+    // The level changed at 1 ms the earliest, it held for the debounce time after the last change
+    EXPECT_GE(elapsedUs, 1000 + debounceMs * 1000);
+    EXPECT_EQ(whileBouncing, 0u);
+    EXPECT_EQ(stats.interrupts, 1u);
+    EXPECT_EQ(stats.handled, 1u);
+}
@@ -0,0 +1,157 @@
+/**
+ * @file i2cBenchmark.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+// Accelerometer reads over the fake bus of sim/idfI2c.cpp, a second of samples at
+// Imu::fifoSampleRateHz each way:
+//  - per axis on heap links, as I2C::slave_read did before (address write, STOP, read)
+//  - all axes in one repeated start burst on the static link (MPU6050::getAcc over I2cBus)
+//  - FIFO drained every Imu::fifoPeriod (MPU6050::startFifoRead, finishFifoRead)
+// Transactions, heap blocks ESP-IDF would take and bus time at 400 kHz are counted by the model,
+// host time is the driver code only. Fails if a static path allocates or FIFO does not cut
+// transactions per sample at least tenfold.
+
+#include "simTest.hpp"
+#include "imu.hpp"
+#include "mpu6050.hpp"
+#include <chrono>
+#include <cstdio>
+
+extern "C" {
+    #include "driver/i2c.h"
+} // extern C close
+
+namespace {
+
+constexpr uint32_t busHz = 400000;
+constexpr int samples = IMU::Imu::fifoSampleRateHz;
+constexpr uint8_t address = 0x68;
+constexpr uint8_t accelXoutH = 0x3B;
+
+struct Counters {
+    uint32_t transactions;
+    uint32_t allocations;
+    uint64_t bitTimes;
+    double hostUs;
+    int samples;
+};
+
+Counters snapshot() {
+    const auto& state = SIM::GetState();
+    return {state.i2cTransactions, state.i2cAllocations, state.i2cBitTimes, 0, 0};
+}
+
+// Former I2C::slave_read: register address in one transaction, data in another, links on the heap
+bool oldSlaveRead(uint8_t reg, uint8_t *buf, uint32_t len) {
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, address << 1, 1);
+    i2c_master_write_byte(cmd, reg, 1);
+    i2c_master_stop(cmd);
+    int ret = i2c_master_cmd_begin(I2C_NUM_0, cmd, 1000 / portTICK_PERIOD_MS);
+    i2c_cmd_link_delete(cmd);
+    if(ret == ESP_FAIL) {
+        return false;
+    }
+    cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, address << 1 | 1, 1);
+    for(; len; buf++, len--) {
+        i2c_master_read_byte(cmd, buf, (i2c_ack_type_t) (len == 1));
+    }
+    i2c_master_stop(cmd);
+    ret = i2c_master_cmd_begin(I2C_NUM_0, cmd, 1000 / portTICK_PERIOD_MS);
+    i2c_cmd_link_delete(cmd);
+    return ret != ESP_FAIL;
+}
+
+template<typename Code>
+Counters measure(Code code) {
+    const auto before = snapshot();
+    const auto start = std::chrono::steady_clock::now();
+    const int count = code();
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    auto after = snapshot();
+    return {after.transactions - before.transactions, after.allocations - before.allocations,
+            after.bitTimes - before.bitTimes, std::chrono::duration<double, std::micro>(elapsed).count(), count};
+}
+
+bool report(const char *name, const Counters& counters) {
+    const double perSample = counters.samples ? 1.0 / counters.samples : 0;
+    printf("  %-26s %7d  %6u %9.2f %12.2f %9.1f %%  %8.1f\n", name, counters.samples,
+            (unsigned int) counters.transactions, counters.transactions * perSample,
+            counters.allocations * perSample, 100.0 * counters.bitTimes / busHz, counters.hostUs * perSample);
+    return counters.samples == samples;
+}
+
+} // namespace end --------------------
+
+int main() {
+    TEST::Reset();
+    TEST::Options().log = ESP_LOG_NONE;
+
+    static bool passed = true;
+    TEST::RunInTask([](void *) {
+        auto& bus = I2cBus::Open({(gpio_num_t) 22, (gpio_num_t) 21, I2C_NUM_0, 50});
+        static MPU6050 mpu(bus);
+        passed &= mpu.init() && mpu.setProfile(MPU6050::Profile::FullAccel, IMU::Imu::fifoSampleRateHz);
+        const int64_t periodUs = 1000000 / IMU::Imu::fifoSampleRateHz;
+
+        printf("A second of accelerometer samples at %d Hz\n", samples);
+        printf("  %-26s %7s  %6s %9s %12s %10s  %8s\n", "", "samples", "trans.", "/sample",
+                "heap/sample", "bus busy", "host us/sample");
+
+        auto perAxis = measure([periodUs] {
+            int count = 0;
+            for(int i = 0; i < samples; i++) {
+                SIM::AdvanceTime(periodUs);
+                uint8_t raw[6];
+                bool ok = true;
+                for(int axis = 0; axis < 3; axis++) {
+                    ok &= oldSlaveRead(accelXoutH + 2 * axis, raw + 2 * axis, 2);
+                }
+                count += ok;
+            }
+            return count;
+        });
+        passed &= report("per axis, heap links", perAxis);
+
+        auto burst = measure([periodUs] {
+            int count = 0;
+            for(int i = 0; i < samples; i++) {
+                SIM::AdvanceTime(periodUs);
+                std::array<float, 3> acc;
+                count += mpu.getAcc(acc);
+            }
+            return count;
+        });
+        passed &= report("burst per sample", burst);
+        passed &= burst.allocations == 0;
+
+        passed &= mpu.enableFifo() && mpu.resetFifo();
+        auto fifo = measure([] {
+            int count = 0;
+            static int16_t block[IMU::Imu::maxBurst * MPU6050::maxFifoValues];
+            const int periods = 1000 / IMU::Imu::fifoPeriod.count();
+            for(int i = 0; i < periods; i++) {
+                SIM::AdvanceTime(IMU::Imu::fifoPeriod.count() * 1000);
+                if(mpu.startFifoRead()) {
+                    const int read = mpu.finishFifoRead(block, IMU::Imu::maxBurst);
+                    count += read > 0 ? read : 0;
+                }
+            }
+            return count;
+        });
+        passed &= report("FIFO every 100 ms", fifo);
+        passed &= fifo.allocations == 0;
+        passed &= fifo.transactions * 10 <= perAxis.transactions;
+    });
+
+    printf("%s\n", passed ? "Benchmark passed" : "Benchmark failed");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,101 @@
+/**
+ * @file i2cBusTest.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+// Task notifications of I2cBus transactions, on the MPU6050 model of the fake bus
+
+#include "simTest.hpp"
+#include "i2cBus.hpp"
+#include <gtest/gtest.h>
+
+namespace {
+
+constexpr uint8_t address = 0x68;
+constexpr uint8_t whoAmI = 0x75;
+// Event of the task itself, as IMU::Event
+constexpr uint32_t eventBit = 1 << 0;
+constexpr uint32_t readBit = 1 << 4;
+
+I2cBus& bus() {
+    return I2cBus::Open({(gpio_num_t) 22, (gpio_num_t) 21, I2C_NUM_0, 50});
+}
+
+// Notification left to the next wait of the task
+struct Pending {
+    bool pending;
+    uint32_t value;
+};
+
+Pending takePending() {
+    Pending result = {};
+    result.pending = xTaskNotifyWait(0, UINT32_MAX, &result.value, 0) == pdTRUE;
+    return result;
+}
+
+class I2cBusTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        TEST::Reset();
+        TEST::Options().log = ESP_LOG_NONE;
+    }
+};
+
+} // namespace end --------------------
+
+TEST_F(I2cBusTest, ReadLeavesNoNotification) {
+    static uint8_t id;
+    static Pending left;
+
+    TEST::RunInTask([](void *) {
+        I2cDevice device(bus(), address);
+        ASSERT_EQ(device.Read(whoAmI, &id, 1), ESP_OK);
+        left = takePending();
+    });
+
+    EXPECT_EQ(id, address);
+    EXPECT_FALSE(left.pending);
+}
+
+TEST_F(I2cBusTest, WaitTakesBitsOfDoneTransaction) {
+    static uint8_t ids[2];
+    static bool done;
+    static Pending left;
+
+    TEST::RunInTask([](void *) {
+        I2cDevice device(bus(), address);
+        I2cBus::Transaction transaction = {};
+        ASSERT_EQ(device.StartRead(transaction, whoAmI, &ids[0], 1, readBit), ESP_OK);
+        // Bus serves in order, the started read is done once this one returns. Its bit
+        // woke the wait of this read and was put back
+        ASSERT_EQ(device.Read(whoAmI, &ids[1], 1), ESP_OK);
+        done = transaction.done;
+        ASSERT_EQ(device.Wait(transaction), ESP_OK);
+        left = takePending();
+    });
+
+    EXPECT_EQ(ids[0], address);
+    EXPECT_EQ(ids[1], address);
+    EXPECT_TRUE(done);
+    EXPECT_FALSE(left.pending);
+    EXPECT_EQ(left.value & (readBit | I2cBus::syncBit), 0u);
+}
+
+TEST_F(I2cBusTest, OtherBitsStayPending) {
+    static uint8_t id;
+    static Pending left;
+
+    TEST::RunInTask([](void *) {
+        I2cDevice device(bus(), address);
+        xTaskNotify(xTaskGetCurrentTaskHandle(), eventBit, eSetBits);
+        ASSERT_EQ(device.Read(whoAmI, &id, 1), ESP_OK);
+        left = takePending();
+    });
+
+    EXPECT_TRUE(left.pending);
+    EXPECT_EQ(left.value, eventBit);
+}
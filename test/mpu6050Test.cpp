@@ -0,0 +1,190 @@
+/**
+ * @file mpu6050Test.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+// MPU6050 driver against the register model of sim/mpu6050Model.cpp
+
+#include "simTest.hpp"
+#include "imu.hpp"
+#include "mpu6050.hpp"
+#include "messages.hpp"
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Model keeps noise within that, see mpu6050Model.cpp
+constexpr int maxNoise = 200;
+constexpr int16_t canary = 0x5A5A;
+
+I2cBus& bus() {
+    return I2cBus::Open({(gpio_num_t) 22, (gpio_num_t) 21, I2C_NUM_0, 50});
+}
+
+// Registers as the datasheet gives them, apart from the driver's table
+struct ExpectedProfile {
+    MPU6050::Profile profile;
+    uint8_t pwrMgmt1;
+    uint8_t pwrMgmt2;
+    int64_t dataReadyPeriodUs;  // Full ones at 100 Hz
+};
+
+const ExpectedProfile expectedProfiles[] = {
+    {MPU6050::Profile::Off, 0x48, 0x3F, 0},
+    {MPU6050::Profile::Cycle1_25Hz, 0x28, 0x07, 800000},
+    {MPU6050::Profile::Cycle5Hz, 0x28, 0x47, 200000},
+    {MPU6050::Profile::Cycle20Hz, 0x28, 0x87, 50000},
+    {MPU6050::Profile::Cycle40Hz, 0x28, 0xC7, 25000},
+    {MPU6050::Profile::FullAccel, 0x08, 0x07, 10000},
+    {MPU6050::Profile::FullAccelGyro, 0x09, 0x00, 10000},
+};
+
+// Registers the sleep request leaves behind
+struct SleepRegisters {
+    uint8_t power[2];
+    uint8_t fifoEn;
+    uint8_t intEnable;
+    uint8_t userCtrl;
+};
+
+class Mpu6050Test : public ::testing::Test {
+protected:
+    void SetUp() override {
+        TEST::Reset();
+        TEST::Options().log = ESP_LOG_NONE;
+    }
+};
+
+} // namespace end --------------------
+
+TEST_F(Mpu6050Test, GyroFifoSamplesKeepStride) {
+    // Whole FIFO of samples with gyroscope, block sized as ImuTask does, canaries behind it
+    static std::vector<int16_t> block;
+    block.assign(IMU::Imu::maxBurst * MPU6050::maxFifoValues + 16, canary);
+    static int samples;
+    static uint8_t values;
+
+    TEST::RunInTask([](void *) {
+        MPU6050 mpu(bus());
+        ASSERT_TRUE(mpu.init());
+        ASSERT_TRUE(mpu.setProfile(MPU6050::Profile::FullAccelGyro, 100));
+        ASSERT_TRUE(mpu.enableFifo());
+        values = mpu.getFifoValues();
+        // More than the FIFO holds without overflow: 85 samples of 12 B
+        SIM::AdvanceTime(800000);
+        ASSERT_TRUE(mpu.startFifoRead());
+        samples = mpu.finishFifoRead(block.data(), IMU::Imu::maxBurst);
+    });
+
+    ASSERT_EQ(values, MPU6050::maxFifoValues);
+    EXPECT_EQ(samples, 80);
+    const auto gravity = SIM::Mpu6050Model::GetGravity(SIM::GetScenario().GetFace(0));
+    for(int i = 0; i < samples; i++) {
+        const int16_t *sample = block.data() + values * i;
+        for(int axis = 0; axis < 3; axis++) {
+            EXPECT_NEAR(sample[axis], MPU6050::AccToRaw(gravity[axis]), maxNoise) << "sample " << i;
+            // Gyroscope of the model reads zero
+            EXPECT_EQ(sample[3 + axis], 0) << "sample " << i;
+        }
+    }
+    for(size_t i = samples * values; i < block.size(); i++) {
+        ASSERT_EQ(block[i], canary) << "value " << i;
+    }
+}
+
+TEST_F(Mpu6050Test, AccelFifoSamples) {
+    static int16_t block[IMU::Imu::maxBurst * MPU6050::maxFifoValues];
+    static int samples;
+    static uint8_t values;
+
+    TEST::RunInTask([](void *) {
+        MPU6050 mpu(bus());
+        ASSERT_TRUE(mpu.init());
+        ASSERT_TRUE(mpu.setProfile(MPU6050::Profile::FullAccel, 100));
+        ASSERT_TRUE(mpu.enableFifo());
+        values = mpu.getFifoValues();
+        SIM::AdvanceTime(100000);
+        ASSERT_TRUE(mpu.startFifoRead());
+        samples = mpu.finishFifoRead(block, IMU::Imu::maxBurst);
+    });
+
+    ASSERT_EQ(values, 3);
+    EXPECT_EQ(samples, 10);
+    const auto gravity = SIM::Mpu6050Model::GetGravity(SIM::GetScenario().GetFace(0));
+    for(int i = 0; i < samples; i++) {
+        for(int axis = 0; axis < 3; axis++) {
+            EXPECT_NEAR(block[values * i + axis], MPU6050::AccToRaw(gravity[axis]), maxNoise) << "sample " << i;
+        }
+    }
+}
+
+TEST_F(Mpu6050Test, ProfileRegisters) {
+    static uint8_t power[sizeof(expectedProfiles) / sizeof(expectedProfiles[0])][2];
+    static int64_t periods[sizeof(expectedProfiles) / sizeof(expectedProfiles[0])];
+    static bool set[sizeof(expectedProfiles) / sizeof(expectedProfiles[0])];
+
+    TEST::RunInTask([](void *) {
+        MPU6050 mpu(bus());
+        I2cDevice device(bus(), MPU6050_ADDR);
+        ASSERT_TRUE(mpu.init());
+        ASSERT_TRUE(mpu.enableDataReadyInterrupt());
+        for(size_t i = 0; i < sizeof(expectedProfiles) / sizeof(expectedProfiles[0]); i++) {
+            set[i] = mpu.setProfile(expectedProfiles[i].profile, 100);
+            ASSERT_EQ(device.Read(PWR_MGMT_1, power[i], 2), ESP_OK);
+            periods[i] = SIM::GetState().mpu.GetDataReadyPeriodUs();
+        }
+    });
+
+    for(size_t i = 0; i < sizeof(expectedProfiles) / sizeof(expectedProfiles[0]); i++) {
+        const auto& expected = expectedProfiles[i];
+        EXPECT_TRUE(set[i]) << "profile " << i;
+        EXPECT_EQ(power[i][0], expected.pwrMgmt1) << "profile " << i;
+        EXPECT_EQ(power[i][1], expected.pwrMgmt2) << "profile " << i;
+        EXPECT_EQ(periods[i], expected.dataReadyPeriodUs) << "profile " << i;
+    }
+}
+
+TEST_F(Mpu6050Test, SleepRequestStopsFifoAndInterrupt) {
+    static bool asleep;
+    static SleepRegisters registers;
+    static int64_t period;
+
+    BUS::Init(BUS::Topics());
+    // Awake with FIFO and data ready interrupt, as after boot
+    xTaskCreate(IMU::ImuTask, "ImuTask", 4 * 1024, NULL, 3, NULL);
+    while(ImuHandle == nullptr) {
+        std::this_thread::yield();
+    }
+
+    TEST::RunInTask([](void *) {
+        I2cDevice device(bus(), MPU6050_ADDR);
+        // Interrupt is the last one ImuTask enables
+        uint8_t intEnable = 0;
+        while(intEnable == 0) {
+            ASSERT_EQ(device.Read(INT_ENABLE, &intEnable, 1), ESP_OK);
+        }
+        asleep = IMU::Imu::PrepareSleep();
+        ASSERT_EQ(device.Read(PWR_MGMT_1, registers.power, 2), ESP_OK);
+        ASSERT_EQ(device.Read(FIFO_EN, &registers.fifoEn, 1), ESP_OK);
+        ASSERT_EQ(device.Read(INT_ENABLE, &registers.intEnable, 1), ESP_OK);
+        ASSERT_EQ(device.Read(USER_CTRL, &registers.userCtrl, 1), ESP_OK);
+        period = SIM::GetState().mpu.GetDataReadyPeriodUs();
+    });
+
+    EXPECT_TRUE(asleep);
+    const auto& expected = expectedProfiles[(size_t) IMU::Imu::sleepProfile];
+    EXPECT_EQ(registers.power[0], expected.pwrMgmt1);
+    EXPECT_EQ(registers.power[1], expected.pwrMgmt2);
+    EXPECT_EQ(registers.fifoEn, 0);
+    EXPECT_EQ(registers.intEnable, 0);
+    // FIFO enable bit
+    EXPECT_EQ(registers.userCtrl & 0x40, 0);
+    EXPECT_EQ(period, 0);
+}
@@ -0,0 +1,109 @@
+/**
+ * @file powerGovernorTest.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+// Power tiers of APP::PowerGovernor and the time spent in them, read back from the telemetry frame
+
+#include "simTest.hpp"
+#include "powerGovernor.hpp"
+#include "telemetry.hpp"
+#include <gtest/gtest.h>
+
+using namespace APP;
+using PROTOCOL::PowerTier;
+
+namespace {
+
+PROTOCOL::Telemetry telemetry() {
+    uint8_t frame[PROTOCOL::maxTelemetryFrameSize];
+    PROTOCOL::Telemetry msg = {};
+    const size_t len = TELEMETRY::Telemetry::Encode(frame, sizeof(frame));
+    EXPECT_TRUE(PROTOCOL::Decode(frame, len, msg));
+    return msg;
+}
+
+class PowerGovernorTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        TEST::Reset();
+        TEST::Options().log = ESP_LOG_NONE;
+    }
+};
+
+} // namespace end --------------------
+
+TEST(PowerGovernorSelect, EnteredBelowThreshold) {
+    EXPECT_EQ(PowerGovernor::Select(PowerTier::Normal, 100), PowerTier::Normal);
+    EXPECT_EQ(PowerGovernor::Select(PowerTier::Normal, 40), PowerTier::Normal);
+    EXPECT_EQ(PowerGovernor::Select(PowerTier::Normal, 39), PowerTier::Saving);
+    EXPECT_EQ(PowerGovernor::Select(PowerTier::Saving, 20), PowerTier::Saving);
+    EXPECT_EQ(PowerGovernor::Select(PowerTier::Saving, 19), PowerTier::Low);
+    EXPECT_EQ(PowerGovernor::Select(PowerTier::Low, 4), PowerTier::Protect);
+    EXPECT_EQ(PowerGovernor::Select(PowerTier::Protect, 0), PowerTier::Protect);
+    // Battery drops fast under load, tiers are skipped
+    EXPECT_EQ(PowerGovernor::Select(PowerTier::Normal, 3), PowerTier::Protect);
+}
+
+TEST(PowerGovernorSelect, HysteresisUpwards) {
+    constexpr int h = PowerGovernor::hysteresis;
+    // Voltage recovers when the load is gone, just above the threshold is not enough
+    EXPECT_EQ(PowerGovernor::Select(PowerTier::Saving, 40), PowerTier::Saving);
+    EXPECT_EQ(PowerGovernor::Select(PowerTier::Saving, 40 + h - 1), PowerTier::Saving);
+    EXPECT_EQ(PowerGovernor::Select(PowerTier::Saving, 40 + h), PowerTier::Normal);
+
+    EXPECT_EQ(PowerGovernor::Select(PowerTier::Protect, 5 + h - 1), PowerTier::Protect);
+    EXPECT_EQ(PowerGovernor::Select(PowerTier::Protect, 5 + h), PowerTier::Low);
+    // Charged while in Protect: straight up, thresholds of each tier left apply
+    EXPECT_EQ(PowerGovernor::Select(PowerTier::Protect, 20 + h - 1), PowerTier::Low);
+    EXPECT_EQ(PowerGovernor::Select(PowerTier::Protect, 90), PowerTier::Normal);
+
+    // Downwards there is none
+    EXPECT_EQ(PowerGovernor::Select(PowerTier::Low, 20 + h - 1), PowerTier::Low);
+    EXPECT_EQ(PowerGovernor::Select(PowerTier::Normal, 40 - 1), PowerTier::Saving);
+}
+
+TEST(PowerGovernorPolicy, ClampedToNormal) {
+    EXPECT_EQ(&PowerGovernor::GetPolicy(PowerTier::Low), &PowerGovernor::policies[(size_t) PowerTier::Low]);
+    // RTC memory of another firmware
+    EXPECT_EQ(&PowerGovernor::GetPolicy(PowerTier::Count), &PowerGovernor::policies[0]);
+    EXPECT_EQ(&PowerGovernor::GetPolicy((PowerTier) 200), &PowerGovernor::policies[0]);
+    EXPECT_TRUE(PowerGovernor::GetPolicy((PowerTier) 200).radio);
+}
+
+TEST_F(PowerGovernorTest, UnknownLevelKeepsTier) {
+    EXPECT_EQ(PowerGovernor::Update(15, 1s), PowerTier::Low);
+    EXPECT_EQ(PowerGovernor::Update(-1, 2s), PowerTier::Low);
+    EXPECT_EQ(PowerGovernor::GetTier(), PowerTier::Low);
+    EXPECT_EQ(&PowerGovernor::GetPolicy(), &PowerGovernor::policies[(size_t) PowerTier::Low]);
+    EXPECT_EQ(PowerGovernor::LimitBleInterval(1min), 60min);
+    EXPECT_EQ(PowerGovernor::LimitBleInterval(2h), 2h);
+}
+
+TEST_F(PowerGovernorTest, TimeInTiersFollowsRtcClock) {
+    PowerGovernor::Update(80, 10s);
+    PowerGovernor::Update(80, 70s);
+    // Saving from here
+    PowerGovernor::Update(30, 100500ms);
+    PowerGovernor::Update(30, 130s);
+
+    auto msg = telemetry();
+    EXPECT_EQ(msg.powerTier, (uint8_t) PowerTier::Saving);
+    EXPECT_EQ(msg.tierChanges, 1u);
+    // Time up to the change belongs to the tier left, remainder of a second goes on
+    EXPECT_EQ(msg.tierTime[(size_t) PowerTier::Normal], 90u);
+    EXPECT_EQ(msg.tierTime[(size_t) PowerTier::Saving], 30u);
+}
+
+TEST_F(PowerGovernorTest, LongSleepCounts) {
+    // Protect tier boots once a day, a week in it is all accounted
+    PowerGovernor::Update(3, 1s);
+    for(int day = 1; day <= 7; day++) {
+        PowerGovernor::Update(3, 1s + std::chrono::hours(24 * day));
+    }
+    EXPECT_EQ(telemetry().tierTime[(size_t) PowerTier::Protect], 7u * 24 * 3600);
+}
@@ -0,0 +1,88 @@
+/**
+ * @file protocolBenchmark.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+// Frames of PROTOCOL against the strings sent before it: size and encode time on the host.
+// Times are of the host CPU, only the ratio carries over to the target.
+// Fails if a binary frame does not fit maxFrameSize (one ATT payload).
+
+#include "protocol.hpp"
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+using namespace PROTOCOL;
+
+namespace {
+
+constexpr int iterations = 1000000;
+
+volatile size_t sink;
+
+// Former encodings (services.cpp, imu.cpp)
+std::string oldPosition(const Position& item) {
+    return std::to_string(item.startTime) + "," + std::to_string(item.face);
+}
+
+std::string oldCalibration(const Calibration& item) {
+    return std::to_string(item.status) + ',' + std::to_string(item.face);
+}
+
+template<typename Code>
+double nsPerCall(Code code) {
+    const auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < iterations; i++) {
+        code(i);
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+bool report(const char *name, size_t oldSize, size_t newSize, double oldNs, double newNs) {
+    printf("%-12s size %3zu B -> %3zu B   encode %7.1f ns -> %6.1f ns (x%.1f)\n",
+            name, oldSize, newSize, oldNs, newNs, oldNs / newNs);
+    return newSize > 0 && newSize <= maxFrameSize;
+}
+
+} // namespace end --------------------
+
+int main() {
+    bool passed = true;
+    uint8_t frame[maxFrameSize];
+
+    // Epoch seconds of 2026 and the highest face
+    const Position position = {.face = 11, .startTime = 1767571200};
+    const double oldPositionNs = nsPerCall([&](int i) {
+        Position item = position;
+        item.startTime += i;
+        sink = oldPosition(item).size();
+    });
+    const double newPositionNs = nsPerCall([&](int i) {
+        Position item = position;
+        item.startTime += i;
+        sink = Encode(item, frame, sizeof(frame));
+    });
+    passed &= report("Position", oldPosition(position).size(), Encode(position, frame, sizeof(frame)),
+                    oldPositionNs, newPositionNs);
+
+    const Calibration calibration = {.status = 2, .face = 5};
+    const double oldCalibrationNs = nsPerCall([&](int i) {
+        Calibration item = calibration;
+        item.face = (int8_t) (i % 6);
+        sink = oldCalibration(item).size();
+    });
+    const double newCalibrationNs = nsPerCall([&](int i) {
+        Calibration item = calibration;
+        item.face = (int8_t) (i % 6);
+        sink = Encode(item, frame, sizeof(frame));
+    });
+    // Old queue item was sizeof("x,xx"), the string was cut to it
+    passed &= report("Calibration", sizeof("x,xx"), Encode(calibration, frame, sizeof(frame)),
+                    oldCalibrationNs, newCalibrationNs);
+    return passed ? 0 : 1;
+}
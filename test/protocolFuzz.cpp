@@ -0,0 +1,190 @@
+/**
+ * @file protocolFuzz.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+// Decoder of frames received over the air. Any input must decode without reading
+// past it, and whatever decodes must encode back to a frame decoding to the same message.
+// Built with clang: libFuzzer target (-fsanitize=fuzzer). Otherwise main() below runs
+// a fixed number of random and mutated frames, under ASan and UBSan.
+//   protocol_fuzz [iterations] [corpus files...]
+
+#include "protocol.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace PROTOCOL;
+
+namespace {
+
+void check(bool condition, const char *what) {
+    if(!condition) {
+        fprintf(stderr, "Protocol fuzz: %s\n", what);
+        abort();
+    }
+}
+
+/**
+ * @brief Decode, encode and decode again. Encoded frames of both passes must be equal
+ */
+template<typename T>
+void roundTrip(const uint8_t *data, size_t size) {
+    T first = {};
+    if(!Decode(data, size, first)) {
+        return;
+    }
+    uint8_t frame[maxTelemetryFrameSize];
+    const size_t len = Encode(first, frame, sizeof(frame));
+    check(len > 0, "decoded message does not encode");
+
+    T second = {};
+    check(Decode(frame, len, second), "encoded message does not decode");
+    uint8_t again[maxTelemetryFrameSize];
+    check(Encode(second, again, sizeof(again)) == len && memcmp(frame, again, len) == 0,
+            "message changed in round trip");
+}
+
+} // namespace end --------------------
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    // Exact size, so ASan sees reads past the input
+    std::vector<uint8_t> input(data, data + size);
+    const uint8_t *frame = input.empty() ? nullptr : input.data();
+
+    Decoder decoder(frame, size);
+    Tag tag;
+    const uint8_t *value = nullptr;
+    uint8_t len = 0;
+    size_t items = 0;
+    while(decoder.Next(tag, value, len)) {
+        check(value >= frame && value + len <= frame + size, "item outside of frame");
+        items++;
+    }
+    check(items <= size / itemHeaderSize, "more items than bytes");
+
+    roundTrip<Position>(frame, size);
+    roundTrip<Calibration>(frame, size);
+    roundTrip<TimeSyncResponse>(frame, size);
+    roundTrip<TimeSyncAdjust>(frame, size);
+    roundTrip<BootProfile>(frame, size);
+    roundTrip<TraceChunk>(frame, size);
+    roundTrip<LogChunk>(frame, size);
+    roundTrip<Telemetry>(frame, size);
+    return 0;
+}
+
+#ifndef PROTOCOL_LIBFUZZER
+
+namespace {
+
+uint32_t state = 0x12345678;
+
+uint32_t next() {
+    // xorshift32, same inputs on each run
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// Valid frames of each message, mutated by the loop
+std::vector<std::vector<uint8_t>> seeds() {
+    std::vector<std::vector<uint8_t>> frames;
+    auto add = [&frames](auto msg) {
+        std::vector<uint8_t> frame(maxTelemetryFrameSize);
+        frame.resize(Encode(msg, frame.data(), frame.size()));
+        frames.push_back(frame);
+    };
+    add(Position {.face = 3, .startTime = 1767571200});
+    add(Calibration {.status = 1, .face = 2});
+    add(TimeSyncResponse {.receiveTime = 1767571200000LL, .holdTime = 4});
+    add(TimeSyncAdjust {.offset = -250, .roundTrip = 30});
+    BootProfile profile = {};
+    profile.times[0] = 1200;
+    add(profile);
+    TraceChunk trace = {};
+    trace.count = traceChunkRecords;
+    add(trace);
+    LogChunk log = {};
+    log.count = logChunkRecords;
+    add(log);
+    Telemetry telemetry = {};
+    telemetry.recentCount = telemetryRecent;
+    add(telemetry);
+    return frames;
+}
+
+std::vector<uint8_t> mutate(std::vector<uint8_t> frame) {
+    const uint32_t mutations = 1 + next() % 4;
+    for(uint32_t i = 0; i < mutations; i++) {
+        switch(next() % 5) {
+            case 0:     // Bit flip
+                if(!frame.empty()) {
+                    frame[next() % frame.size()] ^= (uint8_t) (1 << (next() % 8));
+                }
+                break;
+            case 1:     // Truncate
+                frame.resize(frame.empty() ? 0 : next() % frame.size());
+                break;
+            case 2:     // Random byte, often a tag or length
+                if(!frame.empty()) {
+                    frame[next() % frame.size()] = (uint8_t) next();
+                }
+                break;
+            case 3:     // Append garbage
+                for(uint32_t n = next() % 8; n > 0; n--) {
+                    frame.push_back((uint8_t) next());
+                }
+                break;
+            default:    // Keep version, so the items get decoded
+                if(!frame.empty()) {
+                    frame[0] = version;
+                }
+                break;
+        }
+    }
+    return frame;
+}
+
+} // namespace end --------------------
+
+int main(int argc, char **argv) {
+    const long iterations = argc > 1 ? atol(argv[1]) : 200000;
+
+    for(int i = 2; i < argc; i++) {
+        FILE *file = fopen(argv[i], "rb");
+        if(file == nullptr) {
+            fprintf(stderr, "Cannot open %s\n", argv[i]);
+            return 1;
+        }
+        std::vector<uint8_t> input(maxTelemetryFrameSize * 4);
+        input.resize(fread(input.data(), 1, input.size(), file));
+        fclose(file);
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+
+    const auto frames = seeds();
+    for(long i = 0; i < iterations; i++) {
+        std::vector<uint8_t> input;
+        if(i % 4 == 0) {
+            input.resize(next() % (maxTelemetryFrameSize + 8));
+            for(auto& byte : input) {
+                byte = (uint8_t) next();
+            }
+        }
+        else {
+            input = mutate(frames[next() % frames.size()]);
+        }
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+    printf("Protocol fuzz: %ld inputs, no failure\n", iterations);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,253 @@
+/**
+ * @file protocolTest.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#include "protocol.hpp"
+#include <gtest/gtest.h>
+#include <vector>
+
+using namespace PROTOCOL;
+
+namespace {
+
+template<typename T>
+std::vector<uint8_t> encode(const T& msg, size_t size = maxTelemetryFrameSize) {
+    std::vector<uint8_t> frame(size);
+    frame.resize(Encode(msg, frame.data(), frame.size()));
+    return frame;
+}
+
+} // namespace end --------------------
+
+TEST(Protocol, PositionRoundTrip) {
+    Position sent = {.face = 7, .startTime = 1767571200123LL};
+    auto frame = encode(sent, maxFrameSize);
+    // Version, face item, time item
+    ASSERT_EQ(frame.size(), headerSize + itemHeaderSize + 1 + itemHeaderSize + 8);
+    EXPECT_EQ(frame[0], version);
+
+    Position received = {};
+    ASSERT_TRUE(Decode(frame.data(), frame.size(), received));
+    EXPECT_EQ(received.face, sent.face);
+    EXPECT_EQ(received.startTime, sent.startTime);
+}
+
+TEST(Protocol, NegativeValuesKeepSign) {
+    Position sent = {.face = -1, .startTime = -5};
+    auto frame = encode(sent);
+    Position received = {};
+    ASSERT_TRUE(Decode(frame.data(), frame.size(), received));
+    EXPECT_EQ(received.face, -1);
+    EXPECT_EQ(received.startTime, -5);
+}
+
+TEST(Protocol, CalibrationRoundTrip) {
+    Calibration sent = {.status = 2, .face = 9};
+    auto frame = encode(sent, maxFrameSize);
+    Calibration received = {};
+    ASSERT_TRUE(Decode(frame.data(), frame.size(), received));
+    EXPECT_EQ(received.status, 2);
+    EXPECT_EQ(received.face, 9);
+}
+
+TEST(Protocol, TimeSyncRoundTrip) {
+    TimeSyncResponse response = {.receiveTime = 1767571200000LL, .holdTime = 12};
+    auto frame = encode(response, maxFrameSize);
+    TimeSyncResponse decodedResponse = {};
+    ASSERT_TRUE(Decode(frame.data(), frame.size(), decodedResponse));
+    EXPECT_EQ(decodedResponse.receiveTime, response.receiveTime);
+    EXPECT_EQ(decodedResponse.holdTime, response.holdTime);
+
+    TimeSyncAdjust adjust = {.offset = -86400000LL, .roundTrip = 45};
+    frame = encode(adjust, maxFrameSize);
+    TimeSyncAdjust decodedAdjust = {};
+    ASSERT_TRUE(Decode(frame.data(), frame.size(), decodedAdjust));
+    EXPECT_EQ(decodedAdjust.offset, adjust.offset);
+    EXPECT_EQ(decodedAdjust.roundTrip, adjust.roundTrip);
+}
+
+TEST(Protocol, ComputeTimeSyncCompensatesRoundTrip) {
+    // Tracker 1000 ms behind, 20 ms each way, 5 ms to answer
+    const int64_t t1 = 50000;
+    TimeSyncResponse response = {.receiveTime = t1 + 20 - 1000, .holdTime = 5};
+    const int64_t t4 = t1 + 20 + 5 + 20;
+    auto adjust = ComputeTimeSync(t1, response, t4);
+    EXPECT_EQ(adjust.offset, 1000);
+    EXPECT_EQ(adjust.roundTrip, 40u);
+}
+
+TEST(Protocol, BootProfileRoundTrip) {
+    BootProfile sent;
+    for(size_t i = 0; i < sent.times.size(); i++) {
+        sent.times[i] = 1000 * (i + 1);
+    }
+    auto frame = encode(sent);
+    BootProfile received;
+    ASSERT_TRUE(Decode(frame.data(), frame.size(), received));
+    EXPECT_EQ(received.times, sent.times);
+}
+
+TEST(Protocol, TelemetryRoundTrip) {
+    Telemetry sent = {};
+    sent.wakes = 60;
+    sent.stubWakes = 4247;
+    sent.awakeTime = 264500;
+    sent.advertisingTime = 12000;
+    sent.connectedTime = 3000;
+    sent.i2cTransactions = 123456;
+    sent.flashWrites = 12;
+    for(size_t i = 0; i < sent.wakeCauses.size(); i++) {
+        sent.wakeCauses[i] = i * 3;
+    }
+    for(size_t i = 0; i < sent.awakeHistogram.size(); i++) {
+        sent.awakeHistogram[i] = i + 1;
+    }
+    sent.recentCount = 5;
+    for(size_t i = 0; i < sent.recentCount; i++) {
+        sent.recent[i] = {(uint8_t) i, (uint32_t) (100 * i), (uint32_t) (10 * i), (uint32_t) i,
+                            (uint16_t) (i + 7), (uint16_t) (i & 1)};
+    }
+    sent.powerTier = (uint8_t) PowerTier::Low;
+    sent.tierChanges = 3;
+    sent.tierTime = {{100, 200, 300, 0}};
+    sent.reconnectTime = 48;
+    sent.maxReconnectTime = 612;
+
+    auto frame = encode(sent);
+    ASSERT_GT(frame.size(), 0u);
+    ASSERT_LE(frame.size(), maxTelemetryFrameSize);
+    Telemetry received = {};
+    ASSERT_TRUE(Decode(frame.data(), frame.size(), received));
+    EXPECT_EQ(received.wakes, sent.wakes);
+    EXPECT_EQ(received.stubWakes, sent.stubWakes);
+    EXPECT_EQ(received.awakeTime, sent.awakeTime);
+    EXPECT_EQ(received.i2cTransactions, sent.i2cTransactions);
+    EXPECT_EQ(received.wakeCauses, sent.wakeCauses);
+    EXPECT_EQ(received.awakeHistogram, sent.awakeHistogram);
+    ASSERT_EQ(received.recentCount, sent.recentCount);
+    for(size_t i = 0; i < sent.recentCount; i++) {
+        EXPECT_EQ(received.recent[i].cause, sent.recent[i].cause);
+        EXPECT_EQ(received.recent[i].awakeTime, sent.recent[i].awakeTime);
+        EXPECT_EQ(received.recent[i].advertisingTime, sent.recent[i].advertisingTime);
+        EXPECT_EQ(received.recent[i].connectedTime, sent.recent[i].connectedTime);
+        EXPECT_EQ(received.recent[i].i2cTransactions, sent.recent[i].i2cTransactions);
+        EXPECT_EQ(received.recent[i].flashWrites, sent.recent[i].flashWrites);
+    }
+    EXPECT_EQ(received.powerTier, sent.powerTier);
+    EXPECT_EQ(received.tierChanges, sent.tierChanges);
+    EXPECT_EQ(received.tierTime, sent.tierTime);
+    EXPECT_EQ(received.reconnectTime, sent.reconnectTime);
+    EXPECT_EQ(received.maxReconnectTime, sent.maxReconnectTime);
+}
+
+TEST(Protocol, TraceChunkRoundTrip) {
+    TraceChunk sent = {};
+    sent.core = 1;
+    sent.first = 30;
+    sent.count = traceChunkRecords;
+    for(size_t i = 0; i < sent.count; i++) {
+        sent.records[i] = {(uint8_t) (i % (size_t) TraceEvent::Count), 1, 513, (uint32_t) (i * 80000),
+                            (uint32_t) i, 0xFFFFFFFFu - (uint32_t) i};
+    }
+    auto frame = encode(sent);
+    ASSERT_GT(frame.size(), 0u);
+    TraceChunk received = {};
+    ASSERT_TRUE(Decode(frame.data(), frame.size(), received));
+    EXPECT_EQ(received.core, sent.core);
+    EXPECT_EQ(received.first, sent.first);
+    ASSERT_EQ(received.count, sent.count);
+    for(size_t i = 0; i < sent.count; i++) {
+        EXPECT_EQ(received.records[i].event, sent.records[i].event);
+        EXPECT_EQ(received.records[i].boot, sent.records[i].boot);
+        EXPECT_EQ(received.records[i].cycles, sent.records[i].cycles);
+        EXPECT_EQ(received.records[i].arg1, sent.records[i].arg1);
+    }
+}
+
+TEST(Protocol, LogChunkRoundTrip) {
+    LogChunk sent = {};
+    sent.first = 300;
+    sent.count = logChunkRecords;
+    for(size_t i = 0; i < sent.count; i++) {
+        sent.records[i] = {0x9E3779B9u * (uint32_t) (i + 1), (uint32_t) (i * 1000), 3, (uint8_t) (i % (logMaxArgs + 1)),
+                            65535, {{(uint32_t) i, 0xFFFFFFFFu, 0x3F800000u, 0}}};
+    }
+    auto frame = encode(sent);
+    ASSERT_GT(frame.size(), 0u);
+    ASSERT_LE(frame.size(), maxTelemetryFrameSize);
+    LogChunk received = {};
+    ASSERT_TRUE(Decode(frame.data(), frame.size(), received));
+    EXPECT_EQ(received.first, sent.first);
+    ASSERT_EQ(received.count, sent.count);
+    for(size_t i = 0; i < sent.count; i++) {
+        EXPECT_EQ(received.records[i].id, sent.records[i].id);
+        EXPECT_EQ(received.records[i].time, sent.records[i].time);
+        EXPECT_EQ(received.records[i].level, sent.records[i].level);
+        EXPECT_EQ(received.records[i].argc, sent.records[i].argc);
+        EXPECT_EQ(received.records[i].boot, sent.records[i].boot);
+        EXPECT_EQ(received.records[i].args, sent.records[i].args);
+    }
+}
+
+TEST(Protocol, UnknownItemsAreSkipped) {
+    // Newer firmware adds an item in front of the known ones
+    uint8_t frame[maxFrameSize];
+    Encoder encoder(frame, sizeof(frame));
+    ASSERT_TRUE(encoder.Put((Tag) 0x7F, (uint16_t) 0xBEEF));
+    ASSERT_TRUE(encoder.Put(Tag::CalibrationStatus, (int8_t) 1));
+    ASSERT_TRUE(encoder.Put(Tag::CalibrationFace, (int8_t) 4));
+    Calibration received = {};
+    ASSERT_TRUE(Decode(frame, encoder.Length(), received));
+    EXPECT_EQ(received.status, 1);
+    EXPECT_EQ(received.face, 4);
+}
+
+TEST(Protocol, RejectsOtherVersionAndTruncatedFrames) {
+    auto frame = encode(Position {.face = 3, .startTime = 42}, maxFrameSize);
+    Position received = {};
+
+    auto other = frame;
+    other[0] = version + 1;
+    EXPECT_FALSE(Decode(other.data(), other.size(), received));
+
+    // Any cut loses the time item
+    for(size_t length = 0; length < frame.size(); length++) {
+        EXPECT_FALSE(Decode(frame.data(), length, received)) << "length " << length;
+    }
+    EXPECT_FALSE(Decode(nullptr, 0, received));
+}
+
+TEST(Protocol, WrongItemLengthIsRejected) {
+    uint8_t frame[maxFrameSize];
+    Encoder encoder(frame, sizeof(frame));
+    // Face sent as 16 bits
+    encoder.Put(Tag::Face, (int16_t) 3);
+    encoder.Put(Tag::StartTime, (int64_t) 1);
+    Position received = {};
+    EXPECT_FALSE(Decode(frame, encoder.Length(), received));
+}
+
+TEST(Protocol, SmallBufferEncodesNothing) {
+    Position msg = {.face = 1, .startTime = 2};
+    std::vector<uint8_t> frame(maxFrameSize, 0xAA);
+    for(size_t size = 0; size < headerSize + 2 * itemHeaderSize + 9; size++) {
+        EXPECT_EQ(Encode(msg, frame.data(), size), 0u) << "size " << size;
+    }
+    // Nothing past the buffer was written
+    EXPECT_EQ(frame[headerSize + 2 * itemHeaderSize + 8], 0xAA);
+}
+
+TEST(Protocol, ArrayItemLimit) {
+    uint8_t frame[maxTelemetryFrameSize + 64];
+    uint8_t values[UINT8_MAX + 1] = {};
+    Encoder fits(frame, sizeof(frame));
+    EXPECT_TRUE(fits.PutArray(Tag::BootTimes, values, UINT8_MAX));
+    Encoder tooLong(frame, sizeof(frame));
+    EXPECT_FALSE(tooLong.PutArray(Tag::BootTimes, values, UINT8_MAX + 1));
+    EXPECT_FALSE(tooLong.IsValid());
+}
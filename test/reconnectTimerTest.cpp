@@ -0,0 +1,86 @@
+/**
+ * @file reconnectTimerTest.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#include "reconnectTimer.hpp"
+#include <gtest/gtest.h>
+
+using namespace BLE;
+using namespace std::literals::chrono_literals;
+
+namespace {
+
+// Fake esp_timer clock, us since boot
+int64_t timerUs;
+
+int64_t fakeNow() {
+    return timerUs;
+}
+
+class ReconnectTimerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        timerUs = 250000;
+    }
+};
+
+} // namespace end --------------------
+
+TEST_F(ReconnectTimerTest, AdvertisingUntilLink) {
+    ReconnectTimer timer(fakeNow);
+    timer.OnAdvertise();
+    timerUs += 180000;
+    std::chrono::microseconds elapsed(0);
+    ASSERT_TRUE(timer.OnLink(elapsed));
+    EXPECT_EQ(elapsed, 180ms);
+}
+
+TEST_F(ReconnectTimerTest, TwoConnectionsInOneWake) {
+    ReconnectTimer timer(fakeNow);
+    std::chrono::microseconds elapsed(0);
+    timer.OnAdvertise();
+    timerUs += 100000;
+    ASSERT_TRUE(timer.OnLink(elapsed));
+    EXPECT_EQ(elapsed, 100ms);
+
+    // Connection lasts a minute, advertising restarts at disconnection
+    timerUs += 60000000;
+    timer.OnAdvertise();
+    timerUs += 300000;
+    ASSERT_TRUE(timer.OnLink(elapsed));
+    // Not the minute of the first connection
+    EXPECT_EQ(elapsed, 300ms);
+}
+
+TEST_F(ReconnectTimerTest, RestartAfterDirectedAdvertising) {
+    ReconnectTimer timer(fakeNow);
+    std::chrono::microseconds elapsed(0);
+    timer.OnAdvertise();
+    // Bonded central did not show up, advertising to everyone
+    timerUs += 2000000;
+    timer.OnAdvertise();
+    timerUs += 50000;
+    ASSERT_TRUE(timer.OnLink(elapsed));
+    EXPECT_EQ(elapsed, 50ms);
+}
+
+TEST_F(ReconnectTimerTest, CountedOncePerAdvertising) {
+    ReconnectTimer timer(fakeNow);
+    std::chrono::microseconds elapsed(0);
+    // Link without advertising of this timer
+    EXPECT_FALSE(timer.OnLink(elapsed));
+
+    timer.OnAdvertise();
+    timerUs += 100000;
+    ASSERT_TRUE(timer.OnLink(elapsed));
+    // Link encrypted again, same connection
+    timerUs += 5000000;
+    elapsed = 0us;
+    EXPECT_FALSE(timer.OnLink(elapsed));
+    EXPECT_EQ(elapsed, 0us);
+}
@@ -0,0 +1,134 @@
+/**
+ * @file sleepSchedulerTest.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#include "sleepScheduler.hpp"
+#include <gtest/gtest.h>
+
+using namespace APP;
+using namespace std::literals::chrono_literals;
+
+namespace {
+
+// Fake esp_timer clock, us since boot
+int64_t timerUs;
+
+int64_t fakeNow() {
+    return timerUs;
+}
+
+uint32_t bit(SleepReason reason) {
+    return 1 << (uint32_t) reason;
+}
+
+class SleepSchedulerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        timerUs = 50000;
+    }
+};
+
+} // namespace end --------------------
+
+TEST_F(SleepSchedulerTest, NothingKeepsAwake) {
+    SleepScheduler scheduler(fakeNow);
+    EXPECT_TRUE(scheduler.IsSleepAllowed());
+    EXPECT_EQ(scheduler.GetAwakeReasons(), 0u);
+    EXPECT_EQ(scheduler.GetDominantReason(), SleepReason::COUNT);
+    EXPECT_EQ(scheduler.GetTimeToSleep(), 0us);
+}
+
+TEST_F(SleepSchedulerTest, DeferForDefaultTime) {
+    SleepScheduler scheduler(fakeNow);
+    scheduler.Defer(SleepReason::BLE_WINDOW);
+    EXPECT_FALSE(scheduler.IsSleepAllowed());
+    EXPECT_EQ(scheduler.GetTimeToSleep(), SleepScheduler::GetDeferTime(SleepReason::BLE_WINDOW));
+    EXPECT_EQ(scheduler.GetDeadline(), timerUs + 5000000);
+
+    timerUs += 4999999;
+    EXPECT_EQ(scheduler.GetTimeToSleep(), 1us);
+    EXPECT_EQ(scheduler.GetAwakeReasons(), bit(SleepReason::BLE_WINDOW));
+    // Deadline reached
+    timerUs += 1;
+    EXPECT_TRUE(scheduler.IsSleepAllowed());
+    EXPECT_EQ(scheduler.GetTimeToSleep(), 0us);
+    timerUs += 1000000;
+    EXPECT_EQ(scheduler.GetTimeToSleep(), 0us);
+}
+
+TEST_F(SleepSchedulerTest, DeadlineOnlyMovesLater) {
+    SleepScheduler scheduler(fakeNow);
+    scheduler.Defer(SleepReason::IMU_NEW_POSITION, 10s);
+    const int64_t deadline = scheduler.GetDeadline();
+
+    // Shorter defer later on does not cut it
+    timerUs += 1000000;
+    scheduler.Defer(SleepReason::IMU_NEW_POSITION, 2s);
+    EXPECT_EQ(scheduler.GetDeadline(), deadline);
+    EXPECT_EQ(scheduler.GetTimeToSleep(), 9s);
+
+    // Longer one moves it
+    scheduler.Defer(SleepReason::IMU_NEW_POSITION, 20s);
+    EXPECT_EQ(scheduler.GetTimeToSleep(), 20s);
+}
+
+TEST_F(SleepSchedulerTest, ReasonsAreIndependent) {
+    SleepScheduler scheduler(fakeNow);
+    scheduler.Defer(SleepReason::BOOT);
+    scheduler.Defer(SleepReason::IMU_SEND_POSITION);
+    EXPECT_EQ(scheduler.GetAwakeReasons(), bit(SleepReason::BOOT) | bit(SleepReason::IMU_SEND_POSITION));
+    EXPECT_EQ(scheduler.GetTimeToSleep(), 1s);
+
+    // Boot is over, position send still pending
+    timerUs += 100000;
+    EXPECT_EQ(scheduler.GetAwakeReasons(), bit(SleepReason::IMU_SEND_POSITION));
+    EXPECT_EQ(scheduler.GetTimeToSleep(), 900ms);
+}
+
+TEST_F(SleepSchedulerTest, Release) {
+    SleepScheduler scheduler(fakeNow);
+    scheduler.Defer(SleepReason::OTA_UPDATE);
+    scheduler.Defer(SleepReason::BLE_WINDOW);
+    scheduler.Release(SleepReason::OTA_UPDATE);
+    EXPECT_EQ(scheduler.GetAwakeReasons(), bit(SleepReason::BLE_WINDOW));
+    EXPECT_EQ(scheduler.GetTimeToSleep(), 5s);
+
+    // After release a short defer counts again, not the released deadline
+    scheduler.Defer(SleepReason::OTA_UPDATE, 1s);
+    EXPECT_EQ(scheduler.GetDominantReason(), SleepReason::BLE_WINDOW);
+
+    // Out of range reasons are ignored
+    scheduler.Release(SleepReason::COUNT);
+    scheduler.Defer(SleepReason::COUNT, 1h);
+    EXPECT_EQ(scheduler.GetTimeToSleep(), 5s);
+}
+
+TEST_F(SleepSchedulerTest, ReleaseAll) {
+    SleepScheduler scheduler(fakeNow);
+    scheduler.Defer(SleepReason::IMU_CALIBRATION);
+    scheduler.Defer(SleepReason::OTA_UPDATE);
+    scheduler.ReleaseAll();
+    EXPECT_TRUE(scheduler.IsSleepAllowed());
+    EXPECT_EQ(scheduler.GetDeadline(), 0);
+    EXPECT_EQ(scheduler.GetDominantReason(), SleepReason::COUNT);
+}
+
+TEST_F(SleepSchedulerTest, DominantReasonHasLatestDeadline) {
+    SleepScheduler scheduler(fakeNow);
+    scheduler.Defer(SleepReason::IMU_CALIBRATION);
+    scheduler.Defer(SleepReason::BLE_WINDOW);
+    EXPECT_EQ(scheduler.GetDominantReason(), SleepReason::IMU_CALIBRATION);
+
+    // Calibration ends, window is what keeps the device up
+    scheduler.Release(SleepReason::IMU_CALIBRATION);
+    EXPECT_EQ(scheduler.GetDominantReason(), SleepReason::BLE_WINDOW);
+
+    // Expired deadlines do not dominate
+    timerUs += 5000000;
+    EXPECT_EQ(scheduler.GetDominantReason(), SleepReason::COUNT);
+}
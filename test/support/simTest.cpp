@@ -0,0 +1,82 @@
+/**
+ * @file simTest.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#include "simTest.hpp"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+extern "C" {
+    #include "freertos/FreeRTOS.h"
+    #include "freertos/task.h"
+} // extern C close
+
+namespace {
+
+SIM::Options options;
+SIM::Scenario scenario;
+
+struct Call {
+    void (*code)(void *);
+    void *parameters;
+    std::mutex mutex;
+    std::condition_variable done;
+    bool finished = false;
+};
+
+void callTask(void *argument) {
+    auto call = (Call *) argument;
+    call->code(call->parameters);
+    {
+        std::lock_guard<std::mutex> lock(call->mutex);
+        call->finished = true;
+    }
+    call->done.notify_all();
+    vTaskDelete(NULL);
+}
+
+} // namespace end --------------------
+
+const SIM::Options& SIM::GetOptions() {
+    return options;
+}
+
+const SIM::Scenario& SIM::GetScenario() {
+    return scenario;
+}
+
+void SIM::Report() {
+}
+
+SIM::Options& TEST::Options() {
+    return options;
+}
+
+void TEST::Reset() {
+    // Scheduler of the host kernel never returns, it gets a thread of its own
+    static std::once_flag started;
+    std::call_once(started, [] { std::thread(vTaskStartScheduler).detach(); });
+
+    options = SIM::Options();
+    auto& state = SIM::GetState();
+    state = {};
+    state.mpu.Reset();
+    state.cause = ESP_SLEEP_WAKEUP_UNDEFINED;
+    SIM::FreezeTime();
+    SIM::AdvanceTime(-SIM::Now());
+}
+
+void TEST::RunInTask(void (*code)(void *), void *parameters) {
+    Call call;
+    call.code = code;
+    call.parameters = parameters;
+    xTaskCreate(callTask, "TestTask", configMINIMAL_STACK_SIZE, &call, 1, NULL);
+    std::unique_lock<std::mutex> lock(call.mutex);
+    call.done.wait(lock, [&call] { return call.finished; });
+}
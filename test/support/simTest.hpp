@@ -0,0 +1,34 @@
+/**
+ * @file simTest.hpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+#pragma once
+
+// Host tests run firmware code on the models of sim/, without the entry of the simulation.
+// Options and scenario of the simulation are set by the test.
+
+#include "sim.hpp"
+
+namespace TEST {
+
+/**
+ * @brief Options seen by the firmware and the models through SIM::GetOptions
+ */
+SIM::Options& Options();
+
+/**
+ * @brief Fresh simulation state, power on. Time is frozen at 0 since boot, move it with SIM::AdvanceTime
+ */
+void Reset();
+
+/**
+ * @brief Run code in a kernel task and wait until it returns. Kernel calls which block need a task.
+ */
+void RunInTask(void (*code)(void *), void *parameters = nullptr);
+
+} // namespace TEST end --------------------
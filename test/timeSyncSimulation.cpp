@@ -0,0 +1,138 @@
+/**
+ * @file timeSyncSimulation.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+// Error of the device clock over days, TIMESYNC::TimeSync on the simulated clock.
+// RTC drifts 100 ppm with a daily +/- 30 ppm swing (temperature). Device wakes every 15 min
+// and calls Compensate(), the phone syncs once a day at a random hour over a link with
+// asymmetric delays. Positions are stamped every hour (whole seconds) and corrected at the next sync.
+// Prints worst errors per day, fails if the estimate does not bound the error: from day 3
+// (drift known) clock error under maxErrorUs and under a quarter of the sync-only error.
+
+#include "simTest.hpp"
+#include "timeSync.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+constexpr int days = 7;
+constexpr int64_t stepUs = 60LL * 1000000;
+constexpr int wakeSteps = 15;
+constexpr int eventSteps = 60;
+constexpr int64_t dayUs = 24LL * 3600 * 1000000;
+constexpr double baseDriftPpm = 100;
+constexpr double swingDriftPpm = 30;
+// Clock is not set at power on
+constexpr int64_t initialErrorUs = -3600LL * 1000000;
+// Daily swing alone is 2 * 30 ppm * 1 day / pi = 0.83 s peak to peak, estimate can't follow it
+constexpr int64_t maxErrorUs = 1500000;
+
+struct Event {
+    int64_t wallUs;
+    time_t stamp;
+};
+
+double driftPpm(int64_t now) {
+    return baseDriftPpm + swingDriftPpm * sin(2 * M_PI * (double) now / dayUs);
+}
+
+// Uniform in [from, to)
+int64_t uniform(int64_t from, int64_t to) {
+    return from + (int64_t) (rand() % (to - from));
+}
+
+/**
+ * @brief NTP-like exchange as the client does it, link delays drawn at random
+ * @return step of the clock
+ */
+TIMESYNC::Correction sync() {
+    TIMESYNC::Correction correction = {};
+    const int64_t t1 = SIM::GetWallTime() / 1000;
+    SIM::AdvanceTime(uniform(15, 120) * 1000);
+    TIMESYNC::TimeSync::OnRequest();
+    SIM::AdvanceTime(uniform(1, 10) * 1000);
+    PROTOCOL::TimeSyncResponse response;
+    TIMESYNC::TimeSync::GetResponse(response);
+    SIM::AdvanceTime(uniform(15, 120) * 1000);
+    const int64_t t4 = SIM::GetWallTime() / 1000;
+    auto adjust = PROTOCOL::ComputeTimeSync(t1, response, t4);
+    if(!TIMESYNC::TimeSync::OnAdjust(adjust, correction)) {
+        fprintf(stderr, "Sync rejected\n");
+        exit(1);
+    }
+    return correction;
+}
+
+} // namespace end --------------------
+
+int main() {
+    TEST::Reset();
+    TEST::Options().log = ESP_LOG_NONE;
+    srand(27);
+
+    auto& state = SIM::GetState();
+    state.clockErrorUs = initialErrorUs;
+    // Same clock, stepped at sync only
+    int64_t syncOnlyErrorUs = initialErrorUs;
+
+    std::vector<Event> events;
+    bool passed = true;
+
+    printf("day  drift est.  worst clock error [ms]         worst position error [ms]\n");
+    printf("          [ppm]  sync only   estimated          as stamped  corrected\n");
+    for(int day = 0; day < days; day++) {
+        const int64_t syncAt = day * dayUs + uniform(8, 22) * 3600 * 1000000;
+        bool synced = false;
+        int64_t worstSyncOnly = 0, worstEstimated = 0, worstStamped = 0, worstCorrected = 0;
+
+        for(int step = 0; step < (int) (dayUs / stepUs); step++) {
+            const int64_t now = SIM::Now();
+            const int64_t driftUs = (int64_t) (stepUs * driftPpm(now) / 1e6);
+            SIM::AdvanceTime(stepUs);
+            state.clockErrorUs += driftUs;
+            syncOnlyErrorUs += driftUs;
+
+            if(step % wakeSteps == 0) {
+                TIMESYNC::TimeSync::Compensate();
+            }
+            if(step % eventSteps == 0) {
+                events.push_back({SIM::GetWallTime(), time(NULL)});
+            }
+            if(!synced && SIM::Now() >= syncAt) {
+                synced = true;
+                auto correction = sync();
+                syncOnlyErrorUs = state.clockErrorUs;
+                for(auto& event : events) {
+                    const int64_t stampedErrorUs = (int64_t) event.stamp * 1000000 - event.wallUs;
+                    const int64_t correctedErrorUs = (int64_t) correction.Apply(event.stamp) * 1000000 - event.wallUs;
+                    worstStamped = std::max<int64_t>(worstStamped, llabs(stampedErrorUs));
+                    worstCorrected = std::max<int64_t>(worstCorrected, llabs(correctedErrorUs));
+                }
+                events.clear();
+            }
+            // Clock is not set before the first sync
+            if(day > 0 || synced) {
+                worstSyncOnly = std::max<int64_t>(worstSyncOnly, llabs(syncOnlyErrorUs));
+                worstEstimated = std::max<int64_t>(worstEstimated, llabs(state.clockErrorUs));
+            }
+        }
+
+        printf("%3d %12.1f %10lld %11lld %19lld %10lld\n", day + 1, TIMESYNC::TimeSync::GetDriftPpm(),
+                (long long) worstSyncOnly / 1000, (long long) worstEstimated / 1000,
+                (long long) worstStamped / 1000, (long long) worstCorrected / 1000);
+        if(day >= 2 && (worstEstimated >= maxErrorUs || worstEstimated * 4 >= worstSyncOnly)) {
+            passed = false;
+        }
+    }
+    printf("%s\n", passed ? "Error bound held" : "Error bound exceeded");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,68 @@
+/**
+ * @file traceDump.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+// Trace of two wakes, dumped as the desktop reads it: characteristic frames as hex, one per
+// line (input of tools/trace.py). Checked by traceRoundTrip.py, which converts it to Perfetto JSON.
+// First wake fills the ring past its size, task switches alternate between two tasks.
+
+#include "simTest.hpp"
+#include "trace.hpp"
+#include <cstdio>
+
+using TELEMETRY::Trace;
+
+namespace {
+
+// Four characters of the name, as OnTaskSwitch packs them
+constexpr uint32_t taskA = 'I' | 'm' << 8 | 'u' << 16 | 'T' << 24;
+constexpr uint32_t taskB = 'B' | 'l' << 8 | 'e' << 16;
+
+void dump() {
+    for(;;) {
+        uint8_t frame[PROTOCOL::maxTelemetryFrameSize];
+        const size_t len = Trace::Encode(frame, sizeof(frame));
+        for(size_t i = 0; i < len; i++) {
+            printf("%02x%c", frame[i], i + 1 < len ? ' ' : '\n');
+        }
+        if(len <= PROTOCOL::headerSize) {
+            return;
+        }
+    }
+}
+
+} // namespace end --------------------
+
+int main() {
+    TEST::Reset();
+    TEST::Options().log = ESP_LOG_NONE;
+
+    // First wake: 2 records per step, a step each ms. Ring keeps the last TRACE_RECORDS
+    Trace::Start(ESP_SLEEP_WAKEUP_TIMER);
+    for(uint32_t step = 0; step < TRACE_RECORDS; step++) {
+        SIM::AdvanceTime(1000);
+        Trace::Record(Trace::Event::TaskSwitch, step % 2 ? 0x3ffb0000 : 0x3ffb1000, step % 2 ? taskB : taskA);
+        SIM::AdvanceTime(1000);
+        Trace::Record(Trace::Event::Publish, step, 1);
+    }
+    SIM::AdvanceTime(1000);
+    Trace::Record(Trace::Event::Sleep, 60000, 2 * TRACE_RECORDS + 1);
+
+    // Second wake, a minute later
+    SIM::AdvanceTime(60000000);
+    Trace::Start(ESP_SLEEP_WAKEUP_EXT1);
+    SIM::AdvanceTime(1000);
+    Trace::Record(Trace::Event::TaskSwitch, 0x3ffb1000, taskA);
+    SIM::AdvanceTime(1000);
+    Trace::Record(Trace::Event::Receive, 7, 0);
+
+    // Not hex, tools/trace.py skips it
+    printf("# records %d\n", TRACE_RECORDS);
+    dump();
+    return 0;
+}
@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+"""
+@file traceRoundTrip.py
+@author Maciej Sliwinski
+@brief This file is a part of time_tracker_esp32 project.
+
+The code is distributed under the MIT License.
+See the LICENCE file for more details.
+
+Trace dump of the firmware (traceDump.cpp) through tools/trace.py: the Perfetto JSON must
+hold exactly the records the ring kept, in time order, with task slices and wake arguments.
+
+Usage:
+    traceRoundTrip.py TRACE_DUMP TRACE_PY
+"""
+
+import json
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+
+def check(condition, message):
+    if not condition:
+        print("FAILED: " + message)
+        sys.exit(1)
+
+
+def main():
+    dump_exe, trace_py = sys.argv[1:3]
+    dump = subprocess.run([dump_exe], check=True, stdout=subprocess.PIPE, universal_newlines=True).stdout
+    records = int(re.search(r"^# records (\d+)$", dump, re.M).group(1))
+
+    with tempfile.TemporaryDirectory() as directory:
+        dump_path = os.path.join(directory, "dump.txt")
+        json_path = os.path.join(directory, "trace.json")
+        with open(dump_path, "w") as file:
+            file.write(dump)
+        subprocess.run([sys.executable, trace_py, dump_path, "-o", json_path], check=True)
+        with open(json_path) as file:
+            events = json.load(file)["traceEvents"]
+
+    # First wake: Wake, a task switch and a publish per step, Sleep. Second: Wake, switch, receive
+    steps = records
+    second = 3
+    first_kept = records - second
+    kept_steps = (first_kept - 1) // 2
+    first_step = steps - kept_steps
+
+    by_name = {}
+    for event in events:
+        by_name.setdefault(event["name"], []).append(event)
+
+    publish = by_name.get("publish", [])
+    check([e["args"]["topic"] for e in publish] == list(range(first_step, steps)),
+          "publish records %s, expected steps %d..%d" % ([e["args"]["topic"] for e in publish], first_step, steps - 1))
+    check(all(e["args"]["queued"] for e in publish), "publish arguments")
+
+    # Wake of the first boot was overwritten
+    wakes = by_name.get("wake", [])
+    check(len(wakes) == 1 and wakes[0]["args"] == {"boot": 2, "cause": "ext1", "mhz": 80},
+          "wake records %s" % wakes)
+    sleeps = by_name.get("sleep", [])
+    check(len(sleeps) == 1 and sleeps[0]["args"] == {"sleep_ms": 60000, "awake_ms": 2 * steps + 1},
+          "sleep records %s" % sleeps)
+    receives = by_name.get("receive", [])
+    check(len(receives) == 1 and receives[0]["args"] == {"topic": 7, "left": 0}, "receive records %s" % receives)
+
+    slices = [e for e in events if e["ph"] == "X"]
+    check(len(slices) == kept_steps + 1, "%d task slices, expected %d" % (len(slices), kept_steps + 1))
+    names = [e["name"] for e in slices]
+    expected = ["Ble" if step % 2 else "ImuT" for step in range(first_step, steps)] + ["ImuT"]
+    check(names == expected, "task slices %s" % names)
+    # A slice lasts until the next switch: 2 ms apart, the last one of a wake until Sleep
+    check(all(abs(e["dur"] - 2000) < 1 for e in slices[:-2]), "slice durations %s" % [e["dur"] for e in slices])
+
+    timed = [e for e in events if "ts" in e]
+    check(all(a["ts"] <= b["ts"] for a, b in zip(timed, timed[1:]) if a["ph"] == b["ph"] == "i"),
+          "instants out of order")
+    check(wakes[0]["ts"] > sleeps[0]["ts"], "second wake before the sleep of the first")
+    check(len([e for e in events if e["ph"] == "M"]) == 1, "one track, single core")
+    print("Round trip of %d records passed" % records)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,156 @@
+/**
+ * @file traceTest.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+// TELEMETRY::Trace rings and their dump, decoded with PROTOCOL as the desktop does
+
+#include "simTest.hpp"
+#include "trace.hpp"
+#include <gtest/gtest.h>
+#include <vector>
+
+using TELEMETRY::Trace;
+
+namespace {
+
+std::vector<PROTOCOL::TraceRecord> records;
+std::vector<uint16_t> firsts;
+
+/**
+ * @brief Read chunks as BLE does
+ * @param chunks most chunks to read, the dump is left in the middle after them
+ * @return false if a frame did not decode
+ */
+bool dump(size_t chunks = SIZE_MAX) {
+    records.clear();
+    firsts.clear();
+    for(size_t i = 0; i < chunks; i++) {
+        uint8_t frame[PROTOCOL::maxTelemetryFrameSize];
+        const size_t len = Trace::Encode(frame, sizeof(frame));
+        if(len == PROTOCOL::headerSize) {
+            return true;
+        }
+        PROTOCOL::TraceChunk chunk;
+        if(!PROTOCOL::Decode(frame, len, chunk)) {
+            return false;
+        }
+        firsts.push_back(chunk.first);
+        records.insert(records.end(), chunk.records.begin(), chunk.records.begin() + chunk.count);
+    }
+    return true;
+}
+
+// Each record a millisecond after the previous one, cycles tell them apart
+void record(uint32_t arg0) {
+    SIM::AdvanceTime(1000);
+    Trace::Record(Trace::Event::Publish, arg0, 1);
+}
+
+class TraceTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        TEST::Reset();
+        TEST::Options().log = ESP_LOG_NONE;
+        Trace::Start(ESP_SLEEP_WAKEUP_TIMER);
+    }
+};
+
+} // namespace end --------------------
+
+TEST_F(TraceTest, KeepsWakeUntilFull) {
+    for(uint32_t i = 0; i < 10; i++) {
+        record(i);
+    }
+    ASSERT_TRUE(dump());
+
+    ASSERT_EQ(records.size(), 11u);
+    EXPECT_EQ(records[0].event, (uint8_t) Trace::Event::Wake);
+    EXPECT_EQ(records[0].arg0 & 0xFF, (uint32_t) ESP_SLEEP_WAKEUP_TIMER);
+    EXPECT_EQ(records[0].arg0 >> 8, 80u);
+    for(uint32_t i = 0; i < 10; i++) {
+        EXPECT_EQ(records[1 + i].event, (uint8_t) Trace::Event::Publish);
+        EXPECT_EQ(records[1 + i].arg0, i);
+        EXPECT_EQ(records[1 + i].boot, 1);
+    }
+}
+
+TEST_F(TraceTest, RingKeepsNewestAfterWrapping) {
+    const uint32_t count = 3 * TRACE_RECORDS + 5;
+    for(uint32_t i = 0; i < count; i++) {
+        record(i);
+    }
+    ASSERT_TRUE(dump());
+
+    ASSERT_EQ(records.size(), (size_t) TRACE_RECORDS);
+    for(size_t i = 0; i < firsts.size(); i++) {
+        EXPECT_EQ(firsts[i], i * PROTOCOL::traceChunkRecords);
+    }
+    for(size_t i = 0; i < records.size(); i++) {
+        EXPECT_EQ(records[i].arg0, count - TRACE_RECORDS + i) << "record " << i;
+        // Oldest first
+        if(i) {
+            EXPECT_GT(records[i].cycles, records[i - 1].cycles) << "record " << i;
+        }
+    }
+}
+
+TEST_F(TraceTest, RingSurvivesNextBoot) {
+    for(uint32_t i = 0; i < 5; i++) {
+        record(i);
+    }
+    // Deep sleep: rings are in RTC memory, the next boot appends to them
+    Trace::Start(ESP_SLEEP_WAKEUP_EXT1);
+    record(100);
+    ASSERT_TRUE(dump());
+
+    ASSERT_EQ(records.size(), 8u);
+    EXPECT_EQ(records[0].boot, 1);
+    EXPECT_EQ(records[5].boot, 1);
+    EXPECT_EQ(records[6].event, (uint8_t) Trace::Event::Wake);
+    EXPECT_EQ(records[6].boot, 2);
+    EXPECT_EQ(records[7].arg0, 100u);
+}
+
+TEST_F(TraceTest, PausedWhileDumping) {
+    for(uint32_t i = 0; i < TRACE_RECORDS; i++) {
+        record(i);
+    }
+    ASSERT_TRUE(dump(1));
+    // Dropped, the reader is in the middle of the dump
+    record(1000);
+    // Rest of the dump ends it, recording goes on
+    uint8_t frame[PROTOCOL::maxTelemetryFrameSize];
+    while(Trace::Encode(frame, sizeof(frame)) != PROTOCOL::headerSize) {
+    }
+    record(1001);
+    ASSERT_TRUE(dump());
+
+    ASSERT_EQ(records.size(), (size_t) TRACE_RECORDS);
+    EXPECT_EQ(records.back().arg0, 1001u);
+    EXPECT_EQ(records[records.size() - 2].arg0, TRACE_RECORDS - 1u);
+}
+
+TEST_F(TraceTest, HalfReadDumpResumesAfterTimeout) {
+    for(uint32_t i = 0; i < TRACE_RECORDS; i++) {
+        record(i);
+    }
+    // Reader goes away without disconnecting
+    ASSERT_TRUE(dump(1));
+    SIM::AdvanceTime((Trace::pauseTimeoutMs - 2) * 1000);
+    record(1000);
+    SIM::AdvanceTime(1000);
+    record(1001);
+
+    // Next reader starts from the beginning and sees the records after the timeout
+    ASSERT_TRUE(dump());
+    ASSERT_FALSE(firsts.empty());
+    EXPECT_EQ(firsts[0], 0);
+    ASSERT_EQ(records.size(), (size_t) TRACE_RECORDS);
+    EXPECT_EQ(records.back().arg0, 1001u);
+    EXPECT_EQ(records[records.size() - 2].arg0, TRACE_RECORDS - 1u);
+}
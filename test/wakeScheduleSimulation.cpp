@@ -0,0 +1,212 @@
+/**
+ * @file wakeScheduleSimulation.cpp
+ * @author Maciej Sliwinski
+ * @brief This file is a part of time_tracker_esp32 project.
+ *
+ * The code is distributed under the MIT License.
+ * See the LICENCE file for more details.
+ */
+
+// Energy against sync latency of APP::WakeSchedule over a synthetic week, learned intervals
+// against fixed ones. Runs the schedule code itself, the rest is a short model of
+// AppManagementTask: each wake is a stub wake unless the cube moved or the BLE window is due,
+// then the application boots and advertises, desktop connects if it is around and reads
+// the positions. Currents and timings are those of tools/powerModel.py (no roll cooldown,
+// no power tiers), which models the rest in detail.
+// Office user: flips at random 3 times an hour on work days 9-17, desktop listens in these hours.
+// First week is learning, the second is reported. Fails if learned intervals do not save
+// charge against the defaults or make flips wait longer than maxLatencyP90s.
+
+#include "wakeSchedule.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace APP;
+
+namespace {
+
+// Monday midnight, 2026-01-05
+constexpr time_t start = 1767571200;
+constexpr double hour = 3600;
+constexpr double day = 24 * hour;
+constexpr int learningDays = 7;
+constexpr int days = 7;
+
+constexpr double flipsPerHour = 3;
+constexpr int workStart = 9;
+constexpr int workEnd = 17;
+constexpr int workDays = 5;
+
+// tools/powerModel.py CURRENTS [mA] and timings [s]
+constexpr double sleepMa = 0.035;
+constexpr double stubMa = 12;
+constexpr double bootMa = 30;
+constexpr double advertisingMa = 55;
+constexpr double connectedMa = 65;
+constexpr double bootTime = 0.25;
+constexpr double stubTime = 0.0025;
+// SleepScheduler::GetDeferTime of BLE_WINDOW and IMU_NEW_POSITION
+constexpr double advertisingTime = 5;
+// Bonded reconnect and reading of the positions (sim.day report)
+constexpr double connectTime = 0.2;
+constexpr double readTime = 1;
+
+constexpr double maxLatencyP90s = 60;
+
+struct Result {
+    double chargeMah;
+    unsigned int boots;
+    unsigned int stubWakes;
+    unsigned int windows;
+    std::vector<double> latencies;
+};
+
+bool isWorking(double t) {
+    const int weekDay = (int) (t / day) % 7;
+    const double hourOfDay = fmod(t, day) / hour;
+    return weekDay < workDays && hourOfDay >= workStart && hourOfDay < workEnd;
+}
+
+std::vector<double> makeFlips(double end) {
+    std::mt19937 rng(33);
+    std::exponential_distribution<double> gap(flipsPerHour / hour);
+    std::vector<double> flips;
+    for(double t = 0; t < end;) {
+        if(!isWorking(t)) {
+            // Next full hour
+            t = floor(t / hour + 1) * hour;
+            continue;
+        }
+        t += gap(rng);
+        if(t < end && isWorking(t)) {
+            flips.push_back(t);
+        }
+    }
+    return flips;
+}
+
+double percentile(std::vector<double> values, double p) {
+    if(values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, (size_t) (p / 100 * values.size()))];
+}
+
+/**
+ * @param wakeInterval, bleInterval fixed intervals, 0 - learned by WakeSchedule
+ */
+Result run(const std::vector<double>& flips, std::chrono::seconds wakeInterval, std::chrono::seconds bleInterval) {
+    UsageHistory history = {};
+    WakeSchedule schedule(history);
+    Result result = {};
+    const double measureFrom = learningDays * day;
+    const double end = measureFrom + days * day;
+
+    size_t nextFlip = 0;
+    std::vector<double> saved;
+    double lastBle = 0;
+    double t = 0;
+    double sleepSince = 0;
+    // Power on boots the application, time is not synced before the desktop connects
+    bool boot = true;
+    double interval = defaultWakeInterval.count();
+    double blePeriod = defaultBleInterval.count();
+
+    while(t < end) {
+        const bool measured = t >= measureFrom;
+        double charge = std::max(0.0, t - std::max(sleepSince, measureFrom)) * sleepMa;
+        const time_t now = start + (time_t) t;
+
+        bool moved = false;
+        while(nextFlip < flips.size() && flips[nextFlip] <= t) {
+            saved.push_back(flips[nextFlip++]);
+            moved = true;
+        }
+        // Same sum as the wake time below, so a wake at the deadline sees it due
+        const bool windowDue = t >= lastBle + blePeriod;
+
+        if(boot || moved || windowDue) {
+            double awake = bootTime;
+            charge += bootTime * bootMa;
+            if(moved) {
+                schedule.RecordFlip(now);
+            }
+            else if(windowDue) {
+                schedule.RecordBleWindow(now);
+                result.windows += measured;
+            }
+            if(isWorking(t)) {
+                // Connects during advertising, reads positions and sends the tracker to sleep
+                schedule.RecordConnection(now);
+                charge += connectTime * advertisingMa + readTime * connectedMa;
+                awake += connectTime + readTime;
+                for(double flip : saved) {
+                    if(measured) result.latencies.push_back(t + bootTime + connectTime - flip);
+                }
+                saved.clear();
+                lastBle = t + awake;
+            }
+            else {
+                charge += advertisingTime * advertisingMa;
+                awake += advertisingTime;
+                lastBle = t + awake;
+            }
+            result.boots += measured;
+            t += awake;
+            const time_t woken = start + (time_t) t;
+            interval = wakeInterval.count() ? wakeInterval.count() : schedule.GetWakeInterval(woken).count();
+            blePeriod = bleInterval.count() ? bleInterval.count() : schedule.GetBleInterval(woken).count();
+            boot = false;
+        }
+        else {
+            // Wake stub, cube rests and no window is due
+            charge += stubTime * stubMa;
+            result.stubWakes += measured;
+            t += stubTime;
+        }
+        if(measured) {
+            result.chargeMah += charge / 3600;
+        }
+        sleepSince = t;
+        // Stub wakes at the window deadline at the latest
+        t = std::min(t + interval, lastBle + blePeriod);
+    }
+    return result;
+}
+
+} // namespace end --------------------
+
+int main() {
+    const auto flips = makeFlips((learningDays + days) * day);
+
+    struct Case {
+        const char *name;
+        std::chrono::seconds wake;
+        std::chrono::seconds ble;
+    };
+    const Case cases[] = {
+        {"learned", 0s, 0s},
+        {"fixed default", defaultWakeInterval, defaultBleInterval},
+        {"fixed shortest", minWakeInterval, minBleInterval},
+        {"fixed longest", maxWakeInterval, maxBleInterval},
+    };
+
+    printf("Office week after %d days of learning, flips %d/h on work days %d-%d\n", learningDays,
+            (int) flipsPerHour, workStart, workEnd);
+    printf("schedule         charge [mAh/day]  boots/day  stub wakes/day  windows/day  flip to desktop [s] p50 p90 max\n");
+    Result learned = {}, fixed = {};
+    for(const auto& c : cases) {
+        auto result = run(flips, c.wake, c.ble);
+        printf("%-16s %16.3f %10.0f %15.0f %12.0f %25.1f %5.1f %5.1f\n", c.name, result.chargeMah / days,
+                result.boots / (double) days, result.stubWakes / (double) days, result.windows / (double) days,
+                percentile(result.latencies, 50), percentile(result.latencies, 90), percentile(result.latencies, 100));
+        if(&c == &cases[0]) learned = result;
+        if(&c == &cases[1]) fixed = result;
+    }
+
+    const bool passed = learned.chargeMah < fixed.chargeMah && percentile(learned.latencies, 90) < maxLatencyP90s;
+    printf("%s\n", passed ? "Learned schedule saves charge within the latency bound" : "Learned schedule worse than expected");
+    return passed ? 0 : 1;
+}
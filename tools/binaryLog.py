@@ -0,0 +1,228 @@
+#!/usr/bin/env python3
+"""
+@file binaryLog.py
+@author Maciej Sliwinski
+@brief This file is a part of time_tracker_esp32 project.
+
+The code is distributed under the MIT License.
+See the LICENCE file for more details.
+
+Expands binary log dumps (TELEMETRY::BinaryLog) to text.
+
+Records carry the hash of their format string only. Formats are taken from BLOGx calls
+in the sources, hashed the same way (32 bit FNV-1a). Sources change, keep the table
+of each released firmware:
+    binaryLog.py --extract table.json
+    binaryLog.py --table table.json dump.txt
+
+Input: binary log characteristic frames as hex, one per line, as read until the empty frame.
+Several dumps may follow each other, records seen in more of them are kept once.
+        01 1f 02 00 00 20 fc ...
+
+Output, a line per record, by boot and time since it:
+    boot 12     0.412345 I services.cpp:326 Received packet 5
+
+Usage:
+    binaryLog.py [dump files...] [--sources DIR...] [--table FILE]    (stdin if none)
+    binaryLog.py --extract FILE [--sources DIR...]
+"""
+
+import argparse
+import json
+import os
+import re
+import struct
+import sys
+
+PROTOCOL_VERSION = 0x01
+TAG_LOG_FIRST = 0x1F
+TAG_LOG_RECORDS = 0x20
+MAX_ARGS = 4
+RECORD_WORDS = 3 + MAX_ARGS
+
+# esp_log_level_t
+LEVELS = ["N", "E", "W", "I", "D", "V"]
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+DEFAULT_SOURCES = [os.path.join(ROOT, d) for d in ("app", "drivers", "src")]
+SOURCE_FILES = re.compile(r".*\.(c|cpp|h|hpp)$")
+
+HEX_LINE = re.compile(r"^\s*((?:[0-9a-fA-F]{2}[\s:]*)+)$")
+# Macro name, then the format: adjacent string literals, maybe over several lines
+CALL = re.compile(r"\bBLOG[EWID]\s*\(\s*((?:\"(?:[^\"\\\n]|\\.)*\"\s*)+)")
+LITERAL = re.compile(r"\"((?:[^\"\\\n]|\\.)*)\"")
+ESCAPES = {"n": 10, "t": 9, "r": 13, "0": 0, "\\": 92, "\"": 34, "'": 39, "a": 7, "b": 8, "f": 12, "v": 11}
+# printf conversion: flags, width, precision, length, specifier
+CONVERSION = re.compile(r"%([-+ #0]*)(\d*)(?:\.(\d+))?(hh|h|ll|l|z|j|t)?([diouxXcfeEgGaAsp%])")
+
+
+def fnv1a(data):
+    """Same as TELEMETRY::BinaryLog::Hash"""
+    value = 2166136261
+    for byte in data:
+        value = ((value ^ byte) * 16777619) & 0xFFFFFFFF
+    return value
+
+
+def unescape(literal):
+    """Bytes of a C string literal body"""
+    data = bytearray()
+    i = 0
+    raw = literal.encode("utf-8")
+    while i < len(raw):
+        if raw[i] != ord("\\"):
+            data.append(raw[i])
+            i += 1
+            continue
+        escape = chr(raw[i + 1])
+        if escape == "x":
+            digits = re.match(rb"[0-9a-fA-F]+", raw[i + 2:]).group(0)
+            data.append(int(digits, 16) & 0xFF)
+            i += 2 + len(digits)
+        elif escape in "01234567":
+            digits = re.match(rb"[0-7]{1,3}", raw[i + 1:]).group(0)
+            data.append(int(digits, 8) & 0xFF)
+            i += 1 + len(digits)
+        else:
+            data.append(ESCAPES.get(escape, ord(escape)))
+            i += 2
+    return bytes(data)
+
+
+def extract(sources):
+    """Table id -> format and places it is logged from"""
+    table = {}
+    for source in sources:
+        for directory, _, files in os.walk(source):
+            for name in sorted(files):
+                if not SOURCE_FILES.match(name):
+                    continue
+                path = os.path.join(directory, name)
+                with open(path, encoding="utf-8", errors="replace") as file:
+                    text = file.read()
+                for call in CALL.finditer(text):
+                    data = b"".join(unescape(m.group(1)) for m in LITERAL.finditer(call.group(1)))
+                    line = text.count("\n", 0, call.start()) + 1
+                    entry = table.setdefault("%08x" % fnv1a(data), {"format": data.decode("utf-8", "replace"),
+                                                                    "places": []})
+                    if entry["format"] != data.decode("utf-8", "replace"):
+                        print("Hash collision: '%s' and '%s'" % (entry["format"], data.decode()), file=sys.stderr)
+                    entry["places"].append("%s:%d" % (name, line))
+    return table
+
+
+def parse_frame(data):
+    """Walk TLV items of the frame, see app/protocol/protocol.hpp"""
+    if len(data) < 1 or data[0] != PROTOCOL_VERSION:
+        return None
+    items = {}
+    offset = 1
+    while offset + 2 <= len(data):
+        tag, length = data[offset], data[offset + 1]
+        value = data[offset + 2:offset + 2 + length]
+        if len(value) < length:
+            return None
+        items[tag] = value
+        offset += 2 + length
+    if TAG_LOG_FIRST not in items or TAG_LOG_RECORDS not in items:
+        return None
+
+    raw = items[TAG_LOG_RECORDS]
+    words = [int.from_bytes(raw[i:i + 4], "little") for i in range(0, len(raw) - len(raw) % 4, 4)]
+    records = []
+    for i in range(0, len(words) - len(words) % RECORD_WORDS, RECORD_WORDS):
+        word = words[i:i + RECORD_WORDS]
+        records.append({"id": word[0], "time": word[1], "level": word[2] & 0xFF, "argc": (word[2] >> 8) & 0xFF,
+                        "boot": word[2] >> 16, "args": word[3:3 + MAX_ARGS]})
+    return int.from_bytes(items[TAG_LOG_FIRST], "little"), records
+
+
+def read_records(lines):
+    """Records of all dumps, each once, by boot and time"""
+    records = {}
+    for line in lines:
+        match = HEX_LINE.match(line)
+        if not match:
+            continue
+        frame = parse_frame(bytes.fromhex(re.sub(r"[\s:]", "", match.group(1))))
+        if frame is None:
+            continue
+        for record in frame[1]:
+            key = (record["boot"], record["time"], record["id"], tuple(record["args"]))
+            records.setdefault(key, record)
+    return sorted(records.values(), key=lambda r: (r["boot"], r["time"]))
+
+
+def expand(format, args):
+    """printf on the host, arguments are raw 32 bit words"""
+    args = list(args)
+
+    def convert(match):
+        flags, width, precision, length, specifier = match.groups()
+        if specifier == "%":
+            return "%"
+        if not args:
+            return match.group(0)
+        value = args.pop(0)
+        spec = "%" + flags + width + ("." + precision if precision else "")
+        if specifier in "di":
+            return (spec + "d") % (value - (1 << 32) if value & 0x80000000 else value)
+        if specifier in "ouxX":
+            return (spec + specifier) % value
+        if specifier == "c":
+            return chr(value & 0xFF)
+        if specifier in "feEgGaA":
+            single = struct.unpack("<f", struct.pack("<I", value))[0]
+            return (spec + (specifier if specifier not in "aA" else "e")) % single
+        # Strings and pointers are refused by the firmware
+        return "<0x%08x>" % value
+
+    return CONVERSION.sub(convert, format)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Binary log dump to text")
+    parser.add_argument("files", nargs="*", help="dump files, stdin if none")
+    parser.add_argument("--sources", nargs="+", default=DEFAULT_SOURCES, help="directories searched for formats")
+    parser.add_argument("--table", help="table saved with --extract, instead of the sources")
+    parser.add_argument("--extract", metavar="FILE", help="save table of the sources and exit")
+    args = parser.parse_args()
+
+    if args.table:
+        with open(args.table) as file:
+            table = json.load(file)
+    else:
+        table = extract(args.sources)
+    if args.extract:
+        with open(args.extract, "w") as file:
+            json.dump(table, file, indent=1, sort_keys=True)
+        return 0
+
+    if args.files:
+        lines = []
+        for path in args.files:
+            with open(path) as file:
+                lines.extend(file.readlines())
+    else:
+        lines = sys.stdin.readlines()
+
+    records = read_records(lines)
+    if not records:
+        print("No log records found", file=sys.stderr)
+        return 1
+    for record in records:
+        level = LEVELS[record["level"]] if record["level"] < len(LEVELS) else "?"
+        entry = table.get("%08x" % record["id"])
+        if entry is None:
+            place = "?"
+            message = "unknown format %08x, args %s" % (record["id"], " ".join(
+                "0x%x" % a for a in record["args"][:record["argc"]]))
+        else:
+            place = "|".join(entry["places"])
+            message = expand(entry["format"], record["args"][:record["argc"]])
+        print("boot %-5d %12.6f %s %s %s" % (record["boot"], record["time"] / 1e6, level, place, message))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+"""
+@file bootProfile.py
+@author Maciej Sliwinski
+@brief This file is a part of time_tracker_esp32 project.
+
+The code is distributed under the MIT License.
+See the LICENCE file for more details.
+
+Aggregates wake timelines (TELEMETRY::BootProfile) into percentiles.
+
+Accepts, mixed in any order:
+  - UART lines (firmware built with -D BOOT_PROFILE_UART=1):
+        boot_profile wake=12 app_main=41234 nvs_init=45012 ...
+  - Boot profile characteristic frames as hex, one per line:
+        01 18 1c 12 a1 00 00 ...
+
+Usage:
+    bootProfile.py [log files...]    (stdin if none)
+"""
+
+import math
+import re
+import sys
+
+# Same order as PROTOCOL::BootMarker
+MARKERS = ["app_main", "nvs_init", "imu_init", "first_sample", "ble_init", "advertising", "sleep"]
+PERCENTILES = [50, 90, 99]
+
+PROTOCOL_VERSION = 0x01
+TAG_BOOT_TIMES = 0x18
+
+UART_LINE = re.compile(r"boot_profile\s+wake=(\d+)((?:\s+\w+=\d+)+)")
+HEX_LINE = re.compile(r"^\s*((?:[0-9a-fA-F]{2}[\s:]*)+)$")
+
+
+def parse_uart(match):
+    times = {}
+    for item in match.group(2).split():
+        name, value = item.split("=")
+        times[name] = int(value)
+    return [times.get(name, 0) for name in MARKERS]
+
+
+def parse_frame(data):
+    """Walk TLV items of the frame, see app/protocol/protocol.hpp"""
+    if len(data) < 1 or data[0] != PROTOCOL_VERSION:
+        return None
+    offset = 1
+    while offset + 2 <= len(data):
+        tag, length = data[offset], data[offset + 1]
+        value = data[offset + 2:offset + 2 + length]
+        if len(value) < length:
+            return None
+        if tag == TAG_BOOT_TIMES:
+            times = [int.from_bytes(value[i:i + 4], "little") for i in range(0, length - length % 4, 4)]
+            return (times + [0] * len(MARKERS))[:len(MARKERS)]
+        offset += 2 + length
+    return None
+
+
+def read_timelines(lines):
+    timelines = []
+    for line in lines:
+        match = UART_LINE.search(line)
+        if match:
+            timelines.append(parse_uart(match))
+            continue
+        match = HEX_LINE.match(line)
+        if match:
+            data = bytes.fromhex(re.sub(r"[\s:]", "", match.group(1)))
+            timeline = parse_frame(data)
+            if timeline:
+                timelines.append(timeline)
+    return timelines
+
+
+def percentile(values, p):
+    values = sorted(values)
+    if not values:
+        return 0
+    # Nearest rank
+    rank = max(0, min(len(values) - 1, math.ceil(p / 100.0 * len(values)) - 1))
+    return values[rank]
+
+
+def report(timelines):
+    header = "{:<16}{:>8}".format("marker [ms]", "count") + "".join("{:>10}".format("p%d" % p) for p in PERCENTILES) + "{:>10}".format("max")
+    print("Time since wake")
+    print(header)
+    for index, name in enumerate(MARKERS):
+        values = [t[index] / 1000.0 for t in timelines if t[index]]
+        print_row(name, values)
+
+    # Time spent between consecutive markers reached in the same wake
+    print("\nPhase duration")
+    print(header)
+    for index in range(1, len(MARKERS)):
+        values = []
+        for t in timelines:
+            previous = [t[i] for i in range(index) if t[i]]
+            if t[index] and previous:
+                values.append((t[index] - max(previous)) / 1000.0)
+        print_row("-> " + MARKERS[index], values)
+
+
+def print_row(name, values):
+    row = "{:<16}{:>8}".format(name, len(values))
+    row += "".join("{:>10.1f}".format(percentile(values, p)) for p in PERCENTILES)
+    row += "{:>10.1f}".format(max(values) if values else 0)
+    print(row)
+
+
+def main():
+    if len(sys.argv) > 1:
+        lines = []
+        for path in sys.argv[1:]:
+            with open(path) as file:
+                lines.extend(file.readlines())
+    else:
+        lines = sys.stdin.readlines()
+
+    timelines = read_timelines(lines)
+    if not timelines:
+        print("No boot profiles found", file=sys.stderr)
+        return 1
+    print("Wakes: %d\n" % len(timelines))
+    report(timelines)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,560 @@
+#!/usr/bin/env python3
+"""
+@file powerModel.py
+@author Maciej Sliwinski
+@brief This file is a part of time_tracker_esp32 project.
+
+The code is distributed under the MIT License.
+See the LICENCE file for more details.
+
+Discrete-event model of the tracker: battery life and flip-to-desktop latency
+for a usage profile. Runs weeks of use in a second, so scheduling changes can be
+compared before they are flashed. For the firmware itself on a PC see docs/simulation.md.
+
+Modelled after AppManagementTask (app/appManagement/appManagement.hpp):
+  - timer wakes are handled by the wake stub while the cube rests and no BLE window is due
+  - a moved cube boots the application. IMU registers the position after it is steady
+    for the roll cooldown, which often takes one more wake
+  - new position (or BLE window) starts advertising, desktop connects if it is around,
+    syncs time, reads positions and sends the tracker to sleep
+  - wake and BLE window intervals are learned from usage (WakeSchedule)
+  - battery level selects a power tier which limits intervals and radio use (PowerGovernor)
+Each state draws a fixed current, see --current.
+
+Usage:
+    powerModel.py [--profile office] [--days 28] [--sweep wake_interval=10,20,60]
+"""
+
+import argparse
+import heapq
+import math
+import random
+import sys
+
+HOUR = 3600.0
+DAY = 24 * HOUR
+PERCENTILES = [50, 90, 99]
+
+# Device states and their current [mA]. Override with --current STATE=MA
+CURRENTS = {
+    "sleep": 0.035,         # ESP32 0.015, MPU6050 cycling at 5 Hz 0.020 (IMU::Imu::sleepProfile)
+    "stub": 12.0,
+    "boot": 30.0,
+    "awake": 40.0,
+    "advertising": 55.0,
+    "connected": 65.0,
+}
+
+# Firmware timings [s]. Same as in the sources referenced
+BOOT_TIME = 0.25            # Reset to app_main (measured with tools/bootProfile.py)
+STUB_TIME = 0.0025          # Stub wake to sleep (WakeStub::GetStats)
+ROLL_COOLDOWN = 5.0         # IMU::Imu::rollCooldown
+DEFER = {                   # SleepScheduler::GetDeferTime
+    "boot": 0.1,
+    "ble_window": 5.0,
+    "new_position": 5.0,
+    "send_position": 1.0,
+    "ota": 300.0,
+}
+
+# Mirror of APP::PowerGovernor::policies (app/appManagement/powerGovernor.cpp). Keep in sync.
+# name, enter below [%], min wake interval [s], min BLE interval [s], OTA, radio
+TIERS = [
+    ("normal", 100, 0.0, 0.0, True, True),
+    ("saving", 40, 30.0, 900.0, True, True),
+    ("low", 20, 60.0, 3600.0, False, True),
+    ("protect", 5, 120.0, DAY, False, False),
+]
+TIER_HYSTERESIS = 5
+
+# Usage profiles: flips per hour at work, work hours, work days per week, when desktop listens
+PROFILES = {
+    "office": dict(flips_per_hour=3.0, work_start=9, work_end=17, work_days=5, desktop="work"),
+    "heavy": dict(flips_per_hour=10.0, work_start=8, work_end=20, work_days=6, desktop="work"),
+    "light": dict(flips_per_hour=0.5, work_start=10, work_end=14, work_days=3, desktop="work"),
+    "drawer": dict(flips_per_hour=0.0, work_start=9, work_end=17, work_days=5, desktop="never"),
+}
+
+
+class WakeSchedule:
+    """Mirror of APP::WakeSchedule (app/appManagement/wakeSchedule.hpp). Keep in sync."""
+
+    MIN_WAKE, MAX_WAKE, DEFAULT_WAKE = 10.0, 120.0, 20.0
+    MIN_BLE, MAX_BLE, DEFAULT_BLE = 120.0, 3600.0, 300.0
+    EVENT_WEIGHT = 4
+    MIN_HISTORY = 16 * EVENT_WEIGHT
+
+    def __init__(self):
+        self.flips = [0] * 24
+        self.windows = [0] * 24
+        self.syncs = [0] * 24
+        self.last_decay_day = 0
+
+    def wake_interval(self, now, valid):
+        likelihood = self._likelihood(self.flips, now) if valid else None
+        if likelihood is None:
+            return self.DEFAULT_WAKE
+        return self._interpolate(self.MIN_WAKE, self.MAX_WAKE, likelihood)
+
+    def ble_interval(self, now, valid):
+        likelihood = self._sync_likelihood(now) if valid else None
+        if likelihood is None:
+            return self.DEFAULT_BLE
+        flips = self._likelihood(self.flips, now)
+        if flips is not None and flips > likelihood:
+            likelihood = flips
+        return self._interpolate(self.MIN_BLE, self.MAX_BLE, likelihood)
+
+    def record(self, counters, now, valid):
+        if not valid:
+            return
+        self._decay(now)
+        hour = int(now // HOUR) % 24
+        counters[hour] = min(255, counters[hour] + self.EVENT_WEIGHT)
+
+    @staticmethod
+    def _interpolate(low, high, likelihood):
+        return float(int(high - (high - low) * likelihood))
+
+    def _likelihood(self, counters, now):
+        busiest = max(counters)
+        if sum(counters) < self.MIN_HISTORY or busiest == 0:
+            return None
+        hour = int(now // HOUR) % 24
+        return max(counters[hour], counters[(hour + 1) % 24]) / float(busiest)
+
+    def _sync_likelihood(self, now):
+        if sum(self.windows) < self.MIN_HISTORY:
+            return None
+        hour = int(now // HOUR) % 24
+        likelihood = 0.0
+        for h in (hour, (hour + 1) % 24):
+            if self.windows[h]:
+                likelihood = max(likelihood, self.syncs[h] / float(self.windows[h]))
+        return min(likelihood, 1.0)
+
+    def _decay(self, now):
+        day = int(now // DAY)
+        if day == self.last_decay_day:
+            return
+        days = day - self.last_decay_day if day > self.last_decay_day else 1
+        for _ in range(min(days, 16)):
+            for counters in (self.flips, self.windows, self.syncs):
+                for h in range(24):
+                    counters[h] -= (counters[h] + 3) // 4
+        self.last_decay_day = day
+
+
+def select_tier(current, percent):
+    """PowerGovernor::Select"""
+    selected = 0
+    for i in range(1, len(TIERS)):
+        threshold = TIERS[i][1] + (TIER_HYSTERESIS if i <= current else 0)
+        if percent < threshold:
+            selected = i
+    return selected
+
+
+class User:
+    """Flips and desktop presence. Time 0 is Monday midnight."""
+
+    def __init__(self, profile, days, rng):
+        self.profile = profile
+        self.flips = []
+        face = 1
+        t = 0.0
+        while t < days * DAY:
+            if not self.is_working(t):
+                t = self._next_work_start(t)
+                continue
+            rate = profile["flips_per_hour"] / HOUR
+            if rate <= 0:
+                t = self._work_end(t)
+                continue
+            t += rng.expovariate(rate)
+            if t < days * DAY and self.is_working(t):
+                face = rng.choice([f for f in range(1, 7) if f != face])
+                self.flips.append((t, face))
+        # Tracker is put aside for the evening
+        self.flips = self._with_evenings(days)
+
+    def is_working(self, t):
+        day = int(t // DAY)
+        hour = (t % DAY) / HOUR
+        return day % 7 < self.profile["work_days"] and self.profile["work_start"] <= hour < self.profile["work_end"]
+
+    def is_desktop_present(self, t):
+        desktop = self.profile["desktop"]
+        return desktop == "always" or (desktop == "work" and self.is_working(t))
+
+    def _work_end(self, t):
+        return (t // DAY) * DAY + self.profile["work_end"] * HOUR
+
+    def _next_work_start(self, t):
+        start = (t // DAY) * DAY + self.profile["work_start"] * HOUR
+        return start if start > t else start + DAY
+
+    def _with_evenings(self, days):
+        flips = []
+        for t, face in self.flips:
+            if flips and self._work_end(flips[-1][0]) < t and flips[-1][1] != 1:
+                flips.append((self._work_end(flips[-1][0]), 1))
+            flips.append((t, face))
+        if flips and flips[-1][1] != 1 and self._work_end(flips[-1][0]) < days * DAY:
+            flips.append((self._work_end(flips[-1][0]), 1))
+        return flips
+
+
+class Tracker:
+    """Event driven model of the firmware. RTC memory survives sleep, the rest does not."""
+
+    def __init__(self, user, options):
+        self.user = user
+        self.options = options
+        self.events = []
+        self.sequence = 0
+        self.now = 0.0
+
+        self.state = "sleep"
+        self.state_since = 0.0
+        self.charge = dict.fromkeys(CURRENTS, 0.0)     # mA*s
+        self.time_in = dict.fromkeys(CURRENTS, 0.0)
+        self.counts = dict(boots=0, stub_wakes=0, windows=0, connections=0, flips=0, registered=0, ota=0)
+        self.latencies = []
+        self.tier = 0
+        self.tier_since = 0.0
+        self.time_in_tier = [0.0] * len(TIERS)
+
+        # User side
+        self.face = 1
+        self.flip_time = 0.0
+
+        # RTC memory
+        self.schedule = WakeSchedule()
+        self.clock_valid = False
+        self.last_ble = -math.inf
+        self.old_face = 1
+        self.cooldown = 0.0
+        self.is_new_pos = False
+        self.saved = []                 # flip times of registered positions
+        self.stub_armed = False
+        self.stub_ble_deadline = 0.0
+
+        # Application, valid while awake
+        self.awake = False
+        self.deadlines = {}
+        self.ble_period = 0.0
+        self.ble_active = False
+        self.connected = False
+
+    # Event queue ------------------------------------------------------------
+
+    def at(self, time, handler, *args):
+        self.sequence += 1
+        heapq.heappush(self.events, (time, self.sequence, handler, args))
+
+    def run(self, end):
+        for t, face in self.user.flips:
+            self.at(t, self.on_flip, face)
+        self.at(self.options.boot_at, self.on_wake)
+        while self.events and self.events[0][0] < end:
+            time, _, handler, args = heapq.heappop(self.events)
+            self.now = time
+            handler(*args)
+        self.now = end
+        self.set_state(self.state)
+        self.time_in_tier[self.tier] += self.now - self.tier_since
+        self.tier_since = self.now
+
+    def set_state(self, state):
+        elapsed = self.now - self.state_since
+        self.charge[self.state] += elapsed * self.options.currents[self.state]
+        self.time_in[self.state] += elapsed
+        self.state = state
+        self.state_since = self.now
+
+    def radio_state(self):
+        return "connected" if self.connected else "advertising" if self.ble_active else "awake"
+
+    # User -------------------------------------------------------------------
+
+    def on_flip(self, face):
+        self.face = face
+        self.flip_time = self.now
+        self.counts["flips"] += 1
+        if self.awake:
+            self.poll_imu()
+
+    # Sleep and wake ---------------------------------------------------------
+
+    def on_wake(self):
+        self.set_state("stub")
+        resting = self.face == self.old_face
+        if self.options.stub and self.stub_armed and resting and self.now < self.stub_ble_deadline:
+            self.counts["stub_wakes"] += 1
+            self.at(self.now + STUB_TIME, self.sleep_for, self.interval)
+            return
+        self.set_state("boot")
+        self.at(self.now + BOOT_TIME, self.on_boot)
+
+    def sleep_for(self, interval):
+        self.set_state("sleep")
+        self.at(self.now + interval, self.on_wake)
+
+    def on_boot(self):
+        self.counts["boots"] += 1
+        self.awake = True
+        self.ble_active = False
+        self.connected = False
+        self.deadlines = {}
+        self.set_state("awake")
+        self.ble_period = max(self.options.ble_interval or self.schedule.ble_interval(self.now, self.clock_valid),
+                              TIERS[self.tier][3])
+        self.radio = TIERS[self.tier][5]
+        self.defer("boot")
+        self.poll_imu()
+        self.check()
+
+    def go_to_sleep(self):
+        if self.connected:
+            self.last_ble = self.now
+        self.awake = False
+        self.ble_active = False
+        self.connected = False
+        self.update_tier()
+        self.interval = max(self.options.wake_interval or self.schedule.wake_interval(self.now, self.clock_valid),
+                            TIERS[self.tier][2])
+        self.stub_armed = not self.is_new_pos
+        self.stub_ble_deadline = self.last_ble + self.ble_period
+        self.sleep_for(self.interval)
+
+    def battery_percent(self):
+        self.set_state(self.state)
+        used = sum(self.charge.values()) / 3600.0
+        return max(0.0, 100.0 * (1 - used / self.options.capacity))
+
+    def update_tier(self):
+        if not self.options.tiers:
+            return
+        tier = select_tier(self.tier, self.battery_percent())
+        if tier != self.tier:
+            self.time_in_tier[self.tier] += self.now - self.tier_since
+            self.tier, self.tier_since = tier, self.now
+
+    # AppManagementTask ------------------------------------------------------
+
+    def defer(self, reason):
+        deadline = self.now + DEFER[reason]
+        if deadline > self.deadlines.get(reason, 0.0):
+            self.deadlines[reason] = deadline
+            self.at(deadline, self.check)
+
+    def check(self):
+        if not self.awake:
+            return
+        if self.connected:
+            self.last_ble = self.now
+        if self.now - self.last_ble > self.ble_period:
+            self.last_ble = self.now
+            if self.radio:
+                self.counts["windows"] += 1
+                self.schedule.record(self.schedule.windows, self.now, self.clock_valid)
+                self.start_ble()
+                self.defer("ble_window")
+        else:
+            self.at(self.last_ble + self.ble_period + 1e-3, self.check)
+        if all(deadline <= self.now for deadline in self.deadlines.values()):
+            self.go_to_sleep()
+
+    def start_ble(self):
+        if not self.ble_active:
+            self.ble_active = True
+            self.set_state(self.radio_state())
+        if self.user.is_desktop_present(self.now) and not self.connected:
+            self.at(self.now + self.options.connect_time, self.on_connect, self.boot_id())
+
+    def boot_id(self):
+        return self.counts["boots"]
+
+    # IMU task ---------------------------------------------------------------
+
+    def poll_imu(self):
+        if self.face != self.old_face:
+            self.is_new_pos = True
+            self.old_face = self.face
+            self.cooldown = self.now
+            self.at(self.now + ROLL_COOLDOWN + 1e-3, self.on_cooldown, self.boot_id())
+        if self.is_new_pos and self.now - self.cooldown > ROLL_COOLDOWN:
+            self.is_new_pos = False
+            self.saved.append(self.flip_time)
+            self.counts["registered"] += 1
+            self.schedule.record(self.schedule.flips, self.now, self.clock_valid)
+            if self.radio:
+                self.start_ble()
+                self.defer("new_position")
+
+    def on_cooldown(self, boot):
+        if self.awake and boot == self.boot_id():
+            self.poll_imu()
+
+    # Desktop ----------------------------------------------------------------
+
+    def on_connect(self, boot):
+        if not self.awake or boot != self.boot_id() or self.connected:
+            return
+        self.connected = True
+        self.counts["connections"] += 1
+        self.clock_valid = True
+        self.last_ble = self.now
+        self.schedule.record(self.schedule.syncs, self.now, self.clock_valid)
+        self.set_state(self.radio_state())
+        self.at(self.now + self.options.read_time, self.on_read, boot)
+
+    def on_read(self, boot):
+        if not self.awake or boot != self.boot_id():
+            return
+        if self.saved:
+            self.latencies.append(self.now - self.saved.pop(0))
+            self.defer("send_position")
+            self.at(self.now + self.options.read_time, self.on_read, boot)
+            return
+        if TIERS[self.tier][4] and self.options.ota_rate > 0 and random.random() < self.options.ota_rate:
+            self.counts["ota"] += 1
+            self.defer("ota")
+            return
+        # Desktop writes Sleep characteristic, SleepScheduler::ReleaseAll
+        self.deadlines = {}
+        self.check()
+
+
+def percentile(values, p):
+    values = sorted(values)
+    if not values:
+        return 0
+    # Nearest rank
+    rank = max(0, min(len(values) - 1, math.ceil(p / 100.0 * len(values)) - 1))
+    return values[rank]
+
+
+def simulate(options):
+    rng = random.Random(options.seed)
+    random.seed(options.seed + 1)
+    profile = dict(PROFILES[options.profile])
+    for key in profile:
+        if getattr(options, key, None) is not None:
+            profile[key] = getattr(options, key)
+    user = User(profile, options.days, rng)
+    tracker = Tracker(user, options)
+    tracker.run(options.days * DAY)
+    return tracker
+
+
+def summary(tracker, options):
+    seconds = options.days * DAY
+    charge = sum(tracker.charge.values())
+    average = charge / seconds
+    return dict(
+        average_ua=average * 1000,
+        life_days=0.9 * options.capacity / average / 24 if average > 0 else math.inf,
+        boots=tracker.counts["boots"] / options.days,
+        stub_wakes=tracker.counts["stub_wakes"] / options.days,
+        latency=[percentile(tracker.latencies, p) / 60 for p in PERCENTILES],
+        undelivered=len(tracker.saved),
+    )
+
+
+def report(tracker, options):
+    days = options.days
+    result = summary(tracker, options)
+    charge = sum(tracker.charge.values())
+
+    print("Simulated %g days, profile %s, %d flips" % (days, options.profile, tracker.counts["flips"]))
+    print("\n{:<14}{:>10}{:>14}{:>10}".format("state", "mA", "time/day [s]", "charge"))
+    for state in CURRENTS:
+        print("{:<14}{:>10.3f}{:>14.1f}{:>9.1f}%".format(state, options.currents[state],
+                tracker.time_in[state] / days, 100.0 * tracker.charge[state] / charge if charge else 0))
+
+    print("\nPer day: %.1f boots, %.0f stub wakes, %.1f BLE windows, %.1f connections, %.1f positions" % (
+        tracker.counts["boots"] / days, tracker.counts["stub_wakes"] / days, tracker.counts["windows"] / days,
+        tracker.counts["connections"] / days, tracker.counts["registered"] / days))
+    if tracker.counts["ota"]:
+        print("OTA updates: %d" % tracker.counts["ota"])
+
+    print("\nFlip to desktop [min]" + "".join("{:>8}".format("p%d" % p) for p in PERCENTILES) + "{:>8}".format("max"))
+    values = [latency / 60 for latency in tracker.latencies]
+    print("{:<21}".format("%d delivered" % len(values)) + "".join("{:>8.1f}".format(v) for v in result["latency"]) +
+          "{:>8.1f}".format(max(values) if values else 0))
+    if result["undelivered"]:
+        print("%d positions not delivered at the end" % result["undelivered"])
+
+    if options.tiers:
+        print("\nPower tiers [days]: " + ", ".join("%s %.1f" % (TIERS[i][0], tracker.time_in_tier[i] / DAY)
+                                                     for i in range(len(TIERS))))
+        print("Battery left %.0f%%" % tracker.battery_percent())
+
+    print("\nAverage %.0f uA, %.0f days on %.0f mAh (90%% usable)" % (
+        result["average_ua"], result["life_days"], options.capacity))
+
+
+def sweep(options):
+    name, values = options.sweep.split("=", 1)
+    if not hasattr(options, name):
+        raise SystemExit("Unknown option to sweep: %s" % name)
+    print("{:<16}{:>10}{:>10}{:>8}{:>8}".format(name, "avg uA", "days", "boots", "stub") +
+          "".join("{:>8}".format("p%d min" % p) for p in PERCENTILES))
+    for value in values.split(","):
+        setattr(options, name, type(getattr(options, name) or 0.0)(value))
+        result = summary(simulate(options), options)
+        print("{:<16}{:>10.0f}{:>10.0f}{:>8.1f}{:>8.0f}".format(value, result["average_ua"], result["life_days"],
+                result["boots"], result["stub_wakes"]) + "".join("{:>8.1f}".format(v) for v in result["latency"]))
+
+
+def parse_currents(items):
+    currents = dict(CURRENTS)
+    for item in items or []:
+        state, value = item.split("=")
+        if state not in currents:
+            raise SystemExit("Unknown state %s, one of: %s" % (state, ", ".join(CURRENTS)))
+        currents[state] = float(value)
+    return currents
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Battery life and latency model of the tracker")
+    parser.add_argument("--profile", choices=sorted(PROFILES), default="office")
+    parser.add_argument("--days", type=float, default=28)
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--capacity", type=float, default=500, help="battery [mAh]")
+    parser.add_argument("--current", action="append", metavar="STATE=MA", help="override current of a state")
+    # Profile overrides
+    parser.add_argument("--flips-per-hour", dest="flips_per_hour", type=float)
+    parser.add_argument("--work-start", dest="work_start", type=float)
+    parser.add_argument("--work-end", dest="work_end", type=float)
+    parser.add_argument("--work-days", dest="work_days", type=int)
+    parser.add_argument("--desktop", choices=["work", "always", "never"])
+    # Firmware alternatives
+    parser.add_argument("--wake-interval", dest="wake_interval", type=float, default=0.0,
+                        help="fixed wake interval [s] instead of the learned one")
+    parser.add_argument("--ble-interval", dest="ble_interval", type=float, default=0.0,
+                        help="fixed BLE window interval [s] instead of the learned one")
+    parser.add_argument("--no-stub", dest="stub", action="store_false", help="every wake boots the application")
+    parser.add_argument("--no-tiers", dest="tiers", action="store_false", help="battery level does not limit anything")
+    parser.add_argument("--ota-rate", dest="ota_rate", type=float, default=0.0, help="share of connections with OTA")
+    # Desktop
+    parser.add_argument("--connect-time", dest="connect_time", type=float, default=1.0,
+                        help="advertising start to encrypted link [s]")
+    parser.add_argument("--read-time", dest="read_time", type=float, default=0.05, help="one position read [s]")
+    parser.add_argument("--sweep", metavar="OPTION=V1,V2,..", help="one summary line per value, e.g. wake_interval=10,20")
+    options = parser.parse_args()
+    options.currents = parse_currents(options.current)
+    options.boot_at = 0.0
+
+    if options.sweep:
+        sweep(options)
+    else:
+        report(simulate(options), options)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,237 @@
+#!/usr/bin/env python3
+"""
+@file trace.py
+@author Maciej Sliwinski
+@brief This file is a part of time_tracker_esp32 project.
+
+The code is distributed under the MIT License.
+See the LICENCE file for more details.
+
+Converts trace dumps (TELEMETRY::Trace) to Chrome trace event JSON, open it in
+https://ui.perfetto.dev or chrome://tracing.
+
+Input: trace characteristic frames as hex, one per line, as read until the empty frame.
+Several dumps may follow each other, records seen in more of them are kept once.
+        01 1c 01 00 1d 02 00 00 1e f0 ...
+
+Each core is a track. Task switches become slices of the task that ran, other events
+are instants with their arguments. Wakes are placed at their epoch time, records of
+a wake by CPU cycles since it. Cycle counter wraps every 2^32 cycles (53 s at 80 MHz),
+records of one core must not be further apart than that. Counter of core 1 starts
+a few ms after the one of core 0.
+
+Usage:
+    trace.py [dump files...] [-o trace.json]    (stdin/stdout if none)
+"""
+
+import argparse
+import json
+import re
+import sys
+
+PROTOCOL_VERSION = 0x01
+TAG_TRACE_CORE = 0x1C
+TAG_TRACE_FIRST = 0x1D
+TAG_TRACE_RECORDS = 0x1E
+RECORD_WORDS = 4
+
+# Same order as PROTOCOL::TraceEvent
+EVENTS = ["wake", "sleep", "task_switch", "publish", "receive"]
+# esp_sleep_wakeup_cause_t
+CAUSES = ["reset", "all", "ext0", "ext1", "timer", "touchpad", "ulp", "gpio", "uart"]
+# Used if the wake record was overwritten
+DEFAULT_MHZ = 80
+
+HEX_LINE = re.compile(r"^\s*((?:[0-9a-fA-F]{2}[\s:]*)+)$")
+
+
+def parse_frame(data):
+    """Walk TLV items of the frame, see app/protocol/protocol.hpp"""
+    if len(data) < 1 or data[0] != PROTOCOL_VERSION:
+        return None
+    items = {}
+    offset = 1
+    while offset + 2 <= len(data):
+        tag, length = data[offset], data[offset + 1]
+        value = data[offset + 2:offset + 2 + length]
+        if len(value) < length:
+            return None
+        items[tag] = value
+        offset += 2 + length
+    if TAG_TRACE_CORE not in items or TAG_TRACE_FIRST not in items or TAG_TRACE_RECORDS not in items:
+        return None
+
+    raw = items[TAG_TRACE_RECORDS]
+    words = [int.from_bytes(raw[i:i + 4], "little") for i in range(0, len(raw) - len(raw) % 4, 4)]
+    records = []
+    for i in range(0, len(words) - len(words) % RECORD_WORDS, RECORD_WORDS):
+        head, cycles, arg0, arg1 = words[i:i + RECORD_WORDS]
+        records.append({"event": head & 0xFF, "core": (head >> 8) & 0xFF, "boot": head >> 16,
+                        "cycles": cycles, "arg0": arg0, "arg1": arg1})
+    return items[TAG_TRACE_CORE][0], int.from_bytes(items[TAG_TRACE_FIRST], "little"), records
+
+
+def read_dumps(lines):
+    """Frames grouped by dump. A dump starts again with the first record of core 0"""
+    dumps = []
+    for line in lines:
+        match = HEX_LINE.match(line)
+        if not match:
+            continue
+        frame = parse_frame(bytes.fromhex(re.sub(r"[\s:]", "", match.group(1))))
+        if frame is None:
+            continue
+        core, first, records = frame
+        if not dumps or (core == 0 and first == 0):
+            dumps.append({})
+        dumps[-1].setdefault(core, []).extend(records)
+    return dumps
+
+
+def unwrap(records):
+    """Cycles since the boot, of records of one core in ring order. First record of a boot
+    is taken as not wrapped yet"""
+    previous = {}
+    for record in records:
+        key = record["boot"]
+        if key in previous:
+            last_raw, last = previous[key]
+            record["unwrapped"] = last + ((record["cycles"] - last_raw) & 0xFFFFFFFF)
+        else:
+            record["unwrapped"] = record["cycles"]
+        previous[key] = (record["cycles"], record["unwrapped"])
+
+
+def place_boots(records):
+    """Start of each boot [us]: epoch of its wake record, cycle origin and clock"""
+    boots = {}
+    for record in records:
+        if record["event"] == EVENTS.index("wake") and record["core"] == 0:
+            boots[record["boot"]] = {"epoch_ms": record["arg1"], "origin": record["unwrapped"],
+                                     "mhz": (record["arg0"] >> 8) or DEFAULT_MHZ}
+
+    placed = {}
+    epoch = None
+    last_end = 0
+    for boot in sorted({r["boot"] for r in records}):
+        info = boots.get(boot)
+        if info is not None:
+            if epoch is None:
+                epoch = info["epoch_ms"]
+            else:
+                # Epoch ms is sent as its low 32 bits, boots go forward
+                epoch += (info["epoch_ms"] - epoch) & 0xFFFFFFFF
+            start = epoch * 1000
+            placed[boot] = (max(start, last_end), info["origin"], info["mhz"])
+        else:
+            placed[boot] = (last_end, 0, DEFAULT_MHZ)
+        ends = [r["unwrapped"] - placed[boot][1] for r in records if r["boot"] == boot]
+        last_end = placed[boot][0] + max(ends) / placed[boot][2] + 1
+    return placed
+
+
+def timestamp(record, placed):
+    start, origin, mhz = placed[record["boot"]]
+    return start + (record["unwrapped"] - origin) / mhz
+
+
+def task_name(packed):
+    name = packed.to_bytes(4, "little").rstrip(b"\0").decode("ascii", "replace")
+    return name or "?"
+
+
+def convert(dumps):
+    records = {}
+    for dump in dumps:
+        for core_records in dump.values():
+            unwrap(core_records)
+            for record in core_records:
+                key = (record["boot"], record["core"], record["cycles"], record["event"], record["arg0"], record["arg1"])
+                records.setdefault(key, record)
+    records = list(records.values())
+    if not records:
+        return None
+    placed = place_boots(records)
+    for record in records:
+        record["ts"] = timestamp(record, placed)
+    records.sort(key=lambda r: (r["core"], r["ts"]))
+
+    events = []
+    cores = sorted({r["core"] for r in records})
+    for core in cores:
+        events.append({"ph": "M", "name": "thread_name", "pid": 1, "tid": core, "args": {"name": "core %d" % core}})
+
+    # Open slices are closed with the last record of their wake
+    boot_end = {}
+    for record in records:
+        boot_end[record["boot"]] = max(boot_end.get(record["boot"], 0), record["ts"])
+
+    def close(core, current, ts):
+        events.append({"ph": "X", "name": current["name"], "pid": 1, "tid": core, "ts": current["ts"],
+                       "dur": max(ts - current["ts"], 0), "args": {"handle": "0x%08x" % current["handle"]}})
+
+    running = {}
+    for record in records:
+        core = record["core"]
+        ts = record["ts"]
+        event = EVENTS[record["event"]] if record["event"] < len(EVENTS) else "event_%d" % record["event"]
+
+        # Slice of the task ends at the next switch or when the wake ends
+        current = running.get(core)
+        if current and current["boot"] != record["boot"]:
+            close(core, running.pop(core), boot_end[current["boot"]])
+        elif current and (event == "task_switch" or event == "sleep"):
+            close(core, running.pop(core), ts)
+
+        if event == "task_switch":
+            running[core] = {"name": task_name(record["arg1"]), "handle": record["arg0"], "ts": ts,
+                             "boot": record["boot"]}
+            continue
+        if event == "wake":
+            cause = record["arg0"] & 0xFF
+            args = {"boot": record["boot"], "cause": CAUSES[cause] if cause < len(CAUSES) else cause,
+                    "mhz": record["arg0"] >> 8}
+        elif event == "sleep":
+            args = {"sleep_ms": record["arg0"], "awake_ms": record["arg1"]}
+        elif event == "publish":
+            args = {"topic": record["arg0"], "queued": bool(record["arg1"])}
+        elif event == "receive":
+            args = {"topic": record["arg0"], "left": record["arg1"]}
+        else:
+            args = {"arg0": record["arg0"], "arg1": record["arg1"]}
+        scope = "g" if event in ("wake", "sleep") else "t"
+        events.append({"ph": "i", "s": scope, "name": event, "pid": 1, "tid": core, "ts": ts, "args": args})
+
+    for core, current in running.items():
+        close(core, current, boot_end[current["boot"]])
+    return {"traceEvents": events, "displayTimeUnit": "ms"}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Trace dump to Chrome/Perfetto JSON")
+    parser.add_argument("files", nargs="*", help="dump files, stdin if none")
+    parser.add_argument("-o", "--output", help="JSON file, stdout if not given")
+    args = parser.parse_args()
+
+    if args.files:
+        lines = []
+        for path in args.files:
+            with open(path) as file:
+                lines.extend(file.readlines())
+    else:
+        lines = sys.stdin.readlines()
+
+    trace = convert(read_dumps(lines))
+    if trace is None:
+        print("No trace records found", file=sys.stderr)
+        return 1
+    if args.output:
+        with open(args.output, "w") as file:
+            json.dump(trace, file)
+    else:
+        json.dump(trace, sys.stdout)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())